@@ -44,7 +44,9 @@ typedef enum {
     /** @brief Memory allocation failed */
     SIMPLECHESS_ERROR_OUT_OF_MEMORY = 3,
     /** @brief Unknown or unexpected error occurred */
-    SIMPLECHESS_ERROR_UNKNOWN = 4
+    SIMPLECHESS_ERROR_UNKNOWN = 4,
+    /** @brief Another thread changed the game first; nothing was changed */
+    SIMPLECHESS_ERROR_CONFLICT = 5
 } SimplechessResult;
 
 /**
@@ -135,6 +137,91 @@ typedef enum {
     SIMPLECHESS_CASTLING_BLACK_QUEENSIDE = 8
 } SimplechessCastlingRight;
 
+/**
+ * @brief Tablebase win/draw/loss result, from the side to move's perspective
+ *
+ * Cursed wins and blessed losses are positions that are won (lost) with
+ * perfect play but only by breaking the fifty-move rule, so they are draws
+ * under the rules of the game.
+ */
+typedef enum {
+    /** @brief The side to move loses */
+    SIMPLECHESS_WDL_LOSS = -2,
+    /** @brief The side to move loses, but the fifty-move rule saves it */
+    SIMPLECHESS_WDL_BLESSED_LOSS = -1,
+    /** @brief Draw */
+    SIMPLECHESS_WDL_DRAW = 0,
+    /** @brief The side to move wins, but not within the fifty-move rule */
+    SIMPLECHESS_WDL_CURSED_WIN = 1,
+    /** @brief The side to move wins */
+    SIMPLECHESS_WDL_WIN = 2
+} SimplechessWdl;
+
+/**
+ * @brief How a chess clock adds time
+ */
+typedef enum {
+    /** @brief Fischer increment: the bonus is added after every move */
+    SIMPLECHESS_CLOCK_INCREMENT = 0,
+    /** @brief Simple delay: the clock only starts running after the bonus */
+    SIMPLECHESS_CLOCK_DELAY = 1,
+    /** @brief Bronstein delay: time used, up to the bonus, is given back after the move */
+    SIMPLECHESS_CLOCK_BRONSTEIN = 2
+} SimplechessClockMode;
+
+/**
+ * @brief Memory layout of exported feature planes
+ */
+typedef enum {
+    /** @brief Position, plane, rank, file */
+    SIMPLECHESS_LAYOUT_NCHW = 0,
+    /** @brief Position, rank, file, plane */
+    SIMPLECHESS_LAYOUT_NHWC = 1
+} SimplechessTensorLayout;
+
+/**
+ * @brief Feature planes written by simplechess_export_planes_u8() and
+ * simplechess_export_planes_f32()
+ *
+ * Each plane is 8x8 with rank 1 first and file a first within a rank, from
+ * white's point of view. Scalar features fill their whole plane.
+ */
+typedef enum {
+    /** @brief First of the twelve piece planes: white pawn, knight, bishop,
+     *  rook, queen, king, then the same for black */
+    SIMPLECHESS_PLANE_PIECES = 0,
+    /** @brief 1 if white is to move */
+    SIMPLECHESS_PLANE_WHITE_TO_MOVE = 12,
+    /** @brief First of four castling planes, in SimplechessCastlingRight order */
+    SIMPLECHESS_PLANE_CASTLING = 13,
+    /** @brief 1 on the en passant square */
+    SIMPLECHESS_PLANE_EN_PASSANT = 17,
+    /** @brief The halfmove clock (saturated at 255 in the u8 export) */
+    SIMPLECHESS_PLANE_HALFMOVE_CLOCK = 18,
+    /** @brief Number of planes per position */
+    SIMPLECHESS_PLANE_COUNT = 19
+} SimplechessPlane;
+
+/**
+ * @brief Optional parts of the JSON written by simplechess_game_to_json()
+ */
+typedef enum {
+    /** @brief Include the legal moves of the side to move */
+    SIMPLECHESS_JSON_MOVES = 1,
+    /** @brief Include the clock reading */
+    SIMPLECHESS_JSON_CLOCK = 2
+} SimplechessJsonFlag;
+
+/**
+ * @brief Move generator answering the move queries of a manager's games
+ */
+typedef enum {
+    /** @brief The move sets computed by simple-chess-games */
+    SIMPLECHESS_MOVE_GENERATOR_DEFAULT = 0,
+    /** @brief The wrapper's bitboard generator, using check and pin masks */
+    SIMPLECHESS_MOVE_GENERATOR_BITBOARD = 1
+} SimplechessMoveGenerator;
+
 /**
  * @brief Represents a square on the chess board
  */
@@ -145,6 +232,14 @@ typedef struct {
     char file;
 } SimplechessSquare;
 
+/**
+ * @brief Set of squares, one bit per square
+ *
+ * Bit (rank - 1) * 8 + (file - 'a') stands for a square, so a1 is bit 0,
+ * h1 bit 7 and h8 bit 63.
+ */
+typedef uint64_t SimplechessSquareSet;
+
 /**
  * @brief Represents a chess piece
  */
@@ -181,6 +276,212 @@ typedef struct {
     SimplechessPiece piece;
 } SimplechessSquareAndPiece;
 
+/**
+ * @brief A square whose contents differ between two game stages
+ */
+typedef struct {
+    /** @brief The square */
+    SimplechessSquare square;
+    /** @brief True if the square is occupied in the later stage */
+    bool occupied;
+    /** @brief The piece now on the square (valid if occupied) */
+    SimplechessPiece piece;
+} SimplechessSquareChange;
+
+/**
+ * @brief Fields of SimplechessStageDiff that differ between the two stages
+ */
+typedef enum {
+    /** @brief The side to move changed */
+    SIMPLECHESS_STAGE_DIFF_ACTIVE_COLOR = 1,
+    /** @brief Castling rights changed */
+    SIMPLECHESS_STAGE_DIFF_CASTLING = 2,
+    /** @brief The en passant square changed */
+    SIMPLECHESS_STAGE_DIFF_EN_PASSANT = 4,
+    /** @brief The halfmove clock changed */
+    SIMPLECHESS_STAGE_DIFF_HALFMOVE_CLOCK = 8,
+    /** @brief The fullmove counter changed */
+    SIMPLECHESS_STAGE_DIFF_FULLMOVE_COUNTER = 16
+} SimplechessStageDiffField;
+
+/**
+ * @brief Everything but the board that can differ between two game stages
+ *
+ * The values are those of the later stage; changed tells which of them
+ * differ from the earlier one.
+ */
+typedef struct {
+    /** @brief Bitwise OR of SimplechessStageDiffField flags */
+    uint8_t changed;
+    /** @brief Side to move */
+    SimplechessColor active_color;
+    /** @brief Castling rights (SimplechessCastlingRight flags) */
+    uint8_t castling_rights;
+    /** @brief True if a pawn can be captured en passant */
+    bool has_en_passant;
+    /** @brief Square a pawn capturing en passant moves to (valid if has_en_passant) */
+    SimplechessSquare en_passant;
+    /** @brief Halfmoves since the last capture or pawn move */
+    uint16_t halfmove_clock;
+    /** @brief Fullmove counter */
+    uint16_t fullmove_counter;
+} SimplechessStageDiff;
+
+/**
+ * @brief Time control of a chess clock
+ */
+typedef struct {
+    /** @brief Starting time of each player in milliseconds */
+    uint64_t initial_ms;
+    /** @brief Increment or delay per move in milliseconds */
+    uint32_t bonus_ms;
+    /** @brief How the bonus is applied */
+    SimplechessClockMode mode;
+} SimplechessTimeControl;
+
+/**
+ * @brief Reading of a chess clock
+ */
+typedef struct {
+    /** @brief Time left to white in milliseconds */
+    uint64_t white_ms;
+    /** @brief Time left to black in milliseconds */
+    uint64_t black_ms;
+    /** @brief True while one of the clocks is running */
+    bool running;
+    /** @brief Player whose clock runs (valid if running) */
+    SimplechessColor running_color;
+    /** @brief True if the running player has run out of time */
+    bool flagged;
+} SimplechessClockState;
+
+/**
+ * @brief A clock whose flag fell, reported by simplechess_clock_service_advance()
+ */
+typedef struct {
+    /** @brief Id given to the clock when it was started */
+    uint64_t id;
+    /** @brief Player who ran out of time */
+    SimplechessColor flagged;
+} SimplechessClockEvent;
+
+/**
+ * @brief Contents of a broadcast update
+ *
+ * The SAN, the FEN and the delta lie back to back in one buffer, in that
+ * order, each string followed by its terminating NUL, so the whole update
+ * can be sent with a single write of message_size bytes from message.
+ *
+ * The delta is the binary form of simplechess_game_get_last_move_diff()
+ * (for the first stage of a game, of the difference from an empty board,
+ * with all fields flagged as changed). Integers are little-endian:
+ *
+ *   u8 number of changed squares, then for each square u8 index
+ *   ((rank - 1) * 8 + file - 'a') and u8 piece (0 if the square is empty,
+ *   otherwise SimplechessPieceType + 1, plus 8 for black);
+ *   u8 SimplechessStageDiffField flags, u8 active color, u8 castling
+ *   rights, u8 en passant square index or 0xFF, u16 halfmove clock,
+ *   u16 fullmove counter.
+ *
+ * All pointers stay valid while the update is referenced.
+ */
+typedef struct {
+    /** @brief Number of moves played (the index of the stage in the game history) */
+    size_t ply;
+    /** @brief Algebraic notation of the last move, empty for the first stage */
+    const char* san;
+    /** @brief Length of san, without the terminating NUL */
+    size_t san_length;
+    /** @brief FEN of the position */
+    const char* fen;
+    /** @brief Length of fen, without the terminating NUL */
+    size_t fen_length;
+    /** @brief Binary delta from the previous stage */
+    const uint8_t* delta;
+    /** @brief Size of delta in bytes */
+    size_t delta_size;
+    /** @brief Start of the buffer holding san, fen and delta */
+    const uint8_t* message;
+    /** @brief Size of the whole buffer in bytes */
+    size_t message_size;
+} SimplechessUpdateView;
+
+/**
+ * @brief 128-bit Zobrist hash of a position
+ *
+ * Covers the placement of the pieces, the side to move, the castling rights
+ * and the en passant file when an en passant capture is possible, but not
+ * the move clocks. Hashes are stable across runs and library versions.
+ */
+typedef struct {
+    /** @brief Low 64 bits */
+    uint64_t lo;
+    /** @brief High 64 bits */
+    uint64_t hi;
+} SimplechessPositionHash;
+
+/**
+ * @brief Counters of a position deduplicator
+ */
+typedef struct {
+    /** @brief Hashes inserted, including duplicates */
+    uint64_t positions;
+    /** @brief Distinct hashes inserted */
+    uint64_t unique;
+    /** @brief New hashes recognized by the Bloom filter alone */
+    uint64_t bloom_new;
+    /** @brief Blocks read from disk to resolve Bloom filter hits */
+    uint64_t disk_probes;
+    /** @brief Hashes moved from memory to disk so far */
+    uint64_t spilled;
+    /** @brief Sorted runs currently on disk */
+    size_t runs;
+} SimplechessDedupStats;
+
+/**
+ * @brief Counters of a game manager's game interning
+ */
+typedef struct {
+    /** @brief Games looked up, by FEN or by parent game and move */
+    uint64_t lookups;
+    /** @brief Lookups answered with a game already held by another handle */
+    uint64_t hits;
+    /** @brief Entries in the tables, including released games not yet swept */
+    size_t entries;
+} SimplechessInternStats;
+
+/**
+ * @brief Counters of a game manager's FEN cache
+ */
+typedef struct {
+    /** @brief Games created from a cached FEN */
+    uint64_t hits;
+    /** @brief Games created from a FEN that was not cached */
+    uint64_t misses;
+    /** @brief Games dropped from the cache to make room */
+    uint64_t evictions;
+    /** @brief Games currently in the cache */
+    size_t entries;
+} SimplechessFenCacheStats;
+
+/**
+ * @brief Receives the clocks whose flag fell during one advance
+ *
+ * @param user_data Pointer passed to simplechess_clock_service_advance()
+ * @param events Flag events, valid only during the call
+ * @param count Number of events
+ */
+typedef void (*SimplechessClockCallback)(void* user_data, const SimplechessClockEvent* events, size_t count);
+
+/**
+ * @brief Receives the legal moves of a game one at a time
+ *
+ * @param user_data Pointer passed to simplechess_game_for_each_move()
+ * @param move The move, valid only during the call
+ * @return true to receive the next move, false to stop
+ */
+typedef bool (*SimplechessMoveCallback)(void* user_data, const SimplechessPieceMove* move);
+
 /**
  * @brief Opaque handle to a game manager
  *
@@ -223,6 +524,65 @@ typedef void* SimplechessPlayedMove;
  */
 typedef void* SimplechessBoard;
 
+/**
+ * @brief Opaque handle to a set of Syzygy endgame tablebases
+ *
+ * Tablebases must be destroyed with simplechess_tablebase_destroy().
+ * A tablebase handle may be shared by several threads.
+ */
+typedef void* SimplechessTablebase;
+
+/**
+ * @brief Opaque handle to a session store
+ *
+ * A session store maps 64-bit game ids to live games and may be used from
+ * several threads at once. It must be destroyed with
+ * simplechess_session_store_destroy().
+ */
+typedef void* SimplechessSessionStore;
+
+/**
+ * @brief Opaque handle to an open snapshot file
+ *
+ * Snapshots must be closed with simplechess_snapshot_close().
+ */
+typedef void* SimplechessSnapshot;
+
+/**
+ * @brief Opaque handle to an open move log
+ *
+ * A move log records the changes made through a session store so they
+ * survive a crash. It may be used from several threads at once and must be
+ * closed with simplechess_move_log_close().
+ */
+typedef void* SimplechessMoveLog;
+
+/**
+ * @brief Opaque handle to a clock service
+ *
+ * A clock service keeps the time for the chess clocks started on it and
+ * reports fallen flags. It must be destroyed with
+ * simplechess_clock_service_destroy().
+ */
+typedef void* SimplechessClockService;
+
+/**
+ * @brief Opaque, reference-counted handle to the broadcast update of a game
+ *
+ * An update is immutable and may be shared by any number of threads. Each
+ * holder of a reference releases it with simplechess_update_release().
+ */
+typedef void* SimplechessUpdate;
+
+/**
+ * @brief Opaque handle to a position deduplicator
+ *
+ * A deduplicator remembers the position hashes inserted into it, in bounded
+ * memory, and may be used from several threads at once. It must be
+ * destroyed with simplechess_dedup_destroy().
+ */
+typedef void* SimplechessDedup;
+
 /* ========================================================================== */
 /* Game Manager Functions                                                     */
 /* ========================================================================== */
@@ -242,6 +602,128 @@ typedef void* SimplechessBoard;
  */
 SimplechessResult simplechess_game_manager_create(SimplechessGameManager* manager);
 
+/**
+ * @brief Create a game manager with a choice of move generator
+ *
+ * Games created or restored through the manager, the games that follow
+ * them and the games of session stores created with it answer
+ * simplechess_game_get_available_moves(),
+ * simplechess_game_get_moves_for_piece(), their count functions and
+ * simplechess_game_perft() with the given generator. Both generators give
+ * the same moves, possibly in a different order. Moves are still validated
+ * and played by simple-chess-games.
+ *
+ * simplechess_game_manager_create() uses SIMPLECHESS_MOVE_GENERATOR_DEFAULT.
+ *
+ * @param generator The move generator
+ * @param[out] manager Pointer to store the created manager handle
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if manager is NULL or generator is unknown
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_game_manager_create_with_move_generator(SimplechessMoveGenerator generator,
+                                                                      SimplechessGameManager* manager);
+
+/**
+ * @brief Make the manager's games keep a compact history
+ *
+ * By default every stage of a game's history holds its own board and FEN.
+ * In compact mode, once a game has at least checkpoint_interval stages
+ * before its last capture or pawn move, those stages are replaced by their
+ * moves, two bytes each, and the FEN of every checkpoint_interval-th stage.
+ * Earlier positions cannot repeat, so draw rules are unaffected.
+ * simplechess_game_get_stage_at() rebuilds such stages by replaying at most
+ * checkpoint_interval moves, and keeps recently rebuilt stages in a small
+ * cache shared by all games, so walking a history in order replays one
+ * move per stage.
+ *
+ * Applies to games created or restored through the manager afterwards, the
+ * games that follow them, and the games of session stores created with the
+ * manager afterwards. Set it before sharing the manager between threads.
+ *
+ * @param manager Manager handle
+ * @param checkpoint_interval Plies between checkpoints, or 0 to keep full
+ *                            histories
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if manager is NULL
+ */
+SimplechessResult simplechess_game_manager_set_compact_history(SimplechessGameManager manager, unsigned checkpoint_interval);
+
+/**
+ * @brief Make the manager's games share identical game states
+ *
+ * Games created from the same FEN, and games that follow them by the same
+ * moves, hold identical histories. With interning on, the manager hands out
+ * one shared instance of each such game for as long as any handle holds it,
+ * instead of a copy per handle, and answers repeated moves without replaying
+ * them. This suits servers running many games through the same openings.
+ * Games are shared for their first max_ply plies; beyond that each game is
+ * computed and stored on its own as usual.
+ *
+ * Applies to games created and moves made through the manager afterwards,
+ * and to the session stores created with the manager afterwards. Set it
+ * before sharing the manager between threads; the interning itself is
+ * thread-safe.
+ *
+ * @param manager Manager handle
+ * @param max_ply Plies for which games are shared, or 0 to turn interning off
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if manager is NULL
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_game_manager_set_game_interning(SimplechessGameManager manager, unsigned max_ply);
+
+/**
+ * @brief Get the counters of a manager's game interning
+ *
+ * All counters are zero while interning is off.
+ *
+ * @param manager Manager handle
+ * @param[out] stats Pointer to store the counters
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if manager or stats is NULL
+ */
+SimplechessResult simplechess_game_manager_get_interning_stats(SimplechessGameManager manager, SimplechessInternStats* stats);
+
+/**
+ * @brief Make the manager cache the games it creates from FENs
+ *
+ * The manager keeps the capacity games it most recently created with
+ * simplechess_create_game_from_fen() or simplechess_session_store_create_game(),
+ * keyed by their FEN with whitespace normalized, along with their legal
+ * moves. Creating a game from a cached FEN returns a copy sharing the cached
+ * game, without parsing the FEN again. When the cache is full, the least
+ * recently used game is dropped. FENs that fail to parse are not cached.
+ *
+ * Set it before sharing the manager between threads; the cache itself is
+ * thread-safe. Setting it again starts an empty cache.
+ *
+ * @param manager Manager handle
+ * @param capacity Maximum number of cached games, or 0 to turn the cache off
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if manager is NULL
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_game_manager_set_fen_cache(SimplechessGameManager manager, size_t capacity);
+
+/**
+ * @brief Get the counters of a manager's FEN cache
+ *
+ * All counters are zero while the cache is off.
+ *
+ * @param manager Manager handle
+ * @param[out] stats Pointer to store the counters
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if manager or stats is NULL
+ */
+SimplechessResult simplechess_game_manager_get_fen_cache_stats(SimplechessGameManager manager, SimplechessFenCacheStats* stats);
+
 /**
  * @brief Destroy a game manager
  *
@@ -260,7 +742,9 @@ void simplechess_game_manager_destroy(SimplechessGameManager manager);
  * @brief Create a new game from the standard starting position
  *
  * Creates a new chess game in the standard starting position with
- * white to move first.
+ * white to move first. The manager builds the starting position and its
+ * legal moves once, on first use; new games share them, so creating a game
+ * only allocates its handle.
  *
  * @param manager Game manager handle
  * @param[out] game Pointer to store the created game handle
@@ -307,7 +791,8 @@ SimplechessResult simplechess_create_game_from_fen(SimplechessGameManager manage
  * @return SIMPLECHESS_SUCCESS on success, error code on failure
  *
  * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
- * @retval SIMPLECHESS_ERROR_ILLEGAL_STATE if game is over or move is invalid
+ * @retval SIMPLECHESS_ERROR_ILLEGAL_STATE if game is over (including on
+ *         time, see simplechess_game_start_clock) or move is invalid
  * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
  */
 SimplechessResult simplechess_make_move(
@@ -360,7 +845,8 @@ SimplechessResult simplechess_resign(SimplechessGameManager manager, Simplechess
  * @brief Get the current state of the game
  *
  * Returns whether the game is still in progress or has ended, and if
- * ended, how it ended.
+ * ended, how it ended. A game with a chess clock is over once the flag of
+ * the player to move has fallen (see simplechess_game_start_clock()).
  *
  * @param game Game handle
  * @param[out] state Pointer to store the game state
@@ -374,7 +860,9 @@ SimplechessResult simplechess_game_get_state(SimplechessGame game, SimplechessGa
  * @brief Get the reason why the game was drawn
  *
  * Returns the specific reason for the draw. Only valid if the game
- * state is SIMPLECHESS_GAME_STATE_DRAWN.
+ * state is SIMPLECHESS_GAME_STATE_DRAWN. A draw because a flag fell while
+ * the opponent had only the king is reported as
+ * SIMPLECHESS_DRAW_REASON_INSUFFICIENT_MATERIAL.
  *
  * @param game Game handle
  * @param[out] reason Pointer to store the draw reason
@@ -479,6 +967,197 @@ SimplechessResult simplechess_game_get_moves_for_piece_count(SimplechessGame gam
  */
 SimplechessResult simplechess_game_get_moves_for_piece(SimplechessGame game, const SimplechessSquare* square, SimplechessPieceMove* moves, size_t moves_size);
 
+/**
+ * @brief Call a function for each legal move of a game until it says stop
+ *
+ * Passes the moves of simplechess_game_get_available_moves() one at a time,
+ * without an array to size first. With the bitboard move generator, moves
+ * are generated as they are passed, so stopping early, such as on the
+ * first move matching a condition, skips generating the rest.
+ *
+ * @param game Game handle
+ * @param callback Function receiving each move; returns false to stop
+ * @param user_data Pointer passed to callback
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if game or callback is NULL
+ */
+SimplechessResult simplechess_game_for_each_move(SimplechessGame game, SimplechessMoveCallback callback, void* user_data);
+
+/**
+ * @brief Check whether the side to move has a legal move
+ *
+ * Cheaper than counting the moves: with the bitboard move generator, it
+ * stops at the first legal move found. Together with
+ * simplechess_game_get_attackers() on the king, it tells checkmate from
+ * stalemate. A game that is over has no legal moves.
+ *
+ * @param game Game handle
+ * @param[out] has_move Pointer to store whether there is a legal move
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_game_has_legal_move(SimplechessGame game, bool* has_move);
+
+/**
+ * @brief Get all legal moves of a game grouped by source square
+ *
+ * Fills moves with the moves of simplechess_game_get_available_moves(),
+ * ordered by source square, and offsets with where each square's moves
+ * start: the moves from the square with index i = (rank - 1) * 8 +
+ * (file - 'a') are moves[offsets[i]] to moves[offsets[i + 1] - 1], and
+ * offsets[64] is the number of moves. This replaces a count and a list
+ * call for each piece with a single call.
+ *
+ * @param game Game handle
+ * @param[out] offsets Array of 65 offsets into moves
+ * @param[out] moves Array to store the moves
+ * @param moves_size Number of elements in moves
+ * @param[out] destinations Optional array of 64 sets of the destination
+ *                          squares of each source square, or NULL
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if game, offsets or moves is
+ *         NULL, or moves is too small
+ */
+SimplechessResult simplechess_game_get_moves_by_square(SimplechessGame game, uint16_t offsets[65], SimplechessPieceMove* moves,
+                                                       size_t moves_size, SimplechessSquareSet destinations[64]);
+
+/**
+ * @brief Get the destination squares of the legal moves from each square
+ *
+ * masks[i] holds the squares that the piece on the square with index
+ * i = (rank - 1) * 8 + (file - 'a') can legally move to, and is empty for
+ * squares without a movable piece of the side to move. A promotion counts
+ * once. With the bitboard move generator, the masks are computed without
+ * building a move list, so this suits highlighting and mobility counts,
+ * which do not need the moves themselves.
+ *
+ * @param game Game handle
+ * @param[out] masks Array of 64 destination sets
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_game_get_move_masks(SimplechessGame game, SimplechessSquareSet masks[64]);
+
+/**
+ * @brief Get the captures and promotions of a game, best first
+ *
+ * The first of three stages that split the legal moves of a game without
+ * overlap, for searches that look at captures first and often stop there:
+ * captures (en passant included) and promotions, then quiet moves giving
+ * check (simplechess_game_get_quiet_checks()), then the remaining quiet
+ * moves (simplechess_game_get_quiet_moves()).
+ *
+ * Captures are ordered by MVV-LVA: the most valuable victim first and,
+ * for the same victim, the least valuable attacker first. A promotion
+ * counts as capturing the promoted piece's value less a pawn.
+ *
+ * @param game Game handle
+ * @param[out] moves Array to store the moves
+ * @param moves_size Number of elements in moves; 256 is always enough
+ * @param[out] count Pointer to store the number of moves in the stage, also
+ *                   when moves is too small
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any pointer is NULL or
+ *         moves is too small
+ */
+SimplechessResult simplechess_game_get_captures(SimplechessGame game, SimplechessPieceMove* moves, size_t moves_size, size_t* count);
+
+/**
+ * @brief Get the moves of a game that give check without capturing
+ *
+ * The second stage of simplechess_game_get_captures(): legal moves that
+ * neither capture nor promote and leave the opponent in check, in
+ * generation order.
+ *
+ * @param game Game handle
+ * @param[out] moves Array to store the moves
+ * @param moves_size Number of elements in moves
+ * @param[out] count Pointer to store the number of moves in the stage
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any pointer is NULL or
+ *         moves is too small
+ */
+SimplechessResult simplechess_game_get_quiet_checks(SimplechessGame game, SimplechessPieceMove* moves, size_t moves_size, size_t* count);
+
+/**
+ * @brief Get the quiet moves of a game that do not give check
+ *
+ * The last stage of simplechess_game_get_captures(): legal moves that
+ * neither capture, promote nor give check, in generation order.
+ *
+ * @param game Game handle
+ * @param[out] moves Array to store the moves
+ * @param moves_size Number of elements in moves
+ * @param[out] count Pointer to store the number of moves in the stage
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any pointer is NULL or
+ *         moves is too small
+ */
+SimplechessResult simplechess_game_get_quiet_moves(SimplechessGame game, SimplechessPieceMove* moves, size_t moves_size, size_t* count);
+
+/**
+ * @brief Count the leaves of the legal move tree of a game
+ *
+ * Counts the move sequences of the given length from the current position,
+ * using the move generator of the game's manager. The default generator
+ * plays every move through simple-chess-games, so lines end where the game
+ * ends (including automatic draws such as insufficient material); the
+ * bitboard generator only looks at the board, ending lines at checkmate and
+ * stalemate. Both agree on the standard perft positions.
+ *
+ * @param game Game handle
+ * @param depth Number of plies
+ * @param[out] nodes Pointer to store the number of leaves
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_game_perft(SimplechessGame game, unsigned depth, uint64_t* nodes);
+
+/* ========================================================================== */
+/* Attack Functions                                                           */
+/* ========================================================================== */
+
+/**
+ * @brief Get the squares attacked by one side
+ *
+ * A square is attacked when a piece of the given color could capture on it
+ * if an enemy piece stood there, regardless of pins and of whose turn it
+ * is. Sliding piece attacks come from precomputed tables, indexed with the
+ * BMI2 PEXT instruction on processors where it is fast and by magic
+ * multiplication elsewhere; the choice is made once per process.
+ *
+ * @param game Game handle
+ * @param by Color of the attacking side
+ * @param[out] squares Pointer to store the attacked squares
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_game_get_attacked_squares(SimplechessGame game, SimplechessColor by, SimplechessSquareSet* squares);
+
+/**
+ * @brief Get the pieces of one side attacking a square
+ *
+ * @param game Game handle
+ * @param square The square to query; it may be empty or hold a piece of
+ *               either color
+ * @param by Color of the attacking side
+ * @param[out] attackers Pointer to store the squares of the attacking pieces
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL or the square is off the board
+ */
+SimplechessResult simplechess_game_get_attackers(SimplechessGame game, const SimplechessSquare* square, SimplechessColor by,
+                                                 SimplechessSquareSet* attackers);
+
 /* ========================================================================== */
 /* Game History Functions                                                     */
 /* ========================================================================== */
@@ -629,7 +1308,62 @@ SimplechessResult simplechess_stage_get_fullmove_counter(SimplechessGameStage st
  */
 SimplechessResult simplechess_stage_get_fen(SimplechessGameStage stage, char* buffer, size_t buffer_size);
 
-/* ========================================================================== */
+/**
+ * @brief Get the differences between two game stages
+ *
+ * Lists the squares whose contents differ between the stages, ordered
+ * from a1 to h8, along with the side to move, castling rights, en passant
+ * square and move counters of the later stage. A client that holds the
+ * earlier position can apply the changes instead of parsing a full FEN:
+ * a regular move changes two squares, castling and en passant three or
+ * four. At most 64 squares can change.
+ *
+ * The stages need not come from the same game.
+ *
+ * @param from Earlier game stage
+ * @param to Later game stage
+ * @param[out] changes Array to store the changed squares (may be NULL if changes_size is 0)
+ * @param changes_size Size of the changes array
+ * @param[out] count Pointer to store the number of changed squares; set
+ *             even if the array is too small
+ * @param[out] diff Pointer to store the other differences (may be NULL)
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if a required parameter is NULL or the array is too small
+ */
+SimplechessResult simplechess_stage_diff(
+    SimplechessGameStage from,
+    SimplechessGameStage to,
+    SimplechessSquareChange* changes,
+    size_t changes_size,
+    size_t* count,
+    SimplechessStageDiff* diff);
+
+/**
+ * @brief Get the differences made by the last move of a game
+ *
+ * Equivalent to simplechess_stage_diff() between the last two stages of
+ * the game's history, without creating stage handles.
+ *
+ * @param game Game handle
+ * @param[out] changes Array to store the changed squares (may be NULL if changes_size is 0)
+ * @param changes_size Size of the changes array
+ * @param[out] count Pointer to store the number of changed squares; set
+ *             even if the array is too small
+ * @param[out] diff Pointer to store the other differences (may be NULL)
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if a required parameter is NULL or the array is too small
+ * @retval SIMPLECHESS_ERROR_ILLEGAL_STATE if no move has been played
+ */
+SimplechessResult simplechess_game_get_last_move_diff(
+    SimplechessGame game,
+    SimplechessSquareChange* changes,
+    size_t changes_size,
+    size_t* count,
+    SimplechessStageDiff* diff);
+
+/* ========================================================================== */
 /* Played Move Functions                                                      */
 /* ========================================================================== */
 
@@ -820,6 +1554,900 @@ SimplechessResult simplechess_game_get_castling_rights(SimplechessGame game, uin
  */
 SimplechessResult simplechess_game_get_current_board(SimplechessGame game, SimplechessBoard* board);
 
+/**
+ * @brief Get the memory held by a game
+ *
+ * Estimates the heap bytes reachable from the game handle: the handle, the
+ * stages of its history with their boards, FEN strings and played moves,
+ * the cached move set, and the wrapper's history prefix, clock with its
+ * timer, caches and update message once built.
+ * Handles duplicated from one another share most of this, so the sizes of
+ * such handles do not add up; use simplechess_session_store_memory_usage()
+ * for the total of many games. Allocator overhead is not counted.
+ *
+ * @param game Game handle
+ * @param[out] bytes Pointer to store the number of bytes
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_game_memory_usage(SimplechessGame game, size_t* bytes);
+
+/* ========================================================================== */
+/* Tablebase Functions                                                        */
+/* ========================================================================== */
+
+/**
+ * @brief Open the Syzygy tablebases found in one or more directories
+ *
+ * Scans the directories for WDL (.rtbw) tables and the matching DTZ (.rtbz)
+ * tables. Files are not read at this point: each table is memory-mapped the
+ * first time a position needs it. Directories that do not exist are ignored,
+ * in which case the tablebase simply covers no positions.
+ *
+ * @param paths Directories to scan, separated by ':'
+ * @param[out] tablebase Pointer to store the tablebase handle
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_tablebase_open(const char* paths, SimplechessTablebase* tablebase);
+
+/**
+ * @brief Destroy a tablebase handle
+ *
+ * Unmaps every table that was opened. Games probed through the handle are
+ * not affected.
+ *
+ * @param tablebase Tablebase handle to destroy (can be NULL)
+ */
+void simplechess_tablebase_destroy(SimplechessTablebase tablebase);
+
+/**
+ * @brief Get the largest number of pieces covered by the tablebases
+ *
+ * @param tablebase Tablebase handle
+ * @param[out] max_pieces Pointer to store the piece count (0 if no tables were found)
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_tablebase_get_max_pieces(SimplechessTablebase tablebase, uint8_t* max_pieces);
+
+/**
+ * @brief Look up the win/draw/loss result of the current position
+ *
+ * The result is given from the point of view of the side to move and
+ * assumes perfect play from both sides.
+ *
+ * @param tablebase Tablebase handle
+ * @param game Game handle
+ * @param[out] wdl Pointer to store the result
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ * @retval SIMPLECHESS_ERROR_ILLEGAL_STATE if the game is over, castling is
+ *         still possible, or no table covers the position
+ */
+SimplechessResult simplechess_tablebase_probe_wdl(SimplechessTablebase tablebase, SimplechessGame game, SimplechessWdl* wdl);
+
+/**
+ * @brief Look up the distance to zeroing of the current position
+ *
+ * The distance to zeroing (DTZ) is the number of plies until the next capture
+ * or pawn move when the winning side plays optimally. It is positive if the
+ * side to move wins, negative if it loses and 0 for draws. Cursed wins and
+ * blessed losses are reported with an extra 100 plies.
+ *
+ * @param tablebase Tablebase handle
+ * @param game Game handle
+ * @param[out] dtz Pointer to store the distance in plies
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ * @retval SIMPLECHESS_ERROR_ILLEGAL_STATE if the game is over, castling is
+ *         still possible, or no table covers the position
+ */
+SimplechessResult simplechess_tablebase_probe_dtz(SimplechessTablebase tablebase, SimplechessGame game, int* dtz);
+
+/**
+ * @brief Get the state of the game, adjudicating covered endgames
+ *
+ * Behaves like simplechess_game_get_state(). In addition, if the game is
+ * still in progress and the tablebase covers the current position, the
+ * theoretical result is returned instead: a win for the side that wins with
+ * perfect play, or a draw (including cursed wins and blessed losses).
+ * A win is a draw too if the moves already played without a capture or pawn
+ * move plus its DTZ exceed the fifty-move rule; if that cannot be checked
+ * because the DTZ table is missing, the state is not adjudicated.
+ *
+ * @param game Game handle
+ * @param tablebase Tablebase handle (can be NULL to disable adjudication)
+ * @param[out] state Pointer to store the game state
+ * @param[out] adjudicated Pointer to store whether the state comes from the tablebase
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if game, state or adjudicated is NULL
+ */
+SimplechessResult simplechess_game_get_adjudicated_state(SimplechessGame game, SimplechessTablebase tablebase,
+                                                         SimplechessGameState* state, bool* adjudicated);
+
+/* ========================================================================== */
+/* Session Store Functions                                                    */
+/* ========================================================================== */
+
+/**
+ * @brief Create a session store
+ *
+ * Games are distributed over shards by id and each shard has its own lock,
+ * so threads working on different games rarely contend. Moves are applied
+ * to the stored game in place: there is no handle to swap after each move.
+ *
+ * @note The manager must outlive the store.
+ *
+ * @param manager Game manager used to create games and apply moves
+ * @param shard_count Number of shards, rounded up to a power of two (0 for the default of 64)
+ * @param[out] store Pointer to store the created session store handle
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if manager or store is NULL
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_session_store_create(SimplechessGameManager manager, size_t shard_count, SimplechessSessionStore* store);
+
+/**
+ * @brief Destroy a session store and every game it holds
+ *
+ * Game handles previously returned by simplechess_session_store_lookup()
+ * remain valid.
+ *
+ * @param store Session store handle to destroy (can be NULL)
+ */
+void simplechess_session_store_destroy(SimplechessSessionStore store);
+
+/**
+ * @brief Create a game in the store
+ *
+ * @param store Session store handle
+ * @param id Id of the new game
+ * @param fen FEN string of the initial position, or NULL for the standard starting position
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if store is NULL, the FEN is
+ *         invalid or the id is already in use
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_session_store_create_game(SimplechessSessionStore store, uint64_t id, const char* fen);
+
+/**
+ * @brief Add an existing game to the store
+ *
+ * The store keeps its own reference to the game; the caller still owns the
+ * handle and must destroy it.
+ *
+ * @param store Session store handle
+ * @param id Id of the game
+ * @param game Game handle
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any handle is NULL or the id is already in use
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_session_store_insert(SimplechessSessionStore store, uint64_t id, SimplechessGame game);
+
+/**
+ * @brief Get the current state of a stored game
+ *
+ * Returns a new handle to the game as it is now. Games are immutable, so
+ * this does not copy the game, and the handle is not affected by later
+ * moves applied through the store. It must be destroyed with
+ * simplechess_game_destroy().
+ *
+ * @param store Session store handle
+ * @param id Id of the game
+ * @param[out] game Pointer to store the game handle
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any pointer is NULL or there is no game with this id
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_session_store_lookup(SimplechessSessionStore store, uint64_t id, SimplechessGame* game);
+
+/**
+ * @brief Make a move in a stored game
+ *
+ * The move is validated and applied outside the store's locks, then
+ * published atomically. If another thread changed the same game meanwhile,
+ * the move is not played, since it was chosen for the earlier position, and
+ * SIMPLECHESS_ERROR_CONFLICT is returned; the caller may look the game up
+ * again and decide whether to retry.
+ *
+ * @param store Session store handle
+ * @param id Id of the game
+ * @param move The move to make
+ * @param offer_draw True if the move includes a draw offer
+ * @param[out] state Pointer to store the resulting game state (can be NULL)
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if store or move is NULL or there is no game with this id
+ * @retval SIMPLECHESS_ERROR_ILLEGAL_STATE if game is over or move is invalid
+ * @retval SIMPLECHESS_ERROR_CONFLICT if another thread changed the game first
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_session_store_make_move(SimplechessSessionStore store, uint64_t id, const SimplechessPieceMove* move,
+                                                      bool offer_draw, SimplechessGameState* state);
+
+/**
+ * @brief Claim a draw in a stored game
+ *
+ * @param store Session store handle
+ * @param id Id of the game
+ * @param[out] state Pointer to store the resulting game state (can be NULL)
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if store is NULL or there is no game with this id
+ * @retval SIMPLECHESS_ERROR_ILLEGAL_STATE if no draw can be claimed
+ */
+SimplechessResult simplechess_session_store_claim_draw(SimplechessSessionStore store, uint64_t id, SimplechessGameState* state);
+
+/**
+ * @brief Resign a stored game
+ *
+ * @param store Session store handle
+ * @param id Id of the game
+ * @param resigning_player Color of the player who resigns
+ * @param[out] state Pointer to store the resulting game state (can be NULL)
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if store is NULL or there is no game with this id
+ * @retval SIMPLECHESS_ERROR_ILLEGAL_STATE if game is already over
+ */
+SimplechessResult simplechess_session_store_resign(SimplechessSessionStore store, uint64_t id, SimplechessColor resigning_player,
+                                                   SimplechessGameState* state);
+
+/**
+ * @brief Remove a game from the store
+ *
+ * @param store Session store handle
+ * @param id Id of the game
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if store is NULL or there is no game with this id
+ */
+SimplechessResult simplechess_session_store_remove(SimplechessSessionStore store, uint64_t id);
+
+/**
+ * @brief Get the number of games in the store
+ *
+ * @param store Session store handle
+ * @param[out] count Pointer to store the number of games
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_session_store_count(SimplechessSessionStore store, size_t* count);
+
+/**
+ * @brief Get the memory held by a session store and its games
+ *
+ * Adds up the store's tables and the memory of every stored game as
+ * simplechess_game_memory_usage() reports it, counting data shared by
+ * several games once. Shards are visited one at a time, so the total is
+ * not a snapshot of a store that changes meanwhile.
+ *
+ * @param store Session store handle
+ * @param[out] bytes Pointer to store the number of bytes
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_session_store_memory_usage(SimplechessSessionStore store, size_t* bytes);
+
+/* ========================================================================== */
+/* Snapshot Functions                                                         */
+/* ========================================================================== */
+
+/**
+ * @brief Write a set of games to a snapshot file
+ *
+ * Each game is stored as its initial FEN and its moves. The file is written
+ * next to its final path, synced and then renamed, so an existing snapshot
+ * at path is only replaced by a complete one.
+ *
+ * @param path Path of the snapshot file
+ * @param games Array of game handles
+ * @param ids Ids to store with the games, or NULL to use their array indices
+ * @param count Number of games
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if path is NULL, a game handle is
+ *         NULL or the file cannot be created
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ * @retval SIMPLECHESS_ERROR_UNKNOWN if writing the file fails
+ */
+SimplechessResult simplechess_snapshot_write_games(const char* path, const SimplechessGame* games, const uint64_t* ids, size_t count);
+
+/**
+ * @brief Write every game of a session store to a snapshot file
+ *
+ * The games are copied at a single point in time and then written without
+ * blocking the store. If a move log is attached to the store, the snapshot
+ * records the sequence number of the last logged change it contains.
+ *
+ * @param path Path of the snapshot file
+ * @param store Session store handle
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL or the file cannot be created
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ * @retval SIMPLECHESS_ERROR_UNKNOWN if writing the file fails
+ */
+SimplechessResult simplechess_snapshot_write_store(const char* path, SimplechessSessionStore store);
+
+/**
+ * @brief Open a snapshot file
+ *
+ * The file is memory-mapped and its checksum verified.
+ *
+ * @param path Path of the snapshot file
+ * @param[out] snapshot Pointer to store the snapshot handle
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL, or the
+ *         file cannot be read, is not a snapshot or is corrupt
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_snapshot_open(const char* path, SimplechessSnapshot* snapshot);
+
+/**
+ * @brief Close a snapshot file
+ *
+ * Games restored from the snapshot remain valid.
+ *
+ * @param snapshot Snapshot handle to close (can be NULL)
+ */
+void simplechess_snapshot_close(SimplechessSnapshot snapshot);
+
+/**
+ * @brief Get the number of games in a snapshot
+ *
+ * @param snapshot Snapshot handle
+ * @param[out] count Pointer to store the number of games
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_snapshot_get_count(SimplechessSnapshot snapshot, size_t* count);
+
+/**
+ * @brief Restore one game from a snapshot
+ *
+ * The game is rebuilt from its last capture or pawn move: only the moves
+ * played after it are replayed. Earlier stages are still available through
+ * simplechess_game_get_stage_at(), which recreates them when asked for.
+ *
+ * @param snapshot Snapshot handle
+ * @param manager Game manager handle
+ * @param index Index of the game in the snapshot (0-based)
+ * @param[out] id Pointer to store the id of the game (can be NULL)
+ * @param[out] game Pointer to store the game handle
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if snapshot, manager or game is
+ *         NULL, or index is out of range
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_snapshot_restore_game(SimplechessSnapshot snapshot, SimplechessGameManager manager, size_t index,
+                                                    uint64_t* id, SimplechessGame* game);
+
+/**
+ * @brief Restore every game of a snapshot into a session store
+ *
+ * @param snapshot Snapshot handle
+ * @param store Session store handle
+ * @param threads Number of threads restoring games (0 for one per CPU)
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any handle is NULL or an id
+ *         of the snapshot is already in use in the store
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_snapshot_restore_store(SimplechessSnapshot snapshot, SimplechessSessionStore store, size_t threads);
+
+/* ========================================================================== */
+/* Move Log Functions                                                         */
+/* ========================================================================== */
+
+/**
+ * @brief Open or create a move log
+ *
+ * Once attached to a session store with
+ * simplechess_session_store_set_move_log(), every game created, inserted,
+ * moved, drawn, resigned or removed through the store is appended to the
+ * log and numbered with a log sequence number (LSN). Appending only queues
+ * the record; a background thread writes all queued records and syncs them
+ * to disk together, so one sync covers the moves of many games.
+ *
+ * If the file exists, records after the last complete one (a write cut
+ * short by a crash) are discarded and numbering continues after it.
+ *
+ * @param path Path of the log file
+ * @param[out] log Pointer to store the move log handle
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL, the
+ *         file cannot be opened or is not a move log
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ * @retval SIMPLECHESS_ERROR_UNKNOWN if writing the file fails
+ */
+SimplechessResult simplechess_move_log_open(const char* path, SimplechessMoveLog* log);
+
+/**
+ * @brief Close a move log
+ *
+ * Records still queued are written and synced first. Detach the log from
+ * every session store before closing it.
+ *
+ * @param log Move log handle to close (can be NULL)
+ */
+void simplechess_move_log_close(SimplechessMoveLog log);
+
+/**
+ * @brief Attach a move log to a session store
+ *
+ * Games already in the store are first appended to the log as full game
+ * records, so that simplechess_move_log_recover() rebuilds them too. A
+ * game record replaces the game of the same id on replay, so attaching the
+ * log a store was just recovered from is also correct; it only grows the
+ * log until the next simplechess_move_log_checkpoint(). Changes to the
+ * store wait while the records are written.
+ *
+ * @param store Session store handle
+ * @param log Move log handle, or NULL to stop logging
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if store is NULL
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_session_store_set_move_log(SimplechessSessionStore store, SimplechessMoveLog log);
+
+/**
+ * @brief Get the sequence numbers of a move log
+ *
+ * A change made through the store is covered by the last LSN read after
+ * the call that made it returns.
+ *
+ * @param log Move log handle
+ * @param[out] last_lsn Pointer to store the LSN of the last record appended (can be NULL)
+ * @param[out] durable_lsn Pointer to store the LSN up to which records are on disk (can be NULL)
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if log is NULL or both outputs are NULL
+ */
+SimplechessResult simplechess_move_log_get_lsn(SimplechessMoveLog log, uint64_t* last_lsn, uint64_t* durable_lsn);
+
+/**
+ * @brief Wait until the records up to an LSN are on disk
+ *
+ * @param log Move log handle
+ * @param lsn Sequence number to wait for
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if log is NULL
+ * @retval SIMPLECHESS_ERROR_UNKNOWN if writing the log failed
+ */
+SimplechessResult simplechess_move_log_wait_durable(SimplechessMoveLog log, uint64_t lsn);
+
+/**
+ * @brief Wait until every record appended so far is on disk
+ *
+ * Call this after a change and before acknowledging it. Threads waiting at
+ * the same time share a single sync.
+ *
+ * @param log Move log handle
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if log is NULL
+ * @retval SIMPLECHESS_ERROR_UNKNOWN if writing the log failed
+ */
+SimplechessResult simplechess_move_log_sync(SimplechessMoveLog log);
+
+/**
+ * @brief Write a snapshot of a store and drop the log records it covers
+ *
+ * The snapshot is written as with simplechess_snapshot_write_store(); once
+ * it is safely in place the log is rewritten without the records it
+ * contains, which keeps recovery time bounded.
+ *
+ * @param log Move log handle attached to store
+ * @param store Session store handle
+ * @param snapshot_path Path of the snapshot file
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL, log
+ *         is not attached to store or the snapshot cannot be created
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ * @retval SIMPLECHESS_ERROR_UNKNOWN if writing a file fails
+ */
+SimplechessResult simplechess_move_log_checkpoint(SimplechessMoveLog log, SimplechessSessionStore store, const char* snapshot_path);
+
+/**
+ * @brief Rebuild the games of a store after a restart
+ *
+ * Restores the snapshot, if there is one, then replays the log records
+ * that came after it. Records are replayed in parallel, each game by a
+ * single thread in the order its changes were made. Replay stops at the
+ * first incomplete or corrupt record. Call this before attaching a log to
+ * the store and before opening the log with simplechess_move_log_open().
+ *
+ * @param store Session store handle, normally empty
+ * @param snapshot_path Path of the checkpoint snapshot (can be NULL, and the file may not exist)
+ * @param log_path Path of the move log (the file may not exist)
+ * @param threads Number of threads replaying games (0 for one per CPU)
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if store or log_path is NULL, a
+ *         file is not a snapshot or move log, or the log does not match the
+ *         snapshot
+ * @retval SIMPLECHESS_ERROR_ILLEGAL_STATE if a move log is attached to store
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_move_log_recover(SimplechessSessionStore store, const char* snapshot_path, const char* log_path,
+                                               size_t threads);
+
+/* ========================================================================== */
+/* Clock Functions                                                            */
+/* ========================================================================== */
+
+/**
+ * @brief Create a clock service
+ *
+ * Clocks are kept in a hierarchical timing wheel, so starting, pressing
+ * and stopping a clock take constant time however many are running. The
+ * service's time starts at 0 and only moves with
+ * simplechess_clock_service_advance(), normally called from a periodic
+ * timer with a monotonic time in milliseconds.
+ *
+ * @param tick_ms Resolution of flag events in milliseconds (0 for 1)
+ * @param[out] service Pointer to store the clock service handle
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if service is NULL
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_clock_service_create(uint32_t tick_ms, SimplechessClockService* service);
+
+/**
+ * @brief Destroy a clock service
+ *
+ * Clocks already started keep their readings but no longer advance.
+ *
+ * @param service Clock service handle to destroy (can be NULL)
+ */
+void simplechess_clock_service_destroy(SimplechessClockService service);
+
+/**
+ * @brief Move the time of a clock service forward
+ *
+ * Every clock whose flag fell up to now_ms is reported in a single call to
+ * callback, made after the service has released its lock. Flags are
+ * reported at the first tick boundary at or after they fall.
+ *
+ * @param service Clock service handle
+ * @param now_ms Current time in milliseconds
+ * @param callback Function receiving the flag events (can be NULL)
+ * @param user_data Pointer passed to callback
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if service is NULL or now_ms
+ *         is earlier than the current time
+ */
+SimplechessResult simplechess_clock_service_advance(SimplechessClockService service, uint64_t now_ms,
+                                                    SimplechessClockCallback callback, void* user_data);
+
+/**
+ * @brief Start a chess clock on a game
+ *
+ * The clock of the player to move starts running. Games that follow from
+ * this one by moves, draw claims or resignation carry the clock along:
+ * each move charges the mover and starts the opponent's time, and ending
+ * the game stops it. Once a flag has fallen, simplechess_game_get_state()
+ * reports the game as lost by the player out of time (or drawn if the
+ * opponent has only the king) and further moves fail with
+ * SIMPLECHESS_ERROR_ILLEGAL_STATE. Clocks are not saved in snapshots or
+ * move logs.
+ *
+ * @param game Game handle, which must not have a clock yet
+ * @param service Clock service keeping the time
+ * @param control Time control
+ * @param id Id reported in flag events, typically the game id
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any pointer is NULL or the
+ *         time control is invalid
+ * @retval SIMPLECHESS_ERROR_ILLEGAL_STATE if the game is over or already
+ *         has a clock
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_game_start_clock(SimplechessGame game, SimplechessClockService service,
+                                               const SimplechessTimeControl* control, uint64_t id);
+
+/**
+ * @brief Read the chess clock of a game
+ *
+ * @param game Game handle
+ * @param[out] state Pointer to store the clock reading
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ * @retval SIMPLECHESS_ERROR_ILLEGAL_STATE if the game has no clock
+ */
+SimplechessResult simplechess_game_get_clock(SimplechessGame game, SimplechessClockState* state);
+
+/* ========================================================================== */
+/* Broadcast Update Functions                                                 */
+/* ========================================================================== */
+
+/**
+ * @brief Get the broadcast update for the current position of a game
+ *
+ * Returns the SAN of the last move, the FEN and a binary delta of the
+ * game's current position in one immutable buffer. The update is built the
+ * first time it is asked for and cached with the game, so every later call
+ * for the same game (from any handle to it, including those returned by a
+ * session store, and from any thread) returns the same buffer without
+ * formatting it again.
+ *
+ * @param game Game handle
+ * @param[out] update Pointer to store a new reference to the update
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_game_get_update(SimplechessGame game, SimplechessUpdate* update);
+
+/**
+ * @brief Read the contents of an update
+ *
+ * @param update Update handle
+ * @param[out] view Pointer to store pointers to the contents
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_update_get_view(SimplechessUpdate update, SimplechessUpdateView* view);
+
+/**
+ * @brief Take another reference to an update
+ *
+ * Lets another thread or connection hold on to the update; each reference
+ * is released separately.
+ *
+ * @param update Update handle (NULL is ignored)
+ */
+void simplechess_update_retain(SimplechessUpdate update);
+
+/**
+ * @brief Release a reference to an update
+ *
+ * The update is freed when its last reference, including the one cached
+ * with the game, is released.
+ *
+ * @param update Update handle (NULL is ignored)
+ */
+void simplechess_update_release(SimplechessUpdate update);
+
+/* ========================================================================== */
+/* Tensor Export Functions                                                    */
+/* ========================================================================== */
+
+/**
+ * @brief Export the current positions of games as feature planes
+ *
+ * Writes SIMPLECHESS_PLANE_COUNT planes of 8x8 values per game into one
+ * contiguous tensor of count * SIMPLECHESS_PLANE_COUNT * 64 elements, in the
+ * order of the games array (see SimplechessPlane). Piece, castling, side
+ * and en passant features are 0 or 1; the halfmove clock plane holds the
+ * clock itself, saturated at 255.
+ *
+ * Bit planes are expanded eight squares at a time. With more than one
+ * thread the games are split into contiguous ranges, one per thread.
+ *
+ * @param games Array of game handles
+ * @param count Number of games
+ * @param layout Layout of the tensor
+ * @param[out] out Tensor to fill
+ * @param out_size Number of elements in out
+ * @param threads Number of threads (0 for one per CPU)
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter or game is
+ *         NULL, the layout is unknown or out is too small
+ */
+SimplechessResult simplechess_export_planes_u8(
+    const SimplechessGame* games,
+    size_t count,
+    SimplechessTensorLayout layout,
+    uint8_t* out,
+    size_t out_size,
+    size_t threads);
+
+/**
+ * @brief Export the current positions of games as float feature planes
+ *
+ * Same as simplechess_export_planes_u8() with 32-bit float elements. The
+ * halfmove clock plane holds the clock without saturating it.
+ *
+ * @param games Array of game handles
+ * @param count Number of games
+ * @param layout Layout of the tensor
+ * @param[out] out Tensor to fill
+ * @param out_size Number of elements in out
+ * @param threads Number of threads (0 for one per CPU)
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter or game is
+ *         NULL, the layout is unknown or out is too small
+ */
+SimplechessResult simplechess_export_planes_f32(
+    const SimplechessGame* games,
+    size_t count,
+    SimplechessTensorLayout layout,
+    float* out,
+    size_t out_size,
+    size_t threads);
+
+/* ========================================================================== */
+/* JSON Functions                                                             */
+/* ========================================================================== */
+
+/**
+ * @brief Write the state of a game as JSON
+ *
+ * Writes one compact JSON object (no whitespace) with a fixed set of keys
+ * in a fixed order, so responses can be cached and compared byte for byte.
+ * Values that do not apply are null rather than missing:
+ *
+ *   {"state":"playing"|"drawn"|"white_won"|"black_won",
+ *    "draw_reason":null|"stalemate"|"insufficient_material"|"agreement"|
+ *        "threefold_repetition"|"fivefold_repetition"|"fifty_move_rule"|
+ *        "seventy_five_move_rule",
+ *    "active_color":"white"|"black","fen":"...","castling":"KQkq"|"-",
+ *    "en_passant":null|"e3","halfmove_clock":0,"fullmove_number":1,
+ *    "ply":0,"last_move":null|"Nf3","in_check":false}
+ *
+ * With SIMPLECHESS_JSON_MOVES the object also has "moves", the legal moves
+ * in coordinate notation ("e2e4", "e7e8q"), empty once the game is over.
+ * With SIMPLECHESS_JSON_CLOCK it has "clock", null if the game has no
+ * clock and otherwise {"white_ms":0,"black_ms":0,"running":null|"white"|
+ * "black","flagged":false}. The state reflects a fallen flag.
+ *
+ * The whole document is built in the caller's buffer without intermediate
+ * allocations. Pass a NULL buffer and a size of 0 to learn the size.
+ *
+ * @param game Game handle
+ * @param flags Bitwise OR of SimplechessJsonFlag values
+ * @param[out] buffer Buffer to store the NUL-terminated JSON (may be NULL if buffer_size is 0)
+ * @param buffer_size Size of the buffer
+ * @param[out] required Pointer to store the size needed, including the
+ *             terminating NUL; set even if the buffer is too small (may be NULL)
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if game is NULL or the buffer is too small
+ */
+SimplechessResult simplechess_game_to_json(
+    SimplechessGame game,
+    uint32_t flags,
+    char* buffer,
+    size_t buffer_size,
+    size_t* required);
+
+/* ========================================================================== */
+/* Deduplication Functions                                                    */
+/* ========================================================================== */
+
+/**
+ * @brief Get the position hash of the current stage of a game
+ *
+ * @param game The game
+ * @param[out] hash Pointer to store the hash
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_game_get_position_hash(SimplechessGame game, SimplechessPositionHash* hash);
+
+/**
+ * @brief Get the position hash of a game stage
+ *
+ * @param stage The game stage
+ * @param[out] hash Pointer to store the hash
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_stage_get_position_hash(SimplechessGameStage stage, SimplechessPositionHash* hash);
+
+/**
+ * @brief Create a position deduplicator
+ *
+ * Half of the memory budget holds a Bloom filter of every hash inserted,
+ * which answers most new positions without any lookup. The other half holds
+ * the most recent hashes; when it fills up they are sorted and written to a
+ * run file in spill_directory, and runs of equal size are merged. Hashes
+ * that the filter may have seen are looked up exactly, so the answers are
+ * exact whatever the budget. Run files are unlinked as soon as they are
+ * created and vanish with the deduplicator.
+ *
+ * @param spill_directory Directory for the run files (NULL for TMPDIR, or /tmp)
+ * @param memory_bytes Memory budget in bytes (0 for 64 MiB, otherwise at least 4096)
+ * @param[out] dedup Pointer to store the deduplicator handle
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if dedup is NULL, the budget is
+ *         too small or the directory cannot be opened
+ * @retval SIMPLECHESS_ERROR_OUT_OF_MEMORY if allocation fails
+ */
+SimplechessResult simplechess_dedup_create(const char* spill_directory, size_t memory_bytes, SimplechessDedup* dedup);
+
+/**
+ * @brief Insert position hashes
+ *
+ * @param dedup The deduplicator
+ * @param hashes Hashes to insert
+ * @param count Number of hashes
+ * @param[out] is_new Optional array of count flags, set for the hashes not
+ *             inserted before (a hash repeated within the call is new only
+ *             the first time)
+ * @param[out] new_count Optional pointer to store the number of new hashes
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if dedup is NULL, or hashes is NULL and count is not 0
+ * @retval SIMPLECHESS_ERROR_UNKNOWN if a run file cannot be written or read
+ */
+SimplechessResult simplechess_dedup_insert(SimplechessDedup dedup, const SimplechessPositionHash* hashes, size_t count,
+                                           bool* is_new, size_t* new_count);
+
+/**
+ * @brief Insert every position of a game
+ *
+ * Hashes each stage of the game history, from the initial position to the
+ * current one, and inserts them as simplechess_dedup_insert() does.
+ *
+ * @param dedup The deduplicator
+ * @param game The game
+ * @param[out] is_new Optional array of flags, one per stage of the game
+ * @param is_new_size Number of elements in is_new
+ * @param[out] new_count Optional pointer to store the number of new positions
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if dedup or game is NULL, or
+ *         is_new is shorter than the game history
+ * @retval SIMPLECHESS_ERROR_UNKNOWN if a run file cannot be written or read
+ */
+SimplechessResult simplechess_dedup_add_game(SimplechessDedup dedup, SimplechessGame game, bool* is_new,
+                                             size_t is_new_size, size_t* new_count);
+
+/**
+ * @brief Get the counters of a deduplicator
+ *
+ * @param dedup The deduplicator
+ * @param[out] stats Pointer to store the counters
+ * @return SIMPLECHESS_SUCCESS on success, error code on failure
+ *
+ * @retval SIMPLECHESS_ERROR_INVALID_ARGUMENT if any parameter is NULL
+ */
+SimplechessResult simplechess_dedup_get_stats(SimplechessDedup dedup, SimplechessDedupStats* stats);
+
+/**
+ * @brief Destroy a deduplicator and its run files
+ *
+ * @param dedup Deduplicator handle to destroy (can be NULL)
+ */
+void simplechess_dedup_destroy(SimplechessDedup dedup);
+
 /* ========================================================================== */
 /* Utility Functions                                                          */
 /* ========================================================================== */
@@ -0,0 +1,222 @@
+#include "position.h"
+#include <cstdlib>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define SIMPLECHESS_HAVE_PEXT 1
+#endif
+
+namespace simplechess_c {
+
+namespace {
+    const int bishop_directions[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    const int rook_directions[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+    const Bitboard rank_1 = 0xFFULL;
+    const Bitboard rank_8 = rank_1 << 56;
+    const Bitboard file_a = 0x0101010101010101ULL;
+    const Bitboard file_h = file_a << 7;
+
+    /* Walks the rays square by square; only used to fill the tables. */
+    Bitboard slide(int sq, Bitboard occupied, const int (*directions)[2]) {
+        Bitboard attacks = 0;
+        for (int d = 0; d < 4; ++d) {
+            int rank = square_rank(sq) + directions[d][0];
+            int file = square_file(sq) + directions[d][1];
+            while (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+                Bitboard b = square_bb(rank * 8 + file);
+                attacks |= b;
+                if (occupied & b) {
+                    break;
+                }
+                rank += directions[d][0];
+                file += directions[d][1];
+            }
+        }
+        return attacks;
+    }
+
+    /* The squares whose occupancy can change the attacks from sq: the rays
+     * without their last square. */
+    Bitboard relevant_occupancy(int sq, const int (*directions)[2]) {
+        Bitboard edges = ((rank_1 | rank_8) & ~(rank_1 << (8 * square_rank(sq))))
+                       | ((file_a | file_h) & ~(file_a << square_file(sq)));
+        return slide(sq, 0, directions) & ~edges;
+    }
+
+#ifdef SIMPLECHESS_HAVE_PEXT
+    __attribute__((target("bmi2"))) Bitboard pext_lookup(const Bitboard* attacks, Bitboard occupied, Bitboard mask) {
+        return attacks[_pext_u64(occupied, mask)];
+    }
+
+    __attribute__((target("bmi2"))) size_t pext_index(Bitboard occupied, Bitboard mask) {
+        return _pext_u64(occupied, mask);
+    }
+
+    /* BMI2 is present on Intel since Haswell and on AMD since Excavator, but
+     * AMD implemented PEXT in microcode before Zen 3 (family 19h), where it
+     * is slower than a magic multiplication. */
+    bool pext_is_fast() {
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ebx & bit_BMI2)) {
+            return false;
+        }
+        __get_cpuid(0, &eax, &ebx, &ecx, &edx);
+        const bool amd = ebx == 0x68747541 && edx == 0x69746E65 && ecx == 0x444D4163;  // "AuthenticAMD"
+        if (!amd) {
+            return true;
+        }
+        __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+        unsigned family = (eax >> 8) & 0xF;
+        if (family == 0xF) {
+            family += (eax >> 20) & 0xFF;
+        }
+        return family >= 0x19;
+    }
+#endif
+
+    /* Attack tables of one slider kind. The attacks from a square are
+     * looked up by the occupancy of its relevant squares, turned into an
+     * index either by PEXT or by a magic multiplication. */
+    struct SliderTable {
+        struct Entry {
+            Bitboard mask;
+            Bitboard magic;
+            unsigned shift;
+            const Bitboard* attacks;
+        };
+
+        Entry squares[64];
+        std::vector<Bitboard> attacks;
+    };
+
+    /* Magic factors mapping the relevant occupancies of each square to
+     * distinct entries, or to entries shared only by occupancies with the
+     * same attacks. They were found by a search over sparse random numbers
+     * and give tables with one entry per relevant occupancy. */
+    const Bitboard bishop_magics[64] = {
+        0x0020428400408200ULL, 0x2008010104210004ULL, 0x02D0009200480190ULL, 0x0018158B00010100ULL,
+        0x02C4042132048008ULL, 0x020082202000C221ULL, 0x4000421050080009ULL, 0x0210140202022020ULL,
+        0x00C0101410042248ULL, 0x0405204800D48080ULL, 0x3800C89200420002ULL, 0x180844124A020440ULL,
+        0x04403410A8002221ULL, 0x4040209004200400ULL, 0x084004020202A204ULL, 0x3010002104022000ULL,
+        0x00200240A9110900ULL, 0x2302800404080210ULL, 0x0204188800240010ULL, 0x8048000C01401200ULL,
+        0x120C001A11040900ULL, 0x0000401200500440ULL, 0x00004040840420A0ULL, 0x0020930822880804ULL,
+        0x4044401090900161ULL, 0x0034100015210804ULL, 0x8004100009010120ULL, 0x48C8080000820500ULL,
+        0x0080848004002000ULL, 0x0801004012005044ULL, 0x000080902C040400ULL, 0x0004009005004100ULL,
+        0x0B103010048A0200ULL, 0x8004100203181A00ULL, 0x0800140200100080ULL, 0x8401010800910040ULL,
+        0x0840010011290040ULL, 0x40100214202E1000ULL, 0x0842040040010840ULL, 0x0028010040010860ULL,
+        0x00080202A2051000ULL, 0x4200841008084204ULL, 0x0021120110000D02ULL, 0x48C1004208000084ULL,
+        0x0010088100414400ULL, 0x0021101000420580ULL, 0x0010040558401410ULL, 0x200C0C82A1050205ULL,
+        0x0011108820088000ULL, 0x0001011910120402ULL, 0x1580008608091248ULL, 0x8010018020880C02ULL,
+        0x20A1101032088480ULL, 0x0080100408082800ULL, 0x28100401140401C0ULL, 0x8002102200930012ULL,
+        0x4001040082080200ULL, 0x082200A498081808ULL, 0x000508610080D003ULL, 0x0052020044842402ULL,
+        0x4800A00140C84840ULL, 0x5000000848080820ULL, 0x0101086004240040ULL, 0x0028280808005014ULL
+    };
+
+    const Bitboard rook_magics[64] = {
+        0x008000908064C000ULL, 0x0040200040001000ULL, 0x0180100080A0010AULL, 0x8880041000800800ULL,
+        0x1200100201200804ULL, 0x0200020004011008ULL, 0x2180010000800600ULL, 0x0200005088210204ULL,
+        0x0400800040008021ULL, 0x0400400020005000ULL, 0x8240801000200080ULL, 0x8611001004200900ULL,
+        0x008180800C001800ULL, 0x0100800200800400ULL, 0x0A02000102000408ULL, 0x8020802300104280ULL,
+        0x0080004000402000ULL, 0xE010104000402000ULL, 0x0800808010002000ULL, 0xA280210008100100ULL,
+        0x0001818014000800ULL, 0xA002010100080400ULL, 0x0080240001020870ULL, 0x0001020004048845ULL,
+        0x0081826280004004ULL, 0x2020810900284000ULL, 0x0200100080802000ULL, 0x0200080080100080ULL,
+        0x8083080100100500ULL, 0x4406000901000400ULL, 0x0005020080800100ULL, 0x0090204200008114ULL,
+        0x0010400094800420ULL, 0x0900804000802002ULL, 0x0201001841002000ULL, 0x4100080080801000ULL,
+        0x4540040080800800ULL, 0x0002001004040020ULL, 0x0281195814001002ULL, 0x1240800040800100ULL,
+        0x0880042000524004ULL, 0x02C080410206002CULL, 0x0801200241050010ULL, 0x8400080010008080ULL,
+        0x0008000500090010ULL, 0x0082009084020008ULL, 0x4012000108020004ULL, 0x9000104D08860004ULL,
+        0x2004204114800100ULL, 0x0148802112400300ULL, 0x0202842000100880ULL, 0x001B080080900080ULL,
+        0x001A002008100600ULL, 0x0004008004020080ULL, 0x5181000600040300ULL, 0x0000044401128A00ULL,
+        0x8044110480002441ULL, 0x2008110084402202ULL, 0x90806005090010C1ULL, 0x000420310A004A42ULL,
+        0x0023001004020801ULL, 0x0882001008040102ULL, 0x000230088118020CULL, 0x0000019025040042ULL
+    };
+
+    void build(SliderTable& table, const int (*directions)[2], const Bitboard* magics, bool use_pext) {
+        size_t total = 0;
+        for (int sq = 0; sq < 64; ++sq) {
+            total += size_t(1) << popcount(relevant_occupancy(sq, directions));
+        }
+        table.attacks.assign(total, 0);
+
+        size_t offset = 0;
+        for (int sq = 0; sq < 64; ++sq) {
+            SliderTable::Entry& entry = table.squares[sq];
+            entry.mask = relevant_occupancy(sq, directions);
+            entry.magic = magics[sq];
+            entry.shift = 64 - popcount(entry.mask);
+            Bitboard* attacks = &table.attacks[offset];
+            entry.attacks = attacks;
+            offset += size_t(1) << popcount(entry.mask);
+
+            // Every subset of the mask, by the Carry-Rippler trick
+            Bitboard occupied = 0;
+            do {
+                size_t index = static_cast<size_t>((occupied * entry.magic) >> entry.shift);
+#ifdef SIMPLECHESS_HAVE_PEXT
+                if (use_pext) {
+                    index = pext_index(occupied, entry.mask);
+                }
+#else
+                (void)use_pext;
+#endif
+                attacks[index] = slide(sq, occupied, directions);
+                occupied = (occupied - entry.mask) & entry.mask;
+            } while (occupied);
+        }
+    }
+
+    class SliderAttacks {
+    public:
+        SliderAttacks() {
+#ifdef SIMPLECHESS_HAVE_PEXT
+            // SIMPLECHESS_NO_PEXT lets the magic tables be tested on any CPU
+            const char* no_pext = std::getenv("SIMPLECHESS_NO_PEXT");
+            mPext = !(no_pext && *no_pext) && pext_is_fast();
+#endif
+            build(mBishop, bishop_directions, bishop_magics, mPext);
+            build(mRook, rook_directions, rook_magics, mPext);
+        }
+
+        Bitboard lookup(const SliderTable& table, int sq, Bitboard occupied) const {
+            const SliderTable::Entry& entry = table.squares[sq];
+#ifdef SIMPLECHESS_HAVE_PEXT
+            if (mPext) {
+                return pext_lookup(entry.attacks, occupied, entry.mask);
+            }
+#endif
+            return entry.attacks[((occupied & entry.mask) * entry.magic) >> entry.shift];
+        }
+
+        Bitboard bishop(int sq, Bitboard occupied) const { return lookup(mBishop, sq, occupied); }
+        Bitboard rook(int sq, Bitboard occupied) const { return lookup(mRook, sq, occupied); }
+        bool uses_pext() const { return mPext; }
+
+    private:
+        bool mPext = false;
+        SliderTable mBishop;
+        SliderTable mRook;
+    };
+
+    /* Built once, on first use, for the CPU the library runs on. */
+    const SliderAttacks& sliders() {
+        static const SliderAttacks instance;
+        return instance;
+    }
+}
+
+Bitboard bishop_attacks(int sq, Bitboard occupied) {
+    return sliders().bishop(sq, occupied);
+}
+
+Bitboard rook_attacks(int sq, Bitboard occupied) {
+    return sliders().rook(sq, occupied);
+}
+
+bool slider_attacks_use_pext() {
+    return sliders().uses_pext();
+}
+
+}
@@ -0,0 +1,326 @@
+#include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include "clock.h"
+#include "position.h"
+#include <simplechess/Game.h>
+#include <simplechess/GameStage.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace simplechess_c {
+
+namespace {
+    // Holds the wheel so clocks that outlive the handle keep a valid timer
+    struct ClockService {
+        std::shared_ptr<TimerWheel> wheel;
+    };
+
+    // Time the mover is charged for a turn of elapsed_ms, after the bonus
+    uint64_t charge(const SimplechessTimeControl& control, uint64_t remaining, uint64_t elapsed_ms, bool moved) {
+        switch (control.mode) {
+            case SIMPLECHESS_CLOCK_DELAY:
+                elapsed_ms = elapsed_ms > control.bonus_ms ? elapsed_ms - control.bonus_ms : 0;
+                break;
+            case SIMPLECHESS_CLOCK_BRONSTEIN:
+                if (moved) {
+                    elapsed_ms -= std::min<uint64_t>(elapsed_ms, control.bonus_ms);
+                }
+                break;
+            case SIMPLECHESS_CLOCK_INCREMENT:
+                if (moved) {
+                    remaining += control.bonus_ms;
+                }
+                break;
+        }
+        return remaining > elapsed_ms ? remaining - elapsed_ms : 0;
+    }
+}
+
+ClockTimer::~ClockTimer() {
+    wheel->cancel(*this);
+}
+
+TimerWheel::TimerWheel(uint32_t tick_ms) : mTickMs(tick_ms ? tick_ms : 1) {}
+
+void TimerWheel::link(ClockTimer& timer) {
+    // The level whose span covers the time left; timers further out than the
+    // whole wheel wait in the top level and are placed again when it turns
+    uint64_t delta = timer.expires > mTick ? timer.expires - mTick : 0;
+    int level = 0;
+    while (level < level_count - 1 && delta >= (uint64_t(1) << (slot_bits * (level + 1)))) {
+        level++;
+    }
+    uint64_t expires = std::min(timer.expires, mTick + (uint64_t(1) << (slot_bits * level_count)) - 1);
+    int slot = static_cast<int>((expires >> (slot_bits * level)) & (slot_count - 1));
+
+    timer.level = level;
+    timer.slot = slot;
+    timer.prev = nullptr;
+    timer.next = mSlots[level][slot];
+    if (timer.next) {
+        timer.next->prev = &timer;
+    }
+    mSlots[level][slot] = &timer;
+    mCount++;
+}
+
+void TimerWheel::unlink(ClockTimer& timer) {
+    if (timer.prev) {
+        timer.prev->next = timer.next;
+    } else {
+        mSlots[timer.level][timer.slot] = timer.next;
+    }
+    if (timer.next) {
+        timer.next->prev = timer.prev;
+    }
+    timer.prev = nullptr;
+    timer.next = nullptr;
+    timer.level = -1;
+    mCount--;
+}
+
+void TimerWheel::cascade(int level, int slot) {
+    ClockTimer* timer = mSlots[level][slot];
+    mSlots[level][slot] = nullptr;
+    while (timer) {
+        ClockTimer* next = timer->next;
+        mCount--;
+        link(*timer);
+        timer = next;
+    }
+}
+
+void TimerWheel::schedule(ClockTimer& timer, uint64_t deadline_ms, SimplechessColor color) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (timer.level >= 0) {
+        unlink(timer);
+    }
+    // The current tick has already been processed
+    timer.expires = std::max((deadline_ms + mTickMs - 1) / mTickMs, mTick + 1);
+    timer.color = color;
+    link(timer);
+}
+
+void TimerWheel::cancel(ClockTimer& timer) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (timer.level >= 0) {
+        unlink(timer);
+    }
+}
+
+void TimerWheel::advance(uint64_t now_ms, std::vector<SimplechessClockEvent>& fired) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (now_ms < mNow.load(std::memory_order_relaxed)) {
+        throw std::invalid_argument("Clock time cannot go backwards");
+    }
+    mNow.store(now_ms, std::memory_order_release);
+
+    uint64_t target = now_ms / mTickMs;
+    while (mTick < target) {
+        if (mCount == 0) {
+            mTick = target;
+            break;
+        }
+        mTick++;
+
+        // Higher levels first, so their timers can drop all the way down
+        for (int level = level_count - 1; level >= 1; --level) {
+            if ((mTick & ((uint64_t(1) << (slot_bits * level)) - 1)) == 0) {
+                cascade(level, static_cast<int>((mTick >> (slot_bits * level)) & (slot_count - 1)));
+            }
+        }
+
+        int slot = static_cast<int>(mTick & (slot_count - 1));
+        ClockTimer* timer = mSlots[0][slot];
+        while (timer) {
+            ClockTimer* next = timer->next;
+            if (timer->expires <= mTick) {
+                unlink(*timer);
+                fired.push_back({timer->id, timer->color});
+            }
+            timer = next;
+        }
+    }
+}
+
+uint64_t ClockState::deadline_ms() const {
+    uint64_t deadline = turn_started_ms + remaining_ms[running];
+    if (control.mode == SIMPLECHESS_CLOCK_DELAY) {
+        deadline += control.bonus_ms;
+    }
+    return deadline;
+}
+
+std::shared_ptr<const ClockState> next_clock(const ClockState& clock, const simplechess::Game& before,
+                                             const simplechess::Game& after) {
+    auto next = std::make_shared<ClockState>(clock);
+    if (clock.running < 0) {
+        return next;
+    }
+
+    uint64_t now = clock.timer->wheel->now_ms();
+    if (now >= clock.deadline_ms()) {
+        throw IllegalStateError("The flag of the player to move has fallen");
+    }
+
+    bool moved = after.history().size() > before.history().size();
+    uint64_t elapsed = now - clock.turn_started_ms;
+    next->remaining_ms[clock.running] = charge(clock.control, clock.remaining_ms[clock.running], elapsed, moved);
+    next->turn_started_ms = now;
+    if (after.gameState() != simplechess::GameState::Playing) {
+        next->running = -1;
+    } else if (moved) {
+        next->running = 1 - clock.running;
+    }
+    return next;
+}
+
+void start_clock(GameHandle& handle, const std::shared_ptr<TimerWheel>& wheel, const SimplechessTimeControl& control,
+                 uint64_t id) {
+    if (handle.clock) {
+        throw IllegalStateError("The game already has a clock");
+    }
+    if (handle.game->gameState() != simplechess::GameState::Playing) {
+        throw IllegalStateError("The game is over");
+    }
+    if (control.initial_ms == 0 || control.mode > SIMPLECHESS_CLOCK_BRONSTEIN) {
+        throw std::invalid_argument("Invalid time control");
+    }
+
+    auto clock = std::make_shared<ClockState>();
+    clock->control = control;
+    clock->remaining_ms[0] = control.initial_ms;
+    clock->remaining_ms[1] = control.initial_ms;
+    clock->running = handle.game->activeColor() == simplechess::Color::White ? WHITE : BLACK;
+    clock->turn_started_ms = wheel->now_ms();
+    clock->timer = std::make_shared<ClockTimer>(wheel, id);
+    handle.clock = std::move(clock);
+    schedule_clock(handle);
+}
+
+void schedule_clock(const GameHandle& handle) {
+    if (!handle.clock) {
+        return;
+    }
+    const ClockState& clock = *handle.clock;
+    if (clock.running < 0) {
+        clock.timer->wheel->cancel(*clock.timer);
+    } else {
+        clock.timer->wheel->schedule(*clock.timer, clock.deadline_ms(),
+                                     clock.running == WHITE ? SIMPLECHESS_COLOR_WHITE : SIMPLECHESS_COLOR_BLACK);
+    }
+}
+
+void read_clock(const ClockState& clock, SimplechessClockState& state) {
+    uint64_t remaining[2] = {clock.remaining_ms[0], clock.remaining_ms[1]};
+    state.running = clock.running >= 0;
+    state.running_color = clock.running == BLACK ? SIMPLECHESS_COLOR_BLACK : SIMPLECHESS_COLOR_WHITE;
+    state.flagged = false;
+    if (clock.running >= 0) {
+        uint64_t now = clock.timer->wheel->now_ms();
+        uint64_t elapsed = now - clock.turn_started_ms;
+        remaining[clock.running] = charge(clock.control, remaining[clock.running], elapsed, false);
+        state.flagged = now >= clock.deadline_ms();
+    }
+    state.white_ms = remaining[WHITE];
+    state.black_ms = remaining[BLACK];
+}
+
+SimplechessGameState effective_game_state(const GameHandle& handle, bool* drawn_on_time) {
+    SimplechessGameState state = cpp_to_c_game_state(handle.game->gameState());
+    if (drawn_on_time) {
+        *drawn_on_time = false;
+    }
+    if (state != SIMPLECHESS_GAME_STATE_PLAYING || !handle.clock || handle.clock->running < 0 ||
+        handle.clock->timer->wheel->now_ms() < handle.clock->deadline_ms()) {
+        return state;
+    }
+
+    // A player with a bare king cannot win on time
+    int winner = 1 - handle.clock->running;
+    Position pos;
+    position_from_stage(handle.game->currentStage(), pos);
+    if (popcount(pos.by_color[winner]) == 1) {
+        if (drawn_on_time) {
+            *drawn_on_time = true;
+        }
+        return SIMPLECHESS_GAME_STATE_DRAWN;
+    }
+    return winner == WHITE ? SIMPLECHESS_GAME_STATE_WHITE_WON : SIMPLECHESS_GAME_STATE_BLACK_WON;
+}
+
+}
+
+using namespace simplechess_c;
+
+extern "C" {
+
+SimplechessResult simplechess_clock_service_create(uint32_t tick_ms, SimplechessClockService* service) {
+    if (!service) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        *service = new ClockService{std::make_shared<TimerWheel>(tick_ms)};
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+void simplechess_clock_service_destroy(SimplechessClockService service) {
+    if (service) {
+        delete static_cast<ClockService*>(service);
+    }
+}
+
+SimplechessResult simplechess_clock_service_advance(SimplechessClockService service, uint64_t now_ms,
+                                                    SimplechessClockCallback callback, void* user_data) {
+    if (!service) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        std::vector<SimplechessClockEvent> fired;
+        static_cast<ClockService*>(service)->wheel->advance(now_ms, fired);
+        if (callback && !fired.empty()) {
+            callback(user_data, fired.data(), fired.size());
+        }
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_game_start_clock(SimplechessGame game, SimplechessClockService service,
+                                               const SimplechessTimeControl* control, uint64_t id) {
+    if (!game || !service || !control) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        start_clock(*static_cast<GameHandle*>(game), static_cast<ClockService*>(service)->wheel, *control, id);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_game_get_clock(SimplechessGame game, SimplechessClockState* state) {
+    if (!game || !state) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* handle = static_cast<GameHandle*>(game);
+        if (!handle->clock) {
+            return SIMPLECHESS_ERROR_ILLEGAL_STATE;
+        }
+        read_clock(*handle->clock, *state);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+}
@@ -0,0 +1,117 @@
+/**
+ * @file clock.h
+ * @brief Internal chess clocks driven by a hierarchical timing wheel
+ *
+ * A clock is part of a game handle. Its readings are immutable: every move
+ * produces a handle with a new reading, so games that branch from the same
+ * position each keep their own time. What the readings share is one timer
+ * in a TimerWheel, which follows the handle published last (by a move
+ * through the C API or the session store) and reports when its flag falls.
+ *
+ * The wheel has four levels of 64 slots. A timer sits in the level whose
+ * span covers its expiry and moves down a level each time the level below
+ * wraps around, so starting and stopping a timer are O(1) list operations
+ * and advancing costs one slot per tick plus the timers that expire.
+ *
+ * Time only moves when the wheel is advanced; all clocks read the time of
+ * the last advance.
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_CLOCK_H
+#define SIMPLECHESS_CLOCK_H
+
+#include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace simplechess_c {
+
+class TimerWheel;
+
+/* The timer shared by all readings of one clock. */
+struct ClockTimer {
+    ClockTimer(std::shared_ptr<TimerWheel> owner, uint64_t timer_id) : wheel(std::move(owner)), id(timer_id) {}
+    ~ClockTimer();
+
+    ClockTimer(const ClockTimer&) = delete;
+    ClockTimer& operator=(const ClockTimer&) = delete;
+
+    std::shared_ptr<TimerWheel> wheel;
+    uint64_t id;
+
+    // Owned by the wheel, under its lock
+    ClockTimer* prev = nullptr;
+    ClockTimer* next = nullptr;
+    uint64_t expires = 0;
+    int level = -1;
+    int slot = 0;
+    SimplechessColor color = SIMPLECHESS_COLOR_WHITE;
+};
+
+class TimerWheel {
+public:
+    explicit TimerWheel(uint32_t tick_ms);
+
+    uint64_t now_ms() const { return mNow.load(std::memory_order_acquire); }
+
+    /* (Re)starts the timer so it fires once the time reaches deadline_ms. */
+    void schedule(ClockTimer& timer, uint64_t deadline_ms, SimplechessColor color);
+    void cancel(ClockTimer& timer);
+
+    /* Moves the time forward and appends an event for every timer that
+     * expired. Throws std::invalid_argument if now_ms is in the past. */
+    void advance(uint64_t now_ms, std::vector<SimplechessClockEvent>& fired);
+
+private:
+    static const int level_count = 4;
+    static const int slot_bits = 6;
+    static const int slot_count = 1 << slot_bits;
+
+    void link(ClockTimer& timer);
+    void unlink(ClockTimer& timer);
+    void cascade(int level, int slot);
+
+    std::mutex mMutex;
+    ClockTimer* mSlots[level_count][slot_count] = {};
+    uint64_t mTick = 0;
+    size_t mCount = 0;
+    uint32_t mTickMs;
+    std::atomic<uint64_t> mNow{0};
+};
+
+/* One reading of a clock. */
+struct ClockState {
+    SimplechessTimeControl control;
+    uint64_t remaining_ms[2];
+    int running;            /* color whose time runs, -1 once stopped */
+    uint64_t turn_started_ms;
+    std::shared_ptr<ClockTimer> timer;
+
+    uint64_t deadline_ms() const;
+};
+
+/* Starts a clock on a game handle for the side to move. */
+void start_clock(GameHandle& handle, const std::shared_ptr<TimerWheel>& wheel, const SimplechessTimeControl& control,
+                 uint64_t id);
+
+/* Points the clock's timer at this handle's reading; call it once the
+ * handle is the current one of its game. */
+void schedule_clock(const GameHandle& handle);
+
+/* The current reading, with the time of the running side brought up to
+ * date. */
+void read_clock(const ClockState& clock, SimplechessClockState& state);
+
+/* The state of the game, counting a fallen flag as a loss, or a draw if
+ * the opponent has only the king left. */
+SimplechessGameState effective_game_state(const GameHandle& handle, bool* drawn_on_time = nullptr);
+
+}
+
+#endif /* SIMPLECHESS_CLOCK_H */
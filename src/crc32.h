@@ -0,0 +1,42 @@
+/**
+ * @file crc32.h
+ * @brief CRC-32 (IEEE 802.3) used to check files written by the library
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_CRC32_H
+#define SIMPLECHESS_CRC32_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace simplechess_c {
+
+/* Continues a checksum: crc32_update(crc32_update(0, a), b) is the checksum
+ * of a followed by b. */
+inline uint32_t crc32_update(uint32_t crc, const void* data, size_t size) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+}
+
+#endif /* SIMPLECHESS_CRC32_H */
@@ -0,0 +1,512 @@
+#include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include "history.h"
+#include "position.h"
+#include "zobrist.h"
+#include <simplechess/Game.h>
+#include <simplechess/GameManager.h>
+#include <simplechess/GameStage.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace simplechess_c {
+
+namespace {
+    typedef SimplechessPositionHash Hash;
+
+    const size_t default_memory = size_t(64) << 20;
+    const size_t min_memory = 4096;
+    const int bloom_probes = 4;
+    /* Entries per block of a run file; one block is read per probe. */
+    const size_t block_entries = 256;
+    /* Entries moved per read or write while merging runs. */
+    const size_t io_entries = 4096;
+
+    bool hash_less(const Hash& a, const Hash& b) {
+        return a.hi != b.hi ? a.hi < b.hi : a.lo < b.lo;
+    }
+
+    bool hash_equal(const Hash& a, const Hash& b) {
+        return a.lo == b.lo && a.hi == b.hi;
+    }
+
+    bool hash_empty(const Hash& h) {
+        return h.lo == 0 && h.hi == 0;
+    }
+
+    size_t floor_pow2(size_t n) {
+        size_t p = 1;
+        while (p <= n / 2) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    void write_all(int fd, const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        while (size) {
+            ssize_t n = ::write(fd, p, size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                throw std::runtime_error("Failed to write dedup run");
+            }
+            p += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+
+    void read_at(int fd, void* data, size_t size, uint64_t offset) {
+        char* p = static_cast<char*>(data);
+        while (size) {
+            ssize_t n = ::pread(fd, p, size, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                throw std::runtime_error("Failed to read dedup run");
+            }
+            p += n;
+            size -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+    }
+
+    /* A sorted, immutable file of hashes. Its first entry of every block is
+     * kept in memory, so a lookup costs one read of one block. */
+    struct Run {
+        int fd = -1;
+        uint64_t count = 0;
+        std::vector<Hash> fences;
+    };
+
+    /* Appends sorted hashes to a new, already unlinked file. */
+    class RunWriter {
+    public:
+        explicit RunWriter(const std::string& directory) {
+            std::string path = directory + "/simplechess-dedup-XXXXXX";
+            mRun.fd = ::mkstemp(&path[0]);
+            if (mRun.fd < 0) {
+                throw std::runtime_error("Failed to create dedup run");
+            }
+            ::unlink(path.c_str());
+            mBuffer.reserve(io_entries);
+        }
+
+        ~RunWriter() {
+            if (mRun.fd >= 0) {
+                ::close(mRun.fd);
+            }
+        }
+
+        void add(const Hash& hash) {
+            if (mRun.count % block_entries == 0) {
+                mRun.fences.push_back(hash);
+            }
+            mRun.count++;
+            mBuffer.push_back(hash);
+            if (mBuffer.size() == io_entries) {
+                flush();
+            }
+        }
+
+        Run finish() {
+            flush();
+            Run run = std::move(mRun);
+            mRun.fd = -1;
+            return run;
+        }
+
+    private:
+        void flush() {
+            write_all(mRun.fd, mBuffer.data(), mBuffer.size() * sizeof(Hash));
+            mBuffer.clear();
+        }
+
+        Run mRun;
+        std::vector<Hash> mBuffer;
+    };
+
+    /* Streams the hashes of a run in order. */
+    class RunReader {
+    public:
+        explicit RunReader(const Run& run) : mRun(run) {}
+
+        bool valid() const { return mPosition < mRun.count; }
+
+        const Hash& current() const { return mBuffer[mPosition - mBufferStart]; }
+
+        void next() {
+            mPosition++;
+            fill();
+        }
+
+        void fill() {
+            if (mPosition < mRun.count && mPosition - mBufferStart >= mBuffer.size()) {
+                size_t n = static_cast<size_t>(std::min<uint64_t>(io_entries, mRun.count - mPosition));
+                mBuffer.resize(n);
+                read_at(mRun.fd, mBuffer.data(), n * sizeof(Hash), mPosition * sizeof(Hash));
+                mBufferStart = mPosition;
+            }
+        }
+
+    private:
+        const Run& mRun;
+        uint64_t mPosition = 0;
+        uint64_t mBufferStart = 0;
+        std::vector<Hash> mBuffer;
+    };
+
+    void close_run(Run& run) {
+        if (run.fd >= 0) {
+            ::close(run.fd);
+        }
+        run = Run();
+    }
+}
+
+/* Object behind a SimplechessDedup handle.
+ *
+ * Every hash first goes through a Bloom filter. A hash the filter has never
+ * seen is new for certain and costs no further lookup. The others are looked
+ * up exactly, in an in-memory hash table of recent hashes and then in the
+ * sorted runs spilled from it to disk. Runs are merged like a binary
+ * counter, so there are at most log2(spills) of them. */
+class PositionDedup {
+public:
+    PositionDedup(std::string directory, size_t memory_bytes) : mDirectory(std::move(directory)) {
+        size_t half = memory_bytes / 2;
+        mBloom.assign(std::max<size_t>(floor_pow2(half / 8), 1), 0);
+        mBloomMask = mBloom.size() * 64 - 1;
+        mTable.assign(std::max<size_t>(floor_pow2(half / sizeof(Hash)), 16), Hash{0, 0});
+        mTableMask = mTable.size() - 1;
+        mTableLimit = mTable.size() / 4 * 3;
+    }
+
+    ~PositionDedup() {
+        for (Run& run : mRuns) {
+            close_run(run);
+        }
+    }
+
+    PositionDedup(const PositionDedup&) = delete;
+    PositionDedup& operator=(const PositionDedup&) = delete;
+
+    size_t insert(const Hash* hashes, size_t count, bool* is_new) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        size_t added = 0;
+        for (size_t i = 0; i < count; ++i) {
+            bool fresh = insert_one(hashes[i]);
+            if (is_new) {
+                is_new[i] = fresh;
+            }
+            added += fresh;
+        }
+        return added;
+    }
+
+    void stats(SimplechessDedupStats& out) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        out = mStats;
+        out.runs = 0;
+        for (const Run& run : mRuns) {
+            out.runs += run.count != 0;
+        }
+    }
+
+private:
+    bool insert_one(Hash hash) {
+        if (hash_empty(hash)) {
+            hash.lo = 1;
+        }
+        mStats.positions++;
+        if (!bloom_add(hash)) {
+            mStats.bloom_new++;
+        } else if (table_contains(hash) || runs_contain(hash)) {
+            return false;
+        }
+        table_add(hash);
+        mStats.unique++;
+        return true;
+    }
+
+    /* Sets the bits of hash; returns true if they were all set already. */
+    bool bloom_add(const Hash& hash) {
+        uint64_t h = hash.hi;
+        uint64_t step = (hash.lo >> 32) | 1;
+        bool present = true;
+        for (int i = 0; i < bloom_probes; ++i, h += step) {
+            uint64_t bit = h & mBloomMask;
+            uint64_t mask = uint64_t(1) << (bit & 63);
+            present &= (mBloom[bit >> 6] & mask) != 0;
+            mBloom[bit >> 6] |= mask;
+        }
+        return present;
+    }
+
+    bool table_contains(const Hash& hash) const {
+        for (size_t slot = hash.lo & mTableMask;; slot = (slot + 1) & mTableMask) {
+            if (hash_empty(mTable[slot])) {
+                return false;
+            }
+            if (hash_equal(mTable[slot], hash)) {
+                return true;
+            }
+        }
+    }
+
+    void table_add(const Hash& hash) {
+        size_t slot = hash.lo & mTableMask;
+        while (!hash_empty(mTable[slot])) {
+            slot = (slot + 1) & mTableMask;
+        }
+        mTable[slot] = hash;
+        if (++mTableCount >= mTableLimit) {
+            spill();
+        }
+    }
+
+    bool runs_contain(const Hash& hash) {
+        for (const Run& run : mRuns) {
+            if (run.count && run_contains(run, hash)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool run_contains(const Run& run, const Hash& hash) {
+        auto fence = std::upper_bound(run.fences.begin(), run.fences.end(), hash, hash_less);
+        if (fence == run.fences.begin()) {
+            return false;
+        }
+        uint64_t first = static_cast<uint64_t>(fence - run.fences.begin() - 1) * block_entries;
+        size_t n = static_cast<size_t>(std::min<uint64_t>(block_entries, run.count - first));
+        Hash block[block_entries];
+        read_at(run.fd, block, n * sizeof(Hash), first * sizeof(Hash));
+        mStats.disk_probes++;
+        return std::binary_search(block, block + n, hash, hash_less);
+    }
+
+    void spill() {
+        std::vector<Hash> sorted;
+        sorted.reserve(mTableCount);
+        for (Hash& entry : mTable) {
+            if (!hash_empty(entry)) {
+                sorted.push_back(entry);
+                entry = Hash{0, 0};
+            }
+        }
+        std::sort(sorted.begin(), sorted.end(), hash_less);
+
+        RunWriter writer(mDirectory);
+        for (const Hash& hash : sorted) {
+            writer.add(hash);
+        }
+        Run run = writer.finish();
+        mStats.spilled += mTableCount;
+        mTableCount = 0;
+
+        // Carry into the next level while it is occupied
+        size_t level = 0;
+        for (; level < mRuns.size() && mRuns[level].count; ++level) {
+            Run merged = merge(mRuns[level], run);
+            close_run(mRuns[level]);
+            close_run(run);
+            run = std::move(merged);
+        }
+        if (level == mRuns.size()) {
+            mRuns.emplace_back();
+        }
+        mRuns[level] = std::move(run);
+    }
+
+    Run merge(const Run& a, const Run& b) {
+        RunWriter writer(mDirectory);
+        RunReader ra(a), rb(b);
+        ra.fill();
+        rb.fill();
+        while (ra.valid() && rb.valid()) {
+            if (hash_less(rb.current(), ra.current())) {
+                writer.add(rb.current());
+                rb.next();
+            } else {
+                writer.add(ra.current());
+                ra.next();
+            }
+        }
+        for (; ra.valid(); ra.next()) {
+            writer.add(ra.current());
+        }
+        for (; rb.valid(); rb.next()) {
+            writer.add(rb.current());
+        }
+        return writer.finish();
+    }
+
+    std::string mDirectory;
+    std::mutex mMutex;
+    std::vector<uint64_t> mBloom;
+    uint64_t mBloomMask;
+    std::vector<Hash> mTable;
+    size_t mTableMask;
+    size_t mTableLimit;
+    size_t mTableCount = 0;
+    /* mRuns[i] is empty or holds the merge of 2^i spills. */
+    std::vector<Run> mRuns;
+    SimplechessDedupStats mStats = {};
+};
+
+namespace {
+    /* Hashes of every stage of the game, replayed on the internal board. */
+    std::vector<Hash> game_hashes(const GameHandle& handle) {
+        std::string start_fen;
+        std::vector<uint16_t> moves;
+        encode_history(handle, start_fen, moves);
+
+        Position pos;
+        if (handle.prefix) {
+            simplechess::GameManager manager;
+            position_from_stage(manager.createGameFromFen(start_fen).currentStage(), pos);
+        } else {
+            position_from_stage(handle.game->history().front(), pos);
+        }
+
+        std::vector<Hash> hashes;
+        hashes.reserve(moves.size() + 1);
+        hashes.push_back(position_hash(pos));
+        for (uint16_t move : moves) {
+            do_move(pos, static_cast<Move>(move & ~DRAW_OFFER_BIT));
+            hashes.push_back(position_hash(pos));
+        }
+        return hashes;
+    }
+}
+
+}
+
+using namespace simplechess_c;
+
+extern "C" {
+
+SimplechessResult simplechess_game_get_position_hash(SimplechessGame game, SimplechessPositionHash* hash) {
+    if (!game || !hash) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        Position pos;
+        position_from_stage(game_from_handle(game)->currentStage(), pos);
+        *hash = position_hash(pos);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_stage_get_position_hash(SimplechessGameStage stage, SimplechessPositionHash* hash) {
+    if (!stage || !hash) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        Position pos;
+        position_from_stage(*static_cast<simplechess::GameStage*>(stage), pos);
+        *hash = position_hash(pos);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_dedup_create(const char* spill_directory, size_t memory_bytes, SimplechessDedup* dedup) {
+    if (!dedup || (memory_bytes && memory_bytes < min_memory)) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        std::string directory;
+        if (spill_directory) {
+            directory = spill_directory;
+        } else {
+            const char* tmpdir = std::getenv("TMPDIR");
+            directory = tmpdir && *tmpdir ? tmpdir : "/tmp";
+        }
+        int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        ::close(fd);
+
+        *dedup = new PositionDedup(directory, memory_bytes ? memory_bytes : default_memory);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_dedup_insert(SimplechessDedup dedup, const SimplechessPositionHash* hashes, size_t count,
+                                           bool* is_new, size_t* new_count) {
+    if (!dedup || (!hashes && count > 0)) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        size_t added = static_cast<PositionDedup*>(dedup)->insert(hashes, count, is_new);
+        if (new_count) {
+            *new_count = added;
+        }
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_dedup_add_game(SimplechessDedup dedup, SimplechessGame game, bool* is_new,
+                                             size_t is_new_size, size_t* new_count) {
+    if (!dedup || !game) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        const auto* handle = static_cast<GameHandle*>(game);
+        if (is_new && is_new_size < history_length(*handle)) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        std::vector<Hash> hashes = game_hashes(*handle);
+        size_t added = static_cast<PositionDedup*>(dedup)->insert(hashes.data(), hashes.size(), is_new);
+        if (new_count) {
+            *new_count = added;
+        }
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_dedup_get_stats(SimplechessDedup dedup, SimplechessDedupStats* stats) {
+    if (!dedup || !stats) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        static_cast<PositionDedup*>(dedup)->stats(*stats);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+void simplechess_dedup_destroy(SimplechessDedup dedup) {
+    delete static_cast<PositionDedup*>(dedup);
+}
+
+}
@@ -0,0 +1,90 @@
+#include "fen_cache.h"
+#include <cctype>
+
+namespace simplechess_c {
+
+std::string normalize_fen(const std::string& fen) {
+    std::string normalized;
+    normalized.reserve(fen.size());
+    bool space = false;
+    for (char c : fen) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            space = !normalized.empty();
+            continue;
+        }
+        if (space) {
+            normalized.push_back(' ');
+            space = false;
+        }
+        normalized.push_back(c);
+    }
+    return normalized;
+}
+
+GameHandle FenCache::get(const std::string& fen, const std::function<GameHandle()>& build) {
+    std::string key = normalize_fen(fen);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mIndex.find(key);
+        if (it != mIndex.end()) {
+            mStats.hits++;
+            mEntries.splice(mEntries.begin(), mEntries, it->second);
+            return *it->second->second;
+        }
+        mStats.misses++;
+    }
+
+    auto game = std::make_shared<const GameHandle>(build());
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mIndex.find(key);
+    if (it != mIndex.end()) {
+        return *it->second->second;
+    }
+    mEntries.emplace_front(key, game);
+    mIndex.emplace(std::move(key), mEntries.begin());
+    if (mEntries.size() > mCapacity) {
+        mIndex.erase(mEntries.back().first);
+        mEntries.pop_back();
+        mStats.evictions++;
+    }
+    return *game;
+}
+
+SimplechessFenCacheStats FenCache::stats() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    SimplechessFenCacheStats stats = mStats;
+    stats.entries = mEntries.size();
+    return stats;
+}
+
+}
+
+using namespace simplechess_c;
+
+extern "C" {
+
+SimplechessResult simplechess_game_manager_set_fen_cache(SimplechessGameManager manager, size_t capacity) {
+    if (!manager) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto& cache = manager_from_handle(manager)->fen_cache;
+        cache = capacity ? std::make_shared<FenCache>(capacity) : nullptr;
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_game_manager_get_fen_cache_stats(SimplechessGameManager manager, SimplechessFenCacheStats* stats) {
+    if (!manager || !stats) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    const auto& cache = manager_from_handle(manager)->fen_cache;
+    *stats = cache ? cache->stats() : SimplechessFenCacheStats{};
+    return SIMPLECHESS_SUCCESS;
+}
+
+}
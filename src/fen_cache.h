@@ -0,0 +1,58 @@
+/**
+ * @file fen_cache.h
+ * @brief Internal LRU cache of the games built from FENs
+ *
+ * Keeps the games most recently created from a FEN, keyed by the FEN with
+ * its whitespace normalized, along with their legal moves. A hit hands out
+ * a copy of the cached handle, which shares the game, so creating a game
+ * from a popular FEN neither parses it nor builds the game again.
+ *
+ * Games are built outside the lock; when two threads miss on the same FEN
+ * at once, the first one to finish is cached and returned to both.
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_FEN_CACHE_H
+#define SIMPLECHESS_FEN_CACHE_H
+
+#include "simplechess_internal.h"
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace simplechess_c {
+
+/* The FEN with leading and trailing whitespace removed and every other run
+ * of whitespace replaced with one space. */
+std::string normalize_fen(const std::string& fen);
+
+class FenCache {
+public:
+    /* Holds at most capacity games; capacity must not be zero. */
+    explicit FenCache(size_t capacity) : mCapacity(capacity) {}
+
+    /* The game created from fen, built by build() if it is not cached.
+     * Exceptions thrown by build() propagate and nothing is cached. */
+    GameHandle get(const std::string& fen, const std::function<GameHandle()>& build);
+
+    SimplechessFenCacheStats stats() const;
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const GameHandle>>;
+
+    const size_t mCapacity;
+    mutable std::mutex mMutex;
+    /* Most recently used first. */
+    std::list<Entry> mEntries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> mIndex;
+    SimplechessFenCacheStats mStats = {};
+};
+
+}
+
+#endif /* SIMPLECHESS_FEN_CACHE_H */
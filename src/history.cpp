@@ -0,0 +1,254 @@
+#include "history.h"
+#include "position.h"
+#include <simplechess/Board.h>
+#include <simplechess/Game.h>
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+
+namespace simplechess_c {
+
+namespace {
+    simplechess::Square square_from_index(int index) {
+        return simplechess::Square::fromRankAndFile(static_cast<uint8_t>(square_rank(index) + 1),
+                                                    static_cast<char>('a' + square_file(index)));
+    }
+
+    int promoted_kind(simplechess::PieceType type) {
+        switch (type) {
+            case simplechess::PieceType::Knight: return KIND_KNIGHT;
+            case simplechess::PieceType::Bishop: return KIND_BISHOP;
+            case simplechess::PieceType::Rook: return KIND_ROOK;
+            case simplechess::PieceType::Queen: return KIND_QUEEN;
+            default: throw std::invalid_argument("Invalid promotion piece");
+        }
+    }
+
+    simplechess::PieceType promoted_type(int kind) {
+        switch (kind) {
+            case KIND_KNIGHT: return simplechess::PieceType::Knight;
+            case KIND_BISHOP: return simplechess::PieceType::Bishop;
+            case KIND_ROOK: return simplechess::PieceType::Rook;
+            case KIND_QUEEN: return simplechess::PieceType::Queen;
+            default: throw std::invalid_argument("Invalid promotion piece");
+        }
+    }
+
+    /* Stages rebuilt from prefixes, most recently used first. Entries are
+     * keyed by the serial of their prefix, so those of released prefixes are
+     * never hit again and age out. */
+    class StageCache {
+    public:
+        static const size_t capacity = 64;
+
+        std::optional<simplechess::GameStage> find(uint64_t serial, size_t index) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto it = mIndex.find(Key(serial, index));
+            if (it == mIndex.end()) {
+                return std::nullopt;
+            }
+            mEntries.splice(mEntries.begin(), mEntries, it->second);
+            return it->second->stage;
+        }
+
+        void insert(uint64_t serial, size_t index, const simplechess::GameStage& stage) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            Key key(serial, index);
+            if (mIndex.count(key)) {
+                return;
+            }
+            mEntries.push_front(Entry{key, stage});
+            mIndex.emplace(key, mEntries.begin());
+            if (mEntries.size() > capacity) {
+                mIndex.erase(mEntries.back().key);
+                mEntries.pop_back();
+            }
+        }
+
+    private:
+        using Key = std::pair<uint64_t, size_t>;
+
+        struct Entry {
+            Key key;
+            simplechess::GameStage stage;
+        };
+
+        std::mutex mMutex;
+        std::list<Entry> mEntries;
+        std::map<Key, std::list<Entry>::iterator> mIndex;
+    };
+
+    StageCache& stage_cache() {
+        static StageCache instance;
+        return instance;
+    }
+}
+
+uint64_t HistoryPrefix::next_prefix_serial() {
+    static std::atomic<uint64_t> serial(0);
+    return serial.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+uint16_t encode_piece_move(const simplechess::PieceMove& move, bool offer_draw) {
+    int promoted = move.promoted().has_value() ? promoted_kind(move.promoted().value()) : 0;
+    uint16_t encoded = make_move(square_index(move.src().rank(), move.src().file()),
+                                 square_index(move.dst().rank(), move.dst().file()), promoted);
+    return offer_draw ? static_cast<uint16_t>(encoded | DRAW_OFFER_BIT) : encoded;
+}
+
+uint16_t encode_played_move(const simplechess::PlayedMove& move) {
+    return encode_piece_move(move.pieceMove(), move.isDrawOffered());
+}
+
+simplechess::PieceMove decode_move(const simplechess::GameStage& stage, uint16_t move) {
+    auto src = square_from_index(move_from(move));
+    auto dst = square_from_index(move_to(move));
+    auto piece = stage.board().pieceAt(src);
+    if (!piece.has_value()) {
+        throw std::invalid_argument("No piece on the source square of the move");
+    }
+    int promoted = move_promoted(move);
+    if (promoted) {
+        return simplechess::PieceMove::pawnPromotion(piece.value(), src, dst, promoted_type(promoted));
+    }
+    return simplechess::PieceMove::regularMove(piece.value(), src, dst);
+}
+
+simplechess::Game replay_move(const simplechess::GameManager& manager, const simplechess::Game& game, uint16_t move) {
+    return manager.makeMove(game, decode_move(game.currentStage(), move), (move & DRAW_OFFER_BIT) != 0);
+}
+
+size_t anchor_index(const simplechess::Game& game, size_t last) {
+    const auto& history = game.history();
+    for (size_t i = std::min(last, history.size() - 1); i >= 1; --i) {
+        const auto& stage = history[i];
+        if (stage.halfMovesSinceLastCaptureOrPawnAdvance() == 0 && !stage.move()->isDrawOffered()) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+size_t history_length(const GameHandle& handle) {
+    size_t prefix_length = handle.prefix ? handle.prefix->moves.size() : 0;
+    return prefix_length + handle.game->history().size();
+}
+
+simplechess::GameStage stage_at(const GameHandle& handle, size_t index) {
+    const auto& history = handle.game->history();
+    if (!handle.prefix) {
+        return history.at(index);
+    }
+
+    // The first stored stage was created from a FEN and lacks the move that
+    // led to it, so it is rebuilt from the prefix as well
+    const HistoryPrefix& prefix = *handle.prefix;
+    size_t prefix_length = prefix.moves.size();
+    if (index > prefix_length) {
+        return history.at(index - prefix_length);
+    }
+
+    StageCache& cache = stage_cache();
+    if (auto cached = cache.find(prefix.serial, index)) {
+        return *cached;
+    }
+
+    // Replay from the previous stage when it is cached, as it is when the
+    // history is walked forward, or else from the last checkpoint before
+    // the stage. Starting strictly before it gives the stage its move.
+    size_t from = 0;
+    std::string fen;
+    auto previous = index > 0 ? cache.find(prefix.serial, index - 1) : std::nullopt;
+    if (previous) {
+        from = index - 1;
+        fen = previous->fen();
+    } else {
+        auto checkpoint = std::lower_bound(prefix.checkpoints.begin(), prefix.checkpoints.end(), index,
+                                           [](const HistoryCheckpoint& c, size_t i) { return c.index < i; });
+        if (checkpoint != prefix.checkpoints.begin()) {
+            --checkpoint;
+            from = checkpoint->index;
+            fen = checkpoint->fen;
+        } else {
+            fen = prefix.start_fen;
+        }
+    }
+
+    simplechess::GameManager manager;
+    auto game = std::make_unique<simplechess::Game>(manager.createGameFromFen(fen));
+    for (size_t i = from; i < index; ++i) {
+        game = std::make_unique<simplechess::Game>(replay_move(manager, *game, prefix.moves[i]));
+    }
+    cache.insert(prefix.serial, index, game->currentStage());
+    return game->currentStage();
+}
+
+void compact_history(GameHandle& handle) {
+    const simplechess::Game& game = *handle.game;
+    const auto& history = game.history();
+    const size_t interval = handle.checkpoint_interval;
+
+    // The last two stages stay stored, so the current move and the position
+    // it was played from are never rebuilt
+    if (game.gameState() != simplechess::GameState::Playing || history.size() < 3) {
+        return;
+    }
+    size_t anchor = anchor_index(game, history.size() - 3);
+    if (anchor == 0 || anchor < interval) {
+        return;
+    }
+
+    simplechess::GameManager manager;
+    auto rebuilt = std::make_unique<simplechess::Game>(manager.createGameFromFen(history[anchor].fen()));
+    for (size_t i = anchor + 1; i < history.size(); ++i) {
+        const auto& move = history[i].move().value();
+        rebuilt = std::make_unique<simplechess::Game>(manager.makeMove(*rebuilt, move.pieceMove(), move.isDrawOffered()));
+    }
+    if (rebuilt->gameState() != game.gameState()) {
+        return;
+    }
+
+    auto prefix = std::make_shared<HistoryPrefix>();
+    size_t offset = 0;
+    if (handle.prefix) {
+        prefix->start_fen = handle.prefix->start_fen;
+        prefix->moves = handle.prefix->moves;
+        prefix->checkpoints = handle.prefix->checkpoints;
+        offset = handle.prefix->moves.size();
+    } else {
+        prefix->start_fen = history.front().fen();
+    }
+    prefix->moves.reserve(offset + anchor);
+    for (size_t i = 0; i < anchor; ++i) {
+        size_t index = offset + i;
+        if (index > 0 && index % interval == 0) {
+            prefix->checkpoints.push_back(HistoryCheckpoint{index, history[i].fen()});
+        }
+        prefix->moves.push_back(encode_played_move(history[i + 1].move().value()));
+    }
+
+    handle.game = std::make_shared<const simplechess::Game>(std::move(*rebuilt));
+    handle.prefix = std::move(prefix);
+}
+
+void encode_history(const GameHandle& handle, std::string& start_fen, std::vector<uint16_t>& moves) {
+    const auto& history = handle.game->history();
+    moves.clear();
+    if (handle.prefix) {
+        start_fen = handle.prefix->start_fen;
+        moves = handle.prefix->moves;
+    } else {
+        start_fen = history.front().fen();
+    }
+    moves.reserve(moves.size() + history.size() - 1);
+    for (size_t i = 1; i < history.size(); ++i) {
+        moves.push_back(encode_played_move(history[i].move().value()));
+    }
+}
+
+}
@@ -0,0 +1,81 @@
+/**
+ * @file history.h
+ * @brief Compact move encoding and access to the full history of a game
+ *
+ * Moves are packed in 16 bits using the layout of position.h (from, to and
+ * promoted kind), with DRAW_OFFER_BIT set when the move came with a draw
+ * offer. This is the representation used by snapshots.
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_HISTORY_H
+#define SIMPLECHESS_HISTORY_H
+
+#include "simplechess_internal.h"
+#include <simplechess/GameManager.h>
+#include <simplechess/GameStage.h>
+#include <simplechess/PlayedMove.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace simplechess_c {
+
+const uint16_t DRAW_OFFER_BIT = 0x8000;
+
+/* The FEN of one stage of a prefix, from which the following stages can be
+ * rebuilt without replaying the moves before it. */
+struct HistoryCheckpoint {
+    size_t index;
+    std::string fen;
+};
+
+/* The stages of a game before its first stored stage: the FEN of the
+ * initial position and the moves played from it. Stage i of the prefix is
+ * rebuilt by replaying moves from the last checkpoint before it, or from
+ * the initial position.
+ *
+ * Each prefix has its own serial, which keys the rebuilt stages in the
+ * shared stage cache; a prefix is never modified once a handle holds it. */
+struct HistoryPrefix {
+    std::string start_fen;
+    std::vector<uint16_t> moves;
+    /* Sorted by index; may be empty, as for games restored from snapshots. */
+    std::vector<HistoryCheckpoint> checkpoints;
+    uint64_t serial = next_prefix_serial();
+
+    static uint64_t next_prefix_serial();
+};
+
+uint16_t encode_piece_move(const simplechess::PieceMove& move, bool offer_draw);
+uint16_t encode_played_move(const simplechess::PlayedMove& move);
+
+/* Returns the move as a PieceMove, taking the moving piece from the board of
+ * the stage it is played from. Throws std::invalid_argument if there is no
+ * piece on the source square. */
+simplechess::PieceMove decode_move(const simplechess::GameStage& stage, uint16_t move);
+
+/* Applies an encoded move, including its draw offer. */
+simplechess::Game replay_move(const simplechess::GameManager& manager, const simplechess::Game& game, uint16_t move);
+
+/* Index in the stored history of the last stage, at most last, that a game
+ * can be rebuilt from: one reached by a capture or pawn move without a draw
+ * offer, so no earlier position can repeat and no offer is pending. Returns
+ * 0 if there is none. */
+size_t anchor_index(const simplechess::Game& game, size_t last);
+
+/* Number of stages in the game, including those in its prefix. */
+size_t history_length(const GameHandle& handle);
+
+/* Stage at the given index (0 is the initial position). Stages in the prefix
+ * are rebuilt by replay and kept in a small cache shared by all games. The
+ * index must be below history_length(). */
+simplechess::GameStage stage_at(const GameHandle& handle, size_t index);
+
+/* The moves of the whole game, encoded, and the FEN it starts from. */
+void encode_history(const GameHandle& handle, std::string& start_fen, std::vector<uint16_t>& moves);
+
+}
+
+#endif /* SIMPLECHESS_HISTORY_H */
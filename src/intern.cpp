@@ -0,0 +1,92 @@
+#include "intern.h"
+#include "simplechess_internal.h"
+#include <algorithm>
+#include <iterator>
+
+namespace simplechess_c {
+
+namespace {
+    bool same_owner(const std::weak_ptr<const simplechess::Game>& a, const std::shared_ptr<const simplechess::Game>& b) {
+        return !a.owner_before(b) && !b.owner_before(a);
+    }
+}
+
+GameInterner::GamePtr GameInterner::root(const std::string& fen, const std::function<simplechess::Game()>& create) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.lookups++;
+        auto it = mRoots.find(fen);
+        if (it != mRoots.end()) {
+            if (GamePtr game = it->second.lock()) {
+                mStats.hits++;
+                return game;
+            }
+        }
+    }
+
+    // Built outside the lock; if another thread built it meanwhile, its
+    // instance wins so both callers share one
+    GamePtr game = std::make_shared<const simplechess::Game>(create());
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto& entry = mRoots[fen];
+    if (GamePtr existing = entry.lock()) {
+        return existing;
+    }
+    entry = game;
+    sweep_if_needed();
+    return game;
+}
+
+GameInterner::GamePtr GameInterner::child(const GamePtr& parent, uint16_t move, const std::function<simplechess::Game()>& play) {
+    if (parent->history().size() > mMaxPly) {
+        return std::make_shared<const simplechess::Game>(play());
+    }
+
+    const ChildKey key = {parent.get(), move};
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.lookups++;
+        auto it = mChildren.find(key);
+        if (it != mChildren.end() && same_owner(it->second.parent, parent)) {
+            if (GamePtr game = it->second.game.lock()) {
+                mStats.hits++;
+                return game;
+            }
+        }
+    }
+
+    GamePtr game = std::make_shared<const simplechess::Game>(play());
+    std::lock_guard<std::mutex> lock(mMutex);
+    Child& entry = mChildren[key];
+    if (same_owner(entry.parent, parent)) {
+        if (GamePtr existing = entry.game.lock()) {
+            return existing;
+        }
+    }
+    entry.parent = parent;
+    entry.game = game;
+    sweep_if_needed();
+    return game;
+}
+
+SimplechessInternStats GameInterner::stats() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    SimplechessInternStats stats = mStats;
+    stats.entries = mRoots.size() + mChildren.size();
+    return stats;
+}
+
+void GameInterner::sweep_if_needed() {
+    if (mRoots.size() + mChildren.size() < mSweepThreshold) {
+        return;
+    }
+    for (auto it = mRoots.begin(); it != mRoots.end();) {
+        it = it->second.expired() ? mRoots.erase(it) : std::next(it);
+    }
+    for (auto it = mChildren.begin(); it != mChildren.end();) {
+        it = it->second.game.expired() || it->second.parent.expired() ? mChildren.erase(it) : std::next(it);
+    }
+    mSweepThreshold = std::max<size_t>(1024, 2 * (mRoots.size() + mChildren.size()));
+}
+
+}
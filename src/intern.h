@@ -0,0 +1,87 @@
+/**
+ * @file intern.h
+ * @brief Internal sharing of identical games between handles
+ *
+ * simple-chess-games keeps a board and a FEN in every stage of a game's
+ * history, so the games cannot share boards with each other. What they can
+ * share is the whole game object: games created from the same FEN, and the
+ * games that follow them by the same moves, hold identical histories. The
+ * interner hands out one shared instance for each of those while any handle
+ * still holds it, so the openings of many live games are stored once. A
+ * hit also skips the call into simple-chess-games.
+ *
+ * Children are keyed by the identity of their parent and the encoded move
+ * (which sums up the position, since the parent is itself shared), roots by
+ * their FEN. Entries only hold weak references and are swept as their
+ * games are released.
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_INTERN_H
+#define SIMPLECHESS_INTERN_H
+
+#include "simplechess/simplechess.h"
+#include <simplechess/Game.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace simplechess_c {
+
+class GameInterner {
+public:
+    using GamePtr = std::shared_ptr<const simplechess::Game>;
+
+    /* Games with more than max_ply stored stages are not interned. */
+    explicit GameInterner(size_t max_ply) : mMaxPly(max_ply) {}
+
+    /* The game created from fen by create(), shared with the live games
+     * created from the same FEN. */
+    GamePtr root(const std::string& fen, const std::function<simplechess::Game()>& create);
+
+    /* The game that follows parent after a move, encoded as in history.h
+     * with its draw offer, computed by play() if no live game holds it. */
+    GamePtr child(const GamePtr& parent, uint16_t move, const std::function<simplechess::Game()>& play);
+
+    SimplechessInternStats stats() const;
+
+private:
+    struct ChildKey {
+        const void* parent;
+        uint16_t move;
+
+        bool operator==(const ChildKey& other) const { return parent == other.parent && move == other.move; }
+    };
+
+    struct ChildKeyHash {
+        size_t operator()(const ChildKey& key) const {
+            return std::hash<const void*>()(key.parent) ^ (size_t(key.move) * 0x9E3779B97F4A7C15ULL);
+        }
+    };
+
+    /* The parent is kept as a weak reference too: it pins the parent's
+     * control block, so a new game reusing its address is told apart. */
+    struct Child {
+        std::weak_ptr<const simplechess::Game> parent;
+        std::weak_ptr<const simplechess::Game> game;
+    };
+
+    /* Drops the entries of released games once the tables have doubled
+     * since the last sweep. Called with the mutex held. */
+    void sweep_if_needed();
+
+    const size_t mMaxPly;
+    mutable std::mutex mMutex;
+    std::unordered_map<std::string, std::weak_ptr<const simplechess::Game>> mRoots;
+    std::unordered_map<ChildKey, Child, ChildKeyHash> mChildren;
+    size_t mSweepThreshold = 1024;
+    SimplechessInternStats mStats = {};
+};
+
+}
+
+#endif /* SIMPLECHESS_INTERN_H */
@@ -0,0 +1,283 @@
+#include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include "clock.h"
+#include "history.h"
+#include "position.h"
+#include <simplechess/Game.h>
+#include <simplechess/GameStage.h>
+#include <simplechess/PlayedMove.h>
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string>
+
+namespace simplechess_c {
+
+namespace {
+    /* Writes into a fixed buffer and keeps counting once it is full, so the
+     * caller learns the size it needs from a single pass. */
+    class JsonWriter {
+    public:
+        JsonWriter(char* buffer, size_t size) : mBuffer(buffer), mSize(size) {}
+
+        size_t length() const { return mLength; }
+
+        void raw(const char* text, size_t length) {
+            if (mLength < mSize) {
+                std::memcpy(mBuffer + mLength, text, std::min(length, mSize - mLength));
+            }
+            mLength += length;
+        }
+
+        template <size_t N>
+        void raw(const char (&text)[N]) {
+            raw(text, N - 1);
+        }
+
+        void ch(char c) {
+            if (mLength < mSize) {
+                mBuffer[mLength] = c;
+            }
+            mLength++;
+        }
+
+        void string(const char* text, size_t length) {
+            ch('"');
+            for (size_t i = 0; i < length; ++i) {
+                unsigned char c = static_cast<unsigned char>(text[i]);
+                if (c == '"' || c == '\\') {
+                    ch('\\');
+                    ch(static_cast<char>(c));
+                } else if (c < 0x20) {
+                    static const char hex[] = "0123456789abcdef";
+                    raw("\\u00");
+                    ch(hex[c >> 4]);
+                    ch(hex[c & 15]);
+                } else {
+                    ch(static_cast<char>(c));
+                }
+            }
+            ch('"');
+        }
+
+        void string(const std::string& text) { string(text.data(), text.size()); }
+
+        void number(uint64_t value) {
+            char digits[20];
+            size_t n = 0;
+            do {
+                digits[n++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value);
+            while (n) {
+                ch(digits[--n]);
+            }
+        }
+
+        void boolean(bool value) {
+            if (value) {
+                raw("true");
+            } else {
+                raw("false");
+            }
+        }
+
+        void square(int sq) {
+            char name[2] = {static_cast<char>('a' + square_file(sq)), static_cast<char>('1' + square_rank(sq))};
+            string(name, 2);
+        }
+
+    private:
+        char* mBuffer;
+        size_t mSize;
+        size_t mLength = 0;
+    };
+
+    const char* state_name(SimplechessGameState state) {
+        switch (state) {
+            case SIMPLECHESS_GAME_STATE_DRAWN: return "\"drawn\"";
+            case SIMPLECHESS_GAME_STATE_WHITE_WON: return "\"white_won\"";
+            case SIMPLECHESS_GAME_STATE_BLACK_WON: return "\"black_won\"";
+            default: return "\"playing\"";
+        }
+    }
+
+    const char* draw_reason_name(SimplechessDrawReason reason) {
+        switch (reason) {
+            case SIMPLECHESS_DRAW_REASON_STALEMATE: return "\"stalemate\"";
+            case SIMPLECHESS_DRAW_REASON_INSUFFICIENT_MATERIAL: return "\"insufficient_material\"";
+            case SIMPLECHESS_DRAW_REASON_OFFERED_AND_ACCEPTED: return "\"agreement\"";
+            case SIMPLECHESS_DRAW_REASON_THREE_FOLD_REPETITION: return "\"threefold_repetition\"";
+            case SIMPLECHESS_DRAW_REASON_FIVE_FOLD_REPETITION: return "\"fivefold_repetition\"";
+            case SIMPLECHESS_DRAW_REASON_FIFTY_MOVE_RULE: return "\"fifty_move_rule\"";
+            case SIMPLECHESS_DRAW_REASON_SEVENTY_FIVE_MOVE_RULE: return "\"seventy_five_move_rule\"";
+        }
+        return "null";
+    }
+
+    void put(JsonWriter& out, const char* text) {
+        out.raw(text, std::strlen(text));
+    }
+
+    void write_moves(JsonWriter& out, const Position& pos, bool playing) {
+        static const char promotions[] = " nbrq";
+        out.raw(",\"moves\":[");
+        if (playing) {
+            MoveList list;
+            generate_legal_moves(pos, list);
+            for (size_t i = 0; i < list.size; ++i) {
+                Move move = list.moves[i];
+                char text[5] = {static_cast<char>('a' + square_file(move_from(move))),
+                                static_cast<char>('1' + square_rank(move_from(move))),
+                                static_cast<char>('a' + square_file(move_to(move))),
+                                static_cast<char>('1' + square_rank(move_to(move))),
+                                promotions[move_promoted(move)]};
+                if (i) {
+                    out.ch(',');
+                }
+                out.string(text, move_promoted(move) ? 5 : 4);
+            }
+        }
+        out.ch(']');
+    }
+
+    void write_clock(JsonWriter& out, const GameHandle& handle) {
+        out.raw(",\"clock\":");
+        if (!handle.clock) {
+            out.raw("null");
+            return;
+        }
+        SimplechessClockState clock;
+        read_clock(*handle.clock, clock);
+        out.raw("{\"white_ms\":");
+        out.number(clock.white_ms);
+        out.raw(",\"black_ms\":");
+        out.number(clock.black_ms);
+        out.raw(",\"running\":");
+        if (!clock.running) {
+            out.raw("null");
+        } else if (clock.running_color == SIMPLECHESS_COLOR_WHITE) {
+            out.raw("\"white\"");
+        } else {
+            out.raw("\"black\"");
+        }
+        out.raw(",\"flagged\":");
+        out.boolean(clock.flagged);
+        out.ch('}');
+    }
+
+    void write_game(JsonWriter& out, const GameHandle& handle, uint32_t flags) {
+        const simplechess::Game& game = *handle.game;
+        size_t length = history_length(handle);
+
+        // A restored game's first stored stage lacks its move; rebuild it
+        // only in that case
+        const simplechess::GameStage* current = &game.currentStage();
+        std::optional<simplechess::GameStage> rebuilt;
+        if (!current->move().has_value() && length > 1) {
+            rebuilt.emplace(stage_at(handle, length - 1));
+            current = &*rebuilt;
+        }
+        Position pos;
+        position_from_stage(*current, pos);
+
+        bool drawn_on_time = false;
+        SimplechessGameState state = effective_game_state(handle, &drawn_on_time);
+
+        out.raw("{\"state\":");
+        put(out, state_name(state));
+        out.raw(",\"draw_reason\":");
+        if (state != SIMPLECHESS_GAME_STATE_DRAWN) {
+            out.raw("null");
+        } else if (drawn_on_time) {
+            put(out, draw_reason_name(SIMPLECHESS_DRAW_REASON_INSUFFICIENT_MATERIAL));
+        } else {
+            put(out, draw_reason_name(cpp_to_c_draw_reason(game.drawReason())));
+        }
+        out.raw(",\"active_color\":");
+        if (pos.side == WHITE) {
+            out.raw("\"white\"");
+        } else {
+            out.raw("\"black\"");
+        }
+        out.raw(",\"fen\":");
+        out.string(current->fen());
+
+        out.raw(",\"castling\":\"");
+        if (!pos.castling) {
+            out.ch('-');
+        }
+        if (pos.castling & SIMPLECHESS_CASTLING_WHITE_KINGSIDE) {
+            out.ch('K');
+        }
+        if (pos.castling & SIMPLECHESS_CASTLING_WHITE_QUEENSIDE) {
+            out.ch('Q');
+        }
+        if (pos.castling & SIMPLECHESS_CASTLING_BLACK_KINGSIDE) {
+            out.ch('k');
+        }
+        if (pos.castling & SIMPLECHESS_CASTLING_BLACK_QUEENSIDE) {
+            out.ch('q');
+        }
+        out.ch('"');
+
+        out.raw(",\"en_passant\":");
+        if (pos.en_passant >= 0) {
+            out.square(pos.en_passant);
+        } else {
+            out.raw("null");
+        }
+        out.raw(",\"halfmove_clock\":");
+        out.number(pos.halfmove_clock);
+        out.raw(",\"fullmove_number\":");
+        out.number(pos.fullmove_counter);
+        out.raw(",\"ply\":");
+        out.number(length - 1);
+        out.raw(",\"last_move\":");
+        if (current->move().has_value()) {
+            out.string(current->move()->inAlgebraicNotation());
+        } else {
+            out.raw("null");
+        }
+        out.raw(",\"in_check\":");
+        out.boolean(checkers(pos) != 0);
+
+        if (flags & SIMPLECHESS_JSON_MOVES) {
+            write_moves(out, pos, state == SIMPLECHESS_GAME_STATE_PLAYING);
+        }
+        if (flags & SIMPLECHESS_JSON_CLOCK) {
+            write_clock(out, handle);
+        }
+        out.ch('}');
+    }
+}
+
+}
+
+using namespace simplechess_c;
+
+extern "C" {
+
+SimplechessResult simplechess_game_to_json(SimplechessGame game, uint32_t flags, char* buffer, size_t buffer_size,
+                                           size_t* required) {
+    if (!game || (!buffer && buffer_size)) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        JsonWriter out(buffer, buffer_size);
+        write_game(out, *static_cast<GameHandle*>(game), flags);
+        if (required) {
+            *required = out.length() + 1;
+        }
+        if (out.length() >= buffer_size) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        buffer[out.length()] = '\0';
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+}
@@ -0,0 +1,105 @@
+#include "memory_usage.h"
+#include "clock.h"
+#include "history.h"
+#include <simplechess/Board.h>
+#include <simplechess/Game.h>
+#include <simplechess/GameStage.h>
+#include <simplechess/PlayedMove.h>
+#include <utility>
+
+namespace simplechess_c {
+
+namespace {
+    size_t stage_heap_bytes(const simplechess::GameStage& stage) {
+        using Square = std::pair<const simplechess::Square, simplechess::Piece>;
+        size_t bytes = stage.board().occupiedSquares().size() * tree_node_bytes(sizeof(Square));
+        bytes += string_heap_bytes(stage.fen());
+        if (stage.move()) {
+            bytes += string_heap_bytes(stage.move()->inAlgebraicNotation());
+        }
+        return bytes;
+    }
+
+    size_t game_bytes(const simplechess::Game& game) {
+        const auto& history = game.history();
+        size_t bytes = shared_control_bytes() + sizeof(simplechess::Game);
+        bytes += history.capacity() * sizeof(simplechess::GameStage);
+        for (const auto& stage : history) {
+            bytes += stage_heap_bytes(stage);
+        }
+        bytes += game.allAvailableMoves().size() * tree_node_bytes(sizeof(simplechess::PieceMove));
+        return bytes;
+    }
+}
+
+size_t string_heap_bytes(const std::string& s) {
+    // Short strings live inside the object
+    static const size_t inline_capacity = std::string().capacity();
+    return s.capacity() > inline_capacity ? s.capacity() + 1 : 0;
+}
+
+size_t tree_node_bytes(size_t value_size) {
+    // Color, parent, left and right, then the value
+    return 4 * sizeof(void*) + value_size;
+}
+
+size_t hash_node_bytes(size_t value_size) {
+    // Next pointer, then the value
+    return sizeof(void*) + value_size;
+}
+
+size_t shared_control_bytes() {
+    // Virtual table pointer and the two reference counts
+    return sizeof(void*) + 2 * sizeof(int);
+}
+
+void MemoryCounter::add_game(const GameHandle& handle) {
+    if (first_visit(handle.game.get())) {
+        add(game_bytes(*handle.game));
+    }
+    if (first_visit(handle.prefix.get())) {
+        const HistoryPrefix& prefix = *handle.prefix;
+        add(shared_control_bytes() + sizeof(HistoryPrefix) + string_heap_bytes(prefix.start_fen)
+            + prefix.moves.capacity() * sizeof(uint16_t) + prefix.checkpoints.capacity() * sizeof(HistoryCheckpoint));
+        for (const auto& checkpoint : prefix.checkpoints) {
+            add(string_heap_bytes(checkpoint.fen));
+        }
+    }
+    if (first_visit(handle.clock.get())) {
+        add(shared_control_bytes() + sizeof(ClockState));
+        // The timer is shared by all readings of the clock
+        if (first_visit(handle.clock->timer.get())) {
+            add(shared_control_bytes() + sizeof(ClockTimer));
+        }
+    }
+    if (first_visit(handle.update.get())) {
+        add(shared_control_bytes() + update_slot_bytes(*handle.update));
+    }
+    if (first_visit(handle.moves.get())) {
+        add(shared_control_bytes() + move_cache_bytes());
+    }
+}
+
+}
+
+using namespace simplechess_c;
+
+extern "C" {
+
+SimplechessResult simplechess_game_memory_usage(SimplechessGame game, size_t* bytes) {
+    if (!game || !bytes) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        MemoryCounter counter;
+        counter.add(sizeof(GameHandle));
+        counter.add_game(*static_cast<GameHandle*>(game));
+        *bytes = counter.bytes();
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+}
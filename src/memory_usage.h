@@ -0,0 +1,56 @@
+/**
+ * @file memory_usage.h
+ * @brief Internal estimate of the heap memory held by games
+ *
+ * Sizes are the bytes requested from the allocator, node-based containers
+ * counted with the usual node layout of the standard library. Allocator
+ * overhead and rounding are not counted.
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_MEMORY_USAGE_H
+#define SIMPLECHESS_MEMORY_USAGE_H
+
+#include "simplechess_internal.h"
+#include <cstddef>
+#include <string>
+#include <unordered_set>
+
+namespace simplechess_c {
+
+/* Adds up the memory of several objects, counting the objects they share
+ * (such as the game behind copies of a handle) once. */
+class MemoryCounter {
+public:
+    void add(size_t bytes) { mBytes += bytes; }
+
+    /* The handle object itself is not counted, since it may live inside
+     * another structure. */
+    void add_game(const GameHandle& handle);
+
+    size_t bytes() const { return mBytes; }
+
+private:
+    /* Returns true the first time it sees an object. */
+    bool first_visit(const void* object) { return object && mSeen.insert(object).second; }
+
+    std::unordered_set<const void*> mSeen;
+    size_t mBytes = 0;
+};
+
+/* Heap bytes of a string beyond the object itself. */
+size_t string_heap_bytes(const std::string& s);
+
+/* Bytes of a node of a std::map or std::set holding values of this size. */
+size_t tree_node_bytes(size_t value_size);
+
+/* Bytes of a node of a std::unordered_map or std::unordered_set. */
+size_t hash_node_bytes(size_t value_size);
+
+/* Bytes of the control block of a std::make_shared allocation. */
+size_t shared_control_bytes();
+
+}
+
+#endif /* SIMPLECHESS_MEMORY_USAGE_H */
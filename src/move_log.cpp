@@ -0,0 +1,576 @@
+#include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include "move_log.h"
+#include "session_store.h"
+#include "snapshot.h"
+#include "history.h"
+#include "serialize.h"
+#include "crc32.h"
+#include <simplechess/Game.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace simplechess_c {
+
+namespace {
+    const char log_magic[8] = {'S', 'C', 'M', 'L', 'O', 'G', '0', '1'};
+    const size_t header_size = 16;
+    const size_t record_header_size = 25;
+
+    using RecordVisitor = std::function<void(uint64_t lsn, uint64_t id, LogRecordKind kind,
+                                             const uint8_t* payload, size_t size, size_t offset)>;
+
+    void write_all(int fd, const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+            ssize_t written = ::write(fd, bytes, size);
+            if (written < 0) {
+                throw std::runtime_error("Failed to write move log");
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+
+    // A missing file reads as empty
+    void read_file(const std::string& path, std::vector<uint8_t>& data) {
+        data.clear();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == ENOENT) {
+                return;
+            }
+            throw std::invalid_argument("Cannot open move log");
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::invalid_argument("Cannot open move log");
+        }
+        data.resize(static_cast<size_t>(st.st_size));
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t n = ::read(fd, data.data() + done, data.size() - done);
+            if (n <= 0) {
+                ::close(fd);
+                throw std::runtime_error("Failed to read move log");
+            }
+            done += static_cast<size_t>(n);
+        }
+        ::close(fd);
+    }
+
+    std::vector<uint8_t> make_header(uint64_t first_lsn) {
+        std::vector<uint8_t> header(log_magic, log_magic + sizeof(log_magic));
+        put_u64(header, first_lsn);
+        return header;
+    }
+
+    // Visits the valid records in order and returns the offset where they
+    // end. Throws std::invalid_argument if the header is not a log header.
+    size_t scan_records(const std::vector<uint8_t>& data, uint64_t* first_lsn, const RecordVisitor& visit) {
+        if (data.size() < header_size || std::memcmp(data.data(), log_magic, sizeof(log_magic)) != 0) {
+            throw std::invalid_argument("Not a move log file");
+        }
+        if (first_lsn) {
+            *first_lsn = get_u64(data.data() + 8);
+        }
+
+        size_t offset = header_size;
+        uint64_t previous = 0;
+        while (data.size() - offset >= record_header_size) {
+            const uint8_t* record = data.data() + offset;
+            size_t size = get_u32(record);
+            if (size > data.size() - offset - record_header_size) {
+                break;
+            }
+            size_t length = record_header_size + size;
+            if (crc32_update(0, record + 8, length - 8) != get_u32(record + 4)) {
+                break;
+            }
+            uint64_t lsn = get_u64(record + 8);
+            if (lsn <= previous) {
+                break;
+            }
+            visit(lsn, get_u64(record + 16), static_cast<LogRecordKind>(record[24]), record + record_header_size, size, offset);
+            previous = lsn;
+            offset += length;
+        }
+        return offset;
+    }
+
+    void sync_directory(const std::string& path) {
+        size_t slash = path.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+        int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd >= 0) {
+            ::fsync(fd);
+            ::close(fd);
+        }
+    }
+
+    void apply_record(SessionStore& store, uint64_t id, LogRecordKind kind, const uint8_t* payload, size_t size) {
+        auto& manager = store.manager();
+        bool found = false;
+        switch (kind) {
+            case LOG_CREATE:
+                found = store.create(id, size ? std::string(reinterpret_cast<const char*>(payload), size) : std::string());
+                break;
+            case LOG_MOVE: {
+                if (size != 2) {
+                    throw std::invalid_argument("Malformed move log record");
+                }
+                uint16_t move = get_u16(payload);
+                found = store.update(id, [&manager, move](const simplechess::Game& game) {
+                    return replay_move(manager, game, move);
+                }, nullptr);
+                break;
+            }
+            case LOG_CLAIM_DRAW:
+                found = store.update(id, [&manager](const simplechess::Game& game) {
+                    return manager.claimDraw(game);
+                }, nullptr);
+                break;
+            case LOG_RESIGN: {
+                if (size != 1 || payload[0] > 1) {
+                    throw std::invalid_argument("Malformed move log record");
+                }
+                auto color = payload[0] ? simplechess::Color::Black : simplechess::Color::White;
+                found = store.update(id, [&manager, color](const simplechess::Game& game) {
+                    return manager.resign(game, color);
+                }, nullptr);
+                break;
+            }
+            case LOG_REMOVE:
+                found = store.remove(id);
+                break;
+            case LOG_GAME:
+                // Also written for every stored game when a log is attached,
+                // so it may restate a game the store already has
+                if (game_record_length(payload, size) != size) {
+                    throw std::invalid_argument("Malformed move log record");
+                }
+                store.assign(id, decode_game_record(manager, payload));
+                found = true;
+                break;
+            default:
+                throw std::invalid_argument("Unknown move log record");
+        }
+        if (!found) {
+            throw std::invalid_argument("Move log does not match the restored games");
+        }
+    }
+}
+
+MoveLog::MoveLog(const std::string& path) : mPath(path) {
+    std::vector<uint8_t> data;
+    read_file(path, data);
+
+    size_t end = header_size;
+    uint64_t first_lsn = 1;
+    if (!data.empty()) {
+        end = scan_records(data, &first_lsn, [this](uint64_t lsn, uint64_t, LogRecordKind, const uint8_t*, size_t, size_t) {
+            mLastLsn = lsn;
+        });
+    }
+    mLastLsn = std::max(mLastLsn, first_lsn - 1);
+    mDurableLsn = mLastLsn;
+
+    mFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (mFd < 0) {
+        throw std::invalid_argument("Cannot open move log");
+    }
+    try {
+        if (data.empty()) {
+            auto header = make_header(first_lsn);
+            write_all(mFd, header.data(), header.size());
+        } else if (end < data.size() && ::ftruncate(mFd, static_cast<off_t>(end)) != 0) {
+            throw std::runtime_error("Failed to cut the torn end of the move log");
+        }
+        if (::lseek(mFd, static_cast<off_t>(end), SEEK_SET) < 0 || ::fdatasync(mFd) != 0) {
+            throw std::runtime_error("Failed to sync move log");
+        }
+        if (data.empty()) {
+            sync_directory(path);
+        }
+    } catch (...) {
+        ::close(mFd);
+        throw;
+    }
+
+    mWriter = std::thread(&MoveLog::run, this);
+}
+
+MoveLog::~MoveLog() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWork.notify_one();
+    mWriter.join();
+    ::close(mFd);
+}
+
+uint64_t MoveLog::append(uint64_t id, LogRecordKind kind, const void* payload, size_t size) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    uint64_t lsn = ++mLastLsn;
+    size_t start = mPending.size();
+    put_u32(mPending, static_cast<uint32_t>(size));
+    put_u32(mPending, 0);
+    put_u64(mPending, lsn);
+    put_u64(mPending, id);
+    mPending.push_back(kind);
+    mPending.insert(mPending.end(), static_cast<const uint8_t*>(payload), static_cast<const uint8_t*>(payload) + size);
+
+    uint32_t crc = crc32_update(0, mPending.data() + start + 8, mPending.size() - start - 8);
+    std::vector<uint8_t> encoded;
+    put_u32(encoded, crc);
+    std::copy(encoded.begin(), encoded.end(), mPending.begin() + start + 4);
+
+    mWork.notify_one();
+    return lsn;
+}
+
+void MoveLog::run() {
+    std::vector<uint8_t> batch;
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mWork.wait(lock, [this] { return !mTruncating && (mStop || !mPending.empty()); });
+        if (mPending.empty()) {
+            break;
+        }
+
+        // Everything queued so far goes out with one sync; records appended
+        // meanwhile wait for the next round
+        batch.swap(mPending);
+        uint64_t lsn = mLastLsn;
+        int fd = mFd;
+        mWriting = true;
+        lock.unlock();
+
+        bool written = true;
+        try {
+            write_all(fd, batch.data(), batch.size());
+            written = ::fdatasync(fd) == 0;
+        } catch (...) {
+            written = false;
+        }
+        batch.clear();
+
+        lock.lock();
+        mWriting = false;
+        if (written && !mFailed) {
+            mDurableLsn = lsn;
+        } else {
+            mFailed = true;
+        }
+        mDone.notify_all();
+    }
+}
+
+void MoveLog::wait_durable(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    lsn = std::min(lsn, mLastLsn);
+    mDone.wait(lock, [this, lsn] { return mDurableLsn >= lsn || mFailed; });
+    if (mDurableLsn < lsn) {
+        throw std::runtime_error("Failed to write move log");
+    }
+}
+
+uint64_t MoveLog::last_lsn() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mLastLsn;
+}
+
+uint64_t MoveLog::durable_lsn() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mDurableLsn;
+}
+
+void MoveLog::truncate(uint64_t lsn) {
+    std::vector<uint8_t> pending;
+    uint64_t cut;
+    int old_fd;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDone.wait(lock, [this] { return !mWriting && !mTruncating; });
+        if (mFailed) {
+            throw std::runtime_error("Failed to write move log");
+        }
+        // The writer leaves the file alone until the new one is in place;
+        // records appended meanwhile wait in memory
+        mTruncating = true;
+        pending.swap(mPending);
+        cut = mLastLsn;
+        old_fd = mFd;
+    }
+
+    int fd = -1;
+    bool flushed = false;
+    try {
+        // Flush here so the rewritten log holds every record up to cut
+        write_all(old_fd, pending.data(), pending.size());
+        if (::fdatasync(old_fd) != 0) {
+            throw std::runtime_error("Failed to sync move log");
+        }
+        flushed = true;
+
+        std::vector<uint8_t> data;
+        read_file(mPath, data);
+        std::vector<uint8_t> kept = make_header(std::max(lsn, cut) + 1);
+        scan_records(data, nullptr, [&data, &kept, lsn](uint64_t record_lsn, uint64_t, LogRecordKind, const uint8_t*,
+                                                       size_t size, size_t offset) {
+            if (record_lsn > lsn) {
+                kept.insert(kept.end(), data.begin() + offset, data.begin() + offset + record_header_size + size);
+            }
+        });
+
+        std::string temporary_path = mPath + ".tmp";
+        fd = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot create move log");
+        }
+        try {
+            write_all(fd, kept.data(), kept.size());
+            if (::fdatasync(fd) != 0 || ::rename(temporary_path.c_str(), mPath.c_str()) != 0) {
+                throw std::runtime_error("Failed to replace move log");
+            }
+        } catch (...) {
+            ::close(fd);
+            ::unlink(temporary_path.c_str());
+            throw;
+        }
+        sync_directory(mPath);
+    } catch (...) {
+        // The old log stays in use; it is only broken if the flush failed
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTruncating = false;
+            if (flushed) {
+                mDurableLsn = cut;
+            } else {
+                mFailed = true;
+            }
+        }
+        mDone.notify_all();
+        mWork.notify_one();
+        throw;
+    }
+
+    // Swap files; the writer then appends the records queued meanwhile to
+    // the new log
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFd = fd;
+        mDurableLsn = cut;
+        mTruncating = false;
+    }
+    ::close(old_fd);
+    mDone.notify_all();
+    mWork.notify_one();
+}
+
+void replay_log(const std::string& path, uint64_t after_lsn, SessionStore& store, size_t threads) {
+    std::vector<uint8_t> data;
+    read_file(path, data);
+    if (data.empty()) {
+        return;
+    }
+
+    struct Entry {
+        uint64_t id;
+        LogRecordKind kind;
+        const uint8_t* payload;
+        size_t size;
+    };
+    threads = std::max<size_t>(threads, 1);
+    std::vector<std::vector<Entry>> partitions(threads);
+    scan_records(data, nullptr, [&partitions, after_lsn, threads](uint64_t lsn, uint64_t id, LogRecordKind kind,
+                                                                  const uint8_t* payload, size_t size, size_t) {
+        if (lsn > after_lsn) {
+            partitions[id % threads].push_back({id, kind, payload, size});
+        }
+    });
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto replay_partition = [&store, &partitions, &error, &error_mutex](size_t index) {
+        try {
+            for (const Entry& entry : partitions[index]) {
+                apply_record(store, entry.id, entry.kind, entry.payload, entry.size);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; ++t) {
+        workers.emplace_back(replay_partition, t);
+    }
+    replay_partition(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+}
+
+using namespace simplechess_c;
+
+extern "C" {
+
+SimplechessResult simplechess_move_log_open(const char* path, SimplechessMoveLog* log) {
+    if (!path || !log) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        *log = new MoveLog(path);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+void simplechess_move_log_close(SimplechessMoveLog log) {
+    if (log) {
+        delete static_cast<MoveLog*>(log);
+    }
+}
+
+SimplechessResult simplechess_session_store_set_move_log(SimplechessSessionStore store, SimplechessMoveLog log) {
+    if (!store) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        static_cast<SessionStore*>(store)->set_log(static_cast<MoveLog*>(log));
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_move_log_get_lsn(SimplechessMoveLog log, uint64_t* last_lsn, uint64_t* durable_lsn) {
+    if (!log || (!last_lsn && !durable_lsn)) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* l = static_cast<MoveLog*>(log);
+        if (last_lsn) {
+            *last_lsn = l->last_lsn();
+        }
+        if (durable_lsn) {
+            *durable_lsn = l->durable_lsn();
+        }
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_move_log_wait_durable(SimplechessMoveLog log, uint64_t lsn) {
+    if (!log) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        static_cast<MoveLog*>(log)->wait_durable(lsn);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_move_log_sync(SimplechessMoveLog log) {
+    if (!log) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* l = static_cast<MoveLog*>(log);
+        l->wait_durable(l->last_lsn());
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_move_log_checkpoint(SimplechessMoveLog log, SimplechessSessionStore store, const char* snapshot_path) {
+    if (!log || !store || !snapshot_path) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* l = static_cast<MoveLog*>(log);
+        auto* s = static_cast<SessionStore*>(store);
+        if (s->log() != l) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+
+        std::vector<std::pair<uint64_t, GameHandle>> games;
+        games.reserve(s->count());
+        uint64_t lsn = s->collect(games);
+
+        SnapshotWriter writer(snapshot_path, lsn);
+        for (const auto& entry : games) {
+            writer.add(entry.first, entry.second);
+        }
+        writer.commit();
+
+        // Only once the snapshot is in place may the records it covers go
+        l->truncate(lsn);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_move_log_recover(SimplechessSessionStore store, const char* snapshot_path, const char* log_path,
+                                               size_t threads) {
+    if (!store || !log_path) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* s = static_cast<SessionStore*>(store);
+        if (s->log()) {
+            return SIMPLECHESS_ERROR_ILLEGAL_STATE;
+        }
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        uint64_t lsn = 0;
+        if (snapshot_path && ::access(snapshot_path, F_OK) == 0) {
+            SnapshotFile snapshot(snapshot_path);
+            SimplechessResult result = restore_snapshot(snapshot, *s, threads);
+            if (result != SIMPLECHESS_SUCCESS) {
+                return result;
+            }
+            lsn = snapshot.sequence();
+        }
+        replay_log(log_path, lsn, *s, threads);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+}
@@ -0,0 +1,101 @@
+/**
+ * @file move_log.h
+ * @brief Internal write-ahead log of session store changes
+ *
+ * Every change made through a session store with an attached log is
+ * appended as a record numbered by a log sequence number (LSN). Appending
+ * only copies the record into memory; a background thread writes whatever
+ * has accumulated and syncs it with a single fdatasync, so moves from many
+ * games share one sync (group commit). Callers that must not acknowledge a
+ * move before it is durable wait for its LSN.
+ *
+ * All integers are little-endian.
+ *
+ *   header:  magic "SCMLOG01", u64 LSN of the first record that can follow
+ *   record:  u32 payload length, u32 CRC-32 of the rest of the record,
+ *            u64 LSN, u64 game id, u8 kind, payload
+ *
+ * A record that is cut short or fails its checksum ends the log: it was
+ * being written when the process stopped and was never reported durable.
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_MOVE_LOG_H
+#define SIMPLECHESS_MOVE_LOG_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace simplechess_c {
+
+class SessionStore;
+
+enum LogRecordKind : uint8_t {
+    LOG_CREATE = 1,     /* payload: FEN, empty for the standard position */
+    LOG_MOVE = 2,       /* payload: u16 move (see history.h) */
+    LOG_CLAIM_DRAW = 3, /* no payload */
+    LOG_RESIGN = 4,     /* payload: u8 resigning color, 0 white 1 black */
+    LOG_REMOVE = 5,     /* no payload */
+    LOG_GAME = 6        /* payload: a game record (see snapshot.h) */
+};
+
+class MoveLog {
+public:
+    /* Opens or creates the log. A torn record at the end of an existing log
+     * is cut off and numbering continues after the last valid record. */
+    explicit MoveLog(const std::string& path);
+
+    /* Writes and syncs the records still pending. */
+    ~MoveLog();
+
+    MoveLog(const MoveLog&) = delete;
+    MoveLog& operator=(const MoveLog&) = delete;
+
+    /* Queues a record and returns its LSN. */
+    uint64_t append(uint64_t id, LogRecordKind kind, const void* payload, size_t size);
+
+    /* Blocks until every record up to lsn is on disk. Throws
+     * std::runtime_error if the log could not be written. */
+    void wait_durable(uint64_t lsn);
+
+    uint64_t last_lsn() const;
+    uint64_t durable_lsn() const;
+
+    /* Drops the records up to lsn, which a snapshot now covers. The log is
+     * rewritten without holding the lock that append() takes, so changes
+     * keep being logged meanwhile; they are written to the new log once it
+     * replaces the old one. */
+    void truncate(uint64_t lsn);
+
+private:
+    void run();
+
+    std::string mPath;
+    int mFd = -1;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mWork;
+    std::condition_variable mDone;
+    std::vector<uint8_t> mPending;
+    uint64_t mLastLsn = 0;
+    uint64_t mDurableLsn = 0;
+    bool mWriting = false;
+    bool mTruncating = false;
+    bool mFailed = false;
+    bool mStop = false;
+    std::thread mWriter;
+};
+
+/* Applies the records of the log after the given LSN to the store. Records
+ * of one game are applied in order by one thread; different games are
+ * spread over the threads. */
+void replay_log(const std::string& path, uint64_t after_lsn, SessionStore& store, size_t threads);
+
+}
+
+#endif /* SIMPLECHESS_MOVE_LOG_H */
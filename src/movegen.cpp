@@ -0,0 +1,477 @@
+#include "movegen.h"
+#include "history.h"
+#include <simplechess/Game.h>
+#include <simplechess/GameManager.h>
+#include <simplechess/GameStage.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace simplechess_c {
+
+namespace {
+    uint64_t default_perft(const simplechess::GameManager& manager, const simplechess::Game& game, unsigned depth) {
+        if (depth == 0) {
+            return 1;
+        }
+        const auto& moves = game.allAvailableMoves();
+        if (depth == 1) {
+            return moves.size();
+        }
+        uint64_t nodes = 0;
+        for (const auto& move : moves) {
+            nodes += default_perft(manager, manager.makeMove(game, move), depth - 1);
+        }
+        return nodes;
+    }
+
+    struct MoveVisit {
+        const Position* pos;
+        SimplechessMoveCallback callback;
+        void* user_data;
+    };
+
+    bool visit_c_move(void* context, Move move) {
+        const auto* visit = static_cast<MoveVisit*>(context);
+        SimplechessPieceMove c_move = to_c_piece_move(*visit->pos, move);
+        return visit->callback(visit->user_data, &c_move);
+    }
+
+    /* Buckets moves by source square (counting sort), keeping the order of
+     * the moves within a square. from(move) is the source index, convert
+     * the move as the C API reports it. */
+    template <typename Range, typename From, typename Convert>
+    SimplechessResult bucket_moves(const Range& range, size_t count, From from, Convert convert, uint16_t offsets[65],
+                                   SimplechessPieceMove* moves, size_t moves_size, SimplechessSquareSet* destinations) {
+        if (moves_size < count) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        uint16_t next[64] = {};
+        for (const auto& move : range) {
+            next[from(move)]++;
+        }
+        uint16_t offset = 0;
+        for (int sq = 0; sq < 64; ++sq) {
+            offsets[sq] = offset;
+            offset = static_cast<uint16_t>(offset + next[sq]);
+            next[sq] = offsets[sq];
+            if (destinations) {
+                destinations[sq] = 0;
+            }
+        }
+        offsets[64] = offset;
+        for (const auto& move : range) {
+            SimplechessPieceMove& c_move = moves[next[from(move)]++];
+            c_move = convert(move);
+            if (destinations) {
+                destinations[c_square_to_index(c_move.src)] |= SimplechessSquareSet(1) << c_square_to_index(c_move.dst);
+            }
+        }
+        return SIMPLECHESS_SUCCESS;
+    }
+
+    /* Whether the bitboard generator should generate the moves of a game
+     * itself rather than use its cache, which is empty once it is over. */
+    bool generate_uncached(const GameHandle& handle, const LegalMoves*& cached) {
+        cached = cached_legal_moves(handle);
+        return !cached && handle.game->gameState() == simplechess::GameState::Playing;
+    }
+
+    enum MoveStage {
+        STAGE_CAPTURES,
+        STAGE_CHECKS,
+        STAGE_QUIETS
+    };
+
+    const int piece_values[KIND_COUNT] = {1, 3, 3, 5, 9, 0};
+
+    /* Most valuable victim, then least valuable attacker; a promotion
+     * gains the promoted piece in place of the pawn. */
+    int mvv_lva_score(const Position& pos, Move move) {
+        int gain = pos.board[move_to(move)] ? piece_values[piece_code_kind(pos.board[move_to(move)])]
+                                            : (is_capture(pos, move) ? piece_values[KIND_PAWN] : 0);
+        if (move_promoted(move)) {
+            gain += piece_values[move_promoted(move)] - piece_values[KIND_PAWN];
+        }
+        return gain * 16 - piece_values[moved_kind(pos, move)];
+    }
+
+    /* Orders captures by MVV-LVA, scoring each move once. Insertion sort
+     * keeps equal scores in generation order without the buffer
+     * std::stable_sort takes; capture lists are short. */
+    void sort_captures(const Position& pos, MoveList& list) {
+        int scores[256];
+        for (size_t i = 0; i < list.size; ++i) {
+            const Move move = list.moves[i];
+            const int score = mvv_lva_score(pos, move);
+            size_t j = i;
+            for (; j > 0 && scores[j - 1] < score; --j) {
+                scores[j] = scores[j - 1];
+                list.moves[j] = list.moves[j - 1];
+            }
+            scores[j] = score;
+            list.moves[j] = move;
+        }
+    }
+
+    /* The legal moves of a game in one stage, captures in MVV-LVA order
+     * and the others in generation order. */
+    SimplechessResult staged_moves(SimplechessGame game, MoveStage stage, SimplechessPieceMove* moves, size_t moves_size,
+                                   size_t* count) {
+        if (!game || !moves || !count) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+
+        try {
+            const auto* handle = static_cast<GameHandle*>(game);
+            const LegalMoves* legal = nullptr;
+            Position pos;
+            MoveList selected;
+            bool generated = false;
+            if (handle->move_generator == SIMPLECHESS_MOVE_GENERATOR_BITBOARD) {
+                // Unless all the moves are cached already, the capture stage
+                // generates only moves to its own target squares
+                const LegalMoves* cached;
+                if (stage == STAGE_CAPTURES && generate_uncached(*handle, cached)) {
+                    position_from_stage(handle->game->currentStage(), pos);
+                    generate_captures(pos, selected);
+                    generated = true;
+                } else {
+                    legal = &legal_moves(*handle);
+                    pos = legal->pos;
+                }
+            } else {
+                position_from_stage(handle->game->currentStage(), pos);
+            }
+
+            // Captures and promotions are told apart by the move alone; only
+            // the other stages need to know which moves give check
+            CheckInfo info;
+            if (stage != STAGE_CAPTURES) {
+                init_check_info(pos, info);
+            }
+            auto select = [&](Move move) {
+                if (move_promoted(move) || is_capture(pos, move)) {
+                    if (stage == STAGE_CAPTURES) {
+                        selected.push(move);
+                    }
+                } else if (stage != STAGE_CAPTURES && gives_check(pos, info, move) == (stage == STAGE_CHECKS)) {
+                    selected.push(move);
+                }
+            };
+            if (legal) {
+                for (Move move : legal->list) {
+                    select(move);
+                }
+            } else if (!generated) {
+                for (const auto& move : handle->game->allAvailableMoves()) {
+                    select(encode_piece_move(move, false));
+                }
+            }
+
+            if (stage == STAGE_CAPTURES) {
+                sort_captures(pos, selected);
+            }
+            *count = selected.size;
+            if (moves_size < selected.size) {
+                return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+            }
+            for (size_t i = 0; i < selected.size; ++i) {
+                moves[i] = to_c_piece_move(pos, selected.moves[i]);
+            }
+            return SIMPLECHESS_SUCCESS;
+        } catch (...) {
+            return handle_exception();
+        }
+    }
+
+}
+
+SimplechessPieceType kind_to_c_piece_type(int kind) {
+    switch (kind) {
+        case KIND_PAWN: return SIMPLECHESS_PIECE_TYPE_PAWN;
+        case KIND_KNIGHT: return SIMPLECHESS_PIECE_TYPE_KNIGHT;
+        case KIND_BISHOP: return SIMPLECHESS_PIECE_TYPE_BISHOP;
+        case KIND_ROOK: return SIMPLECHESS_PIECE_TYPE_ROOK;
+        case KIND_QUEEN: return SIMPLECHESS_PIECE_TYPE_QUEEN;
+        default: return SIMPLECHESS_PIECE_TYPE_KING;
+    }
+}
+
+SimplechessSquare index_to_c_square(int sq) {
+    SimplechessSquare square;
+    square.rank = static_cast<uint8_t>(square_rank(sq) + 1);
+    square.file = static_cast<char>('a' + square_file(sq));
+    return square;
+}
+
+int c_square_to_index(const SimplechessSquare& square) {
+    if (square.rank < 1 || square.rank > 8 || square.file < 'a' || square.file > 'h') {
+        return -1;
+    }
+    return square_index(square.rank, square.file);
+}
+
+SimplechessPieceMove to_c_piece_move(const Position& pos, Move move) {
+    uint8_t code = pos.board[move_from(move)];
+    SimplechessPieceMove result;
+    result.piece.type = kind_to_c_piece_type(piece_code_kind(code));
+    result.piece.color = piece_code_color(code) == WHITE ? SIMPLECHESS_COLOR_WHITE : SIMPLECHESS_COLOR_BLACK;
+    result.src = index_to_c_square(move_from(move));
+    result.dst = index_to_c_square(move_to(move));
+    result.is_promotion = move_promoted(move) != 0;
+    result.promoted_type = result.is_promotion ? kind_to_c_piece_type(move_promoted(move)) : SIMPLECHESS_PIECE_TYPE_PAWN;
+    return result;
+}
+
+struct MoveCache {
+    std::once_flag built;
+    std::atomic<bool> ready{false};
+    LegalMoves moves;
+};
+
+std::shared_ptr<MoveCache> new_move_cache() {
+    return std::make_shared<MoveCache>();
+}
+
+size_t move_cache_bytes() {
+    return sizeof(MoveCache);
+}
+
+const LegalMoves& legal_moves(const GameHandle& handle) {
+    MoveCache& cache = *handle.moves;
+    std::call_once(cache.built, [&] {
+        position_from_stage(handle.game->currentStage(), cache.moves.pos);
+        cache.moves.list.size = 0;
+        if (handle.game->gameState() == simplechess::GameState::Playing) {
+            generate_legal_moves(cache.moves.pos, cache.moves.list);
+        }
+        cache.ready.store(true, std::memory_order_release);
+    });
+    return cache.moves;
+}
+
+const LegalMoves* cached_legal_moves(const GameHandle& handle) {
+    if (!handle.moves || !handle.moves->ready.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return &handle.moves->moves;
+}
+
+}
+
+using namespace simplechess_c;
+
+extern "C" {
+
+SimplechessResult simplechess_game_perft(SimplechessGame game, unsigned depth, uint64_t* nodes) {
+    if (!game || !nodes) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        const auto* handle = static_cast<GameHandle*>(game);
+        if (handle->move_generator == SIMPLECHESS_MOVE_GENERATOR_DEFAULT) {
+            simplechess::GameManager manager;
+            *nodes = default_perft(manager, *handle->game, depth);
+        } else if (depth == 0) {
+            *nodes = 1;
+        } else {
+            const LegalMoves& moves = legal_moves(*handle);
+            *nodes = moves.list.size && depth > 1 ? perft(moves.pos, static_cast<int>(depth)) : moves.list.size;
+        }
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_game_for_each_move(SimplechessGame game, SimplechessMoveCallback callback, void* user_data) {
+    if (!game || !callback) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        const auto* handle = static_cast<GameHandle*>(game);
+        if (handle->move_generator == SIMPLECHESS_MOVE_GENERATOR_BITBOARD) {
+            const LegalMoves* cached;
+            if (generate_uncached(*handle, cached)) {
+                Position pos;
+                position_from_stage(handle->game->currentStage(), pos);
+                MoveVisit visit = {&pos, callback, user_data};
+                for_each_legal_move(pos, visit_c_move, &visit);
+            } else if (cached) {
+                MoveVisit visit = {&cached->pos, callback, user_data};
+                for (Move move : cached->list) {
+                    if (!visit_c_move(&visit, move)) {
+                        break;
+                    }
+                }
+            }
+            return SIMPLECHESS_SUCCESS;
+        }
+
+        for (const auto& move : handle->game->allAvailableMoves()) {
+            SimplechessPieceMove c_move = cpp_to_c_piece_move(move);
+            if (!callback(user_data, &c_move)) {
+                break;
+            }
+        }
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_game_has_legal_move(SimplechessGame game, bool* has_move) {
+    if (!game || !has_move) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        const auto* handle = static_cast<GameHandle*>(game);
+        if (handle->move_generator == SIMPLECHESS_MOVE_GENERATOR_BITBOARD) {
+            const LegalMoves* cached;
+            if (generate_uncached(*handle, cached)) {
+                Position pos;
+                position_from_stage(handle->game->currentStage(), pos);
+                *has_move = has_legal_move(pos);
+            } else {
+                *has_move = cached && cached->list.size > 0;
+            }
+            return SIMPLECHESS_SUCCESS;
+        }
+
+        *has_move = !handle->game->allAvailableMoves().empty();
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_game_get_moves_by_square(SimplechessGame game, uint16_t offsets[65], SimplechessPieceMove* moves,
+                                                       size_t moves_size, SimplechessSquareSet destinations[64]) {
+    if (!game || !offsets || !moves) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        const auto* handle = static_cast<GameHandle*>(game);
+        if (handle->move_generator == SIMPLECHESS_MOVE_GENERATOR_BITBOARD) {
+            const LegalMoves& legal = legal_moves(*handle);
+            return bucket_moves(
+                legal.list, legal.list.size, [](Move move) { return move_from(move); },
+                [&legal](Move move) { return to_c_piece_move(legal.pos, move); }, offsets, moves, moves_size, destinations);
+        }
+
+        const auto& cpp_moves = handle->game->allAvailableMoves();
+        return bucket_moves(
+            cpp_moves, cpp_moves.size(),
+            [](const simplechess::PieceMove& move) { return square_index(move.src().rank(), move.src().file()); },
+            [](const simplechess::PieceMove& move) { return cpp_to_c_piece_move(move); }, offsets, moves, moves_size,
+            destinations);
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_game_get_move_masks(SimplechessGame game, SimplechessSquareSet masks[64]) {
+    if (!game || !masks) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        const auto* handle = static_cast<GameHandle*>(game);
+        if (handle->move_generator == SIMPLECHESS_MOVE_GENERATOR_BITBOARD) {
+            const LegalMoves* cached;
+            if (generate_uncached(*handle, cached)) {
+                Position pos;
+                position_from_stage(handle->game->currentStage(), pos);
+                legal_move_masks(pos, masks);
+                return SIMPLECHESS_SUCCESS;
+            }
+            std::fill(masks, masks + 64, SimplechessSquareSet(0));
+            if (cached) {
+                for (Move move : cached->list) {
+                    masks[move_from(move)] |= square_bb(move_to(move));
+                }
+            }
+            return SIMPLECHESS_SUCCESS;
+        }
+
+        std::fill(masks, masks + 64, SimplechessSquareSet(0));
+        for (const auto& move : handle->game->allAvailableMoves()) {
+            int from = square_index(move.src().rank(), move.src().file());
+            masks[from] |= square_bb(square_index(move.dst().rank(), move.dst().file()));
+        }
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_game_get_captures(SimplechessGame game, SimplechessPieceMove* moves, size_t moves_size, size_t* count) {
+    return staged_moves(game, STAGE_CAPTURES, moves, moves_size, count);
+}
+
+SimplechessResult simplechess_game_get_quiet_checks(SimplechessGame game, SimplechessPieceMove* moves, size_t moves_size, size_t* count) {
+    return staged_moves(game, STAGE_CHECKS, moves, moves_size, count);
+}
+
+SimplechessResult simplechess_game_get_quiet_moves(SimplechessGame game, SimplechessPieceMove* moves, size_t moves_size, size_t* count) {
+    return staged_moves(game, STAGE_QUIETS, moves, moves_size, count);
+}
+
+SimplechessResult simplechess_game_get_attacked_squares(SimplechessGame game, SimplechessColor by, SimplechessSquareSet* squares) {
+    if (!game || !squares) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        Position pos;
+        position_from_stage(game_from_handle(game)->currentStage(), pos);
+        const int color = by == SIMPLECHESS_COLOR_WHITE ? WHITE : BLACK;
+        const Bitboard occupied = pos.occupied();
+        Bitboard attacked = 0;
+        Bitboard pieces = pos.by_color[color];
+        while (pieces) {
+            int sq = pop_lsb(pieces);
+            switch (piece_code_kind(pos.board[sq])) {
+                case KIND_PAWN: attacked |= pawn_attacks(color, sq); break;
+                case KIND_KNIGHT: attacked |= knight_attacks(sq); break;
+                case KIND_BISHOP: attacked |= bishop_attacks(sq, occupied); break;
+                case KIND_ROOK: attacked |= rook_attacks(sq, occupied); break;
+                case KIND_QUEEN: attacked |= bishop_attacks(sq, occupied) | rook_attacks(sq, occupied); break;
+                default: attacked |= king_attacks(sq); break;
+            }
+        }
+        *squares = attacked;
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_game_get_attackers(SimplechessGame game, const SimplechessSquare* square, SimplechessColor by,
+                                                 SimplechessSquareSet* attackers) {
+    if (!game || !square || !attackers) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+    const int sq = c_square_to_index(*square);
+    if (sq < 0) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        Position pos;
+        position_from_stage(game_from_handle(game)->currentStage(), pos);
+        const int color = by == SIMPLECHESS_COLOR_WHITE ? WHITE : BLACK;
+        *attackers = attackers_to(pos, sq, pos.occupied()) & pos.by_color[color];
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+}
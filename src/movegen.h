@@ -0,0 +1,47 @@
+/**
+ * @file movegen.h
+ * @brief Move queries answered by the wrapper's own move generator
+ *
+ * Games created through a manager with SIMPLECHESS_MOVE_GENERATOR_BITBOARD
+ * list their moves from the internal board of position.h instead of the
+ * move sets of simple-chess-games. Both give the same moves.
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_MOVEGEN_H
+#define SIMPLECHESS_MOVEGEN_H
+
+#include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include "position.h"
+
+namespace simplechess_c {
+
+SimplechessPieceType kind_to_c_piece_type(int kind);
+SimplechessSquare index_to_c_square(int sq);
+
+/* The index of a square of the C API, or -1 if it is off the board. */
+int c_square_to_index(const SimplechessSquare& square);
+
+/* The move as the C API reports it; pos is the position it is played in. */
+SimplechessPieceMove to_c_piece_move(const Position& pos, Move move);
+
+/* The current position of a game and its legal moves, which are none once
+ * the game is over. */
+struct LegalMoves {
+    Position pos;
+    MoveList list;
+};
+
+/* The legal moves of a game with the bitboard generator, computed on first
+ * use and shared by the copies of its handle. */
+const LegalMoves& legal_moves(const GameHandle& handle);
+
+/* The legal moves of a game with the bitboard generator if they have been
+ * computed, or null. */
+const LegalMoves* cached_legal_moves(const GameHandle& handle);
+
+}
+
+#endif /* SIMPLECHESS_MOVEGEN_H */
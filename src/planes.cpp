@@ -0,0 +1,188 @@
+#include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include "position.h"
+#include <simplechess/Game.h>
+#include <simplechess/GameStage.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace simplechess_c {
+
+namespace {
+    const size_t plane_size = 64;
+    const size_t position_size = SIMPLECHESS_PLANE_COUNT * plane_size;
+
+    /* For every byte, eight bytes holding its bits as 0 or 1, lowest bit
+     * first, so a bitboard expands to a u8 plane eight squares at a time. */
+    struct ByteSpread {
+        uint64_t bytes[256];
+
+        ByteSpread() {
+            for (int value = 0; value < 256; ++value) {
+                uint64_t spread = 0;
+                for (int bit = 0; bit < 8; ++bit) {
+                    spread |= static_cast<uint64_t>((value >> bit) & 1) << (8 * bit);
+                }
+                bytes[value] = spread;
+            }
+        }
+    };
+
+    const ByteSpread& byte_spread() {
+        static const ByteSpread table;
+        return table;
+    }
+
+    template <typename T>
+    void fill_bit_plane(T* out, Bitboard bits) {
+        if constexpr (std::is_same<T, uint8_t>::value) {
+            const ByteSpread& spread = byte_spread();
+            for (int rank = 0; rank < 8; ++rank) {
+                std::memcpy(out + rank * 8, &spread.bytes[(bits >> (rank * 8)) & 0xFF], 8);
+            }
+        } else {
+            for (int sq = 0; sq < 64; ++sq) {
+                out[sq] = static_cast<T>((bits >> sq) & 1);
+            }
+        }
+    }
+
+    // The u8 export saturates the halfmove clock at 255; the f32 export
+    // holds it exactly
+    template <typename T>
+    T halfmove_value(const Position& pos) {
+        if constexpr (std::is_same<T, uint8_t>::value) {
+            return static_cast<T>(std::min<int>(pos.halfmove_clock, 255));
+        } else {
+            return static_cast<T>(pos.halfmove_clock);
+        }
+    }
+
+    template <typename T>
+    void write_nchw(const Position& pos, T* out) {
+        for (int color = WHITE; color <= BLACK; ++color) {
+            for (int kind = KIND_PAWN; kind < KIND_COUNT; ++kind) {
+                fill_bit_plane(out + (SIMPLECHESS_PLANE_PIECES + color * KIND_COUNT + kind) * plane_size,
+                               pos.pieces(color, kind));
+            }
+        }
+        std::fill_n(out + SIMPLECHESS_PLANE_WHITE_TO_MOVE * plane_size, plane_size, static_cast<T>(pos.side == WHITE));
+        for (int right = 0; right < 4; ++right) {
+            std::fill_n(out + (SIMPLECHESS_PLANE_CASTLING + right) * plane_size, plane_size,
+                        static_cast<T>((pos.castling >> right) & 1));
+        }
+        fill_bit_plane(out + SIMPLECHESS_PLANE_EN_PASSANT * plane_size,
+                       pos.en_passant >= 0 ? square_bb(pos.en_passant) : 0);
+        std::fill_n(out + SIMPLECHESS_PLANE_HALFMOVE_CLOCK * plane_size, plane_size,
+                    halfmove_value<T>(pos));
+    }
+
+    template <typename T>
+    void write_nhwc(const Position& pos, T* out) {
+        // Every square has the same scalar channels; write them once and
+        // copy the row of channels across the board
+        T channels[SIMPLECHESS_PLANE_COUNT] = {};
+        channels[SIMPLECHESS_PLANE_WHITE_TO_MOVE] = static_cast<T>(pos.side == WHITE);
+        for (int right = 0; right < 4; ++right) {
+            channels[SIMPLECHESS_PLANE_CASTLING + right] = static_cast<T>((pos.castling >> right) & 1);
+        }
+        channels[SIMPLECHESS_PLANE_HALFMOVE_CLOCK] = halfmove_value<T>(pos);
+        for (int sq = 0; sq < 64; ++sq) {
+            std::memcpy(out + sq * SIMPLECHESS_PLANE_COUNT, channels, sizeof(channels));
+        }
+
+        Bitboard occupied = pos.occupied();
+        while (occupied) {
+            int sq = pop_lsb(occupied);
+            uint8_t code = pos.board[sq];
+            int plane = SIMPLECHESS_PLANE_PIECES + piece_code_color(code) * KIND_COUNT + piece_code_kind(code);
+            out[sq * SIMPLECHESS_PLANE_COUNT + plane] = 1;
+        }
+        if (pos.en_passant >= 0) {
+            out[pos.en_passant * SIMPLECHESS_PLANE_COUNT + SIMPLECHESS_PLANE_EN_PASSANT] = 1;
+        }
+    }
+
+    template <typename T>
+    SimplechessResult export_planes(const SimplechessGame* games, size_t count, SimplechessTensorLayout layout, T* out,
+                                    size_t out_size, size_t threads) {
+        if ((!games || !out) && count > 0) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        if (layout != SIMPLECHESS_LAYOUT_NCHW && layout != SIMPLECHESS_LAYOUT_NHWC) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        if (out_size / position_size < count) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!games[i]) {
+                return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+            }
+        }
+
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = std::min(threads, std::max<size_t>(count, 1));
+
+        std::atomic<int> error(SIMPLECHESS_SUCCESS);
+        auto export_range = [games, count, layout, out, threads, &error](size_t part) {
+            try {
+                size_t first = count * part / threads;
+                size_t last = count * (part + 1) / threads;
+                Position pos;
+                for (size_t i = first; i < last && error.load() == SIMPLECHESS_SUCCESS; ++i) {
+                    position_from_stage(game_from_handle(games[i])->currentStage(), pos);
+                    if (layout == SIMPLECHESS_LAYOUT_NCHW) {
+                        write_nchw(pos, out + i * position_size);
+                    } else {
+                        write_nhwc(pos, out + i * position_size);
+                    }
+                }
+            } catch (...) {
+                error.store(handle_exception());
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < threads; ++t) {
+            workers.emplace_back(export_range, t);
+        }
+        export_range(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        return static_cast<SimplechessResult>(error.load());
+    }
+}
+
+}
+
+using namespace simplechess_c;
+
+extern "C" {
+
+SimplechessResult simplechess_export_planes_u8(const SimplechessGame* games, size_t count, SimplechessTensorLayout layout,
+                                               uint8_t* out, size_t out_size, size_t threads) {
+    try {
+        return export_planes(games, count, layout, out, out_size, threads);
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_export_planes_f32(const SimplechessGame* games, size_t count, SimplechessTensorLayout layout,
+                                                float* out, size_t out_size, size_t threads) {
+    try {
+        return export_planes(games, count, layout, out, out_size, threads);
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+}
@@ -0,0 +1,509 @@
+#include "position.h"
+#include "simplechess/simplechess.h"
+#include <simplechess/GameStage.h>
+#include <simplechess/Board.h>
+#include <simplechess/Square.h>
+#include <simplechess/Piece.h>
+#include <simplechess/Color.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace simplechess_c {
+
+namespace {
+    struct AttackTables {
+        Bitboard pawn[2][64];
+        Bitboard knight[64];
+        Bitboard king[64];
+
+        AttackTables() {
+            static const int knight_steps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+            for (int sq = 0; sq < 64; ++sq) {
+                int rank = square_rank(sq);
+                int file = square_file(sq);
+                knight[sq] = 0;
+                king[sq] = 0;
+                pawn[WHITE][sq] = 0;
+                pawn[BLACK][sq] = 0;
+                for (const auto& step : knight_steps) {
+                    add(knight[sq], rank + step[0], file + step[1]);
+                }
+                for (int dr = -1; dr <= 1; ++dr) {
+                    for (int df = -1; df <= 1; ++df) {
+                        if (dr || df) {
+                            add(king[sq], rank + dr, file + df);
+                        }
+                    }
+                }
+                add(pawn[WHITE][sq], rank + 1, file - 1);
+                add(pawn[WHITE][sq], rank + 1, file + 1);
+                add(pawn[BLACK][sq], rank - 1, file - 1);
+                add(pawn[BLACK][sq], rank - 1, file + 1);
+            }
+        }
+
+        static void add(Bitboard& b, int rank, int file) {
+            if (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+                b |= square_bb(rank * 8 + file);
+            }
+        }
+    };
+
+    const AttackTables& tables() {
+        static const AttackTables instance;
+        return instance;
+    }
+
+    int cpp_to_kind(simplechess::PieceType type) {
+        switch (type) {
+            case simplechess::PieceType::Pawn: return KIND_PAWN;
+            case simplechess::PieceType::Knight: return KIND_KNIGHT;
+            case simplechess::PieceType::Bishop: return KIND_BISHOP;
+            case simplechess::PieceType::Rook: return KIND_ROOK;
+            case simplechess::PieceType::Queen: return KIND_QUEEN;
+            case simplechess::PieceType::King: return KIND_KING;
+        }
+        return KIND_PAWN;
+    }
+
+    void put_piece(Position& pos, int sq, int color, int kind) {
+        pos.board[sq] = make_piece_code(color, kind);
+        pos.by_color[color] |= square_bb(sq);
+        pos.by_kind[kind] |= square_bb(sq);
+    }
+
+    void remove_piece(Position& pos, int sq) {
+        uint8_t code = pos.board[sq];
+        pos.board[sq] = 0;
+        pos.by_color[piece_code_color(code)] &= ~square_bb(sq);
+        pos.by_kind[piece_code_kind(code)] &= ~square_bb(sq);
+    }
+
+    // Castling rights lost when a piece moves from or to each corner and king square
+    uint8_t castling_mask(int sq) {
+        switch (sq) {
+            case 0: return 2;
+            case 4: return 3;
+            case 7: return 1;
+            case 56: return 8;
+            case 60: return 12;
+            case 63: return 4;
+            default: return 0;
+        }
+    }
+
+    template <typename Visit>
+    bool visit_pawn_moves(Visit& visit, int from, int to) {
+        if (square_rank(to) == 0 || square_rank(to) == 7) {
+            return visit(make_move(from, to, KIND_QUEEN)) && visit(make_move(from, to, KIND_ROOK))
+                && visit(make_move(from, to, KIND_BISHOP)) && visit(make_move(from, to, KIND_KNIGHT));
+        }
+        return visit(make_move(from, to));
+    }
+
+    /* Squares strictly between two aligned squares, and the whole line
+     * through them; both empty for squares that are not aligned. */
+    struct LineTables {
+        Bitboard between[64][64];
+        Bitboard line[64][64];
+
+        LineTables() {
+            for (int a = 0; a < 64; ++a) {
+                for (int b = 0; b < 64; ++b) {
+                    between[a][b] = 0;
+                    line[a][b] = 0;
+                    if (a == b) {
+                        continue;
+                    }
+                    if (rook_attacks(a, 0) & square_bb(b)) {
+                        between[a][b] = rook_attacks(a, square_bb(b)) & rook_attacks(b, square_bb(a));
+                        line[a][b] = (rook_attacks(a, 0) & rook_attacks(b, 0)) | square_bb(a) | square_bb(b);
+                    } else if (bishop_attacks(a, 0) & square_bb(b)) {
+                        between[a][b] = bishop_attacks(a, square_bb(b)) & bishop_attacks(b, square_bb(a));
+                        line[a][b] = (bishop_attacks(a, 0) & bishop_attacks(b, 0)) | square_bb(a) | square_bb(b);
+                    }
+                }
+            }
+        }
+    };
+
+    const LineTables& lines() {
+        static const LineTables instance;
+        return instance;
+    }
+
+    /* Pieces of either color that stand alone between king and a slider of
+     * color attacker. */
+    Bitboard slider_blockers(const Position& pos, int attacker, int king) {
+        const Bitboard occupied = pos.occupied();
+        Bitboard snipers = (rook_attacks(king, 0) & (pos.pieces(attacker, KIND_ROOK) | pos.pieces(attacker, KIND_QUEEN)))
+                         | (bishop_attacks(king, 0) & (pos.pieces(attacker, KIND_BISHOP) | pos.pieces(attacker, KIND_QUEEN)));
+        Bitboard result = 0;
+        while (snipers) {
+            Bitboard blockers = lines().between[king][pop_lsb(snipers)] & occupied;
+            if (blockers && !(blockers & (blockers - 1))) {
+                result |= blockers;
+            }
+        }
+        return result;
+    }
+
+    /* Pieces of color that stand alone between the king of color and an
+     * enemy slider, and so may only move along that line. */
+    Bitboard pinned_pieces(const Position& pos, int color, int king) {
+        return slider_blockers(pos, color ^ 1, king) & pos.by_color[color];
+    }
+
+    /* An en passant capture removes two pawns from the rank of the king's
+     * possible attacker, so its legality is checked on the resulting board. */
+    bool en_passant_is_legal(const Position& pos, int from, int king, Bitboard checkers) {
+        const int us = pos.side;
+        const int them = us ^ 1;
+        const int captured = pos.en_passant + (us == WHITE ? -8 : 8);
+        const Bitboard occupied = (pos.occupied() ^ square_bb(from) ^ square_bb(captured)) | square_bb(pos.en_passant);
+        const Bitboard straight = pos.pieces(them, KIND_ROOK) | pos.pieces(them, KIND_QUEEN);
+        const Bitboard diagonal = pos.pieces(them, KIND_BISHOP) | pos.pieces(them, KIND_QUEEN);
+        if (checkers & ~(square_bb(captured) | straight | diagonal)) {
+            return false;
+        }
+        return !(rook_attacks(king, occupied) & straight) && !(bishop_attacks(king, occupied) & diagonal);
+    }
+}
+
+void position_from_stage(const simplechess::GameStage& stage, Position& pos) {
+    std::memset(&pos, 0, sizeof(pos));
+    for (const auto& entry : stage.board().occupiedSquares()) {
+        int sq = square_index(entry.first.rank(), entry.first.file());
+        int color = entry.second.color() == simplechess::Color::White ? WHITE : BLACK;
+        put_piece(pos, sq, color, cpp_to_kind(entry.second.type()));
+    }
+    pos.side = stage.activeColor() == simplechess::Color::White ? WHITE : BLACK;
+    pos.castling = stage.castlingRights();
+    pos.halfmove_clock = stage.halfMovesSinceLastCaptureOrPawnAdvance();
+    pos.fullmove_counter = stage.fullMoveCounter();
+
+    // The en passant target is the fourth FEN field
+    pos.en_passant = -1;
+    const std::string& fen = stage.fen();
+    size_t field = 0;
+    for (int skip = 0; skip < 3 && field != std::string::npos; ++skip) {
+        field = fen.find(' ', field);
+        if (field != std::string::npos) {
+            ++field;
+        }
+    }
+    if (field != std::string::npos && field + 1 < fen.size() && fen[field] >= 'a' && fen[field] <= 'h'
+        && fen[field + 1] >= '1' && fen[field + 1] <= '8') {
+        pos.en_passant = static_cast<int8_t>(square_index(fen[field + 1] - '0', fen[field]));
+    }
+}
+
+Bitboard pawn_attacks(int color, int sq) {
+    return tables().pawn[color][sq];
+}
+
+Bitboard knight_attacks(int sq) {
+    return tables().knight[sq];
+}
+
+Bitboard king_attacks(int sq) {
+    return tables().king[sq];
+}
+
+Bitboard attackers_to(const Position& pos, int sq, Bitboard occupied) {
+    Bitboard diagonal = pos.by_kind[KIND_BISHOP] | pos.by_kind[KIND_QUEEN];
+    Bitboard straight = pos.by_kind[KIND_ROOK] | pos.by_kind[KIND_QUEEN];
+    return (pawn_attacks(BLACK, sq) & pos.pieces(WHITE, KIND_PAWN))
+         | (pawn_attacks(WHITE, sq) & pos.pieces(BLACK, KIND_PAWN))
+         | (knight_attacks(sq) & pos.by_kind[KIND_KNIGHT])
+         | (king_attacks(sq) & pos.by_kind[KIND_KING])
+         | (bishop_attacks(sq, occupied) & diagonal)
+         | (rook_attacks(sq, occupied) & straight);
+}
+
+bool is_square_attacked(const Position& pos, int sq, int by_color) {
+    return (attackers_to(pos, sq, pos.occupied()) & pos.by_color[by_color]) != 0;
+}
+
+Bitboard checkers(const Position& pos) {
+    return attackers_to(pos, pos.king_square(pos.side), pos.occupied()) & pos.by_color[pos.side ^ 1];
+}
+
+void init_check_info(const Position& pos, CheckInfo& info) {
+    const int us = pos.side;
+    const Bitboard occupied = pos.occupied();
+    info.king = pos.king_square(us ^ 1);
+    info.squares[KIND_PAWN] = pawn_attacks(us ^ 1, info.king);
+    info.squares[KIND_KNIGHT] = knight_attacks(info.king);
+    info.squares[KIND_BISHOP] = bishop_attacks(info.king, occupied);
+    info.squares[KIND_ROOK] = rook_attacks(info.king, occupied);
+    info.squares[KIND_QUEEN] = info.squares[KIND_BISHOP] | info.squares[KIND_ROOK];
+    info.squares[KIND_KING] = 0;
+    info.discoverers = slider_blockers(pos, us, info.king) & pos.by_color[us];
+}
+
+bool gives_check(const Position& pos, const CheckInfo& info, Move move) {
+    const int us = pos.side;
+    const int from = move_from(move);
+    const int to = move_to(move);
+    const int kind = moved_kind(pos, move);
+    const Bitboard king = square_bb(info.king);
+
+    // A promoted slider may check through the square its pawn left
+    if (move_promoted(move)) {
+        const Bitboard occupied = pos.occupied() ^ square_bb(from);
+        Bitboard attacks;
+        switch (move_promoted(move)) {
+            case KIND_KNIGHT: attacks = knight_attacks(to); break;
+            case KIND_BISHOP: attacks = bishop_attacks(to, occupied); break;
+            case KIND_ROOK: attacks = rook_attacks(to, occupied); break;
+            default: attacks = bishop_attacks(to, occupied) | rook_attacks(to, occupied); break;
+        }
+        if (attacks & king) {
+            return true;
+        }
+    } else if (info.squares[kind] & square_bb(to)) {
+        return true;
+    }
+
+    if ((info.discoverers & square_bb(from)) && !(lines().line[from][info.king] & square_bb(to))) {
+        return true;
+    }
+
+    // Castling moves the rook and en passant removes a second pawn, so
+    // look for a slider check on the resulting board
+    const bool castling = kind == KIND_KING && (to - from == 2 || from - to == 2);
+    const bool en_passant = kind == KIND_PAWN && to == pos.en_passant;
+    if (!castling && !en_passant) {
+        return false;
+    }
+    Bitboard occupied = (pos.occupied() ^ square_bb(from)) | square_bb(to);
+    Bitboard straight = pos.pieces(us, KIND_ROOK) | pos.pieces(us, KIND_QUEEN);
+    const Bitboard diagonal = pos.pieces(us, KIND_BISHOP) | pos.pieces(us, KIND_QUEEN);
+    if (castling) {
+        const int rook_from = to > from ? from + 3 : from - 4;
+        const int rook_to = to > from ? from + 1 : from - 1;
+        occupied = (occupied ^ square_bb(rook_from)) | square_bb(rook_to);
+        straight ^= square_bb(rook_from) | square_bb(rook_to);
+    } else {
+        occupied ^= square_bb(to + (us == WHITE ? -8 : 8));
+    }
+    return (rook_attacks(info.king, occupied) & straight) || (bishop_attacks(info.king, occupied) & diagonal);
+}
+
+bool is_capture(const Position& pos, Move move) {
+    return pos.board[move_to(move)] != 0
+        || (move_to(move) == pos.en_passant && piece_code_kind(pos.board[move_from(move)]) == KIND_PAWN);
+}
+
+int moved_kind(const Position& pos, Move move) {
+    return piece_code_kind(pos.board[move_from(move)]);
+}
+
+void do_move(Position& pos, Move move) {
+    const int from = move_from(move);
+    const int to = move_to(move);
+    const int us = pos.side;
+    const int kind = moved_kind(pos, move);
+    bool capture = pos.board[to] != 0;
+
+    if (capture) {
+        remove_piece(pos, to);
+    }
+    remove_piece(pos, from);
+    if (kind == KIND_PAWN && to == pos.en_passant) {
+        remove_piece(pos, to + (us == WHITE ? -8 : 8));
+        capture = true;
+    }
+    put_piece(pos, to, us, move_promoted(move) ? move_promoted(move) : kind);
+
+    if (kind == KIND_KING && (to - from == 2 || from - to == 2)) {
+        int rook_from = to > from ? from + 3 : from - 4;
+        int rook_to = to > from ? from + 1 : from - 1;
+        remove_piece(pos, rook_from);
+        put_piece(pos, rook_to, us, KIND_ROOK);
+    }
+
+    pos.castling &= static_cast<uint8_t>(~(castling_mask(from) | castling_mask(to)));
+    pos.en_passant = -1;
+    if (kind == KIND_PAWN && (to - from == 16 || from - to == 16)) {
+        pos.en_passant = static_cast<int8_t>((from + to) / 2);
+    }
+    pos.halfmove_clock = (kind == KIND_PAWN || capture) ? 0 : pos.halfmove_clock + 1;
+    if (us == BLACK) {
+        ++pos.fullmove_counter;
+    }
+    pos.side = static_cast<uint8_t>(us ^ 1);
+}
+
+namespace {
+    /* Calls visit(move) for each legal move to a square of targets until it
+     * returns false; returns false if it did. Shared by the generator and
+     * its early-exit and capture-only forms. */
+    template <typename Visit>
+    bool visit_legal_moves(const Position& pos, Visit&& visit, Bitboard targets = ~Bitboard(0)) {
+        const int us = pos.side;
+        const int them = us ^ 1;
+        const int king = pos.king_square(us);
+        const Bitboard own = pos.by_color[us];
+        const Bitboard enemies = pos.by_color[them];
+        const Bitboard occupied = pos.occupied();
+        const Bitboard check = attackers_to(pos, king, occupied) & enemies;
+
+        // The king may not stay on a line its own body shields from a slider
+        Bitboard king_targets = king_attacks(king) & ~own & targets;
+        while (king_targets) {
+            int to = pop_lsb(king_targets);
+            if (!(attackers_to(pos, to, occupied ^ square_bb(king)) & enemies)) {
+                if (!visit(make_move(king, to))) {
+                    return false;
+                }
+            }
+        }
+        if (check & (check - 1)) {
+            return true;
+        }
+
+        // Other pieces must capture the checker or block its line
+        const Bitboard allowed = (check ? lines().between[king][lsb(check)] | check : ~Bitboard(0)) & targets;
+        const Bitboard pinned = pinned_pieces(pos, us, king);
+        auto legal_targets = [&](int from, Bitboard to) {
+            to &= allowed;
+            if (pinned & square_bb(from)) {
+                to &= lines().line[king][from];
+            }
+            return to;
+        };
+
+        Bitboard pawns = pos.pieces(us, KIND_PAWN);
+        const int forward = us == WHITE ? 8 : -8;
+        const int start_rank = us == WHITE ? 1 : 6;
+        while (pawns) {
+            int from = pop_lsb(pawns);
+            Bitboard to = 0;
+            int one = from + forward;
+            if (!(occupied & square_bb(one))) {
+                to |= square_bb(one);
+                int two = one + forward;
+                if (square_rank(from) == start_rank && !(occupied & square_bb(two))) {
+                    to |= square_bb(two);
+                }
+            }
+            to |= pawn_attacks(us, from) & enemies;
+            to = legal_targets(from, to);
+            while (to) {
+                if (!visit_pawn_moves(visit, from, pop_lsb(to))) {
+                    return false;
+                }
+            }
+            if (pos.en_passant >= 0 && (pawn_attacks(us, from) & targets & square_bb(pos.en_passant))
+                && en_passant_is_legal(pos, from, king, check) && !visit(make_move(from, pos.en_passant))) {
+                return false;
+            }
+        }
+
+        for (int kind = KIND_KNIGHT; kind < KIND_KING; ++kind) {
+            Bitboard pieces = pos.pieces(us, kind);
+            while (pieces) {
+                int from = pop_lsb(pieces);
+                Bitboard to;
+                switch (kind) {
+                    case KIND_KNIGHT: to = knight_attacks(from); break;
+                    case KIND_BISHOP: to = bishop_attacks(from, occupied); break;
+                    case KIND_ROOK: to = rook_attacks(from, occupied); break;
+                    default: to = bishop_attacks(from, occupied) | rook_attacks(from, occupied); break;
+                }
+                to = legal_targets(from, to & ~own);
+                while (to) {
+                    if (!visit(make_move(from, pop_lsb(to)))) {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        // Castling: the king may not start on, cross or land on an attacked square
+        const int base = us == WHITE ? 0 : 56;
+        const uint8_t kingside = us == WHITE ? SIMPLECHESS_CASTLING_WHITE_KINGSIDE : SIMPLECHESS_CASTLING_BLACK_KINGSIDE;
+        const uint8_t queenside = us == WHITE ? SIMPLECHESS_CASTLING_WHITE_QUEENSIDE : SIMPLECHESS_CASTLING_BLACK_QUEENSIDE;
+        if (!check && (pos.castling & (kingside | queenside)) && king == base + 4) {
+            if ((pos.castling & kingside) && (targets & square_bb(base + 6))
+                && pos.board[base + 7] == make_piece_code(us, KIND_ROOK)
+                && !(occupied & (square_bb(base + 5) | square_bb(base + 6)))
+                && !is_square_attacked(pos, base + 5, them) && !is_square_attacked(pos, base + 6, them)
+                && !visit(make_move(base + 4, base + 6))) {
+                return false;
+            }
+            if ((pos.castling & queenside) && (targets & square_bb(base + 2))
+                && pos.board[base] == make_piece_code(us, KIND_ROOK)
+                && !(occupied & (square_bb(base + 1) | square_bb(base + 2) | square_bb(base + 3)))
+                && !is_square_attacked(pos, base + 3, them) && !is_square_attacked(pos, base + 2, them)
+                && !visit(make_move(base + 4, base + 2))) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+void generate_legal_moves(const Position& pos, MoveList& list) {
+    list.size = 0;
+    visit_legal_moves(pos, [&list](Move move) {
+        list.push(move);
+        return true;
+    });
+}
+
+void generate_captures(const Position& pos, MoveList& list) {
+    // Pawns promote on the last rank whether they capture or not, so it is
+    // a target too, and other pieces' quiet moves there are dropped
+    const int us = pos.side;
+    Bitboard targets = pos.by_color[us ^ 1] | (us == WHITE ? Bitboard(0xFF) << 56 : Bitboard(0xFF));
+    if (pos.en_passant >= 0) {
+        targets |= square_bb(pos.en_passant);
+    }
+    list.size = 0;
+    visit_legal_moves(pos, [&pos, &list](Move move) {
+        if (move_promoted(move) || is_capture(pos, move)) {
+            list.push(move);
+        }
+        return true;
+    }, targets);
+}
+
+bool for_each_legal_move(const Position& pos, bool (*visit)(void* context, Move move), void* context) {
+    return visit_legal_moves(pos, [visit, context](Move move) { return visit(context, move); });
+}
+
+void legal_move_masks(const Position& pos, Bitboard masks[64]) {
+    std::fill(masks, masks + 64, Bitboard(0));
+    visit_legal_moves(pos, [masks](Move move) {
+        masks[move_from(move)] |= square_bb(move_to(move));
+        return true;
+    });
+}
+
+bool has_legal_move(const Position& pos) {
+    return !visit_legal_moves(pos, [](Move) { return false; });
+}
+
+uint64_t perft(const Position& pos, int depth) {
+    if (depth <= 0) {
+        return 1;
+    }
+    MoveList list;
+    generate_legal_moves(pos, list);
+    if (depth == 1) {
+        return list.size;
+    }
+    uint64_t nodes = 0;
+    for (Move move : list) {
+        Position next = pos;
+        do_move(next, move);
+        nodes += perft(next, depth - 1);
+    }
+    return nodes;
+}
+
+}
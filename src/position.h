@@ -0,0 +1,164 @@
+/**
+ * @file position.h
+ * @brief Internal bitboard representation of a chess position
+ *
+ * Used where the wrapper needs to reason about a position itself rather than
+ * going through the simple-chess-games objects: the bitboard move generator
+ * and the move queries built on it (allocation-free, grouped by square,
+ * staged), position hashing, update messages, flag-fall adjudication, JSON
+ * export, feature planes and tablebase probing. Squares are indexed as
+ * (rank - 1) * 8 + (file - 'a'), so a1 is 0 and h8 is 63.
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_POSITION_H
+#define SIMPLECHESS_POSITION_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace simplechess {
+    class GameStage;
+}
+
+namespace simplechess_c {
+
+typedef uint64_t Bitboard;
+
+enum PieceKind {
+    KIND_PAWN = 0,
+    KIND_KNIGHT = 1,
+    KIND_BISHOP = 2,
+    KIND_ROOK = 3,
+    KIND_QUEEN = 4,
+    KIND_KING = 5,
+    KIND_COUNT = 6
+};
+
+enum {
+    WHITE = 0,
+    BLACK = 1
+};
+
+/* Piece codes stored in Position::board. They match the piece encoding used
+ * by Syzygy tablebase files: 1-6 for white pawn..king, 9-14 for black, and 0
+ * for an empty square. */
+inline uint8_t make_piece_code(int color, int kind) { return static_cast<uint8_t>((color << 3) | (kind + 1)); }
+inline int piece_code_color(uint8_t code) { return code >> 3; }
+inline int piece_code_kind(uint8_t code) { return (code & 7) - 1; }
+
+inline int square_rank(int sq) { return sq >> 3; }
+inline int square_file(int sq) { return sq & 7; }
+inline Bitboard square_bb(int sq) { return Bitboard(1) << sq; }
+
+/* The index of a square given as the simple-chess-games objects and the C API
+ * spell it: rank 1-8 and file 'a'-'h'. */
+inline int square_index(int rank, char file) { return (rank - 1) * 8 + (file - 'a'); }
+
+inline int popcount(Bitboard b) { return __builtin_popcountll(b); }
+inline int lsb(Bitboard b) { return __builtin_ctzll(b); }
+inline int pop_lsb(Bitboard& b) {
+    int sq = lsb(b);
+    b &= b - 1;
+    return sq;
+}
+
+/* A move packed as from | to << 6 | promoted kind << 12, where the promoted
+ * kind is 0 for non-promotions. Castling is encoded as the king's two-square
+ * move and en passant as the pawn's diagonal move to the target square. */
+typedef uint16_t Move;
+
+inline Move make_move(int from, int to, int promoted = 0) { return static_cast<Move>(from | (to << 6) | (promoted << 12)); }
+inline int move_from(Move m) { return m & 63; }
+inline int move_to(Move m) { return (m >> 6) & 63; }
+inline int move_promoted(Move m) { return (m >> 12) & 7; }
+
+struct Position {
+    Bitboard by_kind[KIND_COUNT];
+    Bitboard by_color[2];
+    uint8_t board[64];
+    uint8_t side;
+    uint8_t castling;
+    int8_t en_passant;
+    uint16_t halfmove_clock;
+    uint16_t fullmove_counter;
+
+    Bitboard pieces(int color, int kind) const { return by_color[color] & by_kind[kind]; }
+    Bitboard occupied() const { return by_color[WHITE] | by_color[BLACK]; }
+    int king_square(int color) const { return lsb(pieces(color, KIND_KING)); }
+};
+
+struct MoveList {
+    Move moves[256];
+    size_t size = 0;
+
+    void push(Move m) { moves[size++] = m; }
+    const Move* begin() const { return moves; }
+    const Move* end() const { return moves + size; }
+};
+
+/* Builds the position shown by a game stage. The en passant square is taken
+ * from the stage's FEN. */
+void position_from_stage(const simplechess::GameStage& stage, Position& pos);
+
+Bitboard pawn_attacks(int color, int sq);
+Bitboard knight_attacks(int sq);
+Bitboard king_attacks(int sq);
+/* Slider attacks come from tables indexed by PEXT on CPUs where it is fast,
+ * by magic multiplication elsewhere (attacks.cpp). */
+Bitboard bishop_attacks(int sq, Bitboard occupied);
+Bitboard rook_attacks(int sq, Bitboard occupied);
+bool slider_attacks_use_pext();
+
+/* Pieces of either color attacking sq given the occupancy. */
+Bitboard attackers_to(const Position& pos, int sq, Bitboard occupied);
+bool is_square_attacked(const Position& pos, int sq, int by_color);
+Bitboard checkers(const Position& pos);
+
+bool is_capture(const Position& pos, Move move);
+int moved_kind(const Position& pos, Move move);
+
+/* What the side to move needs to tell its checking moves without playing
+ * them: the squares each kind of piece checks the enemy king from, and the
+ * own pieces that uncover a slider's check by leaving its line. */
+struct CheckInfo {
+    Bitboard squares[KIND_COUNT];
+    Bitboard discoverers;
+    int king;
+};
+
+void init_check_info(const Position& pos, CheckInfo& info);
+
+/* Whether a legal move gives check. */
+bool gives_check(const Position& pos, const CheckInfo& info, Move move);
+
+/* Applies a legal move, updating castling rights, the en passant square and
+ * the move counters. */
+void do_move(Position& pos, Move move);
+
+/* Fully legal moves, generated from the check and pin masks of the side to
+ * move rather than by trying each pseudo-legal move. */
+void generate_legal_moves(const Position& pos, MoveList& list);
+
+/* The legal captures and promotions, in generation order. Only moves to
+ * enemy pieces, the en passant square and the last rank are generated. */
+void generate_captures(const Position& pos, MoveList& list);
+
+/* Calls visit for each legal move, in the order generate_legal_moves() lists
+ * them, until it returns false. Returns false if it was stopped. */
+bool for_each_legal_move(const Position& pos, bool (*visit)(void* context, Move move), void* context);
+
+/* The destination squares of the legal moves from each square, without
+ * building a move list. */
+void legal_move_masks(const Position& pos, Bitboard masks[64]);
+
+/* Whether the side to move has a legal move; stops at the first one. */
+bool has_legal_move(const Position& pos);
+
+/* Number of leaves of the legal move tree of the given depth. */
+uint64_t perft(const Position& pos, int depth);
+
+}
+
+#endif /* SIMPLECHESS_POSITION_H */
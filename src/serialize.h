@@ -0,0 +1,55 @@
+/**
+ * @file serialize.h
+ * @brief Little-endian integer encoding used by the files written by the library
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_SERIALIZE_H
+#define SIMPLECHESS_SERIALIZE_H
+
+#include <cstdint>
+#include <vector>
+
+namespace simplechess_c {
+
+inline void put_u16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+inline void put_u32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+inline void put_u64(std::vector<uint8_t>& out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+inline uint16_t get_u16(const uint8_t* in) {
+    return static_cast<uint16_t>(in[0] | (in[1] << 8));
+}
+
+inline uint32_t get_u32(const uint8_t* in) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; --i) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+inline uint64_t get_u64(const uint8_t* in) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+}
+
+#endif /* SIMPLECHESS_SERIALIZE_H */
@@ -0,0 +1,444 @@
+#include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include "session_store.h"
+#include "intern.h"
+#include "memory_usage.h"
+#include "move_log.h"
+#include "snapshot.h"
+#include "history.h"
+#include "clock.h"
+#include "serialize.h"
+#include <simplechess/GameManager.h>
+#include <simplechess/Game.h>
+#include <simplechess/GameStage.h>
+#include <simplechess/PlayedMove.h>
+#include <mutex>
+#include <string>
+
+namespace simplechess_c {
+
+namespace {
+    const size_t default_shard_count = 64;
+
+    // Ids are often sequential; mix the bits so they spread over all shards
+    uint64_t mix_id(uint64_t id) {
+        id ^= id >> 30;
+        id *= 0xbf58476d1ce4e5b9ULL;
+        id ^= id >> 27;
+        id *= 0x94d049bb133111ebULL;
+        id ^= id >> 31;
+        return id;
+    }
+
+    // The log record describing how before became after, if it changed
+    bool describe_update(const GameHandle& before, const GameHandle& after, LogRecordKind& kind, std::vector<uint8_t>& payload) {
+        if (history_length(after) > history_length(before)) {
+            kind = LOG_MOVE;
+            put_u16(payload, encode_played_move(after.game->currentStage().move().value()));
+            return true;
+        }
+        switch (after.game->gameState()) {
+            case simplechess::GameState::Drawn:
+                kind = LOG_CLAIM_DRAW;
+                return before.game->gameState() != simplechess::GameState::Drawn;
+            case simplechess::GameState::WhiteWon:
+            case simplechess::GameState::BlackWon:
+                kind = LOG_RESIGN;
+                payload.push_back(after.game->gameState() == simplechess::GameState::WhiteWon ? 1 : 0);
+                return before.game->gameState() == simplechess::GameState::Playing;
+            default:
+                return false;
+        }
+    }
+}
+
+SessionStore::SessionStore(ManagerHandle& manager, size_t shard_count)
+    : mOwner(manager), mManager(manager.manager), mMoveGenerator(manager.move_generator), mCheckpointInterval(manager.checkpoint_interval),
+      mInterner(manager.interner) {
+    size_t shards = 1;
+    while (shards < shard_count) {
+        shards <<= 1;
+    }
+    mShards.reset(new Shard[shards]);
+    mShardMask = shards - 1;
+}
+
+SessionStore::Shard& SessionStore::shard_for(uint64_t id) const {
+    return mShards[mix_id(id) & mShardMask];
+}
+
+void SessionStore::set_log(MoveLog* log) {
+    // As in collect(), no change can come between the game records and
+    // the log taking over while every shard is locked
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    locks.reserve(mShardMask + 1);
+    for (size_t i = 0; i <= mShardMask; ++i) {
+        locks.emplace_back(mShards[i].mutex);
+    }
+
+    if (log) {
+        std::vector<uint8_t> payload;
+        for (size_t i = 0; i <= mShardMask; ++i) {
+            for (const auto& entry : mShards[i].games) {
+                payload.clear();
+                encode_game_record(entry.first, entry.second.game, payload);
+                log->append(entry.first, LOG_GAME, payload.data(), payload.size());
+            }
+        }
+    }
+    mLog.store(log);
+}
+
+bool SessionStore::insert(uint64_t id, GameHandle game) {
+    std::vector<uint8_t> payload;
+    if (log()) {
+        encode_game_record(id, game, payload);
+    }
+    return insert_logged(id, std::move(game), LOG_GAME, payload, false);
+}
+
+void SessionStore::assign(uint64_t id, GameHandle game) {
+    std::vector<uint8_t> payload;
+    if (log()) {
+        encode_game_record(id, game, payload);
+    }
+    insert_logged(id, std::move(game), LOG_GAME, payload, true);
+}
+
+bool SessionStore::create(uint64_t id, const std::string& fen) {
+    GameHandle game = fen.empty() ? new_game(mOwner) : game_from_fen(mOwner, fen);
+    return insert_logged(id, std::move(game), LOG_CREATE, std::vector<uint8_t>(fen.begin(), fen.end()), false);
+}
+
+bool SessionStore::insert_logged(uint64_t id, GameHandle game, uint8_t kind, const std::vector<uint8_t>& payload,
+                                 bool replace) {
+    game.set_move_generator(mMoveGenerator);
+    game.checkpoint_interval = mCheckpointInterval;
+    Shard& shard = shard_for(id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    Entry entry{std::move(game), shard.next_version++};
+    if (replace) {
+        shard.games.insert_or_assign(id, std::move(entry));
+    } else if (!shard.games.emplace(id, std::move(entry)).second) {
+        return false;
+    }
+    if (MoveLog* log = mLog.load()) {
+        log->append(id, static_cast<LogRecordKind>(kind), payload.data(), payload.size());
+    }
+    return true;
+}
+
+bool SessionStore::lookup(uint64_t id, GameHandle& game) const {
+    uint64_t version;
+    return lookup(id, game, version);
+}
+
+bool SessionStore::lookup(uint64_t id, GameHandle& game, uint64_t& version) const {
+    Shard& shard = shard_for(id);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.games.find(id);
+    if (it == shard.games.end()) {
+        return false;
+    }
+    game = it->second.game;
+    version = it->second.version;
+    return true;
+}
+
+bool SessionStore::remove(uint64_t id) {
+    Shard& shard = shard_for(id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    if (shard.games.erase(id) == 0) {
+        return false;
+    }
+    if (MoveLog* log = mLog.load()) {
+        log->append(id, LOG_REMOVE, nullptr, 0);
+    }
+    return true;
+}
+
+size_t SessionStore::count() const {
+    size_t total = 0;
+    for (size_t i = 0; i <= mShardMask; ++i) {
+        std::shared_lock<std::shared_mutex> lock(mShards[i].mutex);
+        total += mShards[i].games.size();
+    }
+    return total;
+}
+
+void SessionStore::memory_usage(MemoryCounter& counter) const {
+    counter.add(sizeof(SessionStore) + (mShardMask + 1) * sizeof(Shard));
+    for (size_t i = 0; i <= mShardMask; ++i) {
+        std::shared_lock<std::shared_mutex> lock(mShards[i].mutex);
+        const auto& games = mShards[i].games;
+        counter.add(games.bucket_count() * sizeof(void*)
+                    + games.size() * hash_node_bytes(sizeof(std::pair<const uint64_t, Entry>)));
+        for (const auto& entry : games) {
+            counter.add_game(entry.second.game);
+        }
+    }
+}
+
+bool SessionStore::update(uint64_t id, const std::function<simplechess::Game(const simplechess::Game&)>& update,
+                          GameHandle* updated) {
+    UpdateOutcome outcome;
+    do {
+        outcome = update_shared(id, [&update](const std::shared_ptr<const simplechess::Game>& game) {
+            return std::make_shared<const simplechess::Game>(update(*game));
+        }, updated);
+    } while (outcome == UPDATE_CONFLICT);
+    return outcome == UPDATE_DONE;
+}
+
+UpdateOutcome SessionStore::make_move(uint64_t id, const simplechess::PieceMove& move, bool offer_draw, GameHandle* updated) {
+    return update_shared(id, [this, &move, offer_draw](const std::shared_ptr<const simplechess::Game>& game) {
+        auto play = [this, &game, &move, offer_draw]() { return mManager.makeMove(*game, move, offer_draw); };
+        if (mInterner) {
+            return mInterner->child(game, encode_piece_move(move, offer_draw), play);
+        }
+        return std::make_shared<const simplechess::Game>(play());
+    }, updated);
+}
+
+UpdateOutcome SessionStore::update_shared(
+    uint64_t id, const std::function<std::shared_ptr<const simplechess::Game>(const std::shared_ptr<const simplechess::Game>&)>& update,
+    GameHandle* updated) {
+    Shard& shard = shard_for(id);
+    GameHandle current(nullptr);
+    uint64_t version;
+    if (!lookup(id, current, version)) {
+        return UPDATE_NOT_FOUND;
+    }
+
+    GameHandle next(current, update(current.game));
+    LogRecordKind kind = LOG_MOVE;
+    std::vector<uint8_t> payload;
+    bool changed = describe_update(current, next, kind, payload);
+
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.games.find(id);
+    if (it == shard.games.end()) {
+        return UPDATE_NOT_FOUND;
+    }
+    if (it->second.version != version) {
+        return UPDATE_CONFLICT;
+    }
+    it->second = Entry{next, shard.next_version++};
+    schedule_clock(it->second.game);
+    MoveLog* log = mLog.load();
+    if (log && changed) {
+        log->append(id, kind, payload.data(), payload.size());
+    }
+    if (updated) {
+        *updated = std::move(next);
+    }
+    return UPDATE_DONE;
+}
+
+uint64_t SessionStore::collect(std::vector<std::pair<uint64_t, GameHandle>>& games) const {
+    // Changes are logged under their shard lock, so with every shard locked
+    // no change can be between the store and the log
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    locks.reserve(mShardMask + 1);
+    for (size_t i = 0; i <= mShardMask; ++i) {
+        locks.emplace_back(mShards[i].mutex);
+    }
+
+    MoveLog* log = mLog.load();
+    uint64_t lsn = log ? log->last_lsn() : 0;
+    for (size_t i = 0; i <= mShardMask; ++i) {
+        for (const auto& entry : mShards[i].games) {
+            games.emplace_back(entry.first, entry.second.game);
+        }
+    }
+    return lsn;
+}
+
+}
+
+using namespace simplechess_c;
+
+namespace {
+    SimplechessResult updated_state(bool found, const GameHandle& updated, SimplechessGameState* state) {
+        if (!found) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        if (state) {
+            *state = effective_game_state(updated);
+        }
+        return SIMPLECHESS_SUCCESS;
+    }
+
+    SimplechessResult update_game(SimplechessSessionStore store, uint64_t id, SimplechessGameState* state,
+                                  const std::function<simplechess::Game(const simplechess::Game&)>& update) {
+        auto* s = static_cast<SessionStore*>(store);
+        GameHandle updated(nullptr);
+        bool found = s->update(id, update, &updated);
+        return updated_state(found, updated, state);
+    }
+}
+
+extern "C" {
+
+SimplechessResult simplechess_session_store_create(SimplechessGameManager manager, size_t shard_count, SimplechessSessionStore* store) {
+    if (!manager || !store) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        *store = new SessionStore(*manager_from_handle(manager), shard_count ? shard_count : default_shard_count);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+void simplechess_session_store_destroy(SimplechessSessionStore store) {
+    if (store) {
+        delete static_cast<SessionStore*>(store);
+    }
+}
+
+SimplechessResult simplechess_session_store_create_game(SimplechessSessionStore store, uint64_t id, const char* fen) {
+    if (!store || (fen && !*fen)) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* s = static_cast<SessionStore*>(store);
+        if (!s->create(id, fen ? std::string(fen) : std::string())) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_session_store_insert(SimplechessSessionStore store, uint64_t id, SimplechessGame game) {
+    if (!store || !game) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* s = static_cast<SessionStore*>(store);
+        if (!s->insert(id, *static_cast<GameHandle*>(game))) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_session_store_lookup(SimplechessSessionStore store, uint64_t id, SimplechessGame* game) {
+    if (!store || !game) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* s = static_cast<SessionStore*>(store);
+        GameHandle found(nullptr);
+        if (!s->lookup(id, found)) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        *game = new GameHandle(std::move(found));
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_session_store_make_move(SimplechessSessionStore store, uint64_t id, const SimplechessPieceMove* move,
+                                                      bool offer_draw, SimplechessGameState* state) {
+    if (!store || !move) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        GameHandle updated(nullptr);
+        UpdateOutcome outcome = static_cast<SessionStore*>(store)->make_move(id, c_to_cpp_piece_move(*move), offer_draw, &updated);
+        if (outcome == UPDATE_CONFLICT) {
+            return SIMPLECHESS_ERROR_CONFLICT;
+        }
+        return updated_state(outcome == UPDATE_DONE, updated, state);
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_session_store_claim_draw(SimplechessSessionStore store, uint64_t id, SimplechessGameState* state) {
+    if (!store) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* s = static_cast<SessionStore*>(store);
+        return update_game(store, id, state, [s](const simplechess::Game& game) {
+            return s->manager().claimDraw(game);
+        });
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_session_store_resign(SimplechessSessionStore store, uint64_t id, SimplechessColor resigning_player,
+                                                   SimplechessGameState* state) {
+    if (!store) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* s = static_cast<SessionStore*>(store);
+        auto cpp_color = c_to_cpp_color(resigning_player);
+        return update_game(store, id, state, [s, cpp_color](const simplechess::Game& game) {
+            return s->manager().resign(game, cpp_color);
+        });
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_session_store_remove(SimplechessSessionStore store, uint64_t id) {
+    if (!store) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* s = static_cast<SessionStore*>(store);
+        return s->remove(id) ? SIMPLECHESS_SUCCESS : SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_session_store_count(SimplechessSessionStore store, size_t* count) {
+    if (!store || !count) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* s = static_cast<SessionStore*>(store);
+        *count = s->count();
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_session_store_memory_usage(SimplechessSessionStore store, size_t* bytes) {
+    if (!store || !bytes) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        MemoryCounter counter;
+        static_cast<SessionStore*>(store)->memory_usage(counter);
+        *bytes = counter.bytes();
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+}
@@ -0,0 +1,134 @@
+/**
+ * @file session_store.h
+ * @brief Internal game session store keyed by 64-bit ids
+ *
+ * Games are spread over shards by id; each shard has its own reader-writer
+ * lock. Lookups take the shard lock in shared mode only long enough to copy
+ * the game handle, and moves are computed outside the lock and published
+ * with a compare-and-swap on the version of the stored entry, so a slow move
+ * never blocks other games in the same shard.
+ *
+ * With a move log attached, every change is appended to the log while the
+ * shard lock is held, so the log sees the changes of a game in the order
+ * they were made.
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_SESSION_STORE_H
+#define SIMPLECHESS_SESSION_STORE_H
+
+#include "simplechess_internal.h"
+#include <simplechess/GameManager.h>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace simplechess_c {
+
+class MoveLog;
+class MemoryCounter;
+
+enum UpdateOutcome {
+    UPDATE_DONE,
+    UPDATE_NOT_FOUND,
+    UPDATE_CONFLICT     /* another thread replaced the game first */
+};
+
+class SessionStore {
+public:
+    /* Games inserted into the store take the move generator and history
+     * mode of manager; games created and moves made in the store go through
+     * its interner, if any. */
+    SessionStore(ManagerHandle& manager, size_t shard_count);
+
+    simplechess::GameManager& manager() const { return mManager; }
+
+    /* Changes made after this are appended to log; nullptr detaches it.
+     * The games already stored are appended first as game records, with
+     * every shard locked, so the log alone can rebuild the store. */
+    void set_log(MoveLog* log);
+    MoveLog* log() const { return mLog.load(); }
+
+    /* Returns false if the id is already in use. */
+    bool insert(uint64_t id, GameHandle game);
+
+    /* Inserts the game, or replaces the one stored under the id. */
+    void assign(uint64_t id, GameHandle game);
+
+    /* Inserts a new game from a FEN, or the standard position if it is
+     * empty. Returns false if the id is already in use. */
+    bool create(uint64_t id, const std::string& fen);
+
+    /* Returns false if there is no game with this id. */
+    bool lookup(uint64_t id, GameHandle& game) const;
+    bool remove(uint64_t id);
+    size_t count() const;
+
+    /* Adds the memory of the store and of its games to counter. */
+    void memory_usage(MemoryCounter& counter) const;
+
+    /* Replaces the stored game by update(current game). The update runs
+     * without holding the shard lock and is retried if another thread
+     * replaced the game in the meantime. Returns false if there is no game
+     * with this id; exceptions thrown by update propagate. */
+    bool update(uint64_t id, const std::function<simplechess::Game(const simplechess::Game&)>& update,
+                GameHandle* updated);
+
+    /* Plays a move on the stored game, through update_shared(). The move
+     * was chosen for the game as it was when the call started, so if
+     * another thread replaces the game meanwhile the move is not played
+     * and UPDATE_CONFLICT is returned. */
+    UpdateOutcome make_move(uint64_t id, const simplechess::PieceMove& move, bool offer_draw, GameHandle* updated);
+
+    /* Copies every stored game with all shards locked at once, so the copy
+     * matches the state of the attached log at the LSN returned (0 without
+     * a log). */
+    uint64_t collect(std::vector<std::pair<uint64_t, GameHandle>>& games) const;
+
+private:
+    /* A stored game and the version it was stored at. Versions come from a
+     * per-shard counter, so an entry replaced, or removed and inserted
+     * again, never gets back a version seen before; the game pointer may
+     * repeat since games are shared through the manager's caches. */
+    struct Entry {
+        GameHandle game;
+        uint64_t version;
+    };
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<uint64_t, Entry> games;
+        uint64_t next_version = 0; /* under the unique lock */
+    };
+
+    Shard& shard_for(uint64_t id) const;
+    bool lookup(uint64_t id, GameHandle& game, uint64_t& version) const;
+    bool insert_logged(uint64_t id, GameHandle game, uint8_t kind, const std::vector<uint8_t>& payload, bool replace);
+
+    /* As update(), for updates that may return a shared game, but without
+     * retrying: returns UPDATE_CONFLICT if another thread replaced or
+     * removed the game while update ran. */
+    UpdateOutcome update_shared(uint64_t id,
+                                const std::function<std::shared_ptr<const simplechess::Game>(const std::shared_ptr<const simplechess::Game>&)>& update,
+                                GameHandle* updated);
+
+    ManagerHandle& mOwner;
+    simplechess::GameManager& mManager;
+    SimplechessMoveGenerator mMoveGenerator;
+    unsigned mCheckpointInterval;
+    std::shared_ptr<GameInterner> mInterner;
+    std::unique_ptr<Shard[]> mShards;
+    size_t mShardMask;
+    std::atomic<MoveLog*> mLog{nullptr};
+};
+
+}
+
+#endif /* SIMPLECHESS_SESSION_STORE_H */
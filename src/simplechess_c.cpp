@@ -1,4 +1,10 @@
 #include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include "history.h"
+#include "clock.h"
+#include "movegen.h"
+#include "intern.h"
+#include "fen_cache.h"
 #include <simplechess/GameManager.h>
 #include <simplechess/Game.h>
 #include <simplechess/GameStage.h>
@@ -9,168 +15,115 @@
 #include <simplechess/Piece.h>
 #include <simplechess/Color.h>
 #include <simplechess/Exceptions.h>
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <cstring>
 #include <map>
 
-namespace {
-    SimplechessColor cpp_to_c_color(simplechess::Color color) {
-        return color == simplechess::Color::White ? SIMPLECHESS_COLOR_WHITE : SIMPLECHESS_COLOR_BLACK;
-    }
-
-    simplechess::Color c_to_cpp_color(SimplechessColor color) {
-        return color == SIMPLECHESS_COLOR_WHITE ? simplechess::Color::White : simplechess::Color::Black;
-    }
+namespace simplechess_c {
 
-    SimplechessGameState cpp_to_c_game_state(simplechess::GameState state) {
-        switch (state) {
-            case simplechess::GameState::Playing: return SIMPLECHESS_GAME_STATE_PLAYING;
-            case simplechess::GameState::Drawn: return SIMPLECHESS_GAME_STATE_DRAWN;
-            case simplechess::GameState::WhiteWon: return SIMPLECHESS_GAME_STATE_WHITE_WON;
-            case simplechess::GameState::BlackWon: return SIMPLECHESS_GAME_STATE_BLACK_WON;
+GameHandle new_game(ManagerHandle& manager) {
+    std::call_once(manager.start_built, [&] {
+        auto start = std::make_unique<GameHandle>(manager.manager.createNewGame());
+        start->set_move_generator(manager.move_generator);
+        if (start->moves) {
+            legal_moves(*start);
         }
-        return SIMPLECHESS_GAME_STATE_PLAYING;
-    }
-
-    SimplechessPieceType cpp_to_c_piece_type(simplechess::PieceType type) {
-        switch (type) {
-            case simplechess::PieceType::Pawn: return SIMPLECHESS_PIECE_TYPE_PAWN;
-            case simplechess::PieceType::Rook: return SIMPLECHESS_PIECE_TYPE_ROOK;
-            case simplechess::PieceType::Knight: return SIMPLECHESS_PIECE_TYPE_KNIGHT;
-            case simplechess::PieceType::Bishop: return SIMPLECHESS_PIECE_TYPE_BISHOP;
-            case simplechess::PieceType::Queen: return SIMPLECHESS_PIECE_TYPE_QUEEN;
-            case simplechess::PieceType::King: return SIMPLECHESS_PIECE_TYPE_KING;
+        manager.start = std::move(start);
+    });
+
+    GameHandle game(*manager.start);
+    game.set_move_generator(manager.move_generator);
+    game.checkpoint_interval = manager.checkpoint_interval;
+    return game;
+}
+
+GameHandle game_from_fen(ManagerHandle& manager, const std::string& fen) {
+    auto build = [&] {
+        auto create = [&] { return manager.manager.createGameFromFen(fen); };
+        GameHandle game(manager.interner ? manager.interner->root(fen, create)
+                                         : std::make_shared<const simplechess::Game>(create()));
+        game.set_move_generator(manager.move_generator);
+        return game;
+    };
+
+    GameHandle game = manager.fen_cache ? manager.fen_cache->get(fen, [&] {
+        // Cached games keep their moves for the copies handed out later
+        GameHandle built = build();
+        if (built.moves) {
+            legal_moves(built);
         }
-        return SIMPLECHESS_PIECE_TYPE_PAWN;
-    }
-
-    simplechess::PieceType c_to_cpp_piece_type(SimplechessPieceType type) {
-        switch (type) {
-            case SIMPLECHESS_PIECE_TYPE_PAWN: return simplechess::PieceType::Pawn;
-            case SIMPLECHESS_PIECE_TYPE_ROOK: return simplechess::PieceType::Rook;
-            case SIMPLECHESS_PIECE_TYPE_KNIGHT: return simplechess::PieceType::Knight;
-            case SIMPLECHESS_PIECE_TYPE_BISHOP: return simplechess::PieceType::Bishop;
-            case SIMPLECHESS_PIECE_TYPE_QUEEN: return simplechess::PieceType::Queen;
-            case SIMPLECHESS_PIECE_TYPE_KING: return simplechess::PieceType::King;
-        }
-        return simplechess::PieceType::Pawn;
-    }
-
-    SimplechessDrawReason cpp_to_c_draw_reason(simplechess::DrawReason reason) {
-        switch (reason) {
-            case simplechess::DrawReason::StaleMate: return SIMPLECHESS_DRAW_REASON_STALEMATE;
-            case simplechess::DrawReason::InsufficientMaterial: return SIMPLECHESS_DRAW_REASON_INSUFFICIENT_MATERIAL;
-            case simplechess::DrawReason::OfferedAndAccepted: return SIMPLECHESS_DRAW_REASON_OFFERED_AND_ACCEPTED;
-            case simplechess::DrawReason::ThreeFoldRepetition: return SIMPLECHESS_DRAW_REASON_THREE_FOLD_REPETITION;
-            case simplechess::DrawReason::FiveFoldRepetition: return SIMPLECHESS_DRAW_REASON_FIVE_FOLD_REPETITION;
-            case simplechess::DrawReason::FiftyMoveRule: return SIMPLECHESS_DRAW_REASON_FIFTY_MOVE_RULE;
-            case simplechess::DrawReason::SeventyFiveMoveRule: return SIMPLECHESS_DRAW_REASON_SEVENTY_FIVE_MOVE_RULE;
-        }
-        return SIMPLECHESS_DRAW_REASON_STALEMATE;
-    }
-
-    SimplechessSquare cpp_to_c_square(const simplechess::Square& square) {
-        SimplechessSquare result;
-        result.rank = square.rank();
-        result.file = square.file();
-        return result;
-    }
+        return built;
+    }) : build();
+    game.set_move_generator(manager.move_generator);
+    game.checkpoint_interval = manager.checkpoint_interval;
+    return game;
+}
 
-    simplechess::Square c_to_cpp_square(const SimplechessSquare& square) {
-        return simplechess::Square::fromRankAndFile(square.rank, square.file);
-    }
+}
 
-    SimplechessPiece cpp_to_c_piece(const simplechess::Piece& piece) {
-        SimplechessPiece result;
-        result.type = cpp_to_c_piece_type(piece.type());
-        result.color = cpp_to_c_color(piece.color());
-        return result;
-    }
+using namespace simplechess_c;
 
-    simplechess::Piece c_to_cpp_piece(const SimplechessPiece& piece) {
-        return simplechess::Piece(c_to_cpp_piece_type(piece.type), c_to_cpp_color(piece.color));
-    }
+extern "C" {
 
-    SimplechessPieceMove cpp_to_c_piece_move(const simplechess::PieceMove& move) {
-        SimplechessPieceMove result;
-        result.piece = cpp_to_c_piece(move.piece());
-        result.src = cpp_to_c_square(move.src());
-        result.dst = cpp_to_c_square(move.dst());
-        result.is_promotion = move.promoted().has_value();
-        result.promoted_type = result.is_promotion ? cpp_to_c_piece_type(move.promoted().value()) : SIMPLECHESS_PIECE_TYPE_PAWN;
-        return result;
-    }
+SimplechessResult simplechess_game_manager_create(SimplechessGameManager* manager) {
+    return simplechess_game_manager_create_with_move_generator(SIMPLECHESS_MOVE_GENERATOR_DEFAULT, manager);
+}
 
-    simplechess::PieceMove c_to_cpp_piece_move(const SimplechessPieceMove& move) {
-        if (move.is_promotion) {
-            return simplechess::PieceMove::pawnPromotion(
-                c_to_cpp_piece(move.piece),
-                c_to_cpp_square(move.src),
-                c_to_cpp_square(move.dst),
-                c_to_cpp_piece_type(move.promoted_type)
-            );
-        } else {
-            return simplechess::PieceMove::regularMove(
-                c_to_cpp_piece(move.piece),
-                c_to_cpp_square(move.src),
-                c_to_cpp_square(move.dst)
-            );
-        }
+SimplechessResult simplechess_game_manager_create_with_move_generator(SimplechessMoveGenerator generator,
+                                                                      SimplechessGameManager* manager) {
+    if (!manager || (generator != SIMPLECHESS_MOVE_GENERATOR_DEFAULT && generator != SIMPLECHESS_MOVE_GENERATOR_BITBOARD)) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
     }
 
-    SimplechessCheckType cpp_to_c_check_type(simplechess::CheckType check_type) {
-        switch (check_type) {
-            case simplechess::CheckType::NoCheck: return SIMPLECHESS_CHECK_TYPE_NO_CHECK;
-            case simplechess::CheckType::Check: return SIMPLECHESS_CHECK_TYPE_CHECK;
-            case simplechess::CheckType::CheckMate: return SIMPLECHESS_CHECK_TYPE_CHECKMATE;
-        }
-        return SIMPLECHESS_CHECK_TYPE_NO_CHECK;
+    try {
+        auto* handle = new ManagerHandle();
+        handle->move_generator = generator;
+        *manager = handle;
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
     }
+}
 
-    SimplechessSquareAndPiece cpp_to_c_square_and_piece(const std::pair<simplechess::Square, simplechess::Piece>& pair) {
-        SimplechessSquareAndPiece result;
-        result.square = cpp_to_c_square(pair.first);
-        result.piece = cpp_to_c_piece(pair.second);
-        return result;
+SimplechessResult simplechess_game_manager_set_compact_history(SimplechessGameManager manager, unsigned checkpoint_interval) {
+    if (!manager) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
     }
 
-    SimplechessResult handle_exception() {
-        try {
-            throw;
-        } catch (const simplechess::IllegalStateException&) {
-            return SIMPLECHESS_ERROR_ILLEGAL_STATE;
-        } catch (const std::invalid_argument&) {
-            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
-        } catch (const std::out_of_range&) {
-            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
-        } catch (const std::bad_alloc&) {
-            return SIMPLECHESS_ERROR_OUT_OF_MEMORY;
-        } catch (...) {
-            return SIMPLECHESS_ERROR_UNKNOWN;
-        }
-    }
+    manager_from_handle(manager)->checkpoint_interval = checkpoint_interval;
+    return SIMPLECHESS_SUCCESS;
 }
 
-extern "C" {
-
-SimplechessResult simplechess_game_manager_create(SimplechessGameManager* manager) {
+SimplechessResult simplechess_game_manager_set_game_interning(SimplechessGameManager manager, unsigned max_ply) {
     if (!manager) {
         return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
     }
 
     try {
-        *manager = new simplechess::GameManager();
+        auto& interner = manager_from_handle(manager)->interner;
+        interner = max_ply ? std::make_shared<GameInterner>(max_ply) : nullptr;
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
         return handle_exception();
     }
 }
 
+SimplechessResult simplechess_game_manager_get_interning_stats(SimplechessGameManager manager, SimplechessInternStats* stats) {
+    if (!manager || !stats) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    const auto& interner = manager_from_handle(manager)->interner;
+    *stats = interner ? interner->stats() : SimplechessInternStats{};
+    return SIMPLECHESS_SUCCESS;
+}
+
 void simplechess_game_manager_destroy(SimplechessGameManager manager) {
     if (manager) {
-        delete static_cast<simplechess::GameManager*>(manager);
+        delete manager_from_handle(manager);
     }
 }
 
@@ -180,9 +133,7 @@ SimplechessResult simplechess_create_new_game(SimplechessGameManager manager, Si
     }
 
     try {
-        auto* mgr = static_cast<simplechess::GameManager*>(manager);
-        auto new_game = mgr->createNewGame();
-        *game = new simplechess::Game(std::move(new_game));
+        *game = new GameHandle(new_game(*manager_from_handle(manager)));
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
         return handle_exception();
@@ -195,9 +146,7 @@ SimplechessResult simplechess_create_game_from_fen(SimplechessGameManager manage
     }
 
     try {
-        auto* mgr = static_cast<simplechess::GameManager*>(manager);
-        auto new_game = mgr->createGameFromFen(std::string(fen));
-        *game = new simplechess::Game(std::move(new_game));
+        *game = new GameHandle(game_from_fen(*manager_from_handle(manager), std::string(fen)));
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
         return handle_exception();
@@ -210,11 +159,17 @@ SimplechessResult simplechess_make_move(SimplechessGameManager manager, Simplech
     }
 
     try {
-        auto* mgr = static_cast<simplechess::GameManager*>(manager);
-        auto* game = static_cast<simplechess::Game*>(input_game);
+        auto* mgr = &manager_from_handle(manager)->manager;
+        auto* parent = static_cast<GameHandle*>(input_game);
+        const auto* game = parent->game.get();
         auto cpp_move = c_to_cpp_piece_move(*move);
-        auto new_game = mgr->makeMove(*game, cpp_move, offer_draw);
-        *result_game = new simplechess::Game(std::move(new_game));
+        auto play = [&]() { return mgr->makeMove(*game, cpp_move, offer_draw); };
+        const auto& interner = manager_from_handle(manager)->interner;
+        auto handle = std::make_unique<GameHandle>(
+            *parent, interner ? interner->child(parent->game, encode_piece_move(cpp_move, offer_draw), play)
+                              : std::make_shared<const simplechess::Game>(play()));
+        schedule_clock(*handle);
+        *result_game = handle.release();
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
         return handle_exception();
@@ -227,10 +182,13 @@ SimplechessResult simplechess_claim_draw(SimplechessGameManager manager, Simplec
     }
 
     try {
-        auto* mgr = static_cast<simplechess::GameManager*>(manager);
-        auto* game = static_cast<simplechess::Game*>(input_game);
+        auto* mgr = &manager_from_handle(manager)->manager;
+        auto* parent = static_cast<GameHandle*>(input_game);
+        const auto* game = parent->game.get();
         auto new_game = mgr->claimDraw(*game);
-        *result_game = new simplechess::Game(std::move(new_game));
+        auto handle = std::make_unique<GameHandle>(*parent, std::move(new_game));
+        schedule_clock(*handle);
+        *result_game = handle.release();
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
         return handle_exception();
@@ -243,11 +201,14 @@ SimplechessResult simplechess_resign(SimplechessGameManager manager, Simplechess
     }
 
     try {
-        auto* mgr = static_cast<simplechess::GameManager*>(manager);
-        auto* game = static_cast<simplechess::Game*>(input_game);
+        auto* mgr = &manager_from_handle(manager)->manager;
+        auto* parent = static_cast<GameHandle*>(input_game);
+        const auto* game = parent->game.get();
         auto cpp_color = c_to_cpp_color(resigning_player);
         auto new_game = mgr->resign(*game, cpp_color);
-        *result_game = new simplechess::Game(std::move(new_game));
+        auto handle = std::make_unique<GameHandle>(*parent, std::move(new_game));
+        schedule_clock(*handle);
+        *result_game = handle.release();
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
         return handle_exception();
@@ -260,8 +221,7 @@ SimplechessResult simplechess_game_get_state(SimplechessGame game, SimplechessGa
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
-        *state = cpp_to_c_game_state(g->gameState());
+        *state = effective_game_state(*static_cast<GameHandle*>(game));
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
         return handle_exception();
@@ -274,8 +234,10 @@ SimplechessResult simplechess_game_get_draw_reason(SimplechessGame game, Simplec
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
-        *reason = cpp_to_c_draw_reason(g->drawReason());
+        bool drawn_on_time = false;
+        effective_game_state(*static_cast<GameHandle*>(game), &drawn_on_time);
+        *reason = drawn_on_time ? SIMPLECHESS_DRAW_REASON_INSUFFICIENT_MATERIAL
+                                : cpp_to_c_draw_reason(game_from_handle(game)->drawReason());
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
         return handle_exception();
@@ -288,7 +250,7 @@ SimplechessResult simplechess_game_get_active_color(SimplechessGame game, Simple
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
+        const auto* g = game_from_handle(game);
         *color = cpp_to_c_color(g->activeColor());
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
@@ -302,7 +264,7 @@ SimplechessResult simplechess_game_can_claim_draw(SimplechessGame game, bool* ca
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
+        const auto* g = game_from_handle(game);
         auto draw_reason = g->reasonToClaimDraw();
         *can_claim = draw_reason.has_value();
         if (*can_claim && reason) {
@@ -320,8 +282,12 @@ SimplechessResult simplechess_game_get_available_moves_count(SimplechessGame gam
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
-        *count = g->allAvailableMoves().size();
+        const auto* handle = static_cast<GameHandle*>(game);
+        if (handle->move_generator == SIMPLECHESS_MOVE_GENERATOR_BITBOARD) {
+            *count = legal_moves(*handle).list.size;
+            return SIMPLECHESS_SUCCESS;
+        }
+        *count = handle->game->allAvailableMoves().size();
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
         return handle_exception();
@@ -334,8 +300,19 @@ SimplechessResult simplechess_game_get_available_moves(SimplechessGame game, Sim
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
-        const auto& cpp_moves = g->allAvailableMoves();
+        const auto* handle = static_cast<GameHandle*>(game);
+        if (handle->move_generator == SIMPLECHESS_MOVE_GENERATOR_BITBOARD) {
+            const LegalMoves& legal = legal_moves(*handle);
+            if (moves_size < legal.list.size) {
+                return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+            }
+            for (size_t i = 0; i < legal.list.size; ++i) {
+                moves[i] = to_c_piece_move(legal.pos, legal.list.moves[i]);
+            }
+            return SIMPLECHESS_SUCCESS;
+        }
+
+        const auto& cpp_moves = handle->game->allAvailableMoves();
 
         if (moves_size < cpp_moves.size()) {
             return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
@@ -358,10 +335,15 @@ SimplechessResult simplechess_game_get_moves_for_piece_count(SimplechessGame gam
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
+        const auto* handle = static_cast<GameHandle*>(game);
         auto cpp_square = c_to_cpp_square(*square);
-        auto moves = g->availableMovesForPiece(cpp_square);
-        *count = moves.size();
+        if (handle->move_generator == SIMPLECHESS_MOVE_GENERATOR_BITBOARD) {
+            const MoveList& list = legal_moves(*handle).list;
+            int from = square_index(cpp_square.rank(), cpp_square.file());
+            *count = std::count_if(list.begin(), list.end(), [from](Move m) { return move_from(m) == from; });
+            return SIMPLECHESS_SUCCESS;
+        }
+        *count = handle->game->availableMovesForPiece(cpp_square).size();
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
         return handle_exception();
@@ -374,9 +356,25 @@ SimplechessResult simplechess_game_get_moves_for_piece(SimplechessGame game, con
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
+        const auto* handle = static_cast<GameHandle*>(game);
         auto cpp_square = c_to_cpp_square(*square);
-        auto cpp_moves = g->availableMovesForPiece(cpp_square);
+        if (handle->move_generator == SIMPLECHESS_MOVE_GENERATOR_BITBOARD) {
+            const LegalMoves& legal = legal_moves(*handle);
+            int from = square_index(cpp_square.rank(), cpp_square.file());
+            size_t n = std::count_if(legal.list.begin(), legal.list.end(), [from](Move m) { return move_from(m) == from; });
+            if (moves_size < n) {
+                return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+            }
+            size_t i = 0;
+            for (Move m : legal.list) {
+                if (move_from(m) == from) {
+                    moves[i++] = to_c_piece_move(legal.pos, m);
+                }
+            }
+            return SIMPLECHESS_SUCCESS;
+        }
+
+        auto cpp_moves = handle->game->availableMovesForPiece(cpp_square);
 
         if (moves_size < cpp_moves.size()) {
             return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
@@ -489,7 +487,7 @@ SimplechessResult simplechess_piece_move_promotion(const SimplechessPiece* piece
 
 void simplechess_game_destroy(SimplechessGame game) {
     if (game) {
-        delete static_cast<simplechess::Game*>(game);
+        delete static_cast<GameHandle*>(game);
     }
 }
 
@@ -503,8 +501,7 @@ SimplechessResult simplechess_game_get_history_length(SimplechessGame game, size
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
-        *length = g->history().size();
+        *length = history_length(*static_cast<GameHandle*>(game));
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
         return handle_exception();
@@ -517,12 +514,11 @@ SimplechessResult simplechess_game_get_stage_at(SimplechessGame game, size_t ind
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
-        const auto& history = g->history();
-        if (index >= history.size()) {
+        const auto* handle = static_cast<GameHandle*>(game);
+        if (index >= history_length(*handle)) {
             return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
         }
-        *stage = new simplechess::GameStage(history[index]);
+        *stage = new simplechess::GameStage(stage_at(*handle, index));
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
         return handle_exception();
@@ -535,7 +531,7 @@ SimplechessResult simplechess_game_get_current_stage(SimplechessGame game, Simpl
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
+        const auto* g = game_from_handle(game);
         *stage = new simplechess::GameStage(g->currentStage());
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
@@ -808,7 +804,7 @@ SimplechessResult simplechess_game_get_halfmove_clock(SimplechessGame game, uint
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
+        const auto* g = game_from_handle(game);
         *halfmoves = g->currentStage().halfMovesSinceLastCaptureOrPawnAdvance();
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
@@ -822,7 +818,7 @@ SimplechessResult simplechess_game_get_fullmove_counter(SimplechessGame game, ui
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
+        const auto* g = game_from_handle(game);
         *fullmoves = g->currentStage().fullMoveCounter();
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
@@ -836,7 +832,7 @@ SimplechessResult simplechess_game_get_current_fen(SimplechessGame game, char* b
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
+        const auto* g = game_from_handle(game);
         const std::string& fen = g->currentStage().fen();
         if (fen.length() + 1 > buffer_size) {
             return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
@@ -854,7 +850,7 @@ SimplechessResult simplechess_game_get_castling_rights(SimplechessGame game, uin
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
+        const auto* g = game_from_handle(game);
         *rights = g->currentStage().castlingRights();
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
@@ -868,7 +864,7 @@ SimplechessResult simplechess_game_get_current_board(SimplechessGame game, Simpl
     }
 
     try {
-        auto* g = static_cast<simplechess::Game*>(game);
+        const auto* g = game_from_handle(game);
         *board = new simplechess::Board(g->currentStage().board());
         return SIMPLECHESS_SUCCESS;
     } catch (...) {
@@ -965,6 +961,7 @@ const char* simplechess_result_to_string(SimplechessResult result) {
         case SIMPLECHESS_ERROR_ILLEGAL_STATE: return "Illegal state";
         case SIMPLECHESS_ERROR_OUT_OF_MEMORY: return "Out of memory";
         case SIMPLECHESS_ERROR_UNKNOWN: return "Unknown error";
+        case SIMPLECHESS_ERROR_CONFLICT: return "Conflicting update";
         default: return "Invalid result code";
     }
 }
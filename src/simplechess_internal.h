@@ -0,0 +1,296 @@
+/**
+ * @file simplechess_internal.h
+ * @brief Conversions between the C API types and simple-chess-games types
+ *
+ * Shared by the translation units of the wrapper. This header is private to
+ * the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_INTERNAL_H
+#define SIMPLECHESS_INTERNAL_H
+
+#include "simplechess/simplechess.h"
+#include <simplechess/PieceMove.h>
+#include <simplechess/Square.h>
+#include <simplechess/Piece.h>
+#include <simplechess/Color.h>
+#include <simplechess/Game.h>
+#include <simplechess/GameManager.h>
+#include <simplechess/Exceptions.h>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace simplechess_c {
+    struct HistoryPrefix;
+    struct ClockState;
+    struct UpdateSlot;
+    struct MoveCache;
+    struct GameHandle;
+    class GameInterner;
+    class FenCache;
+
+    /* An empty slot for the broadcast update of one game; defined in
+     * update.cpp. */
+    std::shared_ptr<UpdateSlot> new_update_slot();
+
+    /* Bytes of an update slot and of the update message it caches, if
+     * built. */
+    size_t update_slot_bytes(const UpdateSlot& slot);
+
+    /* An empty cache for the legal moves of one game; defined in
+     * movegen.cpp. */
+    std::shared_ptr<MoveCache> new_move_cache();
+
+    /* Bytes of a move cache. */
+    size_t move_cache_bytes();
+
+    /* Thrown by the wrapper itself for operations the game's state does not
+     * allow; reported as SIMPLECHESS_ERROR_ILLEGAL_STATE. */
+    class IllegalStateError : public std::logic_error {
+    public:
+        using std::logic_error::logic_error;
+    };
+
+    /* The clock reading after the game went from before to after; defined
+     * in clock.cpp. Throws IllegalStateError if the flag of the side to
+     * move has fallen. */
+    std::shared_ptr<const ClockState> next_clock(const ClockState& clock, const simplechess::Game& before,
+                                                 const simplechess::Game& after);
+
+    /* Moves the stages of the handle's game before its last anchor into its
+     * history prefix if there are at least checkpoint_interval of them;
+     * defined in history.cpp. */
+    void compact_history(GameHandle& handle);
+
+    /* Object behind a SimplechessGame handle. Games are immutable, so the
+     * underlying game is shared and handles can be duplicated cheaply.
+     *
+     * A restored game may keep the part of its history that precedes its
+     * last irreversible move in compact form (see history.h); the game then
+     * only holds the stages from that point on.
+     *
+     * A game may also carry a chess clock (see clock.h), which follows it
+     * from move to move.
+     *
+     * Copies of a handle share the slot that caches the game's broadcast
+     * update, so it is formatted once however many copies ask for it.
+     *
+     * The move generator is that of the manager the game was created with
+     * and answers the game's move queries (see movegen.h). With the bitboard
+     * generator, copies also share the cache of the game's moves.
+     *
+     * With a checkpoint interval, the game keeps a compact history: as it is
+     * played, the stages before its last capture or pawn move go to the
+     * prefix, with the FEN of every checkpoint_interval-th stage. */
+    struct GameHandle {
+        std::shared_ptr<const simplechess::Game> game;
+        std::shared_ptr<const HistoryPrefix> prefix;
+        std::shared_ptr<const ClockState> clock;
+        std::shared_ptr<UpdateSlot> update;
+        SimplechessMoveGenerator move_generator = SIMPLECHESS_MOVE_GENERATOR_DEFAULT;
+        std::shared_ptr<MoveCache> moves;
+        unsigned checkpoint_interval = 0;
+
+        explicit GameHandle(simplechess::Game&& new_game)
+            : game(std::make_shared<const simplechess::Game>(std::move(new_game))), update(new_update_slot()) {}
+        explicit GameHandle(std::shared_ptr<const simplechess::Game> shared_game)
+            : game(std::move(shared_game)), update(game ? new_update_slot() : nullptr) {}
+
+        /* The game that follows parent after a move, draw claim or
+         * resignation. */
+        GameHandle(const GameHandle& parent, simplechess::Game&& next_game)
+            : GameHandle(parent, std::make_shared<const simplechess::Game>(std::move(next_game))) {}
+        GameHandle(const GameHandle& parent, std::shared_ptr<const simplechess::Game> next_game)
+            : game(std::move(next_game)), prefix(parent.prefix),
+              clock(parent.clock ? next_clock(*parent.clock, *parent.game, *game) : nullptr),
+              update(new_update_slot()), move_generator(parent.move_generator),
+              moves(move_generator == SIMPLECHESS_MOVE_GENERATOR_BITBOARD ? new_move_cache() : nullptr),
+              checkpoint_interval(parent.checkpoint_interval) {
+            if (checkpoint_interval) {
+                compact_history(*this);
+            }
+        }
+
+        void set_move_generator(SimplechessMoveGenerator generator) {
+            if (generator != move_generator) {
+                move_generator = generator;
+                moves = generator == SIMPLECHESS_MOVE_GENERATOR_BITBOARD ? new_move_cache() : nullptr;
+            }
+        }
+    };
+
+    /* Object behind a SimplechessGameManager handle. */
+    struct ManagerHandle {
+        simplechess::GameManager manager;
+        SimplechessMoveGenerator move_generator = SIMPLECHESS_MOVE_GENERATOR_DEFAULT;
+        unsigned checkpoint_interval = 0;
+        /* Shares identical games between handles; null unless enabled. */
+        std::shared_ptr<GameInterner> interner;
+        /* Recently created games by FEN; null unless enabled. */
+        std::shared_ptr<FenCache> fen_cache;
+        /* The start position, with its moves, that new games copy; built
+         * by new_game() on first use. */
+        std::once_flag start_built;
+        std::unique_ptr<const GameHandle> start;
+    };
+
+    /* A new game of the manager, sharing its game, moves and update with
+     * the manager's start position; defined in simplechess_c.cpp. */
+    GameHandle new_game(ManagerHandle& manager);
+
+    /* A game of the manager created from fen, through its FEN cache and
+     * interner if it has them; defined in simplechess_c.cpp. */
+    GameHandle game_from_fen(ManagerHandle& manager, const std::string& fen);
+
+    inline ManagerHandle* manager_from_handle(SimplechessGameManager manager) {
+        return static_cast<ManagerHandle*>(manager);
+    }
+
+    inline const simplechess::Game* game_from_handle(SimplechessGame game) {
+        return static_cast<GameHandle*>(game)->game.get();
+    }
+
+    inline SimplechessColor cpp_to_c_color(simplechess::Color color) {
+        return color == simplechess::Color::White ? SIMPLECHESS_COLOR_WHITE : SIMPLECHESS_COLOR_BLACK;
+    }
+
+    inline simplechess::Color c_to_cpp_color(SimplechessColor color) {
+        return color == SIMPLECHESS_COLOR_WHITE ? simplechess::Color::White : simplechess::Color::Black;
+    }
+
+    inline SimplechessGameState cpp_to_c_game_state(simplechess::GameState state) {
+        switch (state) {
+            case simplechess::GameState::Playing: return SIMPLECHESS_GAME_STATE_PLAYING;
+            case simplechess::GameState::Drawn: return SIMPLECHESS_GAME_STATE_DRAWN;
+            case simplechess::GameState::WhiteWon: return SIMPLECHESS_GAME_STATE_WHITE_WON;
+            case simplechess::GameState::BlackWon: return SIMPLECHESS_GAME_STATE_BLACK_WON;
+        }
+        return SIMPLECHESS_GAME_STATE_PLAYING;
+    }
+
+    inline SimplechessPieceType cpp_to_c_piece_type(simplechess::PieceType type) {
+        switch (type) {
+            case simplechess::PieceType::Pawn: return SIMPLECHESS_PIECE_TYPE_PAWN;
+            case simplechess::PieceType::Rook: return SIMPLECHESS_PIECE_TYPE_ROOK;
+            case simplechess::PieceType::Knight: return SIMPLECHESS_PIECE_TYPE_KNIGHT;
+            case simplechess::PieceType::Bishop: return SIMPLECHESS_PIECE_TYPE_BISHOP;
+            case simplechess::PieceType::Queen: return SIMPLECHESS_PIECE_TYPE_QUEEN;
+            case simplechess::PieceType::King: return SIMPLECHESS_PIECE_TYPE_KING;
+        }
+        return SIMPLECHESS_PIECE_TYPE_PAWN;
+    }
+
+    inline simplechess::PieceType c_to_cpp_piece_type(SimplechessPieceType type) {
+        switch (type) {
+            case SIMPLECHESS_PIECE_TYPE_PAWN: return simplechess::PieceType::Pawn;
+            case SIMPLECHESS_PIECE_TYPE_ROOK: return simplechess::PieceType::Rook;
+            case SIMPLECHESS_PIECE_TYPE_KNIGHT: return simplechess::PieceType::Knight;
+            case SIMPLECHESS_PIECE_TYPE_BISHOP: return simplechess::PieceType::Bishop;
+            case SIMPLECHESS_PIECE_TYPE_QUEEN: return simplechess::PieceType::Queen;
+            case SIMPLECHESS_PIECE_TYPE_KING: return simplechess::PieceType::King;
+        }
+        return simplechess::PieceType::Pawn;
+    }
+
+    inline SimplechessDrawReason cpp_to_c_draw_reason(simplechess::DrawReason reason) {
+        switch (reason) {
+            case simplechess::DrawReason::StaleMate: return SIMPLECHESS_DRAW_REASON_STALEMATE;
+            case simplechess::DrawReason::InsufficientMaterial: return SIMPLECHESS_DRAW_REASON_INSUFFICIENT_MATERIAL;
+            case simplechess::DrawReason::OfferedAndAccepted: return SIMPLECHESS_DRAW_REASON_OFFERED_AND_ACCEPTED;
+            case simplechess::DrawReason::ThreeFoldRepetition: return SIMPLECHESS_DRAW_REASON_THREE_FOLD_REPETITION;
+            case simplechess::DrawReason::FiveFoldRepetition: return SIMPLECHESS_DRAW_REASON_FIVE_FOLD_REPETITION;
+            case simplechess::DrawReason::FiftyMoveRule: return SIMPLECHESS_DRAW_REASON_FIFTY_MOVE_RULE;
+            case simplechess::DrawReason::SeventyFiveMoveRule: return SIMPLECHESS_DRAW_REASON_SEVENTY_FIVE_MOVE_RULE;
+        }
+        return SIMPLECHESS_DRAW_REASON_STALEMATE;
+    }
+
+    inline SimplechessSquare cpp_to_c_square(const simplechess::Square& square) {
+        SimplechessSquare result;
+        result.rank = square.rank();
+        result.file = square.file();
+        return result;
+    }
+
+    inline simplechess::Square c_to_cpp_square(const SimplechessSquare& square) {
+        return simplechess::Square::fromRankAndFile(square.rank, square.file);
+    }
+
+    inline SimplechessPiece cpp_to_c_piece(const simplechess::Piece& piece) {
+        SimplechessPiece result;
+        result.type = cpp_to_c_piece_type(piece.type());
+        result.color = cpp_to_c_color(piece.color());
+        return result;
+    }
+
+    inline simplechess::Piece c_to_cpp_piece(const SimplechessPiece& piece) {
+        return simplechess::Piece(c_to_cpp_piece_type(piece.type), c_to_cpp_color(piece.color));
+    }
+
+    inline SimplechessPieceMove cpp_to_c_piece_move(const simplechess::PieceMove& move) {
+        SimplechessPieceMove result;
+        result.piece = cpp_to_c_piece(move.piece());
+        result.src = cpp_to_c_square(move.src());
+        result.dst = cpp_to_c_square(move.dst());
+        result.is_promotion = move.promoted().has_value();
+        result.promoted_type = result.is_promotion ? cpp_to_c_piece_type(move.promoted().value()) : SIMPLECHESS_PIECE_TYPE_PAWN;
+        return result;
+    }
+
+    inline simplechess::PieceMove c_to_cpp_piece_move(const SimplechessPieceMove& move) {
+        if (move.is_promotion) {
+            return simplechess::PieceMove::pawnPromotion(
+                c_to_cpp_piece(move.piece),
+                c_to_cpp_square(move.src),
+                c_to_cpp_square(move.dst),
+                c_to_cpp_piece_type(move.promoted_type)
+            );
+        } else {
+            return simplechess::PieceMove::regularMove(
+                c_to_cpp_piece(move.piece),
+                c_to_cpp_square(move.src),
+                c_to_cpp_square(move.dst)
+            );
+        }
+    }
+
+    inline SimplechessCheckType cpp_to_c_check_type(simplechess::CheckType check_type) {
+        switch (check_type) {
+            case simplechess::CheckType::NoCheck: return SIMPLECHESS_CHECK_TYPE_NO_CHECK;
+            case simplechess::CheckType::Check: return SIMPLECHESS_CHECK_TYPE_CHECK;
+            case simplechess::CheckType::CheckMate: return SIMPLECHESS_CHECK_TYPE_CHECKMATE;
+        }
+        return SIMPLECHESS_CHECK_TYPE_NO_CHECK;
+    }
+
+    inline SimplechessSquareAndPiece cpp_to_c_square_and_piece(const std::pair<simplechess::Square, simplechess::Piece>& pair) {
+        SimplechessSquareAndPiece result;
+        result.square = cpp_to_c_square(pair.first);
+        result.piece = cpp_to_c_piece(pair.second);
+        return result;
+    }
+
+    inline SimplechessResult handle_exception() {
+        try {
+            throw;
+        } catch (const simplechess::IllegalStateException&) {
+            return SIMPLECHESS_ERROR_ILLEGAL_STATE;
+        } catch (const IllegalStateError&) {
+            return SIMPLECHESS_ERROR_ILLEGAL_STATE;
+        } catch (const std::invalid_argument&) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        } catch (const std::out_of_range&) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        } catch (const std::bad_alloc&) {
+            return SIMPLECHESS_ERROR_OUT_OF_MEMORY;
+        } catch (...) {
+            return SIMPLECHESS_ERROR_UNKNOWN;
+        }
+    }
+}
+
+#endif /* SIMPLECHESS_INTERNAL_H */
@@ -0,0 +1,427 @@
+#include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include "snapshot.h"
+#include "history.h"
+#include "session_store.h"
+#include "crc32.h"
+#include "serialize.h"
+#include <simplechess/Game.h>
+#include <simplechess/GameStage.h>
+#include <simplechess/PlayedMove.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace simplechess_c {
+
+namespace {
+    const char snapshot_magic[8] = {'S', 'C', 'S', 'N', 'A', 'P', '0', '1'};
+    const uint32_t snapshot_version = 1;
+    const size_t header_size = 40;
+    const size_t record_header_size = 24;
+    const size_t flush_threshold = 1 << 20;
+
+    enum EndAction : uint8_t {
+        END_NONE = 0,
+        END_CLAIM_DRAW = 1,
+        END_WHITE_RESIGNED = 2,
+        END_BLACK_RESIGNED = 3
+    };
+
+    // How a finished game ended, when replaying its moves does not end it
+    EndAction end_action(const simplechess::Game& game) {
+        switch (game.gameState()) {
+            case simplechess::GameState::Playing:
+                return END_NONE;
+            case simplechess::GameState::Drawn:
+                switch (game.drawReason()) {
+                    case simplechess::DrawReason::OfferedAndAccepted:
+                    case simplechess::DrawReason::ThreeFoldRepetition:
+                    case simplechess::DrawReason::FiftyMoveRule:
+                        return END_CLAIM_DRAW;
+                    default:
+                        return END_NONE;
+                }
+            case simplechess::GameState::WhiteWon:
+            case simplechess::GameState::BlackWon: {
+                const auto& last_move = game.currentStage().move();
+                if (last_move.has_value() && last_move->checkType() == simplechess::CheckType::CheckMate) {
+                    return END_NONE;
+                }
+                return game.gameState() == simplechess::GameState::WhiteWon ? END_BLACK_RESIGNED : END_WHITE_RESIGNED;
+            }
+        }
+        return END_NONE;
+    }
+
+    void write_all(int fd, const void* data, size_t size, off_t offset) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+            ssize_t written = offset < 0 ? ::write(fd, bytes, size) : ::pwrite(fd, bytes, size, offset);
+            if (written < 0) {
+                throw std::runtime_error("Failed to write snapshot");
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+            if (offset >= 0) {
+                offset += written;
+            }
+        }
+    }
+}
+
+void encode_game_record(uint64_t id, const GameHandle& game, std::vector<uint8_t>& out) {
+    std::string start_fen;
+    std::vector<uint16_t> moves;
+    encode_history(game, start_fen, moves);
+
+    size_t prefix_length = game.prefix ? game.prefix->moves.size() : 0;
+    size_t anchor = anchor_index(*game.game, game.game->history().size() - 1);
+    const std::string& anchor_fen = game.game->history()[anchor].fen();
+
+    size_t start = out.size();
+    put_u64(out, id);
+    put_u32(out, static_cast<uint32_t>(moves.size()));
+    put_u32(out, static_cast<uint32_t>(prefix_length + anchor));
+    put_u16(out, static_cast<uint16_t>(start_fen.size()));
+    put_u16(out, static_cast<uint16_t>(anchor_fen.size()));
+    out.push_back(end_action(*game.game));
+    out.insert(out.end(), 3, 0);
+    for (uint16_t move : moves) {
+        put_u16(out, move);
+    }
+    out.insert(out.end(), start_fen.begin(), start_fen.end());
+    out.insert(out.end(), anchor_fen.begin(), anchor_fen.end());
+    out.insert(out.end(), (8 - (out.size() - start) % 8) % 8, 0);
+}
+
+size_t game_record_length(const uint8_t* record, size_t available) {
+    if (available < record_header_size) {
+        return 0;
+    }
+    size_t length = record_header_size + 2 * size_t(get_u32(record + 8)) + get_u16(record + 16) + get_u16(record + 18);
+    length += (8 - length % 8) % 8;
+    if (length > available || get_u32(record + 12) > get_u32(record + 8)) {
+        return 0;
+    }
+    return length;
+}
+
+GameHandle decode_game_record(const simplechess::GameManager& manager, const uint8_t* record) {
+    uint32_t move_count = get_u32(record + 8);
+    uint32_t anchor_ply = get_u32(record + 12);
+    uint16_t start_fen_length = get_u16(record + 16);
+    uint16_t anchor_fen_length = get_u16(record + 18);
+    uint8_t end = record[20];
+    const uint8_t* moves = record + record_header_size;
+    const char* start_fen = reinterpret_cast<const char*>(moves + 2 * size_t(move_count));
+    const char* anchor_fen = start_fen + start_fen_length;
+
+    auto game = std::make_unique<simplechess::Game>(manager.createGameFromFen(std::string(anchor_fen, anchor_fen_length)));
+    for (uint32_t i = anchor_ply; i < move_count; ++i) {
+        game = std::make_unique<simplechess::Game>(replay_move(manager, *game, get_u16(moves + 2 * size_t(i))));
+    }
+    switch (end) {
+        case END_CLAIM_DRAW:
+            game = std::make_unique<simplechess::Game>(manager.claimDraw(*game));
+            break;
+        case END_WHITE_RESIGNED:
+            game = std::make_unique<simplechess::Game>(manager.resign(*game, simplechess::Color::White));
+            break;
+        case END_BLACK_RESIGNED:
+            game = std::make_unique<simplechess::Game>(manager.resign(*game, simplechess::Color::Black));
+            break;
+        default:
+            break;
+    }
+
+    GameHandle handle(std::move(*game));
+    if (anchor_ply > 0) {
+        auto prefix = std::make_shared<HistoryPrefix>();
+        prefix->start_fen.assign(start_fen, start_fen_length);
+        prefix->moves.resize(anchor_ply);
+        for (uint32_t i = 0; i < anchor_ply; ++i) {
+            prefix->moves[i] = get_u16(moves + 2 * size_t(i));
+        }
+        handle.prefix = std::move(prefix);
+    }
+    return handle;
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path, uint64_t sequence)
+    : mPath(path), mTemporaryPath(path + ".tmp"), mSequence(sequence) {
+    mFd = ::open(mTemporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFd < 0) {
+        throw std::invalid_argument("Cannot create snapshot file");
+    }
+    // Placeholder, the header is written once the contents are known
+    mBuffer.assign(header_size, 0);
+    write_all(mFd, mBuffer.data(), mBuffer.size(), -1);
+    mBuffer.clear();
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (mFd >= 0) {
+        ::close(mFd);
+        ::unlink(mTemporaryPath.c_str());
+    }
+}
+
+void SnapshotWriter::write(const void* data, size_t size) {
+    mCrc = crc32_update(mCrc, data, size);
+    write_all(mFd, data, size, -1);
+}
+
+void SnapshotWriter::add(uint64_t id, const GameHandle& game) {
+    encode_game_record(id, game, mBuffer);
+    mCount++;
+
+    if (mBuffer.size() >= flush_threshold) {
+        write(mBuffer.data(), mBuffer.size());
+        mBuffer.clear();
+    }
+}
+
+void SnapshotWriter::commit() {
+    if (!mBuffer.empty()) {
+        write(mBuffer.data(), mBuffer.size());
+        mBuffer.clear();
+    }
+
+    std::vector<uint8_t> header(snapshot_magic, snapshot_magic + sizeof(snapshot_magic));
+    put_u32(header, snapshot_version);
+    put_u32(header, 0);
+    put_u64(header, mCount);
+    put_u64(header, mSequence);
+    put_u32(header, mCrc);
+    put_u32(header, 0);
+    write_all(mFd, header.data(), header.size(), 0);
+
+    if (::fsync(mFd) != 0) {
+        throw std::runtime_error("Failed to sync snapshot");
+    }
+    ::close(mFd);
+    mFd = -1;
+    if (::rename(mTemporaryPath.c_str(), mPath.c_str()) != 0) {
+        ::unlink(mTemporaryPath.c_str());
+        throw std::runtime_error("Failed to rename snapshot");
+    }
+}
+
+SnapshotFile::SnapshotFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::invalid_argument("Cannot open snapshot file");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(header_size)) {
+        ::close(fd);
+        throw std::invalid_argument("Not a snapshot file");
+    }
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        throw std::invalid_argument("Cannot map snapshot file");
+    }
+    mBase = base;
+    mSize = static_cast<size_t>(st.st_size);
+
+    const uint8_t* data = static_cast<const uint8_t*>(mBase);
+    if (std::memcmp(data, snapshot_magic, sizeof(snapshot_magic)) != 0 || get_u32(data + 8) != snapshot_version) {
+        munmap(mBase, mSize);
+        throw std::invalid_argument("Not a snapshot file");
+    }
+    uint64_t count = get_u64(data + 16);
+    mSequence = get_u64(data + 24);
+    if (crc32_update(0, data + header_size, mSize - header_size) != get_u32(data + 32)) {
+        munmap(mBase, mSize);
+        throw std::invalid_argument("Snapshot checksum mismatch");
+    }
+
+    size_t offset = header_size;
+    while (offset < mSize) {
+        size_t length = game_record_length(data + offset, mSize - offset);
+        if (length == 0) {
+            break;
+        }
+        mRecords.push_back(offset);
+        offset += length;
+    }
+    if (offset != mSize || mRecords.size() != count) {
+        munmap(mBase, mSize);
+        throw std::invalid_argument("Truncated snapshot file");
+    }
+}
+
+SnapshotFile::~SnapshotFile() {
+    munmap(mBase, mSize);
+}
+
+uint64_t SnapshotFile::id_at(size_t index) const {
+    return get_u64(static_cast<const uint8_t*>(mBase) + mRecords.at(index));
+}
+
+GameHandle SnapshotFile::restore(const simplechess::GameManager& manager, size_t index) const {
+    return decode_game_record(manager, static_cast<const uint8_t*>(mBase) + mRecords.at(index));
+}
+
+SimplechessResult restore_snapshot(const SnapshotFile& snapshot, SessionStore& store, size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, std::max<size_t>(snapshot.count(), 1));
+
+    std::atomic<int> error(SIMPLECHESS_SUCCESS);
+    auto restore_range = [&snapshot, &store, threads, &error](size_t first) {
+        try {
+            for (size_t i = first; i < snapshot.count() && error.load() == SIMPLECHESS_SUCCESS; i += threads) {
+                if (!store.insert(snapshot.id_at(i), snapshot.restore(store.manager(), i))) {
+                    error.store(SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+                }
+            }
+        } catch (...) {
+            error.store(handle_exception());
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; ++t) {
+        workers.emplace_back(restore_range, t);
+    }
+    restore_range(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return static_cast<SimplechessResult>(error.load());
+}
+
+}
+
+using namespace simplechess_c;
+
+extern "C" {
+
+SimplechessResult simplechess_snapshot_write_games(const char* path, const SimplechessGame* games, const uint64_t* ids, size_t count) {
+    if (!path || (!games && count > 0)) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (!games[i]) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    try {
+        SnapshotWriter writer(path);
+        for (size_t i = 0; i < count; ++i) {
+            writer.add(ids ? ids[i] : i, *static_cast<GameHandle*>(games[i]));
+        }
+        writer.commit();
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_snapshot_write_store(const char* path, SimplechessSessionStore store) {
+    if (!path || !store) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* s = static_cast<SessionStore*>(store);
+
+        // Collect the games first so no shard stays locked during file I/O
+        std::vector<std::pair<uint64_t, GameHandle>> games;
+        games.reserve(s->count());
+        uint64_t lsn = s->collect(games);
+
+        SnapshotWriter writer(path, lsn);
+        for (const auto& entry : games) {
+            writer.add(entry.first, entry.second);
+        }
+        writer.commit();
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_snapshot_open(const char* path, SimplechessSnapshot* snapshot) {
+    if (!path || !snapshot) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        *snapshot = new SnapshotFile(path);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+void simplechess_snapshot_close(SimplechessSnapshot snapshot) {
+    if (snapshot) {
+        delete static_cast<SnapshotFile*>(snapshot);
+    }
+}
+
+SimplechessResult simplechess_snapshot_get_count(SimplechessSnapshot snapshot, size_t* count) {
+    if (!snapshot || !count) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        *count = static_cast<SnapshotFile*>(snapshot)->count();
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_snapshot_restore_game(SimplechessSnapshot snapshot, SimplechessGameManager manager, size_t index,
+                                                    uint64_t* id, SimplechessGame* game) {
+    if (!snapshot || !manager || !game) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* snap = static_cast<SnapshotFile*>(snapshot);
+        auto* mgr = manager_from_handle(manager);
+        if (index >= snap->count()) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        auto* handle = new GameHandle(snap->restore(mgr->manager, index));
+        handle->set_move_generator(mgr->move_generator);
+        handle->checkpoint_interval = mgr->checkpoint_interval;
+        if (id) {
+            *id = snap->id_at(index);
+        }
+        *game = handle;
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_snapshot_restore_store(SimplechessSnapshot snapshot, SimplechessSessionStore store, size_t threads) {
+    if (!snapshot || !store) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        return restore_snapshot(*static_cast<SnapshotFile*>(snapshot), *static_cast<SessionStore*>(store), threads);
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+}
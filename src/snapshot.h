@@ -0,0 +1,102 @@
+/**
+ * @file snapshot.h
+ * @brief Internal snapshot file format for sets of games
+ *
+ * A snapshot is a header followed by one record per game. All integers are
+ * little-endian.
+ *
+ *   header:  magic "SCSNAP01", u32 version, u32 reserved, u64 record count,
+ *            u64 sequence number, u32 CRC-32 of everything after the
+ *            header, u32 reserved
+ *   record:  u64 id, u32 move count, u32 anchor ply, u16 start FEN length,
+ *            u16 anchor FEN length, u8 end action, 3 bytes padding, the
+ *            moves (u16 each, see history.h), the start FEN, the anchor FEN,
+ *            then padding to a multiple of 8 bytes
+ *
+ * The anchor is the last stage reached by an irreversible move (capture or
+ * pawn move) without a draw offer. Nothing before it can affect the rules
+ * any more, so a game is restored by creating it from the anchor FEN and
+ * replaying only the moves after it; the earlier moves are kept compact and
+ * their stages rebuilt only if they are asked for. The end action records
+ * how a finished game ended when replaying the moves would not end it.
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_SNAPSHOT_H
+#define SIMPLECHESS_SNAPSHOT_H
+
+#include "simplechess_internal.h"
+#include <simplechess/GameManager.h>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace simplechess_c {
+
+class SessionStore;
+
+/* Appends the record of one game to out. */
+void encode_game_record(uint64_t id, const GameHandle& game, std::vector<uint8_t>& out);
+
+/* Length of the record starting at record, or 0 if it does not fit in the
+ * available bytes or is malformed. */
+size_t game_record_length(const uint8_t* record, size_t available);
+
+/* Rebuilds the game of a record checked with game_record_length(). */
+GameHandle decode_game_record(const simplechess::GameManager& manager, const uint8_t* record);
+
+class SnapshotWriter {
+public:
+    /* Writes to a temporary file next to path; commit() moves it in place. */
+    explicit SnapshotWriter(const std::string& path, uint64_t sequence = 0);
+    ~SnapshotWriter();
+
+    void add(uint64_t id, const GameHandle& game);
+
+    /* Finishes the header, syncs the file and renames it to its final path. */
+    void commit();
+
+private:
+    void write(const void* data, size_t size);
+
+    std::string mPath;
+    std::string mTemporaryPath;
+    int mFd;
+    uint64_t mSequence;
+    uint64_t mCount = 0;
+    uint32_t mCrc = 0;
+    std::vector<uint8_t> mBuffer;
+};
+
+class SnapshotFile {
+public:
+    /* Maps the file and checks its header and checksum. Throws
+     * std::invalid_argument if it is not a valid snapshot. */
+    explicit SnapshotFile(const std::string& path);
+    ~SnapshotFile();
+
+    SnapshotFile(const SnapshotFile&) = delete;
+    SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+    size_t count() const { return mRecords.size(); }
+    uint64_t sequence() const { return mSequence; }
+    uint64_t id_at(size_t index) const;
+
+    GameHandle restore(const simplechess::GameManager& manager, size_t index) const;
+
+private:
+    void* mBase = nullptr;
+    size_t mSize = 0;
+    uint64_t mSequence = 0;
+    std::vector<size_t> mRecords;
+};
+
+/* Inserts every game of the snapshot into the store, spreading the games
+ * over threads (0 for one per hardware thread). */
+SimplechessResult restore_snapshot(const SnapshotFile& snapshot, SessionStore& store, size_t threads);
+
+}
+
+#endif /* SIMPLECHESS_SNAPSHOT_H */
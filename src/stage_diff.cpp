@@ -0,0 +1,114 @@
+#include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include "stage_diff.h"
+#include "movegen.h"
+#include "history.h"
+#include <simplechess/Game.h>
+#include <simplechess/GameStage.h>
+#include <algorithm>
+
+namespace simplechess_c {
+
+namespace {
+    SimplechessResult copy_diff(const Position& from, const Position& to, SimplechessSquareChange* changes,
+                                size_t changes_size, size_t* count, SimplechessStageDiff* diff) {
+        SimplechessSquareChange all[64];
+        SimplechessStageDiff fields;
+        size_t n = diff_positions(from, to, all, fields);
+        *count = n;
+        if (n > changes_size) {
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+        }
+        std::copy(all, all + n, changes);
+        if (diff) {
+            *diff = fields;
+        }
+        return SIMPLECHESS_SUCCESS;
+    }
+}
+
+size_t diff_positions(const Position& from, const Position& to, SimplechessSquareChange* changes,
+                      SimplechessStageDiff& diff) {
+    size_t count = 0;
+    for (int sq = 0; sq < 64; ++sq) {
+        uint8_t code = to.board[sq];
+        if (code == from.board[sq]) {
+            continue;
+        }
+        SimplechessSquareChange& change = changes[count++];
+        change.square = index_to_c_square(sq);
+        change.occupied = code != 0;
+        change.piece.type = code ? kind_to_c_piece_type(piece_code_kind(code)) : SIMPLECHESS_PIECE_TYPE_PAWN;
+        change.piece.color = code && piece_code_color(code) == BLACK ? SIMPLECHESS_COLOR_BLACK : SIMPLECHESS_COLOR_WHITE;
+    }
+
+    diff.changed = 0;
+    if (from.side != to.side) {
+        diff.changed |= SIMPLECHESS_STAGE_DIFF_ACTIVE_COLOR;
+    }
+    if (from.castling != to.castling) {
+        diff.changed |= SIMPLECHESS_STAGE_DIFF_CASTLING;
+    }
+    if (from.en_passant != to.en_passant) {
+        diff.changed |= SIMPLECHESS_STAGE_DIFF_EN_PASSANT;
+    }
+    if (from.halfmove_clock != to.halfmove_clock) {
+        diff.changed |= SIMPLECHESS_STAGE_DIFF_HALFMOVE_CLOCK;
+    }
+    if (from.fullmove_counter != to.fullmove_counter) {
+        diff.changed |= SIMPLECHESS_STAGE_DIFF_FULLMOVE_COUNTER;
+    }
+    diff.active_color = to.side == BLACK ? SIMPLECHESS_COLOR_BLACK : SIMPLECHESS_COLOR_WHITE;
+    diff.castling_rights = to.castling;
+    diff.has_en_passant = to.en_passant >= 0;
+    diff.en_passant = index_to_c_square(to.en_passant >= 0 ? to.en_passant : 0);
+    diff.halfmove_clock = to.halfmove_clock;
+    diff.fullmove_counter = to.fullmove_counter;
+    return count;
+}
+
+}
+
+using namespace simplechess_c;
+
+extern "C" {
+
+SimplechessResult simplechess_stage_diff(SimplechessGameStage from, SimplechessGameStage to,
+                                         SimplechessSquareChange* changes, size_t changes_size, size_t* count,
+                                         SimplechessStageDiff* diff) {
+    if (!from || !to || !count || (!changes && changes_size)) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        Position before, after;
+        position_from_stage(*static_cast<simplechess::GameStage*>(from), before);
+        position_from_stage(*static_cast<simplechess::GameStage*>(to), after);
+        return copy_diff(before, after, changes, changes_size, count, diff);
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_game_get_last_move_diff(SimplechessGame game, SimplechessSquareChange* changes,
+                                                      size_t changes_size, size_t* count, SimplechessStageDiff* diff) {
+    if (!game || !count || (!changes && changes_size)) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        const auto* handle = static_cast<GameHandle*>(game);
+        size_t length = history_length(*handle);
+        if (length < 2) {
+            return SIMPLECHESS_ERROR_ILLEGAL_STATE;
+        }
+        Position before, after;
+        position_from_stage(stage_at(*handle, length - 2), before);
+        position_from_stage(handle->game->currentStage(), after);
+        return copy_diff(before, after, changes, changes_size, count, diff);
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+}
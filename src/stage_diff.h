@@ -0,0 +1,24 @@
+/**
+ * @file stage_diff.h
+ * @brief Internal differences between two positions
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_STAGE_DIFF_H
+#define SIMPLECHESS_STAGE_DIFF_H
+
+#include "simplechess/simplechess.h"
+#include "position.h"
+
+namespace simplechess_c {
+
+/* Writes the squares that differ between from and to, ordered by square
+ * index, into changes (which must hold 64 entries) and the other fields of
+ * to into diff. Returns the number of changed squares. */
+size_t diff_positions(const Position& from, const Position& to, SimplechessSquareChange* changes,
+                      SimplechessStageDiff& diff);
+
+}
+
+#endif /* SIMPLECHESS_STAGE_DIFF_H */
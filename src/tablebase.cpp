@@ -0,0 +1,1249 @@
+/*
+ * Syzygy tablebase probing.
+ *
+ * The table decoding and the probing search are adapted from Fathom
+ * (https://github.com/jdart1/Fathom), which builds on Ronald de Man's
+ * original probing code and is distributed under the MIT license below.
+ * Tables are discovered by scanning the configured directories for *.rtbw
+ * files, each file is memory-mapped the first time a position needs it, and
+ * probes decompress a single value out of the mapped block.
+ *
+ * Copyright (c) 2013-2018 Ronald de Man
+ * Copyright (c) 2015 basil00
+ * Modifications Copyright (c) 2016-2020 by Jon Dart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include "clock.h"
+#include "position.h"
+#include <simplechess/Game.h>
+#include <simplechess/GameStage.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace simplechess_c;
+
+namespace {
+
+constexpr int TB_PIECES = 7;
+
+enum WdlScore {
+    WDL_LOSS = -2,
+    WDL_BLESSED_LOSS = -1,
+    WDL_DRAW = 0,
+    WDL_CURSED_WIN = 1,
+    WDL_WIN = 2
+};
+
+// Outcome of a probe besides its value: the table could not be read, the
+// DTZ table only stores the other side to move, or the best move is a
+// capture or pawn move and the table was not needed
+enum ProbeState {
+    PROBE_FAIL = 0,
+    PROBE_OK = 1,
+    PROBE_CHANGE_STM = -1,
+    PROBE_ZEROING_BEST_MOVE = 2
+};
+
+enum TableType { TABLE_WDL = 0, TABLE_DTZ = 1 };
+
+// Pawnless tables encode the pieces relative to the a1-d1-d4 triangle, pawn
+// tables are split by the file of the leading pawn
+enum Encoding { PIECE_ENC, FILE_ENC };
+
+enum DtzFlag {
+    DTZ_FLAG_STM = 1,
+    DTZ_FLAG_MAPPED = 2,
+    DTZ_FLAG_WIN_PLIES = 4,
+    DTZ_FLAG_LOSS_PLIES = 8,
+    DTZ_FLAG_WIDE = 16
+};
+
+// Indexed by WDL + 2
+const int wdl_to_map[5] = {1, 3, 0, 2, 0};
+const uint8_t plies_flags[5] = {DTZ_FLAG_LOSS_PLIES, 0, 0, 0, DTZ_FLAG_WIN_PLIES};
+const int wdl_to_dtz[5] = {-1, -101, 0, 101, 1};
+
+// Multi-byte values in the files have a fixed byte order
+uint16_t read_le_u16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t read_le_u32(const uint8_t* p) {
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+uint32_t read_be_u32(const uint8_t* p) {
+    return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+}
+
+uint64_t read_be_u64(const uint8_t* p) {
+    return uint64_t(read_be_u32(p)) << 32 | read_be_u32(p + 4);
+}
+
+// Square and index maps of the encoding, computed once
+struct Indices {
+    int8_t off_diag[64];     // Sign of rank - file
+    uint8_t triangle[64];    // a1-d1-d4 triangle to 0..9, diagonal last
+    uint8_t lower[64];       // Below the a1-h8 diagonal to 0..27
+    uint8_t diag[64];        // On the a1-h8 diagonal to 0..7
+    uint8_t flap[64];        // Pawn square to file * 6 + rank, files mirrored to a-d
+    uint8_t pawn_twist[64];  // Pawn square to 0..47, edge files and low ranks highest
+    int16_t kk_idx[10][64];  // The 462 legal king pairs, first king in the triangle
+    uint64_t binomial[7][64];
+    uint64_t pawn_idx[6][24];
+    uint64_t pawn_factor_file[6][4];
+
+    Indices();
+};
+
+int flip_diag(int sq) {
+    return (sq >> 3) | ((sq & 7) << 3);
+}
+
+Indices::Indices() {
+    std::memset(this, 0, sizeof(*this));
+
+    int lower_code = 0;
+    for (int sq = 0; sq < 64; ++sq) {
+        int offset = square_rank(sq) - square_file(sq);
+        off_diag[sq] = static_cast<int8_t>((offset > 0) - (offset < 0));
+        if (offset < 0) {
+            lower[sq] = static_cast<uint8_t>(lower_code++);
+        } else if (offset == 0) {
+            diag[sq] = static_cast<uint8_t>(square_rank(sq));
+        }
+    }
+
+    int triangle_code = 0;
+    for (int sq = 0; sq < 64; ++sq) {
+        if (square_file(sq) <= 3 && off_diag[sq] < 0) {
+            triangle[sq] = static_cast<uint8_t>(triangle_code++);
+        }
+    }
+    for (int sq = 0; sq < 64; sq += 9) {
+        if (square_file(sq) <= 3) {
+            triangle[sq] = static_cast<uint8_t>(triangle_code++);
+        }
+    }
+
+    // Pairs with both kings on the diagonal come after all the others, and
+    // a first king on the diagonal never has the second above it
+    std::memset(kk_idx, 0xFF, sizeof(kk_idx));
+    std::vector<std::pair<int, int>> both_on_diagonal;
+    int code = 0;
+    for (int idx = 0; idx < 10; ++idx) {
+        int s1 = 0;
+        while (square_file(s1) > 3 || off_diag[s1] > 0 || triangle[s1] != idx) {
+            ++s1;
+        }
+        for (int s2 = 0; s2 < 64; ++s2) {
+            if ((king_attacks(s1) | square_bb(s1)) & square_bb(s2)) {
+                continue;
+            }
+            if (!off_diag[s1] && off_diag[s2] > 0) {
+                continue;
+            }
+            if (!off_diag[s1] && !off_diag[s2]) {
+                both_on_diagonal.emplace_back(idx, s2);
+            } else {
+                kk_idx[idx][s2] = static_cast<int16_t>(code++);
+            }
+        }
+    }
+    for (const auto& pair : both_on_diagonal) {
+        kk_idx[pair.first][pair.second] = static_cast<int16_t>(code++);
+    }
+
+    int twist = 47;
+    for (int file = 0; file <= 3; ++file) {
+        for (int rank = 1; rank <= 6; ++rank) {
+            int sq = rank * 8 + file;
+            flap[sq] = flap[sq ^ 7] = static_cast<uint8_t>(file * 6 + rank - 1);
+            pawn_twist[sq] = static_cast<uint8_t>(twist--);
+            pawn_twist[sq ^ 7] = static_cast<uint8_t>(twist--);
+        }
+    }
+
+    // binomial[k][n] is the number of ways to choose k squares out of n
+    for (int k = 0; k < 7; ++k) {
+        for (int n = 0; n < 64; ++n) {
+            uint64_t f = 1, l = 1;
+            for (int i = 0; i < k; ++i) {
+                f *= uint64_t(n - i);
+                l *= uint64_t(i + 1);
+            }
+            binomial[k][n] = f / l;
+        }
+    }
+
+    // Leading pawns: j runs over the files a-d, then the ranks 2-7
+    for (int k = 0; k < 6; ++k) {
+        uint64_t s = 0;
+        for (int j = 0; j < 24; ++j) {
+            pawn_idx[k][j] = s;
+            s += binomial[k][pawn_twist[(1 + j % 6) * 8 + j / 6]];
+            if ((j + 1) % 6 == 0) {
+                pawn_factor_file[k][j / 6] = s;
+                s = 0;
+            }
+        }
+    }
+}
+
+const Indices& indices() {
+    static const Indices instance;
+    return instance;
+}
+
+// Material signature: one 4-bit count per (color, kind)
+typedef uint64_t MaterialKey;
+
+MaterialKey material_key(const int counts[2][KIND_COUNT], bool swap_colors) {
+    MaterialKey key = 0;
+    for (int color = 0; color < 2; ++color) {
+        for (int kind = 0; kind < KIND_COUNT; ++kind) {
+            int slot = (swap_colors ? color ^ 1 : color) * KIND_COUNT + kind;
+            key |= MaterialKey(counts[color][kind]) << (4 * slot);
+        }
+    }
+    return key;
+}
+
+MaterialKey material_key(const Position& pos) {
+    int counts[2][KIND_COUNT];
+    for (int color = 0; color < 2; ++color) {
+        for (int kind = 0; kind < KIND_COUNT; ++kind) {
+            counts[color][kind] = popcount(pos.pieces(color, kind));
+        }
+    }
+    return material_key(counts, false);
+}
+
+// One compressed subtable: canonical Huffman codes for symbols that expand
+// to runs of values through a pairing tree
+struct PairsData {
+    const uint8_t* index_table = nullptr; // 6-byte entries: block, offset
+    const uint8_t* size_table = nullptr;  // Length of each block, 16-bit
+    const uint8_t* data = nullptr;
+    const uint8_t* offset = nullptr;      // Lowest symbol of each code length, 16-bit
+    const uint8_t* sym_pat = nullptr;     // Symbol pairs, two 12-bit values each
+    uint8_t block_size = 0;               // log2 of the block size in bytes
+    uint8_t idx_bits = 0;                 // log2 of the index span, 0 for a single value
+    uint8_t min_len = 0;
+    uint8_t const_value[2] = {};
+    std::vector<uint64_t> base;
+    std::vector<uint8_t> sym_len;
+};
+
+struct EncInfo {
+    PairsData precomp;
+    uint64_t factor[TB_PIECES] = {};
+    uint8_t pieces[TB_PIECES] = {};
+    uint8_t norm[TB_PIECES] = {}; // Size of the group starting at each piece
+};
+
+struct TableFile {
+    std::string path;
+    std::once_flag once;
+    bool ready = false;
+    void* base_address = nullptr;
+    size_t mapping = 0;
+};
+
+// The WDL and DTZ tables of one material signature
+struct TableEntry {
+    MaterialKey key = 0;
+    MaterialKey key2 = 0; // Colors swapped
+    int num = 0;
+    bool symmetric = false;
+    bool has_pawns = false;
+    bool kk_enc = false;    // Pawnless with no unique piece besides the kings
+    uint8_t pawns[2] = {};  // Leading color, other color
+    TableFile files[2];
+    bool wdl_split = false; // WDL table stores both sides to move
+    EncInfo wdl[8];         // Side to move * 4 + leading pawn file
+    EncInfo dtz[4];         // Leading pawn file
+    const uint8_t* dtz_map = nullptr;
+    uint16_t dtz_map_idx[4][4] = {};
+    uint8_t dtz_flags[4] = {};
+
+    ~TableEntry() {
+        for (TableFile& file : files) {
+            if (file.base_address) {
+                munmap(file.base_address, file.mapping);
+            }
+        }
+    }
+};
+
+// Reading the table headers
+
+uint64_t init_enc_info(EncInfo& ei, const TableEntry& entry, const uint8_t* tb, int shift, int t, Encoding enc) {
+    const Indices& ix = indices();
+    bool more_pawns = enc != PIECE_ENC && entry.pawns[1] > 0;
+
+    for (int i = 0; i < entry.num; ++i) {
+        ei.pieces[i] = static_cast<uint8_t>((tb[i + 1 + more_pawns] >> shift) & 0x0F);
+        ei.norm[i] = 0;
+    }
+
+    int order = (tb[0] >> shift) & 0x0F;
+    int order2 = more_pawns ? (tb[1] >> shift) & 0x0F : 0x0F;
+
+    int k = ei.norm[0] = static_cast<uint8_t>(enc != PIECE_ENC ? entry.pawns[0] : entry.kk_enc ? 2 : 3);
+    if (more_pawns) {
+        ei.norm[k] = entry.pawns[1];
+        k += ei.norm[k];
+    }
+    for (int i = k; i < entry.num; i += ei.norm[i]) {
+        for (int j = i; j < entry.num && ei.pieces[j] == ei.pieces[i]; ++j) {
+            ei.norm[i]++;
+        }
+    }
+
+    // Groups are multiplied in a per-table order: the leading group sits at
+    // order and the remaining pawns at order2
+    int n = 64 - k;
+    uint64_t f = 1;
+    for (int i = 0; k < entry.num || i == order || i == order2; ++i) {
+        if (i == order) {
+            ei.factor[0] = f;
+            f *= enc == FILE_ENC ? ix.pawn_factor_file[ei.norm[0] - 1][t] : entry.kk_enc ? 462 : 31332;
+        } else if (i == order2) {
+            ei.factor[ei.norm[0]] = f;
+            f *= ix.binomial[ei.norm[ei.norm[0]]][48 - ei.norm[0]];
+        } else {
+            ei.factor[k] = f;
+            f *= ix.binomial[ei.norm[k]][n];
+            n -= ei.norm[k];
+            k += ei.norm[k];
+        }
+    }
+    return f;
+}
+
+void calc_sym_len(PairsData& d, uint32_t s, std::vector<bool>& done) {
+    const uint8_t* w = d.sym_pat + 3 * s;
+    uint32_t s2 = (w[2] << 4) | (w[1] >> 4);
+    if (s2 == 0x0FFF) {
+        d.sym_len[s] = 0;
+    } else {
+        uint32_t s1 = ((w[1] & 0x0F) << 8) | w[0];
+        if (!done[s1]) {
+            calc_sym_len(d, s1, done);
+        }
+        if (!done[s2]) {
+            calc_sym_len(d, s2, done);
+        }
+        d.sym_len[s] = static_cast<uint8_t>(d.sym_len[s1] + d.sym_len[s2] + 1);
+    }
+    done[s] = true;
+}
+
+// Reads the header of a subtable with tb_size positions. sizes receives the
+// sizes of its index table, block length table and data, which come later
+// in the file.
+const uint8_t* setup_pairs(PairsData& d, const uint8_t* data, uint64_t tb_size, size_t sizes[3], uint8_t* flags,
+                           TableType type) {
+    *flags = data[0];
+    if (data[0] & 0x80) {
+        d.idx_bits = 0;
+        d.const_value[0] = type == TABLE_WDL ? data[1] : 0;
+        d.const_value[1] = 0;
+        sizes[0] = sizes[1] = sizes[2] = 0;
+        return data + 2;
+    }
+
+    d.block_size = data[1];
+    d.idx_bits = data[2];
+    uint32_t real_num_blocks = read_le_u32(data + 4);
+    uint32_t num_blocks = real_num_blocks + data[3];
+    int max_len = data[8];
+    d.min_len = data[9];
+    int h = max_len - d.min_len + 1;
+    uint32_t num_syms = read_le_u16(data + 10 + 2 * h);
+    d.offset = data + 10;
+    d.sym_pat = data + 12 + 2 * h;
+
+    uint64_t num_indices = (tb_size + (uint64_t(1) << d.idx_bits) - 1) >> d.idx_bits;
+    sizes[0] = size_t(6 * num_indices);
+    sizes[1] = 2 * size_t(num_blocks);
+    sizes[2] = size_t(real_num_blocks) << d.block_size;
+
+    d.sym_len.assign(num_syms, 0);
+    std::vector<bool> done(num_syms);
+    for (uint32_t s = 0; s < num_syms; ++s) {
+        if (!done[s]) {
+            calc_sym_len(d, s, done);
+        }
+    }
+
+    // Canonical Huffman code: base[i] is the lowest 64-bit left-aligned code
+    // of length min_len + i
+    d.base.assign(h, 0);
+    for (int i = h - 2; i >= 0; --i) {
+        d.base[i] = (d.base[i + 1] + read_le_u16(d.offset + 2 * i) - read_le_u16(d.offset + 2 * (i + 1))) / 2;
+    }
+    for (int i = 0; i < h; ++i) {
+        d.base[i] <<= 64 - (d.min_len + i);
+    }
+
+    return data + 12 + 2 * h + 3 * num_syms + (num_syms & 1);
+}
+
+void read_table(TableEntry& entry, TableType type, const uint8_t* data) {
+    const bool split = type == TABLE_WDL && (data[0] & 0x01);
+    const int num = entry.has_pawns ? 4 : 1;
+    const Encoding enc = entry.has_pawns ? FILE_ENC : PIECE_ENC;
+    EncInfo* ei = type == TABLE_WDL ? entry.wdl : entry.dtz;
+    data++;
+
+    uint64_t tb_size[4][2] = {};
+    for (int t = 0; t < num; ++t) {
+        tb_size[t][0] = init_enc_info(ei[t], entry, data, 0, t, enc);
+        if (split) {
+            tb_size[t][1] = init_enc_info(ei[num + t], entry, data, 4, t, enc);
+        }
+        data += entry.num + 1 + (entry.has_pawns && entry.pawns[1]);
+    }
+    data += reinterpret_cast<uintptr_t>(data) & 1;
+
+    size_t sizes[4][2][3] = {};
+    for (int t = 0; t < num; ++t) {
+        uint8_t flags;
+        data = setup_pairs(ei[t].precomp, data, tb_size[t][0], sizes[t][0], &flags, type);
+        if (type == TABLE_DTZ) {
+            entry.dtz_flags[t] = flags;
+        }
+        if (split) {
+            data = setup_pairs(ei[num + t].precomp, data, tb_size[t][1], sizes[t][1], &flags, type);
+        }
+    }
+
+    // DTZ values may be stored through a per-outcome map
+    if (type == TABLE_DTZ) {
+        entry.dtz_map = data;
+        for (int t = 0; t < num; ++t) {
+            if (!(entry.dtz_flags[t] & DTZ_FLAG_MAPPED)) {
+                continue;
+            }
+            if (!(entry.dtz_flags[t] & DTZ_FLAG_WIDE)) {
+                for (int i = 0; i < 4; ++i) {
+                    entry.dtz_map_idx[t][i] = static_cast<uint16_t>(data + 1 - entry.dtz_map);
+                    data += 1 + data[0];
+                }
+            } else {
+                data += reinterpret_cast<uintptr_t>(data) & 1;
+                for (int i = 0; i < 4; ++i) {
+                    entry.dtz_map_idx[t][i] = static_cast<uint16_t>((data - entry.dtz_map) / 2 + 1);
+                    data += 2 + 2 * read_le_u16(data);
+                }
+            }
+        }
+        data += reinterpret_cast<uintptr_t>(data) & 1;
+    }
+
+    for (int t = 0; t < num; ++t) {
+        ei[t].precomp.index_table = data;
+        data += sizes[t][0][0];
+        if (split) {
+            ei[num + t].precomp.index_table = data;
+            data += sizes[t][1][0];
+        }
+    }
+    for (int t = 0; t < num; ++t) {
+        ei[t].precomp.size_table = data;
+        data += sizes[t][0][1];
+        if (split) {
+            ei[num + t].precomp.size_table = data;
+            data += sizes[t][1][1];
+        }
+    }
+    for (int t = 0; t < num; ++t) {
+        for (int side = 0; side <= int(split); ++side) {
+            data = reinterpret_cast<const uint8_t*>((reinterpret_cast<uintptr_t>(data) + 0x3F) & ~uintptr_t(0x3F));
+            ei[side * num + t].precomp.data = data;
+            data += sizes[t][side][2];
+        }
+    }
+
+    if (type == TABLE_WDL) {
+        entry.wdl_split = split;
+    }
+}
+
+// Maps the file and parses its header the first time the table is needed.
+// Returns false if the file is missing or is not a valid table.
+bool ensure_mapped(TableEntry& entry, TableType type) {
+    TableFile& file = entry.files[type];
+    std::call_once(file.once, [&entry, &file, type]() {
+        int fd = ::open(file.path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size % 64 != 16) {
+            ::close(fd);
+            return;
+        }
+        void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            return;
+        }
+        madvise(base, st.st_size, MADV_RANDOM);
+        file.base_address = base;
+        file.mapping = st.st_size;
+
+        static const uint32_t magic[2] = {0x5D23E871, 0xA50C66D7};
+        const uint8_t* data = static_cast<const uint8_t*>(base);
+        if (read_le_u32(data) != magic[type]) {
+            return;
+        }
+        read_table(entry, type, data + 4);
+        file.ready = true;
+    });
+    return file.ready;
+}
+
+// Probing
+
+// Returns the 3-byte symbol holding the value at idx
+const uint8_t* decompress_pairs(const PairsData& d, uint64_t idx) {
+    if (!d.idx_bits) {
+        return d.const_value;
+    }
+
+    uint64_t main_idx = idx >> d.idx_bits;
+    int lit_idx = static_cast<int>(idx & ((uint64_t(1) << d.idx_bits) - 1)) - (1 << (d.idx_bits - 1));
+    uint32_t block = read_le_u32(d.index_table + 6 * main_idx);
+    lit_idx += read_le_u16(d.index_table + 6 * main_idx + 4);
+
+    if (lit_idx < 0) {
+        while (lit_idx < 0) {
+            lit_idx += read_le_u16(d.size_table + 2 * size_t(--block)) + 1;
+        }
+    } else {
+        while (lit_idx > read_le_u16(d.size_table + 2 * size_t(block))) {
+            lit_idx -= read_le_u16(d.size_table + 2 * size_t(block++)) + 1;
+        }
+    }
+
+    const uint8_t* ptr = d.data + (uint64_t(block) << d.block_size);
+    uint64_t code = read_be_u64(ptr);
+    ptr += 8;
+    int empty_bits = 0;
+    uint32_t sym;
+
+    while (true) {
+        int len = 0;
+        while (code < d.base[len]) {
+            ++len;
+        }
+        int bits = d.min_len + len;
+        sym = read_le_u16(d.offset + 2 * len) + static_cast<uint32_t>((code - d.base[len]) >> (64 - bits));
+        if (lit_idx < d.sym_len[sym] + 1) {
+            break;
+        }
+        lit_idx -= d.sym_len[sym] + 1;
+        code <<= bits;
+        empty_bits += bits;
+        if (empty_bits >= 32) {
+            empty_bits -= 32;
+            code |= uint64_t(read_be_u32(ptr)) << empty_bits;
+            ptr += 4;
+        }
+    }
+
+    while (d.sym_len[sym]) {
+        const uint8_t* w = d.sym_pat + 3 * sym;
+        uint32_t left = ((w[1] & 0x0F) << 8) | w[0];
+        if (lit_idx < d.sym_len[left] + 1) {
+            sym = left;
+        } else {
+            lit_idx -= d.sym_len[left] + 1;
+            sym = (w[2] << 4) | (w[1] >> 4);
+        }
+    }
+    return d.sym_pat + 3 * sym;
+}
+
+// Puts the squares of every piece of the kind at pieces[i] into p, starting
+// at p[i]; returns the index after them
+int fill_squares(const Position& pos, const uint8_t* pieces, bool flip, int mirror, int* p, int i) {
+    int color = piece_code_color(pieces[i]) ^ int(flip);
+    Bitboard b = pos.pieces(color, piece_code_kind(pieces[i]));
+    do {
+        p[i++] = pop_lsb(b) ^ mirror;
+    } while (b);
+    return i;
+}
+
+// Moves the leading pawn (nearest the edge, then lowest rank) to p[0] and
+// returns its file mirrored to a-d
+int leading_pawn(int* p, const TableEntry& entry) {
+    const Indices& ix = indices();
+    for (int i = 1; i < entry.pawns[0]; ++i) {
+        if (ix.flap[p[0]] > ix.flap[p[i]]) {
+            std::swap(p[0], p[i]);
+        }
+    }
+    return std::min(square_file(p[0]), 7 - square_file(p[0]));
+}
+
+uint64_t encode(int* p, const EncInfo& ei, const TableEntry& entry, Encoding enc) {
+    const Indices& ix = indices();
+    const int n = entry.num;
+    uint64_t idx;
+    int k;
+
+    if (p[0] & 0x04) {
+        for (int i = 0; i < n; ++i) {
+            p[i] ^= 0x07;
+        }
+    }
+
+    if (enc == PIECE_ENC) {
+        if (p[0] & 0x20) {
+            for (int i = 0; i < n; ++i) {
+                p[i] ^= 0x38;
+            }
+        }
+
+        // Mirror along a1-h8 so that the first off-diagonal piece of the
+        // leading group is below it
+        for (int i = 0; i < n; ++i) {
+            if (ix.off_diag[p[i]]) {
+                if (ix.off_diag[p[i]] > 0 && i < (entry.kk_enc ? 2 : 3)) {
+                    for (int j = 0; j < n; ++j) {
+                        p[j] = flip_diag(p[j]);
+                    }
+                }
+                break;
+            }
+        }
+
+        if (entry.kk_enc) {
+            idx = uint64_t(ix.kk_idx[ix.triangle[p[0]]][p[1]]);
+            k = 2;
+        } else {
+            int s1 = p[1] > p[0];
+            int s2 = (p[2] > p[0]) + (p[2] > p[1]);
+
+            if (ix.off_diag[p[0]]) {
+                idx = uint64_t(ix.triangle[p[0]]) * 63 * 62 + (p[1] - s1) * 62 + (p[2] - s2);
+            } else if (ix.off_diag[p[1]]) {
+                idx = 6 * 63 * 62 + uint64_t(ix.diag[p[0]]) * 28 * 62 + ix.lower[p[1]] * 62 + p[2] - s2;
+            } else if (ix.off_diag[p[2]]) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + uint64_t(ix.diag[p[0]]) * 7 * 28 + (ix.diag[p[1]] - s1) * 28
+                    + ix.lower[p[2]];
+            } else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + uint64_t(ix.diag[p[0]]) * 7 * 6
+                    + (ix.diag[p[1]] - s1) * 6 + (ix.diag[p[2]] - s2);
+            }
+            k = 3;
+        }
+        idx *= ei.factor[0];
+    } else {
+        for (int i = 1; i < entry.pawns[0]; ++i) {
+            for (int j = i + 1; j < entry.pawns[0]; ++j) {
+                if (ix.pawn_twist[p[i]] < ix.pawn_twist[p[j]]) {
+                    std::swap(p[i], p[j]);
+                }
+            }
+        }
+
+        k = entry.pawns[0];
+        idx = ix.pawn_idx[k - 1][ix.flap[p[0]]];
+        for (int i = 1; i < k; ++i) {
+            idx += ix.binomial[k - i][ix.pawn_twist[p[i]]];
+        }
+        idx *= ei.factor[0];
+
+        // Pawns of the other color, on the 48 pawn squares
+        if (entry.pawns[1]) {
+            int t = k + entry.pawns[1];
+            std::sort(p + k, p + t);
+            uint64_t s = 0;
+            for (int i = k; i < t; ++i) {
+                int sq = p[i];
+                int skips = 0;
+                for (int j = 0; j < k; ++j) {
+                    skips += sq > p[j];
+                }
+                s += ix.binomial[i - k + 1][sq - skips - 8];
+            }
+            idx += s * ei.factor[k];
+            k = t;
+        }
+    }
+
+    // Remaining groups: squares in ascending order, skipping those taken by
+    // earlier groups
+    while (k < n) {
+        int t = k + ei.norm[k];
+        std::sort(p + k, p + t);
+        uint64_t s = 0;
+        for (int i = k; i < t; ++i) {
+            int sq = p[i];
+            int skips = 0;
+            for (int j = 0; j < k; ++j) {
+                skips += sq > p[j];
+            }
+            s += ix.binomial[i - k + 1][sq - skips];
+        }
+        idx += s * ei.factor[k];
+        k = t;
+    }
+    return idx;
+}
+
+class Tablebase {
+public:
+    explicit Tablebase(const std::string& paths);
+
+    int max_pieces() const { return mMaxPieces; }
+
+    int probe_wdl(const Position& pos, ProbeState* result);
+    int probe_dtz(const Position& pos, ProbeState* result);
+
+private:
+    void add(const std::string& directory, const std::string& name);
+    int probe_table(const Position& pos, int wdl, ProbeState* result, TableType type);
+    int probe_ab(const Position& pos, int alpha, int beta, ProbeState* result);
+
+    std::vector<std::unique_ptr<TableEntry>> mEntries;
+    std::unordered_map<MaterialKey, TableEntry*> mByKey;
+    int mMaxPieces = 0;
+};
+
+int kind_from_char(char c) {
+    switch (c) {
+        case 'P': return KIND_PAWN;
+        case 'N': return KIND_KNIGHT;
+        case 'B': return KIND_BISHOP;
+        case 'R': return KIND_ROOK;
+        case 'Q': return KIND_QUEEN;
+        case 'K': return KIND_KING;
+        default: return -1;
+    }
+}
+
+Tablebase::Tablebase(const std::string& paths) {
+    size_t start = 0;
+    while (start <= paths.size()) {
+        size_t end = paths.find(':', start);
+        if (end == std::string::npos) {
+            end = paths.size();
+        }
+        std::string directory = paths.substr(start, end - start);
+        start = end + 1;
+        if (directory.empty()) {
+            continue;
+        }
+
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) {
+            continue;
+        }
+        while (struct dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() > 5 && name.compare(name.size() - 5, 5, ".rtbw") == 0) {
+                add(directory, name.substr(0, name.size() - 5));
+            }
+        }
+        closedir(dir);
+    }
+}
+
+// Registers the WDL and DTZ tables for a material signature like "KRPvKR"
+void Tablebase::add(const std::string& directory, const std::string& name) {
+    size_t separator = name.find('v');
+    if (separator == std::string::npos) {
+        return;
+    }
+
+    int counts[2][KIND_COUNT] = {};
+    int piece_count = 0;
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (i == separator) {
+            continue;
+        }
+        int kind = kind_from_char(name[i]);
+        if (kind < 0) {
+            return;
+        }
+        counts[i < separator ? WHITE : BLACK][kind]++;
+        piece_count++;
+    }
+    if (counts[WHITE][KIND_KING] != 1 || counts[BLACK][KIND_KING] != 1 || piece_count > TB_PIECES) {
+        return;
+    }
+
+    MaterialKey key = material_key(counts, false);
+    if (mByKey.count(key)) {
+        return; // Already found in an earlier directory
+    }
+
+    auto entry = std::make_unique<TableEntry>();
+    entry->key = key;
+    entry->key2 = material_key(counts, true);
+    entry->num = piece_count;
+    entry->symmetric = entry->key == entry->key2;
+    entry->has_pawns = counts[WHITE][KIND_PAWN] || counts[BLACK][KIND_PAWN];
+    entry->files[TABLE_WDL].path = directory + "/" + name + ".rtbw";
+    entry->files[TABLE_DTZ].path = directory + "/" + name + ".rtbz";
+
+    if (entry->has_pawns) {
+        // The leading color is the one with fewer (but at least one) pawns
+        bool lead_white = counts[WHITE][KIND_PAWN]
+            && (!counts[BLACK][KIND_PAWN] || counts[BLACK][KIND_PAWN] >= counts[WHITE][KIND_PAWN]);
+        entry->pawns[0] = static_cast<uint8_t>(counts[lead_white ? WHITE : BLACK][KIND_PAWN]);
+        entry->pawns[1] = static_cast<uint8_t>(counts[lead_white ? BLACK : WHITE][KIND_PAWN]);
+    } else {
+        int unique = 0;
+        for (int color = 0; color < 2; ++color) {
+            for (int kind = 0; kind < KIND_COUNT; ++kind) {
+                unique += counts[color][kind] == 1;
+            }
+        }
+        entry->kk_enc = unique == 2;
+    }
+
+    mByKey[entry->key] = entry.get();
+    mByKey[entry->key2] = entry.get();
+    mEntries.push_back(std::move(entry));
+    mMaxPieces = std::max(mMaxPieces, piece_count);
+}
+
+// Looks the position up in its WDL or DTZ table. For DTZ, wdl is the known
+// outcome of the position, which selects the value map.
+int Tablebase::probe_table(const Position& pos, int wdl, ProbeState* result, TableType type) {
+    if (type == TABLE_WDL && popcount(pos.occupied()) == 2) {
+        return WDL_DRAW; // KvK
+    }
+
+    MaterialKey key = material_key(pos);
+    auto it = mByKey.find(key);
+    if (it == mByKey.end() || !ensure_mapped(*it->second, type)) {
+        *result = PROBE_FAIL;
+        return 0;
+    }
+    const TableEntry& entry = *it->second;
+
+    // Tables are built with white as the stronger side, and symmetric
+    // tables store white to move only: flip colors when needed
+    bool flip, black_side;
+    if (!entry.symmetric) {
+        flip = key != entry.key;
+        black_side = (pos.side == WHITE) == flip;
+    } else {
+        flip = pos.side != WHITE;
+        black_side = false;
+    }
+
+    const EncInfo* ei = type == TABLE_WDL ? entry.wdl : entry.dtz;
+    int p[TB_PIECES];
+    uint64_t idx;
+    int t = 0;
+    uint8_t flags = 0;
+
+    if (!entry.has_pawns) {
+        if (type == TABLE_DTZ) {
+            flags = entry.dtz_flags[0];
+            if ((flags & DTZ_FLAG_STM) != black_side && !entry.symmetric) {
+                *result = PROBE_CHANGE_STM;
+                return 0;
+            }
+        } else if (entry.wdl_split) {
+            ei += black_side;
+        }
+        for (int i = 0; i < entry.num;) {
+            i = fill_squares(pos, ei->pieces, flip, 0, p, i);
+        }
+        idx = encode(p, *ei, entry, PIECE_ENC);
+    } else {
+        int i = fill_squares(pos, ei->pieces, flip, flip ? 0x38 : 0, p, 0);
+        t = leading_pawn(p, entry);
+        if (type == TABLE_DTZ) {
+            flags = entry.dtz_flags[t];
+            if ((flags & DTZ_FLAG_STM) != black_side && !entry.symmetric) {
+                *result = PROBE_CHANGE_STM;
+                return 0;
+            }
+        }
+        ei += t + (type == TABLE_WDL && entry.wdl_split ? 4 * black_side : 0);
+        while (i < entry.num) {
+            i = fill_squares(pos, ei->pieces, flip, flip ? 0x38 : 0, p, i);
+        }
+        idx = encode(p, *ei, entry, FILE_ENC);
+    }
+
+    const uint8_t* w = decompress_pairs(ei->precomp, idx);
+    if (type == TABLE_WDL) {
+        return w[0] - 2;
+    }
+
+    int value = w[0] + ((w[1] & 0x0F) << 8);
+    if (flags & DTZ_FLAG_MAPPED) {
+        int slot = entry.dtz_map_idx[t][wdl_to_map[wdl + 2]] + value;
+        value = flags & DTZ_FLAG_WIDE ? read_le_u16(entry.dtz_map + 2 * slot) : entry.dtz_map[slot];
+    }
+
+    // DTZ is stored in moves or plies depending on the table; always
+    // report plies
+    if (!(flags & plies_flags[wdl + 2]) || (wdl & 1)) {
+        value *= 2;
+    }
+    return value;
+}
+
+// Tables store "don't care" values where a capture is best, so captures are
+// resolved by an alpha-beta search before the table is consulted
+int Tablebase::probe_ab(const Position& pos, int alpha, int beta, ProbeState* result) {
+    MoveList moves;
+    generate_legal_moves(pos, moves);
+    for (Move move : moves) {
+        if (!is_capture(pos, move)) {
+            continue;
+        }
+        Position next = pos;
+        do_move(next, move);
+        int value = -probe_ab(next, -beta, -alpha, result);
+        if (*result == PROBE_FAIL) {
+            return 0;
+        }
+        if (value > alpha) {
+            if (value >= beta) {
+                return value;
+            }
+            alpha = value;
+        }
+    }
+
+    int value = probe_table(pos, 0, result, TABLE_WDL);
+    return alpha >= value ? alpha : value;
+}
+
+// Tables also ignore en passant rights, so en passant captures are tracked
+// apart from the others in case the position is stalemate without them
+int Tablebase::probe_wdl(const Position& pos, ProbeState* result) {
+    *result = PROBE_OK;
+
+    MoveList moves;
+    generate_legal_moves(pos, moves);
+    int best_capture = -3, best_en_passant = -3;
+    bool only_en_passant = true;
+
+    for (Move move : moves) {
+        bool en_passant = move_to(move) == pos.en_passant && moved_kind(pos, move) == KIND_PAWN;
+        if (!en_passant) {
+            only_en_passant = false;
+        }
+        if (!is_capture(pos, move)) {
+            continue;
+        }
+        Position next = pos;
+        do_move(next, move);
+        int value = -probe_ab(next, WDL_LOSS, -best_capture, result);
+        if (*result == PROBE_FAIL) {
+            return 0;
+        }
+        if (value > best_capture) {
+            if (value == WDL_WIN) {
+                *result = PROBE_ZEROING_BEST_MOVE;
+                return value;
+            }
+            if (!en_passant) {
+                best_capture = value;
+            } else if (value > best_en_passant) {
+                best_en_passant = value;
+            }
+        }
+    }
+
+    int value = probe_table(pos, 0, result, TABLE_WDL);
+    if (*result == PROBE_FAIL) {
+        return 0;
+    }
+
+    // max(value, best_capture) is the value of the position without en
+    // passant rights
+    if (best_en_passant > best_capture) {
+        if (best_en_passant > value) {
+            *result = PROBE_ZEROING_BEST_MOVE;
+            return best_en_passant;
+        }
+        best_capture = best_en_passant;
+    }
+    if (best_capture >= value) {
+        *result = best_capture > WDL_DRAW ? PROBE_ZEROING_BEST_MOVE : PROBE_OK;
+        return best_capture;
+    }
+
+    // Without the en passant capture the position would be stalemate, which
+    // is what the table stored
+    if (best_en_passant > -3 && value == WDL_DRAW && only_en_passant && !checkers(pos)) {
+        *result = PROBE_ZEROING_BEST_MOVE;
+        return best_en_passant;
+    }
+    return value;
+}
+
+bool is_mate(const Position& pos) {
+    return checkers(pos) && !has_legal_move(pos);
+}
+
+int Tablebase::probe_dtz(const Position& pos, ProbeState* result) {
+    int wdl = probe_wdl(pos, result);
+    if (*result == PROBE_FAIL || wdl == WDL_DRAW) {
+        return 0;
+    }
+    if (*result == PROBE_ZEROING_BEST_MOVE) {
+        return wdl_to_dtz[wdl + 2];
+    }
+
+    MoveList moves;
+    generate_legal_moves(pos, moves);
+
+    // A winning side may win with a pawn move
+    if (wdl > 0) {
+        for (Move move : moves) {
+            if (moved_kind(pos, move) != KIND_PAWN || is_capture(pos, move)) {
+                continue;
+            }
+            Position next = pos;
+            do_move(next, move);
+            int value = -probe_wdl(next, result);
+            if (*result == PROBE_FAIL) {
+                return 0;
+            }
+            if (value == wdl) {
+                return wdl_to_dtz[wdl + 2];
+            }
+        }
+    }
+
+    // The best move is not an en passant capture, so wdl is also the value
+    // of the position without en passant rights and selects the DTZ map
+    int dtz = probe_table(pos, wdl, result, TABLE_DTZ);
+    if (*result == PROBE_FAIL) {
+        return 0;
+    }
+    if (*result != PROBE_CHANGE_STM) {
+        return wdl_to_dtz[wdl + 2] + (wdl > 0 ? dtz : -dtz);
+    }
+
+    // The table stores the other side to move: take the best DTZ over a
+    // one-ply search. Captures and pawn moves are already accounted for: if
+    // winning they were tried above, if losing the worst of them is the
+    // initial value.
+    *result = PROBE_OK;
+    int best = wdl > 0 ? 0x7FFFFFFF : wdl_to_dtz[wdl + 2];
+    for (Move move : moves) {
+        if (is_capture(pos, move) || moved_kind(pos, move) == KIND_PAWN) {
+            continue;
+        }
+        Position next = pos;
+        do_move(next, move);
+        int value = -probe_dtz(next, result);
+        if (*result == PROBE_FAIL) {
+            return 0;
+        }
+        if (value == 1 && is_mate(next)) {
+            best = 1;
+        } else if (wdl > 0) {
+            if (value > 0 && value + 1 < best) {
+                best = value + 1;
+            }
+        } else if (value - 1 < best) {
+            best = value - 1;
+        }
+    }
+    return best;
+}
+
+// Builds the position to probe, or returns an error code if the current
+// position of the game cannot be looked up
+SimplechessResult probeable_position(const Tablebase& tablebase, const GameHandle& handle, Position& pos) {
+    if (effective_game_state(handle) != SIMPLECHESS_GAME_STATE_PLAYING) {
+        return SIMPLECHESS_ERROR_ILLEGAL_STATE;
+    }
+    position_from_stage(handle.game->currentStage(), pos);
+    if (pos.castling || popcount(pos.occupied()) > tablebase.max_pieces()) {
+        return SIMPLECHESS_ERROR_ILLEGAL_STATE;
+    }
+    return SIMPLECHESS_SUCCESS;
+}
+
+}
+
+extern "C" {
+
+SimplechessResult simplechess_tablebase_open(const char* paths, SimplechessTablebase* tablebase) {
+    if (!paths || !tablebase) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        *tablebase = new Tablebase(std::string(paths));
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+void simplechess_tablebase_destroy(SimplechessTablebase tablebase) {
+    if (tablebase) {
+        delete static_cast<Tablebase*>(tablebase);
+    }
+}
+
+SimplechessResult simplechess_tablebase_get_max_pieces(SimplechessTablebase tablebase, uint8_t* max_pieces) {
+    if (!tablebase || !max_pieces) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* tb = static_cast<Tablebase*>(tablebase);
+        *max_pieces = static_cast<uint8_t>(tb->max_pieces());
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_tablebase_probe_wdl(SimplechessTablebase tablebase, SimplechessGame game, SimplechessWdl* wdl) {
+    if (!tablebase || !game || !wdl) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* tb = static_cast<Tablebase*>(tablebase);
+        Position pos;
+        SimplechessResult status = probeable_position(*tb, *static_cast<GameHandle*>(game), pos);
+        if (status != SIMPLECHESS_SUCCESS) {
+            return status;
+        }
+
+        ProbeState state;
+        int score = tb->probe_wdl(pos, &state);
+        if (state == PROBE_FAIL) {
+            return SIMPLECHESS_ERROR_ILLEGAL_STATE;
+        }
+        *wdl = static_cast<SimplechessWdl>(score);
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_tablebase_probe_dtz(SimplechessTablebase tablebase, SimplechessGame game, int* dtz) {
+    if (!tablebase || !game || !dtz) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        auto* tb = static_cast<Tablebase*>(tablebase);
+        Position pos;
+        SimplechessResult status = probeable_position(*tb, *static_cast<GameHandle*>(game), pos);
+        if (status != SIMPLECHESS_SUCCESS) {
+            return status;
+        }
+
+        ProbeState state;
+        int value = tb->probe_dtz(pos, &state);
+        if (state == PROBE_FAIL) {
+            return SIMPLECHESS_ERROR_ILLEGAL_STATE;
+        }
+        *dtz = value;
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_game_get_adjudicated_state(SimplechessGame game, SimplechessTablebase tablebase,
+                                                         SimplechessGameState* state, bool* adjudicated) {
+    if (!game || !state || !adjudicated) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        const auto& handle = *static_cast<GameHandle*>(game);
+        *state = effective_game_state(handle);
+        *adjudicated = false;
+        if (!tablebase || *state != SIMPLECHESS_GAME_STATE_PLAYING) {
+            return SIMPLECHESS_SUCCESS;
+        }
+
+        auto* tb = static_cast<Tablebase*>(tablebase);
+        Position pos;
+        if (probeable_position(*tb, handle, pos) != SIMPLECHESS_SUCCESS) {
+            return SIMPLECHESS_SUCCESS;
+        }
+        ProbeState probe;
+        int score = tb->probe_wdl(pos, &probe);
+        if (probe == PROBE_FAIL) {
+            return SIMPLECHESS_SUCCESS;
+        }
+
+        // A win is only won under the fifty-move rule if the next capture or
+        // pawn move comes before the clock runs out. The table's own outcome
+        // assumes a fresh clock, so cursed wins and blessed losses are draws
+        // already, and the clock of the game can turn a win into one too.
+        bool decisive = score == WDL_WIN || score == WDL_LOSS;
+        if (decisive && pos.halfmove_clock > 0) {
+            int dtz = tb->probe_dtz(pos, &probe);
+            if (probe == PROBE_FAIL) {
+                return SIMPLECHESS_SUCCESS;
+            }
+            decisive = pos.halfmove_clock + std::abs(dtz) <= 100;
+        }
+        if (decisive) {
+            bool white_wins = (score == WDL_WIN) == (pos.side == WHITE);
+            *state = white_wins ? SIMPLECHESS_GAME_STATE_WHITE_WON : SIMPLECHESS_GAME_STATE_BLACK_WON;
+        } else {
+            *state = SIMPLECHESS_GAME_STATE_DRAWN;
+        }
+        *adjudicated = true;
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+}
@@ -0,0 +1,173 @@
+#include "simplechess/simplechess.h"
+#include "simplechess_internal.h"
+#include "history.h"
+#include "position.h"
+#include "serialize.h"
+#include "stage_diff.h"
+#include <simplechess/Game.h>
+#include <simplechess/GameStage.h>
+#include <simplechess/PlayedMove.h>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace simplechess_c {
+
+namespace {
+    /* Object behind a SimplechessUpdate handle. */
+    struct Update {
+        std::atomic<size_t> refs{1};
+        size_t ply = 0;
+        size_t san_length = 0;
+        size_t fen_length = 0;
+        std::vector<uint8_t> message;
+    };
+
+    void release(Update* update) {
+        if (update && update->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete update;
+        }
+    }
+
+    uint8_t delta_piece(const SimplechessSquareChange& change) {
+        if (!change.occupied) {
+            return 0;
+        }
+        return static_cast<uint8_t>((change.piece.type + 1) | (change.piece.color == SIMPLECHESS_COLOR_BLACK ? 8 : 0));
+    }
+
+    void put_delta(std::vector<uint8_t>& out, const SimplechessSquareChange* changes, size_t count,
+                   const SimplechessStageDiff& diff) {
+        out.push_back(static_cast<uint8_t>(count));
+        for (size_t i = 0; i < count; ++i) {
+            out.push_back(static_cast<uint8_t>(square_index(changes[i].square.rank, changes[i].square.file)));
+            out.push_back(delta_piece(changes[i]));
+        }
+        out.push_back(diff.changed);
+        out.push_back(static_cast<uint8_t>(diff.active_color));
+        out.push_back(diff.castling_rights);
+        out.push_back(diff.has_en_passant
+                          ? static_cast<uint8_t>(square_index(diff.en_passant.rank, diff.en_passant.file))
+                          : 0xFF);
+        put_u16(out, diff.halfmove_clock);
+        put_u16(out, diff.fullmove_counter);
+    }
+
+    Update* build_update(const GameHandle& handle) {
+        size_t length = history_length(handle);
+        simplechess::GameStage current = stage_at(handle, length - 1);
+
+        Position before, after;
+        if (length > 1) {
+            position_from_stage(stage_at(handle, length - 2), before);
+        } else {
+            std::memset(&before, 0, sizeof(before));
+            before.en_passant = -1;
+        }
+        position_from_stage(current, after);
+        SimplechessSquareChange changes[64];
+        SimplechessStageDiff diff;
+        size_t count = diff_positions(before, after, changes, diff);
+        if (length == 1) {
+            diff.changed = SIMPLECHESS_STAGE_DIFF_ACTIVE_COLOR | SIMPLECHESS_STAGE_DIFF_CASTLING |
+                           SIMPLECHESS_STAGE_DIFF_EN_PASSANT | SIMPLECHESS_STAGE_DIFF_HALFMOVE_CLOCK |
+                           SIMPLECHESS_STAGE_DIFF_FULLMOVE_COUNTER;
+        }
+
+        std::string san;
+        if (current.move().has_value()) {
+            san = current.move()->inAlgebraicNotation();
+        }
+        const std::string& fen = current.fen();
+
+        auto update = std::make_unique<Update>();
+        update->ply = length - 1;
+        update->san_length = san.size();
+        update->fen_length = fen.size();
+        std::vector<uint8_t>& message = update->message;
+        message.reserve(san.size() + fen.size() + 2 + 2 * count + 9);
+        message.insert(message.end(), san.begin(), san.end());
+        message.push_back(0);
+        message.insert(message.end(), fen.begin(), fen.end());
+        message.push_back(0);
+        put_delta(message, changes, count, diff);
+        return update.release();
+    }
+}
+
+/* Caches the update of one game; shared by the copies of its handle. */
+struct UpdateSlot {
+    std::once_flag built;
+    std::atomic<Update*> update{nullptr}; // Read without the once flag by the memory estimate
+
+    ~UpdateSlot() { release(update.load(std::memory_order_relaxed)); }
+};
+
+std::shared_ptr<UpdateSlot> new_update_slot() {
+    return std::make_shared<UpdateSlot>();
+}
+
+size_t update_slot_bytes(const UpdateSlot& slot) {
+    size_t bytes = sizeof(UpdateSlot);
+    if (const Update* update = slot.update.load(std::memory_order_acquire)) {
+        bytes += sizeof(Update) + update->message.capacity();
+    }
+    return bytes;
+}
+
+}
+
+using namespace simplechess_c;
+
+extern "C" {
+
+SimplechessResult simplechess_game_get_update(SimplechessGame game, SimplechessUpdate* update) {
+    if (!game || !update) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    try {
+        const auto* handle = static_cast<GameHandle*>(game);
+        UpdateSlot& slot = *handle->update;
+        std::call_once(slot.built, [&] { slot.update.store(build_update(*handle), std::memory_order_release); });
+        Update* built = slot.update.load(std::memory_order_relaxed);
+        built->refs.fetch_add(1, std::memory_order_relaxed);
+        *update = built;
+        return SIMPLECHESS_SUCCESS;
+    } catch (...) {
+        return handle_exception();
+    }
+}
+
+SimplechessResult simplechess_update_get_view(SimplechessUpdate update, SimplechessUpdateView* view) {
+    if (!update || !view) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    const auto* u = static_cast<const Update*>(update);
+    const uint8_t* message = u->message.data();
+    view->ply = u->ply;
+    view->san = reinterpret_cast<const char*>(message);
+    view->san_length = u->san_length;
+    view->fen = view->san + u->san_length + 1;
+    view->fen_length = u->fen_length;
+    view->delta = message + u->san_length + u->fen_length + 2;
+    view->delta_size = u->message.size() - (u->san_length + u->fen_length + 2);
+    view->message = message;
+    view->message_size = u->message.size();
+    return SIMPLECHESS_SUCCESS;
+}
+
+void simplechess_update_retain(SimplechessUpdate update) {
+    if (update) {
+        static_cast<Update*>(update)->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void simplechess_update_release(SimplechessUpdate update) {
+    release(static_cast<Update*>(update));
+}
+
+}
@@ -0,0 +1,80 @@
+#include "zobrist.h"
+
+namespace simplechess_c {
+
+namespace {
+    uint64_t splitmix64(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    struct Key {
+        uint64_t lo;
+        uint64_t hi;
+
+        void toggle(const Key& other) {
+            lo ^= other.lo;
+            hi ^= other.hi;
+        }
+    };
+
+    /* Fixed keys, so hashes can be stored and compared across runs. */
+    struct ZobristKeys {
+        Key pieces[2][KIND_COUNT][64];
+        Key castling[16];
+        Key en_passant_file[8];
+        Key black_to_move;
+
+        ZobristKeys() {
+            uint64_t state = 0x5C4E55D0B2157ULL;
+            auto next = [&state]() { return Key{splitmix64(state), splitmix64(state)}; };
+            for (auto& color : pieces) {
+                for (auto& kind : color) {
+                    for (auto& key : kind) {
+                        key = next();
+                    }
+                }
+            }
+            for (auto& key : castling) {
+                key = next();
+            }
+            for (auto& key : en_passant_file) {
+                key = next();
+            }
+            black_to_move = next();
+        }
+    };
+
+    const ZobristKeys& zobrist_keys() {
+        static const ZobristKeys keys;
+        return keys;
+    }
+}
+
+SimplechessPositionHash position_hash(const Position& pos) {
+    const ZobristKeys& keys = zobrist_keys();
+    Key key = {0, 0};
+
+    Bitboard occupied = pos.occupied();
+    while (occupied) {
+        int sq = pop_lsb(occupied);
+        uint8_t code = pos.board[sq];
+        key.toggle(keys.pieces[piece_code_color(code)][piece_code_kind(code)][sq]);
+    }
+    key.toggle(keys.castling[pos.castling & 15]);
+    if (pos.en_passant >= 0
+        && (pawn_attacks(pos.side ^ 1, pos.en_passant) & pos.pieces(pos.side, KIND_PAWN))) {
+        key.toggle(keys.en_passant_file[square_file(pos.en_passant)]);
+    }
+    if (pos.side == BLACK) {
+        key.toggle(keys.black_to_move);
+    }
+    if (key.lo == 0 && key.hi == 0) {
+        key.lo = 1;
+    }
+    return SimplechessPositionHash{key.lo, key.hi};
+}
+
+}
@@ -0,0 +1,24 @@
+/**
+ * @file zobrist.h
+ * @brief Internal 128-bit Zobrist hashing of positions
+ *
+ * This header is private to the library and is not installed.
+ */
+
+#ifndef SIMPLECHESS_ZOBRIST_H
+#define SIMPLECHESS_ZOBRIST_H
+
+#include "simplechess/simplechess.h"
+#include "position.h"
+
+namespace simplechess_c {
+
+/* Hash of the placement, side to move, castling rights and en passant file
+ * of a position. The en passant file only counts when a pawn of the side to
+ * move can capture there, so positions that repeat under the FIDE rules hash
+ * alike. The clocks are not hashed. Never returns an all-zero hash. */
+SimplechessPositionHash position_hash(const Position& pos);
+
+}
+
+#endif /* SIMPLECHESS_ZOBRIST_H */
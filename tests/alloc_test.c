@@ -0,0 +1,329 @@
+/**
+ * @file alloc_test.c
+ * @brief Allocation budgets of the hot query paths
+ *
+ * Replaces malloc, calloc, realloc and free with counting versions that
+ * forward to glibc, so the allocations of the C++ code behind the library
+ * (operator new ends up in malloc) are counted too. Each probe is called
+ * once to fill the caches it relies on, then called repeatedly while
+ * counting, and fails if it allocates more per call than its budget.
+ *
+ * The budgets are those of the current code. A probe going over its
+ * budget is a regression; one coming in under it is reported so that the
+ * budget can be lowered.
+ *
+ * Requires glibc (__libc_malloc and friends); built on Linux only.
+ *
+ * Usage: alloc_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simplechess/simplechess.h"
+
+#define MAX_MOVES 256
+#define CALLS 100
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static __thread int counting;
+static __thread size_t allocations;
+
+void* malloc(size_t size) {
+    allocations += counting;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    allocations += counting;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    allocations += counting;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+typedef struct {
+    SimplechessGame game;
+    SimplechessPieceMove moves[MAX_MOVES];
+    SimplechessGameStage stage;
+} Fixture;
+
+typedef struct {
+    const char* name;
+    /* Allocations allowed per call, for the default and the bitboard
+     * generator */
+    size_t budget[2];
+    SimplechessResult (*call)(Fixture* fixture);
+} Probe;
+
+/* Returns from the probe if a call fails, so that a failing call is not
+ * taken for one that does not allocate. */
+#define CHECK(call)                                   \
+    do {                                              \
+        SimplechessResult check_result = (call);      \
+        if (check_result != SIMPLECHESS_SUCCESS) {    \
+            return check_result;                      \
+        }                                             \
+    } while (0)
+
+static SimplechessResult get_state(Fixture* f) {
+    SimplechessGameState state;
+    return simplechess_game_get_state(f->game, &state);
+}
+
+static SimplechessResult get_active_color(Fixture* f) {
+    SimplechessColor color;
+    return simplechess_game_get_active_color(f->game, &color);
+}
+
+static SimplechessResult can_claim_draw(Fixture* f) {
+    bool can_claim;
+    SimplechessDrawReason reason;
+    return simplechess_game_can_claim_draw(f->game, &can_claim, &reason);
+}
+
+static SimplechessResult get_available_moves_count(Fixture* f) {
+    size_t count;
+    return simplechess_game_get_available_moves_count(f->game, &count);
+}
+
+static SimplechessResult get_available_moves(Fixture* f) {
+    return simplechess_game_get_available_moves(f->game, f->moves, MAX_MOVES);
+}
+
+static bool stop_at_first(void* user_data, const SimplechessPieceMove* move) {
+    (void)user_data;
+    (void)move;
+    return false;
+}
+
+static SimplechessResult early_exit_moves(Fixture* f) {
+    bool has_move;
+    CHECK(simplechess_game_has_legal_move(f->game, &has_move));
+    return simplechess_game_for_each_move(f->game, stop_at_first, NULL);
+}
+
+static SimplechessResult get_moves_for_piece(Fixture* f) {
+    /* The white knight on f3, with white to move */
+    SimplechessSquare square = {3, 'f'};
+    size_t count;
+    CHECK(simplechess_game_get_moves_for_piece_count(f->game, &square, &count));
+    /* A square without moves would measure nothing */
+    if (count == 0) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+    return simplechess_game_get_moves_for_piece(f->game, &square, f->moves, MAX_MOVES);
+}
+
+static SimplechessResult get_move_masks(Fixture* f) {
+    SimplechessSquareSet masks[64];
+    return simplechess_game_get_move_masks(f->game, masks);
+}
+
+static SimplechessResult get_staged_moves(Fixture* f) {
+    size_t count;
+    CHECK(simplechess_game_get_captures(f->game, f->moves, MAX_MOVES, &count));
+    CHECK(simplechess_game_get_quiet_checks(f->game, f->moves, MAX_MOVES, &count));
+    return simplechess_game_get_quiet_moves(f->game, f->moves, MAX_MOVES, &count);
+}
+
+static SimplechessResult get_attacks(Fixture* f) {
+    SimplechessSquare square = {4, 'e'};
+    SimplechessSquareSet squares;
+    CHECK(simplechess_game_get_attacked_squares(f->game, SIMPLECHESS_COLOR_WHITE, &squares));
+    return simplechess_game_get_attackers(f->game, &square, SIMPLECHESS_COLOR_BLACK, &squares);
+}
+
+static SimplechessResult get_history_length(Fixture* f) {
+    size_t length;
+    return simplechess_game_get_history_length(f->game, &length);
+}
+
+static SimplechessResult get_clocks(Fixture* f) {
+    uint16_t halfmove, fullmove;
+    CHECK(simplechess_game_get_halfmove_clock(f->game, &halfmove));
+    return simplechess_game_get_fullmove_counter(f->game, &fullmove);
+}
+
+static SimplechessResult get_position_hash(Fixture* f) {
+    SimplechessPositionHash hash;
+    return simplechess_game_get_position_hash(f->game, &hash);
+}
+
+static SimplechessResult get_update(Fixture* f) {
+    SimplechessUpdate update;
+    CHECK(simplechess_game_get_update(f->game, &update));
+    simplechess_update_release(update);
+    return SIMPLECHESS_SUCCESS;
+}
+
+static SimplechessResult stage_getters(Fixture* f) {
+    SimplechessColor color;
+    uint16_t clock;
+    CHECK(simplechess_stage_get_active_color(f->stage, &color));
+    CHECK(simplechess_stage_get_halfmove_clock(f->stage, &clock));
+    return simplechess_stage_get_fullmove_counter(f->stage, &clock);
+}
+
+static SimplechessResult square_utilities(Fixture* f) {
+    SimplechessSquare square, other;
+    SimplechessColor color;
+    bool flag;
+    char text[3];
+    (void)f;
+    CHECK(simplechess_square_from_rank_and_file(4, 'e', &square));
+    CHECK(simplechess_square_from_string("d5", &other));
+    CHECK(simplechess_square_to_string(&square, text, sizeof(text)));
+    CHECK(simplechess_square_is_inside_boundaries(square.rank, square.file, &flag));
+    CHECK(simplechess_square_get_color(square, &color));
+    CHECK(simplechess_squares_are_equal(square, other, &flag));
+    return simplechess_color_get_opposite(color, &color);
+}
+
+static SimplechessResult piece_move_constructors(Fixture* f) {
+    SimplechessPiece pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_WHITE};
+    SimplechessSquare e7 = {7, 'e'}, e8 = {8, 'e'};
+    CHECK(simplechess_piece_move_regular(&pawn, &e7, &e8, &f->moves[0]));
+    return simplechess_piece_move_promotion(&pawn, &e7, &e8, SIMPLECHESS_PIECE_TYPE_QUEEN, &f->moves[0]);
+}
+
+/* Not a probe: copying a stage always allocates, which shows that the
+ * counting versions are in use. */
+static void get_current_stage(Fixture* f) {
+    SimplechessGameStage stage;
+    if (simplechess_game_get_current_stage(f->game, &stage) == SIMPLECHESS_SUCCESS) {
+        simplechess_game_stage_destroy(stage);
+    }
+}
+
+static const Probe probes[] = {
+    {"simplechess_game_get_state", {0, 0}, get_state},
+    {"simplechess_game_get_active_color", {0, 0}, get_active_color},
+    {"simplechess_game_can_claim_draw", {0, 0}, can_claim_draw},
+    {"simplechess_game_get_available_moves_count", {0, 0}, get_available_moves_count},
+    {"simplechess_game_get_available_moves", {0, 0}, get_available_moves},
+    /* The default generator copies the std::set of moves of the piece */
+    {"simplechess_game_get_moves_for_piece[_count]", {10, 0}, get_moves_for_piece},
+    {"simplechess_game_has_legal_move/for_each_move", {0, 0}, early_exit_moves},
+    {"simplechess_game_get_move_masks", {0, 0}, get_move_masks},
+    {"simplechess_game_get_captures/quiet_checks/quiet_moves", {0, 0}, get_staged_moves},
+    {"simplechess_game_get_attacked_squares/attackers", {0, 0}, get_attacks},
+    {"simplechess_game_get_history_length", {0, 0}, get_history_length},
+    {"simplechess_game_get_halfmove_clock/fullmove_counter", {0, 0}, get_clocks},
+    {"simplechess_game_get_position_hash", {0, 0}, get_position_hash},
+    {"simplechess_game_get_update", {0, 0}, get_update},
+    {"simplechess_stage_get_*", {0, 0}, stage_getters},
+    {"square and color utilities", {0, 0}, square_utilities},
+    {"simplechess_piece_move_regular/promotion", {0, 0}, piece_move_constructors},
+};
+
+/* Runs every probe on a game of the manager after the given moves. */
+static int run_probes(const char* generator, int index, SimplechessGameManager manager, const char* line) {
+    Fixture fixture;
+    int failures = 0;
+
+    if (simplechess_create_new_game(manager, &fixture.game) != SIMPLECHESS_SUCCESS) {
+        printf("  cannot create a game\n");
+        return 1;
+    }
+    for (const char* p = line; *p; p += 4) {
+        SimplechessSquare src = {p[1] - '0', p[0]}, dst = {p[3] - '0', p[2]};
+        size_t count = 0;
+        SimplechessGame next;
+        simplechess_game_get_available_moves_count(fixture.game, &count);
+        simplechess_game_get_available_moves(fixture.game, fixture.moves, MAX_MOVES);
+        size_t i = 0;
+        while (i < count && !(fixture.moves[i].src.rank == src.rank && fixture.moves[i].src.file == src.file
+                              && fixture.moves[i].dst.rank == dst.rank && fixture.moves[i].dst.file == dst.file)) {
+            i++;
+        }
+        if (i == count || simplechess_make_move(manager, fixture.game, &fixture.moves[i], false, &next) != SIMPLECHESS_SUCCESS) {
+            printf("  cannot play %.4s\n", p);
+            simplechess_game_destroy(fixture.game);
+            return 1;
+        }
+        simplechess_game_destroy(fixture.game);
+        fixture.game = next;
+    }
+    if (simplechess_game_get_current_stage(fixture.game, &fixture.stage) != SIMPLECHESS_SUCCESS) {
+        printf("  cannot get the current stage\n");
+        simplechess_game_destroy(fixture.game);
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); i++) {
+        const Probe* probe = &probes[i];
+        size_t budget = probe->budget[index];
+        SimplechessResult result = probe->call(&fixture);
+
+        allocations = 0;
+        counting = 1;
+        for (int n = 0; n < CALLS && result == SIMPLECHESS_SUCCESS; n++) {
+            result = probe->call(&fixture);
+        }
+        counting = 0;
+
+        if (result != SIMPLECHESS_SUCCESS) {
+            printf("  %-8s %-54s failed: %s\n", generator, probe->name, simplechess_result_to_string(result));
+            failures++;
+            continue;
+        }
+
+        double per_call = (double)allocations / CALLS;
+        const char* verdict = "ok";
+        if (allocations > budget * CALLS) {
+            verdict = "OVER BUDGET";
+            failures++;
+        } else if (allocations < budget * CALLS) {
+            verdict = "under budget, lower it";
+        }
+        printf("  %-8s %-54s %6.2f / %zu  %s\n", generator, probe->name, per_call, budget, verdict);
+    }
+
+    allocations = 0;
+    counting = 1;
+    get_current_stage(&fixture);
+    counting = 0;
+    if (allocations == 0) {
+        printf("  allocations are not being counted\n");
+        failures++;
+    }
+
+    simplechess_game_stage_destroy(fixture.stage);
+    simplechess_game_destroy(fixture.game);
+    return failures;
+}
+
+int main(void) {
+    SimplechessGameManager managers[2];
+    const char* names[2] = {"default", "bitboard"};
+    int failures = 0;
+
+    if (simplechess_game_manager_create(&managers[0]) != SIMPLECHESS_SUCCESS
+        || simplechess_game_manager_create_with_move_generator(SIMPLECHESS_MOVE_GENERATOR_BITBOARD, &managers[1])
+               != SIMPLECHESS_SUCCESS) {
+        printf("cannot create the game managers\n");
+        return 1;
+    }
+
+    printf("Allocations per call (measured / budget)\n");
+    for (int i = 0; i < 2; i++) {
+        failures += run_probes(names[i], i, managers[i], "e2e4e7e5g1f3b8c6f1c4g8f6");
+    }
+
+    simplechess_game_manager_destroy(managers[0]);
+    simplechess_game_manager_destroy(managers[1]);
+
+    printf("\n%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
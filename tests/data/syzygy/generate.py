@@ -0,0 +1,543 @@
+#!/usr/bin/env python3
+"""Generates the three-piece Syzygy tables used by the test suite.
+
+The tables KQvK, KRvK and KPvK are solved by retrograde analysis and written
+in the Syzygy .rtbw/.rtbz format: the same index encoding, canonical Huffman
+compression and block layout that src/tablebase.cpp decodes. Symbols are
+single values (no pairing), which the format allows. KBvK and KNvK, which
+KPvK reaches by underpromotion, are written as all draws.
+
+WDL tables store both sides to move. DTZ tables store white (the stronger
+side) to move, in plies, so probes with black to move go through the one-ply
+search of the prober.
+
+Usage: generate.py [output directory]
+"""
+
+import heapq
+import os
+import struct
+import sys
+from array import array
+
+WDL_MAGIC = 0x5D23E871
+DTZ_MAGIC = 0xA50C66D7
+
+DTZ_FLAG_WIN_PLIES = 4
+DTZ_FLAG_LOSS_PLIES = 8
+
+# Piece codes of the table headers
+WHITE_PAWN, WHITE_KNIGHT, WHITE_BISHOP, WHITE_ROOK, WHITE_QUEEN, WHITE_KING = 1, 2, 3, 4, 5, 6
+BLACK_KING = 14
+
+BLOCK_SIZE = 10  # log2 of the block size in bytes
+IDX_BITS = 10
+
+UNKNOWN, WIN, LOSS, DRAW = 0, 1, 2, 3
+
+
+def rank_of(sq):
+    return sq >> 3
+
+
+def file_of(sq):
+    return sq & 7
+
+
+# Encoding tables, as built by Indices in src/tablebase.cpp
+
+OFF_DIAG = [(rank_of(sq) > file_of(sq)) - (rank_of(sq) < file_of(sq)) for sq in range(64)]
+LOWER = [0] * 64
+DIAG = [0] * 64
+TRIANGLE = [0] * 64
+FLAP = [0] * 64
+PAWN_TWIST = [0] * 64
+
+
+def init_indices():
+    code = 0
+    for sq in range(64):
+        if OFF_DIAG[sq] < 0:
+            LOWER[sq] = code
+            code += 1
+        elif OFF_DIAG[sq] == 0:
+            DIAG[sq] = rank_of(sq)
+    code = 0
+    for sq in range(64):
+        if file_of(sq) <= 3 and OFF_DIAG[sq] < 0:
+            TRIANGLE[sq] = code
+            code += 1
+    for sq in range(0, 64, 9):
+        if file_of(sq) <= 3:
+            TRIANGLE[sq] = code
+            code += 1
+    twist = 47
+    for f in range(4):
+        for r in range(1, 7):
+            sq = r * 8 + f
+            FLAP[sq] = FLAP[sq ^ 7] = f * 6 + r - 1
+            PAWN_TWIST[sq] = twist
+            PAWN_TWIST[sq ^ 7] = twist - 1
+            twist -= 2
+
+
+init_indices()
+
+
+def flip_diag(sq):
+    return (sq >> 3) | ((sq & 7) << 3)
+
+
+def encode_piece(p):
+    """Index of three pawnless pieces, all unique (31332 per side)."""
+    p = list(p)
+    if p[0] & 0x04:
+        p = [sq ^ 0x07 for sq in p]
+    if p[0] & 0x20:
+        p = [sq ^ 0x38 for sq in p]
+    for sq in p:
+        if OFF_DIAG[sq]:
+            if OFF_DIAG[sq] > 0:
+                p = [flip_diag(s) for s in p]
+            break
+    s1 = p[1] > p[0]
+    s2 = (p[2] > p[0]) + (p[2] > p[1])
+    if OFF_DIAG[p[0]]:
+        return TRIANGLE[p[0]] * 63 * 62 + (p[1] - s1) * 62 + (p[2] - s2)
+    if OFF_DIAG[p[1]]:
+        return 6 * 63 * 62 + DIAG[p[0]] * 28 * 62 + LOWER[p[1]] * 62 + p[2] - s2
+    if OFF_DIAG[p[2]]:
+        return 6 * 63 * 62 + 4 * 28 * 62 + DIAG[p[0]] * 7 * 28 + (DIAG[p[1]] - s1) * 28 + LOWER[p[2]]
+    return (6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + DIAG[p[0]] * 7 * 6 + (DIAG[p[1]] - s1) * 6
+            + (DIAG[p[2]] - s2))
+
+
+def encode_pawn(p):
+    """Leading pawn file and index of a pawn and two kings (6 * 63 * 62 per file)."""
+    t = min(file_of(p[0]), 7 - file_of(p[0]))
+    if p[0] & 0x04:
+        p = [sq ^ 0x07 for sq in p]
+    # The pawn's rank, then each king among the squares left
+    king = p[1] - (p[1] > p[0])
+    other = p[2] - (p[2] > p[0]) - (p[2] > p[1])
+    return t, FLAP[p[0]] % 6 + 6 * king + 6 * 63 * other
+
+
+# Move generation
+
+def king_targets(sq):
+    return [t for t in range(64)
+            if t != sq and abs(rank_of(t) - rank_of(sq)) <= 1 and abs(file_of(t) - file_of(sq)) <= 1]
+
+
+KING = [king_targets(sq) for sq in range(64)]
+KING_MASK = [sum(1 << t for t in KING[sq]) for sq in range(64)]
+
+ROOK_DIRS = [(1, 0), (-1, 0), (0, 1), (0, -1)]
+QUEEN_DIRS = ROOK_DIRS + [(1, 1), (1, -1), (-1, 1), (-1, -1)]
+
+
+def rays(sq, dirs):
+    result = []
+    for dr, df in dirs:
+        ray = []
+        r, f = rank_of(sq) + dr, file_of(sq) + df
+        while 0 <= r < 8 and 0 <= f < 8:
+            ray.append(r * 8 + f)
+            r, f = r + dr, f + df
+        result.append(ray)
+    return result
+
+
+def slider_targets(ray_table, sq, blocker):
+    """Squares a slider on sq reaches with a single blocking square."""
+    targets = []
+    for ray in ray_table[sq]:
+        for t in ray:
+            if t == blocker:
+                break
+            targets.append(t)
+    return targets
+
+
+class Piece:
+    def __init__(self, kind):
+        self.kind = kind
+        if kind == 'P':
+            self.attack_mask = [0] * 64
+            for sq in range(64):
+                for df in (-1, 1):
+                    if 0 <= file_of(sq) + df < 8 and rank_of(sq) < 7:
+                        self.attack_mask[sq] |= 1 << (sq + 8 + df)
+            self.attacks = lambda sq, blocker: self.attack_mask[sq]
+        else:
+            ray_table = [rays(sq, QUEEN_DIRS if kind == 'Q' else ROOK_DIRS) for sq in range(64)]
+            masks = {}
+            for sq in range(64):
+                for blocker in range(64):
+                    masks[sq * 64 + blocker] = sum(1 << t for t in slider_targets(ray_table, sq, blocker))
+            self.ray_table = ray_table
+            self.attacks = lambda sq, blocker: masks[sq * 64 + blocker]
+
+
+def state_index(stm, wk, x, bk):
+    return stm << 18 | wk << 12 | x << 6 | bk
+
+
+STATES = 1 << 19
+ZEROING = 1 << 20
+
+
+def is_legal(piece, stm, wk, x, bk):
+    if wk == x or wk == bk or x == bk or (KING_MASK[wk] >> bk) & 1:
+        return False
+    if piece.kind == 'P' and (x < 8 or x >= 56):
+        return False
+    # The side that just moved cannot be in check
+    return stm == 1 or not (piece.attacks(x, wk) >> bk) & 1
+
+
+def solve(kind, promotions):
+    """Solves K+kind v K. promotions maps a promoted kind to the WDL array of its
+    table (or None for a drawn ending). Returns the WDL and DTZ arrays."""
+    piece = Piece(kind)
+    legal = bytearray(STATES)
+    in_check = bytearray(STATES)
+    start = array('i', [0]) * (STATES + 1)
+    edges = array('i')
+    moves = array('i', [0]) * STATES
+    external_win = bytearray(STATES)   # A zeroing move wins outright
+    external_loss = array('i', [0]) * STATES  # Moves known to lose
+    wdl = bytearray(STATES)
+
+    for s in range(STATES):
+        start[s] = len(edges)
+        stm, wk, x, bk = s >> 18, (s >> 12) & 63, (s >> 6) & 63, s & 63
+        if not is_legal(piece, stm, wk, x, bk):
+            continue
+        legal[s] = 1
+        count = 0
+        if stm == 0:
+            for t in KING[wk]:
+                if t != x and t != bk and not (KING_MASK[bk] >> t) & 1:
+                    edges.append(state_index(1, t, x, bk))
+                    count += 1
+            if kind == 'P':
+                one = x + 8
+                if one != wk and one != bk:
+                    if one >= 56:
+                        for promoted in ('Q', 'R', 'B', 'N'):
+                            count += 1
+                            table = promotions.get(promoted)
+                            result = table[state_index(1, wk, one, bk)] if table else DRAW
+                            if result == LOSS:
+                                external_win[s] = 1
+                            elif result == WIN:
+                                external_loss[s] += 1
+                    else:
+                        edges.append(state_index(1, wk, one, bk) | ZEROING)
+                        count += 1
+                        two = x + 16
+                        if x < 16 and two != wk and two != bk:
+                            edges.append(state_index(1, wk, two, bk) | ZEROING)
+                            count += 1
+            else:
+                for t in slider_targets(piece.ray_table, x, wk):
+                    edges.append(state_index(1, wk, t, bk))
+                    count += 1
+        else:
+            attacked = piece.attacks(x, wk) | KING_MASK[wk]
+            in_check[s] = (attacked >> bk) & 1
+            for t in KING[bk]:
+                if t == wk or (attacked >> t) & 1:
+                    continue
+                count += 1  # Capturing the piece draws
+                if t != x:
+                    edges.append(state_index(0, wk, x, t))
+        moves[s] = count
+    start[STATES] = len(edges)
+
+    preds = predecessors(edges, start, lambda child: True)
+
+    # WDL: mates are lost, then a position is won if a move reaches a lost
+    # position and lost once every move reaches a won one
+    remaining = array('i', moves)
+    queue = []
+    for s in range(STATES):
+        if not legal[s]:
+            continue
+        if moves[s] == 0:
+            wdl[s] = LOSS if in_check[s] else DRAW
+            if in_check[s]:
+                queue.append(s)
+        elif external_win[s]:
+            wdl[s] = WIN
+            queue.append(s)
+        else:
+            remaining[s] -= external_loss[s]
+            if remaining[s] == 0:
+                wdl[s] = LOSS
+                queue.append(s)
+    for s in queue:
+        for i in range(preds[1][s], preds[1][s + 1]):
+            p = preds[0][i]
+            if wdl[p]:
+                continue
+            if wdl[s] == LOSS:
+                wdl[p] = WIN
+                queue.append(p)
+            else:
+                remaining[p] -= 1
+                if remaining[p] == 0:
+                    wdl[p] = LOSS
+                    queue.append(p)
+    for s in range(STATES):
+        if legal[s] and not wdl[s]:
+            wdl[s] = DRAW
+
+    # DTZ in plies: a zeroing move or a mate ends the count, and only moves
+    # that keep the outcome are followed
+    dtz = array('i', [-1]) * STATES
+    quiet = predecessors(edges, start, lambda child: not child & ZEROING)
+    remaining = array('i', [0]) * STATES
+    buckets = [[], []]
+    for s in range(STATES):
+        if not legal[s] or wdl[s] == DRAW:
+            continue
+        if moves[s] == 0:
+            dtz[s] = 0
+            buckets[0].append(s)
+            continue
+        zeroing_win = external_win[s]
+        has_zeroing = False
+        for i in range(start[s], start[s + 1]):
+            child = edges[i]
+            if child & ZEROING:
+                has_zeroing = True
+                if wdl[child & ~ZEROING] == LOSS:
+                    zeroing_win = True
+            elif wdl[s] == LOSS:
+                remaining[s] += 1
+        if wdl[s] == WIN and zeroing_win:
+            dtz[s] = 1
+            buckets[1].append(s)
+        elif wdl[s] == LOSS and remaining[s] == 0:
+            assert has_zeroing
+            dtz[s] = 1
+            buckets[1].append(s)
+    d = 0
+    while d < len(buckets):
+        for s in buckets[d]:
+            for i in range(quiet[1][s], quiet[1][s + 1]):
+                p = quiet[0][i]
+                if dtz[p] >= 0:
+                    continue
+                if wdl[s] == LOSS and wdl[p] == WIN:
+                    dtz[p] = d + 1
+                elif wdl[s] == WIN and wdl[p] == LOSS:
+                    remaining[p] -= 1
+                    if remaining[p]:
+                        continue
+                    dtz[p] = d + 1
+                else:
+                    continue
+                while len(buckets) <= d + 1:
+                    buckets.append([])
+                buckets[d + 1].append(p)
+        d += 1
+    for s in range(STATES):
+        assert not legal[s] or wdl[s] == DRAW or dtz[s] >= 0
+    return legal, wdl, dtz
+
+
+def predecessors(edges, start, keep):
+    """Reverses the move graph: positions that reach each state, as a flat
+    array and per-state offsets."""
+    counts = array('i', [0]) * (STATES + 1)
+    for child in edges:
+        if keep(child):
+            counts[(child & ~ZEROING) + 1] += 1
+    for s in range(STATES):
+        counts[s + 1] += counts[s]
+    fill = array('i', counts)
+    flat = array('i', [0]) * counts[STATES]
+    for s in range(STATES):
+        for i in range(start[s], start[s + 1]):
+            child = edges[i]
+            if keep(child):
+                child &= ~ZEROING
+                flat[fill[child]] = s
+                fill[child] += 1
+    return flat, counts
+
+
+# Compression
+
+def huffman_lengths(freq):
+    if len(freq) == 1:
+        return {value: 1 for value in freq}
+    heap = [(count, i, [value]) for i, (value, count) in enumerate(sorted(freq.items()))]
+    heapq.heapify(heap)
+    lengths = {value: 0 for value in freq}
+    order = len(heap)
+    while len(heap) > 1:
+        c1, _, v1 = heapq.heappop(heap)
+        c2, _, v2 = heapq.heappop(heap)
+        for value in v1 + v2:
+            lengths[value] += 1
+        heapq.heappush(heap, (c1 + c2, order, v1 + v2))
+        order += 1
+    return lengths
+
+
+def compress(values, flags, magic):
+    """Returns the pairs header and the index, size and data sections of one
+    subtable."""
+    freq = {}
+    for value in values:
+        freq[value] = freq.get(value, 0) + 1
+    # A single value needs no data, but DTZ tables can only hold zero that way
+    if len(freq) == 1 and (magic == WDL_MAGIC or 0 in freq):
+        return bytes([flags | 0x80, next(iter(freq))]), b'', b'', b''
+
+    lengths = huffman_lengths(freq)
+    min_len, max_len = min(lengths.values()), max(lengths.values())
+    assert max_len <= 32
+    # Longer codes take the lower symbol numbers
+    symbols = sorted(freq, key=lambda value: (-lengths[value], value))
+    h = max_len - min_len + 1
+    offset = [sum(1 for value in symbols if lengths[value] > min_len + i) for i in range(h)]
+    base = [0] * h
+    for i in range(h - 2, -1, -1):
+        base[i] = (base[i + 1] + offset[i] - offset[i + 1]) // 2
+    codes = {}
+    for number, value in enumerate(symbols):
+        i = lengths[value] - min_len
+        codes[value] = (base[i] + number - offset[i], lengths[value])
+
+    block_bits = 8 << BLOCK_SIZE
+    blocks, starts = [], []
+    bits, used, count = 0, 0, 0
+    for position, value in enumerate(values):
+        code, length = codes[value]
+        if used + length > block_bits:
+            blocks.append((bits << (block_bits - used), count))
+            bits, used, count = 0, 0, 0
+        if count == 0:
+            starts.append(position)
+        bits = bits << length | code
+        used += length
+        count += 1
+    blocks.append((bits << (block_bits - used), count))
+
+    num_indices = (len(values) + (1 << IDX_BITS) - 1) >> IDX_BITS
+    index = bytearray()
+    block = 0
+    for main in range(num_indices):
+        position = (main << IDX_BITS) + (1 << (IDX_BITS - 1))
+        while block + 1 < len(starts) and starts[block + 1] <= position:
+            block += 1
+        index += struct.pack('<IH', block, position - starts[block])
+    sizes = b''.join(struct.pack('<H', count - 1) for _, count in blocks)
+    data = b''.join(bits.to_bytes(block_bits // 8, 'big') for bits, _ in blocks)
+
+    header = bytearray([flags, BLOCK_SIZE, IDX_BITS, 0])
+    header += struct.pack('<I', len(blocks))
+    header += bytes([max_len, min_len])
+    for value in offset:
+        header += struct.pack('<H', value)
+    header += struct.pack('<H', len(symbols))
+    for value in symbols:
+        header += bytes([value & 0xFF, 0xF0 | (value >> 8), 0xFF])
+    header += b'\0' * (len(symbols) & 1)
+    return bytes(header), bytes(index), sizes, data
+
+
+def write_table(path, magic, flag_byte, piece_headers, subtables):
+    """subtables: (header, index, sizes, data) in file order."""
+    out = bytearray(struct.pack('<I', magic))
+    out.append(flag_byte)
+    for piece_header in piece_headers:
+        out += piece_header
+    out += b'\0' * (len(out) & 1)
+    for subtable in subtables:
+        out += subtable[0]
+    if magic == DTZ_MAGIC:
+        out += b'\0' * (len(out) & 1)
+    for subtable in subtables:
+        out += subtable[1]
+    for subtable in subtables:
+        out += subtable[2]
+    for subtable in subtables:
+        out += b'\0' * (-len(out) % 64)
+        out += subtable[3]
+    out += b'\0' * ((16 - len(out)) % 64)
+    with open(path, 'wb') as f:
+        f.write(out)
+
+
+def build(directory, name, kind, promotions):
+    legal, wdl, dtz = solve(kind, promotions)
+    pawn = kind == 'P'
+    files = 4 if pawn else 1
+    size = 6 * 63 * 62 if pawn else 31332
+    code = {'Q': WHITE_QUEEN, 'R': WHITE_ROOK, 'P': WHITE_PAWN}[kind]
+
+    # Unused indices take the most common value to compress well
+    wdl_values = [[array('B', [2]) * size for _ in range(2)] for _ in range(files)]
+    dtz_values = [array('H', [0]) * size for _ in range(files)]
+    max_dtz = 0
+    for s in range(STATES):
+        if not legal[s]:
+            continue
+        stm, wk, x, bk = s >> 18, (s >> 12) & 63, (s >> 6) & 63, s & 63
+        if pawn:
+            t, idx = encode_pawn([x, wk, bk])
+        else:
+            t, idx = 0, encode_piece([wk, x, bk])
+        wdl_values[t][stm][idx] = {WIN: 4, LOSS: 0, DRAW: 2}[wdl[s]]
+        if stm == 0 and wdl[s] != DRAW:
+            dtz_values[t][idx] = max(dtz[s] - 1, 0)
+            max_dtz = max(max_dtz, dtz[s])
+    assert max_dtz <= 100
+
+    # The pawn leads pawn tables, pawnless ones list the pieces as indexed
+    order = bytes([0x00])
+    pieces = bytes([code, WHITE_KING, BLACK_KING] if pawn else [WHITE_KING, code, BLACK_KING])
+    wdl_header = order + bytes(piece | piece << 4 for piece in pieces)
+    wdl_subtables = [compress(wdl_values[t][side], 0, WDL_MAGIC) for t in range(files) for side in range(2)]
+    write_table(os.path.join(directory, name + '.rtbw'), WDL_MAGIC, 0x01 | (0x02 if pawn else 0),
+                [wdl_header] * files, wdl_subtables)
+
+    dtz_flags = DTZ_FLAG_WIN_PLIES | DTZ_FLAG_LOSS_PLIES
+    dtz_subtables = [compress(dtz_values[t], dtz_flags, DTZ_MAGIC) for t in range(files)]
+    write_table(os.path.join(directory, name + '.rtbz'), DTZ_MAGIC, 0x02 if pawn else 0,
+                [order + pieces] * files, dtz_subtables)
+    print('%s: longest win %d plies' % (name, max_dtz))
+    return wdl
+
+
+def build_draw(directory, name, code):
+    """A lone minor piece cannot mate: every position is a draw."""
+    order = bytes([0x00])
+    pieces = bytes([WHITE_KING, code, BLACK_KING])
+    draws = [2] * 31332
+    write_table(os.path.join(directory, name + '.rtbw'), WDL_MAGIC, 0x01,
+                [order + bytes(piece | piece << 4 for piece in pieces)],
+                [compress(draws, 0, WDL_MAGIC)] * 2)
+    write_table(os.path.join(directory, name + '.rtbz'), DTZ_MAGIC, 0,
+                [order + pieces], [compress([0] * 31332, 0, DTZ_MAGIC)])
+
+
+def main():
+    directory = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.abspath(__file__))
+    # Underpromotions in KPvK reach these
+    build_draw(directory, 'KBvK', WHITE_BISHOP)
+    build_draw(directory, 'KNvK', WHITE_KNIGHT)
+    queen = build(directory, 'KQvK', 'Q', {})
+    rook = build(directory, 'KRvK', 'R', {})
+    build(directory, 'KPvK', 'P', {'Q': queen, 'R': rook})
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,205 @@
+/**
+ * @file perft_test.c
+ * @brief Differential perft tests of the move generators
+ *
+ * For every position of an EPD file, walks the move tree to a small depth
+ * with a game of each move generator, checking at every node that both list
+ * the same moves, then checks the perft counts given in the file (";D<depth>
+ * <nodes>" fields) with the bitboard generator.
+ *
+ * Usage: perft_test [file.epd] [differential depth]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simplechess/simplechess.h"
+
+#ifndef PERFT_EPD
+#define PERFT_EPD "tests/data/perft.epd"
+#endif
+
+#define MAX_MOVES 256
+
+static SimplechessGameManager default_manager;
+static SimplechessGameManager bitboard_manager;
+
+static int move_key(const SimplechessPieceMove* move) {
+    int src = (move->src.rank - 1) * 8 + (move->src.file - 'a');
+    int dst = (move->dst.rank - 1) * 8 + (move->dst.file - 'a');
+    return (src * 64 + dst) * 8 + (move->is_promotion ? (int)move->promoted_type + 1 : 0);
+}
+
+static int compare_moves(const void* a, const void* b) {
+    return move_key(a) - move_key(b);
+}
+
+static int same_moves(const SimplechessPieceMove* a, const SimplechessPieceMove* b, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (move_key(&a[i]) != move_key(&b[i]) || a[i].piece.type != b[i].piece.type || a[i].piece.color != b[i].piece.color) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static size_t sorted_moves(SimplechessGame game, SimplechessPieceMove* moves) {
+    size_t count = 0;
+    if (simplechess_game_get_available_moves_count(game, &count) != SIMPLECHESS_SUCCESS || count > MAX_MOVES
+        || (count && simplechess_game_get_available_moves(game, moves, MAX_MOVES) != SIMPLECHESS_SUCCESS)) {
+        return (size_t)-1;
+    }
+    qsort(moves, count, sizeof(*moves), compare_moves);
+    return count;
+}
+
+static void print_line(const char* fen, const SimplechessPieceMove* line, int length) {
+    printf("    at %s moves", fen);
+    for (int i = 0; i < length; i++) {
+        printf(" %c%d%c%d", line[i].src.file, line[i].src.rank, line[i].dst.file, line[i].dst.rank);
+    }
+    printf("\n");
+}
+
+/* Returns the number of leaves, or -1 after reporting a mismatch. */
+static long long walk(const char* fen, SimplechessGame reference, SimplechessGame bitboard, int depth,
+                      SimplechessPieceMove* line, int ply) {
+    SimplechessPieceMove expected[MAX_MOVES], actual[MAX_MOVES];
+    size_t n = sorted_moves(reference, expected);
+    size_t m = sorted_moves(bitboard, actual);
+    if (n == (size_t)-1 || m == (size_t)-1) {
+        printf("    move query failed\n");
+        print_line(fen, line, ply);
+        return -1;
+    }
+    if (n != m || !same_moves(expected, actual, n)) {
+        printf("    %zu moves from the default generator, %zu from the bitboard one\n", n, m);
+        print_line(fen, line, ply);
+        return -1;
+    }
+    if (depth == 0) {
+        return 1;
+    }
+
+    long long leaves = 0;
+    for (size_t i = 0; i < n; i++) {
+        SimplechessGame next_reference, next_bitboard;
+        if (simplechess_make_move(default_manager, reference, &expected[i], false, &next_reference) != SIMPLECHESS_SUCCESS) {
+            return -1;
+        }
+        if (simplechess_make_move(bitboard_manager, bitboard, &expected[i], false, &next_bitboard) != SIMPLECHESS_SUCCESS) {
+            simplechess_game_destroy(next_reference);
+            return -1;
+        }
+        line[ply] = expected[i];
+        long long below = walk(fen, next_reference, next_bitboard, depth - 1, line, ply + 1);
+        simplechess_game_destroy(next_reference);
+        simplechess_game_destroy(next_bitboard);
+        if (below < 0) {
+            return -1;
+        }
+        leaves += below;
+    }
+    return leaves;
+}
+
+static int check_position(char* entry, int differential_depth) {
+    char* fields = strchr(entry, ';');
+    if (fields) {
+        *fields++ = '\0';
+    }
+    size_t length = strlen(entry);
+    while (length && (entry[length - 1] == ' ' || entry[length - 1] == '\t')) {
+        entry[--length] = '\0';
+    }
+    printf("%s\n", entry);
+
+    SimplechessGame reference, bitboard;
+    if (simplechess_create_game_from_fen(default_manager, entry, &reference) != SIMPLECHESS_SUCCESS) {
+        printf("  ✗ cannot create the game\n");
+        return 0;
+    }
+    if (simplechess_create_game_from_fen(bitboard_manager, entry, &bitboard) != SIMPLECHESS_SUCCESS) {
+        simplechess_game_destroy(reference);
+        printf("  ✗ cannot create the game\n");
+        return 0;
+    }
+
+    int ok = 1;
+    SimplechessPieceMove line[64];
+    long long leaves = walk(entry, reference, bitboard, differential_depth, line, 0);
+    if (leaves < 0) {
+        ok = 0;
+    }
+
+    while (ok && fields && *fields) {
+        unsigned depth;
+        unsigned long long expected;
+        int consumed = 0;
+        while (*fields == ' ' || *fields == ';') {
+            fields++;
+        }
+        if (!*fields || *fields == '\n') {
+            break;
+        }
+        if (sscanf(fields, "D%u %llu%n", &depth, &expected, &consumed) != 2) {
+            printf("  ✗ malformed field: %s\n", fields);
+            ok = 0;
+            break;
+        }
+        fields += consumed;
+
+        uint64_t nodes = 0;
+        if (simplechess_game_perft(bitboard, depth, &nodes) != SIMPLECHESS_SUCCESS || nodes != expected) {
+            printf("  ✗ perft %u: expected %llu, got %llu\n", depth, expected, (unsigned long long)nodes);
+            ok = 0;
+        }
+    }
+
+    simplechess_game_destroy(reference);
+    simplechess_game_destroy(bitboard);
+    printf("  %s\n", ok ? "✓ PASSED" : "✗ FAILED");
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : PERFT_EPD;
+    int differential_depth = argc > 2 ? atoi(argv[2]) : 2;
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("Cannot open %s\n", path);
+        return 1;
+    }
+    if (simplechess_game_manager_create(&default_manager) != SIMPLECHESS_SUCCESS
+        || simplechess_game_manager_create_with_move_generator(SIMPLECHESS_MOVE_GENERATOR_BITBOARD, &bitboard_manager)
+               != SIMPLECHESS_SUCCESS) {
+        printf("Cannot create the game managers\n");
+        fclose(file);
+        return 1;
+    }
+
+    char entry[512];
+    int passed = 0, failed = 0;
+    while (fgets(entry, sizeof(entry), file)) {
+        entry[strcspn(entry, "\r\n")] = '\0';
+        if (!entry[0] || entry[0] == '#') {
+            continue;
+        }
+        if (check_position(entry, differential_depth)) {
+            passed++;
+        } else {
+            failed++;
+        }
+    }
+    fclose(file);
+    simplechess_game_manager_destroy(default_manager);
+    simplechess_game_manager_destroy(bitboard_manager);
+
+    printf("==========================================\n");
+    printf("Perft Results:\n");
+    printf("  Positions: %d\n", passed + failed);
+    printf("  Passed: %d\n", passed);
+    printf("  Failed: %d\n", failed);
+    return failed == 0 && passed > 0 ? 0 : 1;
+}
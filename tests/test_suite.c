@@ -10,8 +10,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
 #include "simplechess/simplechess.h"
 
+#ifndef SYZYGY_PATH
+#define SYZYGY_PATH "tests/data/syzygy"
+#endif
+
 /* ========================================================================== */
 /* Test Framework                                                             */
 /* ========================================================================== */
@@ -632,6 +637,9 @@ static int test_result_to_string(void) {
     str = simplechess_result_to_string(SIMPLECHESS_ERROR_UNKNOWN);
     ASSERT_STR_EQ(str, "Unknown error");
 
+    str = simplechess_result_to_string(SIMPLECHESS_ERROR_CONFLICT);
+    ASSERT_STR_EQ(str, "Conflicting update");
+
     // Test invalid result code
     str = simplechess_result_to_string((SimplechessResult)999);
     ASSERT_STR_EQ(str, "Invalid result code");
@@ -1081,6 +1089,1843 @@ static int test_draw_offer_functionality(void) {
     return 1;
 }
 
+/**
+ * Write a Syzygy table file into a directory, padded to the size the format
+ * requires (16 bytes past a multiple of 64)
+ */
+static int write_table_file(const char* directory, const char* name, const unsigned char* bytes, size_t size) {
+    char path[256];
+    unsigned char padded[80] = {0};
+    memcpy(padded, bytes, size);
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return 0;
+    }
+    size_t written = fwrite(padded, 1, sizeof(padded), file);
+    fclose(file);
+    return written == sizeof(padded);
+}
+
+static void remove_table_file(const char* directory, const char* name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    remove(path);
+}
+
+static int check_tablebase_adjudication_clock(const char* directory) {
+    SimplechessGameManager manager;
+    SimplechessGame game;
+    SimplechessTablebase tablebase;
+    SimplechessClockService service;
+    SimplechessTimeControl control = {500, 0, SIMPLECHESS_CLOCK_INCREMENT};
+    SimplechessGameState state;
+    SimplechessWdl wdl;
+    SimplechessResult result;
+    uint8_t max_pieces;
+    bool adjudicated;
+    int dtz;
+
+    result = simplechess_game_manager_create(&manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_tablebase_open(directory, &tablebase);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_tablebase_get_max_pieces(tablebase, &max_pieces);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(max_pieces, 3);
+
+    // Fresh clock: the win is adjudicated as is
+    result = simplechess_create_game_from_fen(manager, "8/8/8/4k3/8/8/8/3QK3 w - - 0 1", &game);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_tablebase_probe_wdl(tablebase, game, &wdl);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(wdl, SIMPLECHESS_WDL_WIN);
+
+    result = simplechess_tablebase_probe_dtz(tablebase, game, &dtz);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(dtz, 20);
+
+    result = simplechess_game_get_adjudicated_state(game, tablebase, &state, &adjudicated);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT(adjudicated);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_WHITE_WON);
+    simplechess_game_destroy(game);
+
+    // 80 + 20 plies still reaches the zeroing move in time
+    result = simplechess_create_game_from_fen(manager, "8/8/8/4k3/8/8/8/3QK3 w - - 80 60", &game);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_game_get_adjudicated_state(game, tablebase, &state, &adjudicated);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT(adjudicated);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_WHITE_WON);
+    simplechess_game_destroy(game);
+
+    // 90 + 20 plies does not: a fifty-move draw
+    result = simplechess_create_game_from_fen(manager, "8/8/8/4k3/8/8/8/3QK3 w - - 90 60", &game);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_game_get_adjudicated_state(game, tablebase, &state, &adjudicated);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT(adjudicated);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_DRAWN);
+    simplechess_game_destroy(game);
+
+    // A fallen flag ends the game before the tablebase is consulted: white
+    // runs out of time against a bare king, which is a draw
+    result = simplechess_clock_service_create(10, &service);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_create_game_from_fen(manager, "8/8/8/4k3/8/8/8/3QK3 w - - 0 1", &game);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_start_clock(game, service, &control, 1), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_clock_service_advance(service, 1000, NULL, NULL), SIMPLECHESS_SUCCESS);
+
+    adjudicated = true;
+    result = simplechess_game_get_adjudicated_state(game, tablebase, &state, &adjudicated);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT(!adjudicated);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_DRAWN);
+
+    result = simplechess_tablebase_probe_wdl(tablebase, game, &wdl);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_ILLEGAL_STATE);
+    simplechess_game_destroy(game);
+    simplechess_clock_service_destroy(service);
+
+    simplechess_tablebase_destroy(tablebase);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+/**
+ * Test that adjudication accounts for the fifty-move clock of the game
+ */
+static int test_tablebase_adjudication_clock(void) {
+    /* KQvK tables holding a single value: a win for white to move (a loss
+     * for black) and a DTZ of 20 plies, stored through the DTZ value map */
+    static const unsigned char wdl_table[] = {
+        0x71, 0xE8, 0x23, 0x5D, // Magic
+        0x01,                   // Both sides to move
+        0x00, 0x66, 0x55, 0xEE, // Group order, then K, Q, k for each side
+        0x00,                   // Padding
+        0x80, 0x04,             // White to move: single value, win
+        0x80, 0x00              // Black to move: single value, loss
+    };
+    static const unsigned char dtz_table[] = {
+        0xD7, 0x66, 0x0C, 0xA5, // Magic
+        0x00,
+        0x00, 0x06, 0x05, 0x0E, // Group order, then K, Q, k
+        0x00,                   // Padding
+        0x86, 0x00,             // Single value, mapped, wins in plies
+        0x01, 19, 0x01, 0, 0x01, 0, 0x01, 0 // Value maps by outcome
+    };
+    char directory[] = "/tmp/simplechess_tables_XXXXXX";
+    ASSERT(mkdtemp(directory) != NULL);
+
+    // The directory is removed whether or not the checks pass
+    int passed = write_table_file(directory, "KQvK.rtbw", wdl_table, sizeof(wdl_table))
+              && write_table_file(directory, "KQvK.rtbz", dtz_table, sizeof(dtz_table))
+              && check_tablebase_adjudication_clock(directory);
+    remove_table_file(directory, "KQvK.rtbw");
+    remove_table_file(directory, "KQvK.rtbz");
+    rmdir(directory);
+    return passed;
+}
+
+typedef struct {
+    const char* fen;
+    SimplechessWdl wdl;
+    int dtz;
+} TablebaseCase;
+
+static int check_tablebase_case(SimplechessGameManager manager, SimplechessTablebase tablebase,
+                                const TablebaseCase* test_case) {
+    SimplechessGame game;
+    SimplechessWdl wdl;
+    int dtz;
+
+    ASSERT_EQ(simplechess_create_game_from_fen(manager, test_case->fen, &game), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_tablebase_probe_wdl(tablebase, game, &wdl), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(wdl, test_case->wdl);
+    ASSERT_EQ(simplechess_tablebase_probe_dtz(tablebase, game, &dtz), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(dtz, test_case->dtz);
+    simplechess_game_destroy(game);
+    return 1;
+}
+
+/**
+ * Test probing the three-piece tables in tests/data/syzygy (built by
+ * generate.py there). DTZ tables store white to move, so the black to move
+ * cases go through the one-ply search, and the colors swapped cases through
+ * the flipped lookup.
+ */
+static int test_tablebase_probe_tables(void) {
+    static const TablebaseCase cases[] = {
+        // KQvK: Qc8 mates, and black to move is mated in four plies
+        {"k7/8/1K6/8/8/8/8/2Q5 w - - 0 1", SIMPLECHESS_WDL_WIN, 1},
+        {"k7/8/1K6/8/8/8/8/2Q5 b - - 0 1", SIMPLECHESS_WDL_LOSS, -4},
+        // Black takes the undefended queen
+        {"7K/8/8/8/8/8/1k6/Q7 b - - 0 1", SIMPLECHESS_WDL_DRAW, 0},
+        // Every piece on the a1-h8 diagonal, then the same with colors swapped
+        {"8/8/5k2/8/3K4/8/1Q6/8 w - - 0 1", SIMPLECHESS_WDL_WIN, 11},
+        {"8/8/5k2/8/3K4/8/1Q6/8 b - - 0 1", SIMPLECHESS_WDL_LOSS, -12},
+        {"8/1q6/8/3k4/8/5K2/8/8 b - - 0 1", SIMPLECHESS_WDL_WIN, 11},
+        // KRvK: Rh8 mates; the longest win (16 moves) and a diagonal position
+        {"k7/8/1K6/8/8/8/8/7R w - - 0 1", SIMPLECHESS_WDL_WIN, 1},
+        {"8/8/8/8/8/2k5/1R6/K7 w - - 0 1", SIMPLECHESS_WDL_WIN, 31},
+        {"8/8/8/8/8/2k5/1R6/K7 b - - 0 1", SIMPLECHESS_WDL_LOSS, -32},
+        {"k7/1r6/2K5/8/8/8/8/8 b - - 0 1", SIMPLECHESS_WDL_WIN, 31},
+        {"8/8/8/4k3/8/2K5/8/R7 w - - 0 1", SIMPLECHESS_WDL_WIN, 25},
+        // KPvK: the king in front of the pawn on the sixth rank wins with
+        // either side to move, the pawn moves on the third ply
+        {"4k3/8/4K3/4P3/8/8/8/8 w - - 0 1", SIMPLECHESS_WDL_WIN, 3},
+        {"4k3/8/4K3/4P3/8/8/8/8 b - - 0 1", SIMPLECHESS_WDL_LOSS, -4},
+        {"8/8/8/8/4p3/4k3/8/4K3 w - - 0 1", SIMPLECHESS_WDL_LOSS, -4},
+        // The king behind the pawn draws, as does a rook pawn
+        {"4k3/8/4P3/4K3/8/8/8/8 w - - 0 1", SIMPLECHESS_WDL_DRAW, 0},
+        {"k7/8/1K6/P7/8/8/8/8 w - - 0 1", SIMPLECHESS_WDL_DRAW, 0},
+        // Promoting wins at once, unless it stalemates: then the king moves
+        // first
+        {"8/4P1k1/8/8/8/8/8/K7 w - - 0 1", SIMPLECHESS_WDL_WIN, 1},
+        {"8/6P1/8/8/8/7K/8/7k w - - 0 1", SIMPLECHESS_WDL_WIN, 3},
+        // Black takes the undefended pawn
+        {"8/8/8/8/8/8/3kP3/7K b - - 0 1", SIMPLECHESS_WDL_DRAW, 0},
+    };
+    SimplechessGameManager manager;
+    SimplechessTablebase tablebase;
+    uint8_t max_pieces;
+
+    ASSERT_EQ(simplechess_game_manager_create(&manager), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_tablebase_open(SYZYGY_PATH, &tablebase), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_tablebase_get_max_pieces(tablebase, &max_pieces), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(max_pieces, 3);
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (!check_tablebase_case(manager, tablebase, &cases[i])) {
+            printf("    ... in %s\n", cases[i].fen);
+            return 0;
+        }
+    }
+
+    simplechess_tablebase_destroy(tablebase);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+/**
+ * Test tablebase probing when no tables are available
+ */
+static int test_tablebase_without_tables(void) {
+    SimplechessGameManager manager;
+    SimplechessGame game;
+    SimplechessTablebase tablebase;
+    SimplechessGameState state;
+    SimplechessWdl wdl;
+    SimplechessResult result;
+    uint8_t max_pieces = 99;
+    bool adjudicated = true;
+    int dtz;
+
+    result = simplechess_game_manager_create(&manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    // KQ vs K: a trivial win, but there are no tables to look it up in
+    result = simplechess_create_game_from_fen(manager, "8/8/8/4k3/8/8/8/3QK3 w - - 0 1", &game);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_tablebase_open("/nonexistent/syzygy:/also/missing", &tablebase);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_tablebase_get_max_pieces(tablebase, &max_pieces);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(max_pieces, 0);
+
+    result = simplechess_tablebase_probe_wdl(tablebase, game, &wdl);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_ILLEGAL_STATE);
+
+    result = simplechess_tablebase_probe_dtz(tablebase, game, &dtz);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_ILLEGAL_STATE);
+
+    // Adjudication falls back to the regular game state
+    result = simplechess_game_get_adjudicated_state(game, tablebase, &state, &adjudicated);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_PLAYING);
+    ASSERT(!adjudicated);
+
+    adjudicated = true;
+    result = simplechess_game_get_adjudicated_state(game, NULL, &state, &adjudicated);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_PLAYING);
+    ASSERT(!adjudicated);
+
+    // Null arguments
+    result = simplechess_tablebase_open(NULL, &tablebase);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    result = simplechess_tablebase_probe_wdl(tablebase, NULL, &wdl);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    result = simplechess_game_get_adjudicated_state(game, tablebase, NULL, &adjudicated);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    simplechess_tablebase_destroy(tablebase);
+    simplechess_game_destroy(game);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+/**
+ * Test the session store
+ */
+static int test_session_store(void) {
+    SimplechessGameManager manager;
+    SimplechessSessionStore store;
+    SimplechessGame game;
+    SimplechessGameState state;
+    SimplechessColor color;
+    SimplechessResult result;
+    size_t count, length;
+
+    result = simplechess_game_manager_create(&manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_session_store_create(manager, 0, &store);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_session_store_create_game(store, 1, NULL);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_session_store_create_game(store, 2, "4k3/8/8/8/8/8/4P3/4K3 w - - 0 1");
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    // Ids are unique
+    result = simplechess_session_store_create_game(store, 1, NULL);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    result = simplechess_session_store_count(store, &count);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(count, 2);
+
+    // Keep a handle to the game before the move
+    SimplechessGame before;
+    result = simplechess_session_store_lookup(store, 1, &before);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    SimplechessPiece pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_WHITE};
+    SimplechessSquare e2 = {2, 'e'};
+    SimplechessSquare e4 = {4, 'e'};
+    SimplechessSquare e5 = {5, 'e'};
+    SimplechessPieceMove move;
+    result = simplechess_piece_move_regular(&pawn, &e2, &e4, &move);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_session_store_make_move(store, 1, &move, false, &state);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_PLAYING);
+
+    // The same move is no longer legal
+    result = simplechess_session_store_make_move(store, 1, &move, false, NULL);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_ILLEGAL_STATE);
+
+    result = simplechess_session_store_lookup(store, 1, &game);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_game_get_active_color(game, &color);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(color, SIMPLECHESS_COLOR_BLACK);
+    result = simplechess_game_get_history_length(game, &length);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(length, 2);
+    simplechess_game_destroy(game);
+
+    // Earlier handles are unaffected
+    result = simplechess_game_get_active_color(before, &color);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(color, SIMPLECHESS_COLOR_WHITE);
+
+    // Games are independent
+    result = simplechess_piece_move_regular(&pawn, &e2, &e4, &move);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_session_store_make_move(store, 2, &move, false, &state);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_session_store_resign(store, 2, SIMPLECHESS_COLOR_BLACK, &state);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_WHITE_WON);
+
+    result = simplechess_piece_move_regular(&pawn, &e4, &e5, &move);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_session_store_make_move(store, 2, &move, false, &state);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_ILLEGAL_STATE);
+
+    // Inserting an existing game shares it with the caller
+    result = simplechess_session_store_insert(store, 3, before);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    simplechess_game_destroy(before);
+
+    result = simplechess_session_store_remove(store, 2);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_session_store_remove(store, 2);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    result = simplechess_session_store_lookup(store, 2, &game);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    result = simplechess_session_store_count(store, &count);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(count, 2);
+
+    result = simplechess_session_store_lookup(store, 3, &game);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_game_get_active_color(game, &color);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(color, SIMPLECHESS_COLOR_WHITE);
+
+    simplechess_session_store_destroy(store);
+
+    // Handles outlive the store
+    result = simplechess_game_get_history_length(game, &length);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(length, 1);
+
+    simplechess_game_destroy(game);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+/**
+ * Test writing and restoring snapshots
+ */
+static int test_snapshot_round_trip(void) {
+    const char* path = "simplechess_test_snapshot.bin";
+    SimplechessGameManager manager;
+    SimplechessSessionStore store, restored_store;
+    SimplechessSnapshot snapshot;
+    SimplechessGame original, restored;
+    SimplechessGameStage original_stage, restored_stage;
+    SimplechessGameState state;
+    SimplechessResult result;
+    SimplechessPieceMove move;
+    size_t count, original_length, restored_length, i;
+    uint64_t id;
+    char original_fen[128], restored_fen[128];
+
+    result = simplechess_game_manager_create(&manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_session_store_create(manager, 4, &store);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    // Game 7: 1. e4 d5 2. exd5 Nf6, with a draw offer on the last move
+    result = simplechess_session_store_create_game(store, 7, NULL);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    SimplechessPiece white_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_WHITE};
+    SimplechessPiece black_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_BLACK};
+    SimplechessPiece black_knight = {SIMPLECHESS_PIECE_TYPE_KNIGHT, SIMPLECHESS_COLOR_BLACK};
+    SimplechessSquare e2 = {2, 'e'}, e4 = {4, 'e'}, d7 = {7, 'd'}, d5 = {5, 'd'}, g8 = {8, 'g'}, f6 = {6, 'f'};
+
+    simplechess_piece_move_regular(&white_pawn, &e2, &e4, &move);
+    ASSERT_EQ(simplechess_session_store_make_move(store, 7, &move, false, NULL), SIMPLECHESS_SUCCESS);
+    simplechess_piece_move_regular(&black_pawn, &d7, &d5, &move);
+    ASSERT_EQ(simplechess_session_store_make_move(store, 7, &move, false, NULL), SIMPLECHESS_SUCCESS);
+    simplechess_piece_move_regular(&white_pawn, &e4, &d5, &move);
+    ASSERT_EQ(simplechess_session_store_make_move(store, 7, &move, false, NULL), SIMPLECHESS_SUCCESS);
+    simplechess_piece_move_regular(&black_knight, &g8, &f6, &move);
+    ASSERT_EQ(simplechess_session_store_make_move(store, 7, &move, true, NULL), SIMPLECHESS_SUCCESS);
+
+    // Game 9: resigned before any move
+    result = simplechess_session_store_create_game(store, 9, NULL);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_session_store_resign(store, 9, SIMPLECHESS_COLOR_WHITE, NULL);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_snapshot_write_store(path, store);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_snapshot_open(path, &snapshot);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_snapshot_get_count(snapshot, &count);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(count, 2);
+
+    result = simplechess_session_store_create(manager, 0, &restored_store);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_snapshot_restore_store(snapshot, restored_store, 2);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    // Every stage of game 7 matches, including those before the capture
+    ASSERT_EQ(simplechess_session_store_lookup(store, 7, &original), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_lookup(restored_store, 7, &restored), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_history_length(original, &original_length), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_history_length(restored, &restored_length), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(restored_length, original_length);
+    for (i = 0; i < original_length; i++) {
+        ASSERT_EQ(simplechess_game_get_stage_at(original, i, &original_stage), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_game_get_stage_at(restored, i, &restored_stage), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_stage_get_fen(original_stage, original_fen, sizeof(original_fen)), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_stage_get_fen(restored_stage, restored_fen, sizeof(restored_fen)), SIMPLECHESS_SUCCESS);
+        ASSERT_STR_EQ(restored_fen, original_fen);
+
+        SimplechessPlayedMove played_move;
+        bool has_move, offered;
+        ASSERT_EQ(simplechess_stage_get_move(restored_stage, &played_move, &has_move), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(has_move, i > 0);
+        if (has_move) {
+            ASSERT_EQ(simplechess_played_move_is_draw_offered(played_move, &offered), SIMPLECHESS_SUCCESS);
+            ASSERT_EQ(offered, i == original_length - 1);
+            simplechess_played_move_destroy(played_move);
+        }
+        simplechess_game_stage_destroy(original_stage);
+        simplechess_game_stage_destroy(restored_stage);
+    }
+    simplechess_game_destroy(original);
+
+    // The draw offer on the last move can still be accepted
+    ASSERT_EQ(simplechess_claim_draw(manager, restored, &original), SIMPLECHESS_SUCCESS);
+    simplechess_game_destroy(original);
+    simplechess_game_destroy(restored);
+
+    // Game 9 is still resigned
+    result = simplechess_snapshot_restore_game(snapshot, manager, 1, &id, &restored);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    if (id != 9) {
+        simplechess_game_destroy(restored);
+        result = simplechess_snapshot_restore_game(snapshot, manager, 0, &id, &restored);
+        ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    }
+    ASSERT_EQ(id, 9);
+    ASSERT_EQ(simplechess_game_get_state(restored, &state), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_BLACK_WON);
+    simplechess_game_destroy(restored);
+
+    // Restoring again into the same store collides on ids
+    result = simplechess_snapshot_restore_store(snapshot, restored_store, 1);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    result = simplechess_snapshot_restore_game(snapshot, manager, 2, &id, &restored);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    simplechess_snapshot_close(snapshot);
+
+    // Corrupt files are rejected
+    FILE* file = fopen(path, "r+b");
+    ASSERT(file != NULL);
+    fseek(file, 50, SEEK_SET);
+    fputc('X', file);
+    fclose(file);
+    result = simplechess_snapshot_open(path, &snapshot);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    remove(path);
+
+    result = simplechess_snapshot_open("/nonexistent/snapshot.bin", &snapshot);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    simplechess_session_store_destroy(restored_store);
+    simplechess_session_store_destroy(store);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+/**
+ * Test logging store changes and recovering them after a restart
+ */
+static int test_move_log_recovery(void) {
+    const char* log_path = "simplechess_test_moves.log";
+    const char* snapshot_path = "simplechess_test_checkpoint.bin";
+    SimplechessGameManager manager;
+    SimplechessSessionStore store, recovered_store;
+    SimplechessMoveLog log;
+    SimplechessGame original, recovered;
+    SimplechessGameState state;
+    SimplechessPieceMove move;
+    SimplechessResult result;
+    uint64_t last_lsn, durable_lsn;
+    size_t count, original_length, recovered_length;
+    char original_fen[128], recovered_fen[128];
+
+    remove(log_path);
+    remove(snapshot_path);
+
+    result = simplechess_game_manager_create(&manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_session_store_create(manager, 4, &store);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_move_log_open(log_path, &log);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_session_store_set_move_log(store, log);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    SimplechessPiece white_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_WHITE};
+    SimplechessPiece black_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_BLACK};
+    SimplechessSquare e2 = {2, 'e'}, e4 = {4, 'e'}, e7 = {7, 'e'}, e5 = {5, 'e'};
+
+    // Four changes before the checkpoint
+    ASSERT_EQ(simplechess_session_store_create_game(store, 1, NULL), SIMPLECHESS_SUCCESS);
+    simplechess_piece_move_regular(&white_pawn, &e2, &e4, &move);
+    ASSERT_EQ(simplechess_session_store_make_move(store, 1, &move, false, NULL), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_create_game(store, 2, NULL), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_resign(store, 2, SIMPLECHESS_COLOR_WHITE, NULL), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_move_log_sync(log), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_move_log_get_lsn(log, &last_lsn, &durable_lsn), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(last_lsn, 4);
+    ASSERT_EQ(durable_lsn, 4);
+
+    result = simplechess_move_log_checkpoint(log, store, snapshot_path);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    // Three more that only the log has
+    simplechess_piece_move_regular(&black_pawn, &e7, &e5, &move);
+    ASSERT_EQ(simplechess_session_store_make_move(store, 1, &move, false, NULL), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_create_game(store, 3, "8/8/8/4k3/8/8/4P3/4K3 w - - 0 1"), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_remove(store, 2), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_move_log_sync(log), SIMPLECHESS_SUCCESS);
+
+    ASSERT_EQ(simplechess_session_store_set_move_log(store, NULL), SIMPLECHESS_SUCCESS);
+    simplechess_move_log_close(log);
+
+    // A record torn by a crash is ignored
+    FILE* file = fopen(log_path, "ab");
+    ASSERT(file != NULL);
+    fputs("torn", file);
+    fclose(file);
+
+    result = simplechess_session_store_create(manager, 0, &recovered_store);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_move_log_recover(recovered_store, snapshot_path, log_path, 2);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_count(recovered_store, &count), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(count, 2);
+    ASSERT_EQ(simplechess_session_store_lookup(recovered_store, 2, &recovered), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    ASSERT_EQ(simplechess_session_store_lookup(store, 1, &original), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_lookup(recovered_store, 1, &recovered), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_history_length(original, &original_length), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_history_length(recovered, &recovered_length), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(recovered_length, 3);
+    ASSERT_EQ(recovered_length, original_length);
+    ASSERT_EQ(simplechess_game_get_current_fen(original, original_fen, sizeof(original_fen)), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_current_fen(recovered, recovered_fen, sizeof(recovered_fen)), SIMPLECHESS_SUCCESS);
+    ASSERT_STR_EQ(recovered_fen, original_fen);
+    simplechess_game_destroy(original);
+    simplechess_game_destroy(recovered);
+
+    ASSERT_EQ(simplechess_session_store_lookup(recovered_store, 3, &recovered), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_state(recovered, &state), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_PLAYING);
+    simplechess_game_destroy(recovered);
+
+    // Reopening cuts the torn record and continues the numbering
+    result = simplechess_move_log_open(log_path, &log);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_move_log_get_lsn(log, &last_lsn, NULL), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(last_lsn, 7);
+
+    // Recovery refuses a store that is already logging
+    ASSERT_EQ(simplechess_session_store_set_move_log(recovered_store, log), SIMPLECHESS_SUCCESS);
+    result = simplechess_move_log_recover(recovered_store, NULL, log_path, 1);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_ILLEGAL_STATE);
+    ASSERT_EQ(simplechess_session_store_set_move_log(recovered_store, NULL), SIMPLECHESS_SUCCESS);
+    simplechess_move_log_close(log);
+
+    result = simplechess_move_log_open(snapshot_path, &log);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    remove(log_path);
+    remove(snapshot_path);
+    simplechess_session_store_destroy(recovered_store);
+    simplechess_session_store_destroy(store);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+/**
+ * Test attaching a move log to a store that already holds games
+ */
+static int test_move_log_attach_to_live_store(void) {
+    const char* log_path = "simplechess_test_attach.log";
+    SimplechessGameManager manager;
+    SimplechessSessionStore stores[3];
+    SimplechessMoveLog log;
+    SimplechessGame game;
+    SimplechessPieceMove move;
+    size_t count;
+    char fens[3][128];
+
+    remove(log_path);
+    ASSERT_EQ(simplechess_game_manager_create(&manager), SIMPLECHESS_SUCCESS);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(simplechess_session_store_create(manager, 4, &stores[i]), SIMPLECHESS_SUCCESS);
+    }
+
+    // A game created and played before the log exists, then one move logged
+    SimplechessPiece white_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_WHITE};
+    SimplechessPiece black_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_BLACK};
+    SimplechessSquare e2 = {2, 'e'}, e4 = {4, 'e'}, e7 = {7, 'e'}, e5 = {5, 'e'};
+    ASSERT_EQ(simplechess_session_store_create_game(stores[0], 1, NULL), SIMPLECHESS_SUCCESS);
+    simplechess_piece_move_regular(&white_pawn, &e2, &e4, &move);
+    ASSERT_EQ(simplechess_session_store_make_move(stores[0], 1, &move, false, NULL), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_move_log_open(log_path, &log), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_set_move_log(stores[0], log), SIMPLECHESS_SUCCESS);
+    simplechess_piece_move_regular(&black_pawn, &e7, &e5, &move);
+    ASSERT_EQ(simplechess_session_store_make_move(stores[0], 1, &move, false, NULL), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_set_move_log(stores[0], NULL), SIMPLECHESS_SUCCESS);
+    simplechess_move_log_close(log);
+
+    // The log alone rebuilds the game, and still does after the recovered
+    // store is attached to it again, which restates the game
+    ASSERT_EQ(simplechess_move_log_recover(stores[1], NULL, log_path, 1), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_move_log_open(log_path, &log), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_set_move_log(stores[1], log), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_set_move_log(stores[1], NULL), SIMPLECHESS_SUCCESS);
+    simplechess_move_log_close(log);
+    ASSERT_EQ(simplechess_move_log_recover(stores[2], NULL, log_path, 1), SIMPLECHESS_SUCCESS);
+
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(simplechess_session_store_count(stores[i], &count), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(count, 1);
+        ASSERT_EQ(simplechess_session_store_lookup(stores[i], 1, &game), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_game_get_current_fen(game, fens[i], sizeof(fens[i])), SIMPLECHESS_SUCCESS);
+        simplechess_game_destroy(game);
+    }
+    ASSERT_STR_EQ(fens[1], fens[0]);
+    ASSERT_STR_EQ(fens[2], fens[0]);
+
+    remove(log_path);
+    for (int i = 0; i < 3; i++) {
+        simplechess_session_store_destroy(stores[i]);
+    }
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+typedef struct {
+    SimplechessClockEvent events[4];
+    size_t count;
+} ClockEvents;
+
+static void collect_clock_events(void* user_data, const SimplechessClockEvent* events, size_t count) {
+    ClockEvents* collected = (ClockEvents*)user_data;
+    for (size_t i = 0; i < count && collected->count < 4; i++) {
+        collected->events[collected->count++] = events[i];
+    }
+}
+
+static int test_clock_flag(void) {
+    SimplechessGameManager manager;
+    SimplechessClockService service;
+    SimplechessGame game, after_e4, after_e5, bare;
+    SimplechessClockState clock;
+    SimplechessGameState state;
+    SimplechessDrawReason reason;
+    SimplechessPieceMove move;
+    SimplechessResult result;
+    ClockEvents fired = {0};
+
+    result = simplechess_game_manager_create(&manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_clock_service_create(10, &service);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_create_new_game(manager, &game);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    ASSERT_EQ(simplechess_game_get_clock(game, &clock), SIMPLECHESS_ERROR_ILLEGAL_STATE);
+    SimplechessTimeControl control = {1000, 100, SIMPLECHESS_CLOCK_INCREMENT};
+    ASSERT_EQ(simplechess_game_start_clock(game, service, &control, 7), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_start_clock(game, service, &control, 7), SIMPLECHESS_ERROR_ILLEGAL_STATE);
+
+    // White spends 300 ms and gets the increment back
+    ASSERT_EQ(simplechess_clock_service_advance(service, 300, collect_clock_events, &fired), SIMPLECHESS_SUCCESS);
+    SimplechessPiece white_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_WHITE};
+    SimplechessSquare e2 = {2, 'e'}, e4 = {4, 'e'}, e7 = {7, 'e'}, e5 = {5, 'e'};
+    simplechess_piece_move_regular(&white_pawn, &e2, &e4, &move);
+    result = simplechess_make_move(manager, game, &move, false, &after_e4);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_clock(after_e4, &clock), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(clock.white_ms, 800);
+    ASSERT_EQ(clock.black_ms, 1000);
+    ASSERT(clock.running);
+    ASSERT_EQ(clock.running_color, SIMPLECHESS_COLOR_BLACK);
+
+    // Black's flag falls at 1300 ms
+    ASSERT_EQ(simplechess_clock_service_advance(service, 1299, collect_clock_events, &fired), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(fired.count, 0);
+    ASSERT_EQ(simplechess_game_get_state(after_e4, &state), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_PLAYING);
+    ASSERT_EQ(simplechess_clock_service_advance(service, 1300, collect_clock_events, &fired), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(fired.count, 1);
+    ASSERT_EQ(fired.events[0].id, 7);
+    ASSERT_EQ(fired.events[0].flagged, SIMPLECHESS_COLOR_BLACK);
+    ASSERT_EQ(simplechess_game_get_state(after_e4, &state), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_WHITE_WON);
+    ASSERT_EQ(simplechess_game_get_clock(after_e4, &clock), SIMPLECHESS_SUCCESS);
+    ASSERT(clock.flagged);
+    ASSERT_EQ(clock.black_ms, 0);
+
+    SimplechessPiece black_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_BLACK};
+    simplechess_piece_move_regular(&black_pawn, &e7, &e5, &move);
+    result = simplechess_make_move(manager, after_e4, &move, false, &after_e5);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_ILLEGAL_STATE);
+    ASSERT_EQ(simplechess_clock_service_advance(service, 1000, NULL, NULL), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    // Flagging against a bare king is a draw
+    result = simplechess_create_game_from_fen(manager, "8/8/8/4k3/8/8/4P3/4K3 w - - 0 1", &bare);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    control.initial_ms = 500;
+    ASSERT_EQ(simplechess_game_start_clock(bare, service, &control, 8), SIMPLECHESS_SUCCESS);
+    fired.count = 0;
+    ASSERT_EQ(simplechess_clock_service_advance(service, 5000, collect_clock_events, &fired), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(fired.count, 1);
+    ASSERT_EQ(fired.events[0].id, 8);
+    ASSERT_EQ(simplechess_game_get_state(bare, &state), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_DRAWN);
+    ASSERT_EQ(simplechess_game_get_draw_reason(bare, &reason), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(reason, SIMPLECHESS_DRAW_REASON_INSUFFICIENT_MATERIAL);
+
+    simplechess_game_destroy(bare);
+    simplechess_game_destroy(after_e4);
+    simplechess_game_destroy(game);
+    simplechess_clock_service_destroy(service);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+static int test_stage_diff(void) {
+    SimplechessGameManager manager;
+    SimplechessGame game, after_e4, castling, castled;
+    SimplechessGameStage first, current;
+    SimplechessSquareChange changes[64];
+    SimplechessStageDiff diff;
+    SimplechessPieceMove move;
+    SimplechessResult result;
+    size_t count;
+
+    result = simplechess_game_manager_create(&manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_create_new_game(manager, &game);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_game_get_last_move_diff(game, changes, 64, &count, &diff);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_ILLEGAL_STATE);
+
+    SimplechessPiece white_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_WHITE};
+    SimplechessSquare e2 = {2, 'e'}, e4 = {4, 'e'};
+    simplechess_piece_move_regular(&white_pawn, &e2, &e4, &move);
+    result = simplechess_make_move(manager, game, &move, false, &after_e4);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_game_get_last_move_diff(after_e4, changes, 64, &count, &diff);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(count, 2);
+    ASSERT_EQ(changes[0].square.rank, 2);
+    ASSERT_EQ(changes[0].square.file, 'e');
+    ASSERT(!changes[0].occupied);
+    ASSERT_EQ(changes[1].square.rank, 4);
+    ASSERT(changes[1].occupied);
+    ASSERT_EQ(changes[1].piece.type, SIMPLECHESS_PIECE_TYPE_PAWN);
+    ASSERT_EQ(changes[1].piece.color, SIMPLECHESS_COLOR_WHITE);
+    ASSERT(diff.changed & SIMPLECHESS_STAGE_DIFF_ACTIVE_COLOR);
+    ASSERT(!(diff.changed & SIMPLECHESS_STAGE_DIFF_CASTLING));
+    ASSERT(!(diff.changed & SIMPLECHESS_STAGE_DIFF_FULLMOVE_COUNTER));
+    ASSERT_EQ(diff.active_color, SIMPLECHESS_COLOR_BLACK);
+
+    // The same diff from two stage handles
+    ASSERT_EQ(simplechess_game_get_stage_at(after_e4, 0, &first), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_current_stage(after_e4, &current), SIMPLECHESS_SUCCESS);
+    result = simplechess_stage_diff(first, current, changes, 64, &count, NULL);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(count, 2);
+    result = simplechess_stage_diff(current, current, NULL, 0, &count, &diff);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(count, 0);
+    ASSERT_EQ(diff.changed, 0);
+
+    // Castling moves king and rook and drops both rights
+    result = simplechess_create_game_from_fen(manager, "r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 3 1", &castling);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    SimplechessPiece white_king = {SIMPLECHESS_PIECE_TYPE_KING, SIMPLECHESS_COLOR_WHITE};
+    SimplechessSquare e1 = {1, 'e'}, g1 = {1, 'g'};
+    simplechess_piece_move_regular(&white_king, &e1, &g1, &move);
+    result = simplechess_make_move(manager, castling, &move, false, &castled);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_game_get_last_move_diff(castled, changes, 2, &count, &diff);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(count, 4);
+    result = simplechess_game_get_last_move_diff(castled, changes, 64, &count, &diff);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(count, 4);
+    ASSERT_EQ(changes[1].square.file, 'f');
+    ASSERT_EQ(changes[1].piece.type, SIMPLECHESS_PIECE_TYPE_ROOK);
+    ASSERT_EQ(changes[2].square.file, 'g');
+    ASSERT_EQ(changes[2].piece.type, SIMPLECHESS_PIECE_TYPE_KING);
+    ASSERT(diff.changed & SIMPLECHESS_STAGE_DIFF_CASTLING);
+    ASSERT(diff.changed & SIMPLECHESS_STAGE_DIFF_HALFMOVE_CLOCK);
+    ASSERT_EQ(diff.castling_rights, SIMPLECHESS_CASTLING_BLACK_KINGSIDE | SIMPLECHESS_CASTLING_BLACK_QUEENSIDE);
+    ASSERT_EQ(diff.halfmove_clock, 4);
+
+    simplechess_game_stage_destroy(first);
+    simplechess_game_stage_destroy(current);
+    simplechess_game_destroy(castled);
+    simplechess_game_destroy(castling);
+    simplechess_game_destroy(after_e4);
+    simplechess_game_destroy(game);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+static int test_broadcast_update(void) {
+    SimplechessGameManager manager;
+    SimplechessSessionStore store;
+    SimplechessGame game, looked_up;
+    SimplechessUpdate first, update, shared;
+    SimplechessUpdateView view;
+    SimplechessPieceMove move;
+    SimplechessResult result;
+    char fen[128];
+
+    result = simplechess_game_manager_create(&manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_session_store_create(manager, 4, &store);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_create_game(store, 1, NULL), SIMPLECHESS_SUCCESS);
+
+    // The first stage lists every piece
+    ASSERT_EQ(simplechess_session_store_lookup(store, 1, &game), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_update(game, &first), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_update_get_view(first, &view), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(view.ply, 0);
+    ASSERT_EQ(view.san_length, 0);
+    ASSERT_EQ(view.delta[0], 32);
+    ASSERT_EQ(view.delta_size, 1 + 2 * 32 + 8);
+    simplechess_game_destroy(game);
+
+    SimplechessPiece white_knight = {SIMPLECHESS_PIECE_TYPE_KNIGHT, SIMPLECHESS_COLOR_WHITE};
+    SimplechessSquare g1 = {1, 'g'}, f3 = {3, 'f'};
+    simplechess_piece_move_regular(&white_knight, &g1, &f3, &move);
+    ASSERT_EQ(simplechess_session_store_make_move(store, 1, &move, false, NULL), SIMPLECHESS_SUCCESS);
+
+    ASSERT_EQ(simplechess_session_store_lookup(store, 1, &game), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_update(game, &update), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_update_get_view(update, &view), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(view.ply, 1);
+    ASSERT_STR_EQ(view.san, "Nf3");
+    ASSERT_EQ(simplechess_game_get_current_fen(game, fen, sizeof(fen)), SIMPLECHESS_SUCCESS);
+    ASSERT_STR_EQ(view.fen, fen);
+    ASSERT_EQ(view.fen_length, strlen(fen));
+    ASSERT_EQ(view.message_size, view.san_length + view.fen_length + 2 + view.delta_size);
+
+    // g1 emptied, f3 gets a white knight, black to move
+    ASSERT_EQ(view.delta_size, 1 + 2 * 2 + 8);
+    ASSERT_EQ(view.delta[0], 2);
+    ASSERT_EQ(view.delta[1], 6);
+    ASSERT_EQ(view.delta[2], 0);
+    ASSERT_EQ(view.delta[3], 21);
+    ASSERT_EQ(view.delta[4], SIMPLECHESS_PIECE_TYPE_KNIGHT + 1);
+    ASSERT(view.delta[5] & SIMPLECHESS_STAGE_DIFF_ACTIVE_COLOR);
+    ASSERT_EQ(view.delta[6], SIMPLECHESS_COLOR_BLACK);
+
+    // Every handle to the same game shares one buffer
+    ASSERT_EQ(simplechess_session_store_lookup(store, 1, &looked_up), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_update(looked_up, &shared), SIMPLECHESS_SUCCESS);
+    ASSERT(shared == update);
+    simplechess_update_retain(shared);
+    simplechess_update_release(shared);
+    simplechess_update_release(shared);
+
+    // An update outlives the game it came from
+    simplechess_game_destroy(looked_up);
+    simplechess_game_destroy(game);
+    simplechess_session_store_destroy(store);
+    ASSERT_EQ(simplechess_update_get_view(update, &view), SIMPLECHESS_SUCCESS);
+    ASSERT_STR_EQ(view.san, "Nf3");
+    simplechess_update_release(update);
+    simplechess_update_release(first);
+    simplechess_update_release(NULL);
+
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+static int test_game_to_json(void) {
+    SimplechessGameManager manager;
+    SimplechessGame game, after_e4, resigned;
+    SimplechessPieceMove move;
+    SimplechessResult result;
+    char json[2048], small[16];
+    size_t required, used;
+
+    result = simplechess_game_manager_create(&manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_create_new_game(manager, &game);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    result = simplechess_game_to_json(game, 0, json, sizeof(json), &used);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_STR_EQ(json,
+                  "{\"state\":\"playing\",\"draw_reason\":null,\"active_color\":\"white\","
+                  "\"fen\":\"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1\",\"castling\":\"KQkq\","
+                  "\"en_passant\":null,\"halfmove_clock\":0,\"fullmove_number\":1,\"ply\":0,\"last_move\":null,"
+                  "\"in_check\":false}");
+    ASSERT_EQ(used, strlen(json) + 1);
+
+    // Sizing pass, then a buffer that is too small
+    result = simplechess_game_to_json(game, SIMPLECHESS_JSON_MOVES | SIMPLECHESS_JSON_CLOCK, NULL, 0, &required);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    result = simplechess_game_to_json(game, SIMPLECHESS_JSON_MOVES | SIMPLECHESS_JSON_CLOCK, small, sizeof(small), &used);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(used, required);
+    result = simplechess_game_to_json(game, SIMPLECHESS_JSON_MOVES | SIMPLECHESS_JSON_CLOCK, json, sizeof(json), &used);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(used, required);
+    ASSERT(strstr(json, ",\"moves\":[") != NULL);
+    ASSERT(strstr(json, "\"g1f3\"") != NULL);
+    ASSERT(strstr(json, ",\"clock\":null}") != NULL);
+
+    SimplechessPiece white_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_WHITE};
+    SimplechessSquare e2 = {2, 'e'}, e4 = {4, 'e'};
+    simplechess_piece_move_regular(&white_pawn, &e2, &e4, &move);
+    result = simplechess_make_move(manager, game, &move, false, &after_e4);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_game_to_json(after_e4, 0, json, sizeof(json), NULL);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT(strstr(json, "\"active_color\":\"black\"") != NULL);
+    ASSERT(strstr(json, "\"ply\":1,\"last_move\":\"e4\"") != NULL);
+
+    result = simplechess_resign(manager, after_e4, SIMPLECHESS_COLOR_BLACK, &resigned);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_game_to_json(resigned, SIMPLECHESS_JSON_MOVES, json, sizeof(json), NULL);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT(strstr(json, "{\"state\":\"white_won\",\"draw_reason\":null,") == json);
+    ASSERT(strstr(json, ",\"moves\":[]}") != NULL);
+
+    ASSERT_EQ(simplechess_game_to_json(NULL, 0, json, sizeof(json), NULL), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    simplechess_game_destroy(resigned);
+    simplechess_game_destroy(after_e4);
+    simplechess_game_destroy(game);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+static int test_export_planes(void) {
+    SimplechessGameManager manager;
+    SimplechessGame games[3];
+    SimplechessResult result;
+    const size_t position_size = SIMPLECHESS_PLANE_COUNT * 64;
+    static uint8_t nchw[3 * SIMPLECHESS_PLANE_COUNT * 64], nhwc[3 * SIMPLECHESS_PLANE_COUNT * 64];
+    static float nchw_f32[3 * SIMPLECHESS_PLANE_COUNT * 64];
+
+    result = simplechess_game_manager_create(&manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_create_new_game(manager, &games[0]), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_create_game_from_fen(manager, "4k3/8/8/3pP3/8/8/8/4K3 w - d6 7 40", &games[1]),
+              SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_create_game_from_fen(manager, "r3k3/8/8/8/8/8/8/4K2R b Kq - 0 1", &games[2]),
+              SIMPLECHESS_SUCCESS);
+
+    result = simplechess_export_planes_u8(games, 3, SIMPLECHESS_LAYOUT_NCHW, nchw, sizeof(nchw), 2);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+
+    // Start position: white pawns fill rank 2, black king on e8
+    for (int sq = 0; sq < 64; sq++) {
+        ASSERT_EQ(nchw[SIMPLECHESS_PLANE_PIECES * 64 + sq], sq >= 8 && sq < 16);
+        ASSERT_EQ(nchw[(SIMPLECHESS_PLANE_PIECES + 11) * 64 + sq], sq == 60);
+        ASSERT_EQ(nchw[SIMPLECHESS_PLANE_WHITE_TO_MOVE * 64 + sq], 1);
+        ASSERT_EQ(nchw[(SIMPLECHESS_PLANE_CASTLING + 3) * 64 + sq], 1);
+    }
+
+    // En passant square and halfmove clock of the second game
+    const uint8_t* second = nchw + position_size;
+    ASSERT_EQ(second[SIMPLECHESS_PLANE_EN_PASSANT * 64 + 43], 1);
+    ASSERT_EQ(second[SIMPLECHESS_PLANE_EN_PASSANT * 64 + 44], 0);
+    ASSERT_EQ(second[SIMPLECHESS_PLANE_HALFMOVE_CLOCK * 64 + 5], 7);
+    ASSERT_EQ(second[SIMPLECHESS_PLANE_CASTLING * 64], 0);
+
+    // Third game: black to move, only white kingside and black queenside castling
+    const uint8_t* third = nchw + 2 * position_size;
+    ASSERT_EQ(third[SIMPLECHESS_PLANE_WHITE_TO_MOVE * 64], 0);
+    ASSERT_EQ(third[SIMPLECHESS_PLANE_CASTLING * 64], 1);
+    ASSERT_EQ(third[(SIMPLECHESS_PLANE_CASTLING + 1) * 64], 0);
+    ASSERT_EQ(third[(SIMPLECHESS_PLANE_CASTLING + 3) * 64], 1);
+
+    // The other layout and type hold the same values
+    result = simplechess_export_planes_u8(games, 3, SIMPLECHESS_LAYOUT_NHWC, nhwc, sizeof(nhwc), 1);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_export_planes_f32(games, 3, SIMPLECHESS_LAYOUT_NCHW, nchw_f32, 3 * position_size, 0);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    for (size_t n = 0; n < 3; n++) {
+        for (size_t plane = 0; plane < SIMPLECHESS_PLANE_COUNT; plane++) {
+            for (size_t sq = 0; sq < 64; sq++) {
+                uint8_t value = nchw[n * position_size + plane * 64 + sq];
+                ASSERT_EQ(nhwc[n * position_size + sq * SIMPLECHESS_PLANE_COUNT + plane], value);
+                ASSERT(nchw_f32[n * position_size + plane * 64 + sq] == (float)value);
+            }
+        }
+    }
+
+    // A halfmove clock past 255 saturates in u8 but not in f32
+    SimplechessGame long_clock;
+    ASSERT_EQ(simplechess_create_game_from_fen(manager, "4k3/8/8/8/8/8/8/4K3 w - - 300 200", &long_clock),
+              SIMPLECHESS_SUCCESS);
+    result = simplechess_export_planes_u8(&long_clock, 1, SIMPLECHESS_LAYOUT_NCHW, nchw, position_size, 1);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(nchw[SIMPLECHESS_PLANE_HALFMOVE_CLOCK * 64], 255);
+    result = simplechess_export_planes_f32(&long_clock, 1, SIMPLECHESS_LAYOUT_NHWC, nchw_f32, position_size, 1);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT(nchw_f32[63 * SIMPLECHESS_PLANE_COUNT + SIMPLECHESS_PLANE_HALFMOVE_CLOCK] == 300.0f);
+    simplechess_game_destroy(long_clock);
+
+    result = simplechess_export_planes_u8(games, 3, SIMPLECHESS_LAYOUT_NCHW, nchw, sizeof(nchw) - 1, 1);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    result = simplechess_export_planes_u8(games, 3, (SimplechessTensorLayout)7, nchw, sizeof(nchw), 1);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    for (int i = 0; i < 3; i++) {
+        simplechess_game_destroy(games[i]);
+    }
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+static int test_position_dedup(void) {
+    SimplechessGameManager manager;
+    SimplechessGame games[5];
+    SimplechessDedup dedup;
+    SimplechessDedupStats stats;
+    SimplechessPositionHash hashes[2000], start_hash, last_hash;
+    SimplechessPieceMove move;
+    SimplechessResult result;
+    bool is_new[5];
+    size_t new_count;
+
+    // The smallest budget, so the hashes spill to disk and runs get merged
+    result = simplechess_dedup_create(".", 4096, &dedup);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    for (uint64_t i = 0; i < 2000; i++) {
+        hashes[i].lo = (i + 1) * 0x9E3779B97F4A7C15ULL;
+        hashes[i].hi = i * 0xBF58476D1CE4E5B9ULL;
+    }
+    result = simplechess_dedup_insert(dedup, hashes, 1000, NULL, &new_count);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(new_count, 1000);
+    result = simplechess_dedup_insert(dedup, hashes, 2000, NULL, &new_count);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(new_count, 1000);
+    ASSERT_EQ(simplechess_dedup_get_stats(dedup, &stats), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(stats.positions, 3000);
+    ASSERT_EQ(stats.unique, 2000);
+    ASSERT(stats.spilled > 0);
+    ASSERT(stats.runs > 0);
+    ASSERT(stats.disk_probes > 0);
+
+    // Nf3 Nf6 Ng1 Ng8 returns to the start position
+    result = simplechess_game_manager_create(&manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_create_new_game(manager, &games[0]), SIMPLECHESS_SUCCESS);
+    SimplechessPiece white_knight = {SIMPLECHESS_PIECE_TYPE_KNIGHT, SIMPLECHESS_COLOR_WHITE};
+    SimplechessPiece black_knight = {SIMPLECHESS_PIECE_TYPE_KNIGHT, SIMPLECHESS_COLOR_BLACK};
+    SimplechessSquare g1 = {1, 'g'}, f3 = {3, 'f'}, g8 = {8, 'g'}, f6 = {6, 'f'};
+    const SimplechessPiece* pieces[4] = {&white_knight, &black_knight, &white_knight, &black_knight};
+    const SimplechessSquare* from[4] = {&g1, &g8, &f3, &f6};
+    const SimplechessSquare* to[4] = {&f3, &f6, &g1, &g8};
+    for (int i = 0; i < 4; i++) {
+        simplechess_piece_move_regular(pieces[i], from[i], to[i], &move);
+        ASSERT_EQ(simplechess_make_move(manager, games[i], &move, false, &games[i + 1]), SIMPLECHESS_SUCCESS);
+    }
+    ASSERT_EQ(simplechess_game_get_position_hash(games[0], &start_hash), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_position_hash(games[4], &last_hash), SIMPLECHESS_SUCCESS);
+    ASSERT(start_hash.lo == last_hash.lo && start_hash.hi == last_hash.hi);
+
+    result = simplechess_dedup_add_game(dedup, games[4], is_new, 4, NULL);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    result = simplechess_dedup_add_game(dedup, games[4], is_new, 5, &new_count);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(new_count, 4);
+    ASSERT(is_new[0] && is_new[1] && is_new[2] && is_new[3]);
+    ASSERT(!is_new[4]);
+    result = simplechess_dedup_add_game(dedup, games[2], NULL, 0, &new_count);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(new_count, 0);
+
+    ASSERT_EQ(simplechess_dedup_create(".", 100, &dedup), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(simplechess_dedup_insert(NULL, hashes, 1, NULL, NULL), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    simplechess_dedup_destroy(dedup);
+    for (int i = 0; i < 5; i++) {
+        simplechess_game_destroy(games[i]);
+    }
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+static int test_bitboard_move_generator(void) {
+    SimplechessGameManager manager, bitboard_manager;
+    SimplechessGame games[2], after[2], finished;
+    SimplechessPieceMove move, moves[64];
+    SimplechessResult result;
+    size_t counts[2], piece_count;
+    uint64_t nodes;
+
+    result = simplechess_game_manager_create(&manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_game_manager_create_with_move_generator(SIMPLECHESS_MOVE_GENERATOR_BITBOARD, &bitboard_manager);
+    ASSERT_EQ(result, SIMPLECHESS_SUCCESS);
+    result = simplechess_game_manager_create_with_move_generator((SimplechessMoveGenerator)9, &bitboard_manager);
+    ASSERT_EQ(result, SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    // Both generators agree after a double pawn push allowing en passant
+    const char* fen = "4k3/8/8/8/3p4/8/4P3/4K3 w - - 0 1";
+    ASSERT_EQ(simplechess_create_game_from_fen(manager, fen, &games[0]), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_create_game_from_fen(bitboard_manager, fen, &games[1]), SIMPLECHESS_SUCCESS);
+    SimplechessPiece white_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_WHITE};
+    SimplechessSquare e2 = {2, 'e'}, e4 = {4, 'e'}, d4 = {4, 'd'};
+    simplechess_piece_move_regular(&white_pawn, &e2, &e4, &move);
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(simplechess_make_move(i ? bitboard_manager : manager, games[i], &move, false, &after[i]),
+                  SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_game_get_available_moves_count(after[i], &counts[i]), SIMPLECHESS_SUCCESS);
+    }
+    ASSERT_EQ(counts[0], counts[1]);
+    ASSERT_EQ(counts[1], 7);
+
+    // The black pawn may push or take en passant
+    ASSERT_EQ(simplechess_game_get_moves_for_piece_count(after[1], &d4, &piece_count), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(piece_count, 2);
+    ASSERT_EQ(simplechess_game_get_moves_for_piece(after[1], &d4, moves, 1), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(simplechess_game_get_moves_for_piece(after[1], &d4, moves, 64), SIMPLECHESS_SUCCESS);
+    ASSERT(moves[0].piece.type == SIMPLECHESS_PIECE_TYPE_PAWN && moves[0].piece.color == SIMPLECHESS_COLOR_BLACK);
+    ASSERT((moves[0].dst.file == 'e') != (moves[1].dst.file == 'e'));
+
+    ASSERT_EQ(simplechess_game_perft(after[0], 3, &nodes), SIMPLECHESS_SUCCESS);
+    uint64_t default_nodes = nodes;
+    ASSERT_EQ(simplechess_game_perft(after[1], 3, &nodes), SIMPLECHESS_SUCCESS);
+    ASSERT(nodes == default_nodes);
+
+    // No moves once the game is over
+    ASSERT_EQ(simplechess_resign(bitboard_manager, after[1], SIMPLECHESS_COLOR_BLACK, &finished), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_available_moves_count(finished, &counts[1]), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(counts[1], 0);
+    simplechess_game_destroy(finished);
+
+    ASSERT_EQ(simplechess_game_perft(NULL, 1, &nodes), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    for (int i = 0; i < 2; i++) {
+        simplechess_game_destroy(games[i]);
+        simplechess_game_destroy(after[i]);
+    }
+    simplechess_game_manager_destroy(bitboard_manager);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+static int test_attack_queries(void) {
+    SimplechessGameManager manager;
+    SimplechessGame game;
+    SimplechessSquareSet squares;
+
+    ASSERT_EQ(simplechess_game_manager_create(&manager), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_create_game_from_fen(manager, "4k3/8/8/8/3q4/8/8/R3K3 w - - 0 1", &game), SIMPLECHESS_SUCCESS);
+
+    // The rook sweeps the a-file and the first rank up to its own king
+    ASSERT_EQ(simplechess_game_get_attacked_squares(game, SIMPLECHESS_COLOR_WHITE, &squares), SIMPLECHESS_SUCCESS);
+    ASSERT(squares == 0x010101010101393EULL);
+
+    SimplechessSquare d1 = {1, 'd'}, h8 = {8, 'h'}, off_board = {9, 'a'};
+    ASSERT_EQ(simplechess_game_get_attackers(game, &d1, SIMPLECHESS_COLOR_WHITE, &squares), SIMPLECHESS_SUCCESS);
+    ASSERT(squares == ((1ULL << 0) | (1ULL << 4)));
+    ASSERT_EQ(simplechess_game_get_attackers(game, &d1, SIMPLECHESS_COLOR_BLACK, &squares), SIMPLECHESS_SUCCESS);
+    ASSERT(squares == (1ULL << 27));
+
+    // The queen reaches the corner along the diagonal
+    ASSERT_EQ(simplechess_game_get_attackers(game, &h8, SIMPLECHESS_COLOR_BLACK, &squares), SIMPLECHESS_SUCCESS);
+    ASSERT(squares == (1ULL << 27));
+
+    ASSERT_EQ(simplechess_game_get_attackers(game, &off_board, SIMPLECHESS_COLOR_WHITE, &squares),
+              SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(simplechess_game_get_attacked_squares(NULL, SIMPLECHESS_COLOR_WHITE, &squares),
+              SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    simplechess_game_destroy(game);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+static int test_memory_usage(void) {
+    SimplechessGameManager manager;
+    SimplechessGame game, next;
+    SimplechessSessionStore store;
+    SimplechessPieceMove move;
+    SimplechessUpdate update;
+    SimplechessClockService service;
+    SimplechessTimeControl control = {60000, 0, SIMPLECHESS_CLOCK_INCREMENT};
+    size_t start_bytes, next_bytes, game_bytes, store_bytes, empty_bytes;
+
+    ASSERT_EQ(simplechess_game_manager_create(&manager), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_create_new_game(manager, &game), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_memory_usage(game, &start_bytes), SIMPLECHESS_SUCCESS);
+    ASSERT(start_bytes > 0);
+
+    // Each move adds a stage to the history
+    SimplechessPiece white_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_WHITE};
+    SimplechessSquare e2 = {2, 'e'}, e4 = {4, 'e'};
+    simplechess_piece_move_regular(&white_pawn, &e2, &e4, &move);
+    ASSERT_EQ(simplechess_make_move(manager, game, &move, false, &next), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_memory_usage(next, &next_bytes), SIMPLECHESS_SUCCESS);
+    ASSERT(next_bytes > start_bytes);
+
+    // So do the update message once built, and a running clock
+    ASSERT_EQ(simplechess_game_get_update(game, &update), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_memory_usage(game, &game_bytes), SIMPLECHESS_SUCCESS);
+    ASSERT(game_bytes > start_bytes);
+    simplechess_update_release(update);
+    ASSERT_EQ(simplechess_clock_service_create(10, &service), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_start_clock(game, service, &control, 1), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_memory_usage(game, &start_bytes), SIMPLECHESS_SUCCESS);
+    ASSERT(start_bytes > game_bytes);
+
+    // A store counts its tables and the games it holds
+    ASSERT_EQ(simplechess_session_store_create(manager, 4, &store), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_memory_usage(store, &empty_bytes), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_insert(store, 1, next), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_insert(store, 2, next), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_memory_usage(store, &store_bytes), SIMPLECHESS_SUCCESS);
+    ASSERT(store_bytes > empty_bytes + next_bytes / 2);
+    // The two entries share one game, which is counted once
+    ASSERT(store_bytes < empty_bytes + 2 * next_bytes);
+
+    ASSERT_EQ(simplechess_game_memory_usage(NULL, &start_bytes), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(simplechess_session_store_memory_usage(store, NULL), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    simplechess_session_store_destroy(store);
+    simplechess_game_destroy(next);
+    simplechess_game_destroy(game);
+    simplechess_clock_service_destroy(service);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+static int stage_text_at(SimplechessGame game, size_t index, char* fen, size_t fen_size, char* san, size_t san_size) {
+    SimplechessGameStage stage;
+    SimplechessPlayedMove played;
+    bool has_move;
+    san[0] = '\0';
+    if (simplechess_game_get_stage_at(game, index, &stage) != SIMPLECHESS_SUCCESS) {
+        return 0;
+    }
+    int ok = simplechess_stage_get_fen(stage, fen, fen_size) == SIMPLECHESS_SUCCESS
+          && simplechess_stage_get_move(stage, &played, &has_move) == SIMPLECHESS_SUCCESS;
+    if (ok && has_move) {
+        ok = simplechess_played_move_get_algebraic_notation(played, san, san_size) == SIMPLECHESS_SUCCESS;
+        simplechess_played_move_destroy(played);
+    }
+    simplechess_game_stage_destroy(stage);
+    return ok;
+}
+
+static int test_compact_history(void) {
+    SimplechessGameManager manager, compact_manager;
+    SimplechessGame games[2];
+    SimplechessPieceMove moves[256];
+    size_t count, lengths[2], bytes[2];
+    char fens[2][128], sans[2][16];
+    unsigned seed = 12345;
+
+    ASSERT_EQ(simplechess_game_manager_create(&manager), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_manager_create(&compact_manager), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_manager_set_compact_history(compact_manager, 8), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_manager_set_compact_history(NULL, 8), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(simplechess_create_new_game(manager, &games[0]), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_create_new_game(compact_manager, &games[1]), SIMPLECHESS_SUCCESS);
+
+    // Play the same random game in both modes
+    for (int ply = 0; ply < 160; ply++) {
+        SimplechessGameState state;
+        ASSERT_EQ(simplechess_game_get_state(games[0], &state), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_game_get_available_moves_count(games[0], &count), SIMPLECHESS_SUCCESS);
+        if (state != SIMPLECHESS_GAME_STATE_PLAYING || count == 0) {
+            break;
+        }
+        ASSERT_EQ(simplechess_game_get_available_moves(games[0], moves, 256), SIMPLECHESS_SUCCESS);
+        seed = seed * 1103515245u + 12345u;
+        const SimplechessPieceMove* move = &moves[(seed >> 8) % count];
+        for (int i = 0; i < 2; i++) {
+            SimplechessGame next;
+            ASSERT_EQ(simplechess_make_move(i ? compact_manager : manager, games[i], move, ply % 7 == 3, &next),
+                      SIMPLECHESS_SUCCESS);
+            simplechess_game_destroy(games[i]);
+            games[i] = next;
+        }
+    }
+
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(simplechess_game_get_history_length(games[i], &lengths[i]), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_game_memory_usage(games[i], &bytes[i]), SIMPLECHESS_SUCCESS);
+    }
+    ASSERT_EQ(lengths[1], lengths[0]);
+    ASSERT(lengths[0] > 40);
+    ASSERT(bytes[1] * 2 < bytes[0]);
+
+    // Every stage is rebuilt with its move, walking backwards (from the
+    // checkpoints) and then forwards (from the cached previous stage)
+    for (size_t k = 0; k < 2 * lengths[0]; k++) {
+        size_t index = k < lengths[0] ? lengths[0] - 1 - k : k - lengths[0];
+        for (int i = 0; i < 2; i++) {
+            ASSERT(stage_text_at(games[i], index, fens[i], sizeof(fens[i]), sans[i], sizeof(sans[i])));
+        }
+        ASSERT_STR_EQ(fens[1], fens[0]);
+        ASSERT_STR_EQ(sans[1], sans[0]);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        simplechess_game_destroy(games[i]);
+    }
+    simplechess_game_manager_destroy(compact_manager);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+static int test_game_interning(void) {
+    SimplechessGameManager manager, plain_manager;
+    SimplechessGame games[2], next[2];
+    SimplechessSessionStore stores[2];
+    SimplechessInternStats stats;
+    SimplechessPieceMove move;
+    size_t bytes[2];
+    char fens[2][128];
+
+    ASSERT_EQ(simplechess_game_manager_create(&manager), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_manager_create(&plain_manager), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_manager_set_game_interning(manager, 32), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_manager_get_interning_stats(plain_manager, &stats), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(stats.lookups, 0);
+
+    // Two games through the same move share one game state
+    SimplechessPiece white_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_WHITE};
+    SimplechessSquare e2 = {2, 'e'}, e4 = {4, 'e'};
+    simplechess_piece_move_regular(&white_pawn, &e2, &e4, &move);
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(simplechess_create_new_game(manager, &games[i]), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_make_move(manager, games[i], &move, false, &next[i]), SIMPLECHESS_SUCCESS);
+    }
+    ASSERT_EQ(simplechess_game_manager_get_interning_stats(manager, &stats), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(stats.lookups, 2);
+    ASSERT_EQ(stats.hits, 1);
+    ASSERT(stats.entries >= 1);
+    ASSERT_EQ(simplechess_game_get_current_fen(next[0], fens[0], sizeof(fens[0])), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_current_fen(next[1], fens[1], sizeof(fens[1])), SIMPLECHESS_SUCCESS);
+    ASSERT_STR_EQ(fens[1], fens[0]);
+
+    // Stores of games through the same openings hold them once
+    SimplechessPiece black_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_BLACK};
+    SimplechessSquare e7 = {7, 'e'}, e5 = {5, 'e'};
+    SimplechessPieceMove reply;
+    simplechess_piece_move_regular(&black_pawn, &e7, &e5, &reply);
+    for (int s = 0; s < 2; s++) {
+        ASSERT_EQ(simplechess_session_store_create(s ? plain_manager : manager, 4, &stores[s]), SIMPLECHESS_SUCCESS);
+        for (uint64_t id = 1; id <= 8; id++) {
+            ASSERT_EQ(simplechess_session_store_create_game(stores[s], id, NULL), SIMPLECHESS_SUCCESS);
+            ASSERT_EQ(simplechess_session_store_make_move(stores[s], id, &move, false, NULL), SIMPLECHESS_SUCCESS);
+            ASSERT_EQ(simplechess_session_store_make_move(stores[s], id, &reply, false, NULL), SIMPLECHESS_SUCCESS);
+        }
+        ASSERT_EQ(simplechess_session_store_memory_usage(stores[s], &bytes[s]), SIMPLECHESS_SUCCESS);
+    }
+    ASSERT(bytes[0] * 2 < bytes[1]);
+
+    ASSERT_EQ(simplechess_game_manager_set_game_interning(NULL, 32), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(simplechess_game_manager_get_interning_stats(manager, NULL), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    for (int i = 0; i < 2; i++) {
+        simplechess_session_store_destroy(stores[i]);
+        simplechess_game_destroy(next[i]);
+        simplechess_game_destroy(games[i]);
+    }
+    simplechess_game_manager_destroy(plain_manager);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+static int test_new_game_template(void) {
+    SimplechessGameManager manager;
+    SimplechessGame games[2], next[2];
+    SimplechessSessionStore store;
+    SimplechessPieceMove moves[2];
+    size_t count, game_bytes, empty_bytes, store_bytes;
+    char fens[2][128];
+
+    ASSERT_EQ(simplechess_game_manager_create_with_move_generator(SIMPLECHESS_MOVE_GENERATOR_BITBOARD, &manager),
+              SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_create(manager, 4, &store), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_memory_usage(store, &empty_bytes), SIMPLECHESS_SUCCESS);
+
+    // New games share the start position and its moves
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(simplechess_create_new_game(manager, &games[i]), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_game_get_available_moves_count(games[i], &count), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(count, 20);
+        ASSERT_EQ(simplechess_session_store_insert(store, (uint64_t)i, games[i]), SIMPLECHESS_SUCCESS);
+    }
+    ASSERT_EQ(simplechess_session_store_create_game(store, 2, NULL), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_memory_usage(games[0], &game_bytes), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_session_store_memory_usage(store, &store_bytes), SIMPLECHESS_SUCCESS);
+    ASSERT(store_bytes < empty_bytes + 2 * game_bytes);
+
+    // ... but are played independently
+    SimplechessPiece white_pawn = {SIMPLECHESS_PIECE_TYPE_PAWN, SIMPLECHESS_COLOR_WHITE};
+    SimplechessSquare e2 = {2, 'e'}, e4 = {4, 'e'}, d2 = {2, 'd'}, d4 = {4, 'd'};
+    simplechess_piece_move_regular(&white_pawn, &e2, &e4, &moves[0]);
+    simplechess_piece_move_regular(&white_pawn, &d2, &d4, &moves[1]);
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(simplechess_make_move(manager, games[i], &moves[i], false, &next[i]), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_game_get_current_fen(next[i], fens[i], sizeof(fens[i])), SIMPLECHESS_SUCCESS);
+    }
+    ASSERT(strcmp(fens[0], fens[1]) != 0);
+    ASSERT_EQ(simplechess_game_get_available_moves_count(games[1], &count), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(count, 20);
+
+    for (int i = 0; i < 2; i++) {
+        simplechess_game_destroy(next[i]);
+        simplechess_game_destroy(games[i]);
+    }
+    simplechess_session_store_destroy(store);
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+static int test_fen_cache(void) {
+    SimplechessGameManager manager;
+    SimplechessGame games[4];
+    SimplechessFenCacheStats stats;
+    SimplechessGameState state;
+    size_t counts[2];
+    const char* fens[] = {
+        "8/8/8/4k3/8/8/4P3/4K3 w - - 0 1",
+        "  8/8/8/4k3/8/8/4P3/4K3   w - -  0 1 ",
+        "8/8/8/3k4/8/8/3P4/3K4 w - - 0 1",
+        "8/8/8/2k5/8/8/2P5/2K5 w - - 0 1",
+    };
+
+    ASSERT_EQ(simplechess_game_manager_create_with_move_generator(SIMPLECHESS_MOVE_GENERATOR_BITBOARD, &manager),
+              SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_manager_set_fen_cache(manager, 2), SIMPLECHESS_SUCCESS);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(simplechess_create_game_from_fen(manager, fens[i], &games[i]), SIMPLECHESS_SUCCESS);
+    }
+
+    // The same FEN with other spacing is a hit; the fourth FEN evicts the
+    // least recently used one
+    ASSERT_EQ(simplechess_game_manager_get_fen_cache_stats(manager, &stats), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(stats.hits, 1);
+    ASSERT_EQ(stats.misses, 3);
+    ASSERT_EQ(stats.evictions, 1);
+    ASSERT_EQ(stats.entries, 2);
+
+    // A cached game plays like the one it was copied from
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(simplechess_game_get_state(games[i], &state), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(state, SIMPLECHESS_GAME_STATE_PLAYING);
+        ASSERT_EQ(simplechess_game_get_available_moves_count(games[i], &counts[i]), SIMPLECHESS_SUCCESS);
+    }
+    ASSERT_EQ(counts[1], counts[0]);
+
+    ASSERT_EQ(simplechess_game_manager_set_fen_cache(NULL, 2), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(simplechess_game_manager_get_fen_cache_stats(manager, NULL), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(simplechess_game_manager_set_fen_cache(manager, 0), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_manager_get_fen_cache_stats(manager, &stats), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(stats.hits, 0);
+
+    for (int i = 0; i < 4; i++) {
+        simplechess_game_destroy(games[i]);
+    }
+    simplechess_game_manager_destroy(manager);
+    return 1;
+}
+
+typedef int (*GeneratorCheck)(SimplechessGameManager manager, int generator, void* context);
+
+/**
+ * Run a check with a game manager of each move generator. The check gets the
+ * index of the generator, 0 for the default one and 1 for the bitboard one,
+ * so it can keep per-generator results in the context for comparing them.
+ */
+static int with_each_move_generator(GeneratorCheck check, void* context) {
+    const SimplechessMoveGenerator generators[2] = {SIMPLECHESS_MOVE_GENERATOR_DEFAULT, SIMPLECHESS_MOVE_GENERATOR_BITBOARD};
+    for (int i = 0; i < 2; i++) {
+        SimplechessGameManager manager;
+        ASSERT_EQ(simplechess_game_manager_create_with_move_generator(generators[i], &manager), SIMPLECHESS_SUCCESS);
+        int passed = check(manager, i, context);
+        simplechess_game_manager_destroy(manager);
+        if (!passed) {
+            printf("    ... with the %s move generator\n", i ? "bitboard" : "default");
+            return 0;
+        }
+    }
+    return 1;
+}
+
+typedef struct {
+    size_t seen;
+    size_t stop_after;
+} MoveVisitCount;
+
+static bool count_moves(void* user_data, const SimplechessPieceMove* move) {
+    MoveVisitCount* visit = user_data;
+    (void)move;
+    return ++visit->seen < visit->stop_after;
+}
+
+static int check_for_each_move(SimplechessGameManager manager, int generator, void* context) {
+    SimplechessGame start, mated;
+    size_t count;
+    bool has_move;
+    (void)generator;
+    (void)context;
+
+    ASSERT_EQ(simplechess_create_game_from_fen(manager, "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3", &start),
+              SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_create_game_from_fen(manager, "rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3", &mated),
+              SIMPLECHESS_SUCCESS);
+
+    // Every move is passed, or as many as the callback asks for
+    MoveVisitCount all = {0, (size_t)-1}, three = {0, 3};
+    ASSERT_EQ(simplechess_game_for_each_move(start, count_moves, &all), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_available_moves_count(start, &count), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(all.seen, count);
+    ASSERT_EQ(simplechess_game_for_each_move(start, count_moves, &three), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(three.seen, 3);
+
+    ASSERT_EQ(simplechess_game_has_legal_move(start, &has_move), SIMPLECHESS_SUCCESS);
+    ASSERT(has_move);
+    ASSERT_EQ(simplechess_game_has_legal_move(mated, &has_move), SIMPLECHESS_SUCCESS);
+    ASSERT(!has_move);
+    all.seen = 0;
+    ASSERT_EQ(simplechess_game_for_each_move(mated, count_moves, &all), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(all.seen, 0);
+
+    ASSERT_EQ(simplechess_game_for_each_move(start, NULL, NULL), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(simplechess_game_has_legal_move(NULL, &has_move), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+
+    simplechess_game_destroy(mated);
+    simplechess_game_destroy(start);
+    return 1;
+}
+
+static int test_for_each_move(void) {
+    return with_each_move_generator(check_for_each_move, NULL);
+}
+
+typedef struct {
+    uint16_t offsets[2][65];
+    SimplechessSquareSet destinations[2][64];
+} MovesBySquare;
+
+static int check_moves_by_square(SimplechessGameManager manager, int generator, void* context) {
+    MovesBySquare* results = context;
+    uint16_t* offsets = results->offsets[generator];
+    SimplechessSquareSet* destinations = results->destinations[generator];
+    SimplechessGame game;
+    SimplechessPieceMove moves[256];
+    size_t count, piece_count;
+
+    ASSERT_EQ(simplechess_create_game_from_fen(manager, "r3k2r/pPpp1ppp/8/4p3/4P3/5N2/PPPP1PPP/R3K2R w KQkq - 0 1", &game),
+              SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_moves_by_square(game, offsets, moves, 256, destinations), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_available_moves_count(game, &count), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(offsets[64], count);
+
+    // Each bucket holds the moves of the piece on its square
+    for (int sq = 0; sq < 64; sq++) {
+        SimplechessSquare square = {(uint8_t)(sq / 8 + 1), (char)('a' + sq % 8)};
+        SimplechessSquareSet seen = 0;
+        ASSERT(offsets[sq] <= offsets[sq + 1]);
+        ASSERT_EQ(simplechess_game_get_moves_for_piece_count(game, &square, &piece_count), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ((size_t)(offsets[sq + 1] - offsets[sq]), piece_count);
+        for (uint16_t m = offsets[sq]; m < offsets[sq + 1]; m++) {
+            ASSERT_EQ(moves[m].src.rank, square.rank);
+            ASSERT_EQ(moves[m].src.file, square.file);
+            seen |= (SimplechessSquareSet)1 << ((moves[m].dst.rank - 1) * 8 + (moves[m].dst.file - 'a'));
+        }
+        ASSERT(seen == destinations[sq]);
+    }
+
+    ASSERT_EQ(simplechess_game_get_moves_by_square(game, offsets, moves, count - 1, NULL),
+              SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(simplechess_game_get_moves_by_square(game, NULL, moves, 256, NULL), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    simplechess_game_destroy(game);
+    return 1;
+}
+
+static int test_moves_by_square(void) {
+    MovesBySquare results;
+    ASSERT(with_each_move_generator(check_moves_by_square, &results));
+
+    // Both generators bucket the same moves
+    ASSERT(memcmp(results.offsets[0], results.offsets[1], sizeof(results.offsets[0])) == 0);
+    ASSERT(memcmp(results.destinations[0], results.destinations[1], sizeof(results.destinations[0])) == 0);
+    return 1;
+}
+
+static int check_move_masks(SimplechessGameManager manager, int generator, void* context) {
+    SimplechessSquareSet (*results)[64] = context;
+    SimplechessSquareSet* masks = results[generator];
+    SimplechessSquareSet cached[64], destinations[64];
+    SimplechessPieceMove moves[256];
+    uint16_t offsets[65];
+    SimplechessGame game;
+
+    ASSERT_EQ(simplechess_create_game_from_fen(manager, "4k3/1P6/8/3pP3/8/8/8/R3K2R w KQ d6 0 1", &game),
+              SIMPLECHESS_SUCCESS);
+
+    // Generated directly, and from the cached moves once they are listed
+    ASSERT_EQ(simplechess_game_get_move_masks(game, masks), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_moves_by_square(game, offsets, moves, 256, destinations), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_move_masks(game, cached), SIMPLECHESS_SUCCESS);
+    ASSERT(memcmp(cached, destinations, sizeof(destinations)) == 0);
+    ASSERT(memcmp(masks, cached, sizeof(cached)) == 0);
+
+    // Castling both ways, en passant, and a promotion counted once
+    ASSERT(masks[4] & ((SimplechessSquareSet)1 << 6));
+    ASSERT(masks[4] & ((SimplechessSquareSet)1 << 2));
+    ASSERT(masks[36] & ((SimplechessSquareSet)1 << 43));
+    ASSERT(masks[49] & ((SimplechessSquareSet)1 << 57));
+    ASSERT_EQ(masks[60], 0);
+
+    ASSERT_EQ(simplechess_game_get_move_masks(game, NULL), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(simplechess_game_get_move_masks(NULL, masks), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    simplechess_game_destroy(game);
+    return 1;
+}
+
+static int test_move_masks(void) {
+    SimplechessSquareSet masks[2][64];
+    ASSERT(with_each_move_generator(check_move_masks, masks));
+    ASSERT(memcmp(masks[0], masks[1], sizeof(masks[0])) == 0);
+    return 1;
+}
+
+static int check_staged_moves(SimplechessGameManager manager, int generator, void* context) {
+    SimplechessGame game;
+    SimplechessPieceMove captures[256], checks[256], quiets[256];
+    size_t counts[3], total;
+    (void)generator;
+    (void)context;
+
+    // b7 can take the rook on a8 or promote on b8, the knight on d4 can be
+    // taken by pawn or rook, and Rh1 is a quiet check
+    ASSERT_EQ(simplechess_create_game_from_fen(manager, "r2q3k/1P6/8/8/3n4/2P5/8/1K1R4 w - - 0 1", &game),
+              SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_captures(game, captures, 256, &counts[0]), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_quiet_checks(game, checks, 256, &counts[1]), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_quiet_moves(game, quiets, 256, &counts[2]), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(simplechess_game_get_available_moves_count(game, &total), SIMPLECHESS_SUCCESS);
+    ASSERT_EQ(counts[0] + counts[1] + counts[2], total);
+
+    // Four bxa8 promotions, four b8 promotions, cxd4 and Rxd4, by material
+    // gained: bxa8=Q, bxa8=R, b8=Q, bxa8=B/N, b8=R, then the knight taken by
+    // the pawn before the rook, then b8=B/N
+    ASSERT_EQ(counts[0], 10);
+    ASSERT_EQ(captures[0].dst.file, 'a');
+    ASSERT_EQ(captures[0].promoted_type, SIMPLECHESS_PIECE_TYPE_QUEEN);
+    ASSERT_EQ(captures[1].dst.file, 'a');
+    ASSERT_EQ(captures[1].promoted_type, SIMPLECHESS_PIECE_TYPE_ROOK);
+    ASSERT_EQ(captures[2].dst.file, 'b');
+    ASSERT_EQ(captures[2].promoted_type, SIMPLECHESS_PIECE_TYPE_QUEEN);
+    ASSERT_EQ(captures[6].dst.file, 'd');
+    ASSERT_EQ(captures[6].piece.type, SIMPLECHESS_PIECE_TYPE_PAWN);
+    ASSERT_EQ(captures[7].dst.file, 'd');
+    ASSERT_EQ(captures[7].piece.type, SIMPLECHESS_PIECE_TYPE_ROOK);
+
+    int found = 0;
+    for (size_t m = 0; m < counts[1]; m++) {
+        found |= checks[m].dst.rank == 1 && checks[m].dst.file == 'h';
+    }
+    ASSERT(found);
+    for (size_t m = 0; m < counts[2]; m++) {
+        ASSERT(!(quiets[m].dst.rank == 1 && quiets[m].dst.file == 'h'));
+    }
+
+    ASSERT_EQ(simplechess_game_get_captures(game, captures, 1, &counts[0]), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(counts[0], 10);
+    ASSERT_EQ(simplechess_game_get_quiet_moves(game, quiets, 256, NULL), SIMPLECHESS_ERROR_INVALID_ARGUMENT);
+    simplechess_game_destroy(game);
+
+    // Captures before and after the game's moves are cached: en passant,
+    // castling rights, a promotion by push and by capture, and a check
+    const struct {
+        const char* fen;
+        size_t captures;
+    } cases[] = {
+        {"4k3/8/8/3pP3/8/8/8/R3K2R w KQ d6 0 1", 1},
+        {"r3k2r/8/8/8/8/8/6p1/R3K2R b KQkq - 0 1", 10},
+        {"4k3/8/8/8/1b6/8/8/R3K2R w KQ - 0 1", 0},
+        {"4k3/8/8/8/1b6/3N4/8/R3K3 w Q - 0 1", 1},
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        ASSERT_EQ(simplechess_create_game_from_fen(manager, cases[c].fen, &game), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_game_get_captures(game, captures, 256, &counts[0]), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(counts[0], cases[c].captures);
+        ASSERT_EQ(simplechess_game_get_available_moves_count(game, &total), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_game_get_captures(game, quiets, 256, &counts[1]), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(counts[1], counts[0]);
+        for (size_t m = 0; m < counts[0]; m++) {
+            ASSERT_EQ(quiets[m].src.rank * 8 + quiets[m].src.file, captures[m].src.rank * 8 + captures[m].src.file);
+            ASSERT_EQ(quiets[m].dst.rank * 8 + quiets[m].dst.file, captures[m].dst.rank * 8 + captures[m].dst.file);
+            ASSERT_EQ(quiets[m].promoted_type, captures[m].promoted_type);
+        }
+        simplechess_game_destroy(game);
+    }
+    return 1;
+}
+
+static int test_staged_moves(void) {
+    return with_each_move_generator(check_staged_moves, NULL);
+}
+
+static int check_staged_quiet_checks(SimplechessGameManager manager, int generator, void* context) {
+    SimplechessPieceMove moves[256];
+    size_t counts[2];
+    (void)generator;
+    (void)context;
+
+    // Discovered checks by a knight, a bishop's line and the king itself,
+    // checks by the rook of either castling, and pawn pushes that stay on
+    // the checking line
+    const struct {
+        const char* fen;
+        SimplechessSquare king;
+        size_t checks;
+    } cases[] = {
+        {"4k3/8/8/8/4N3/8/8/4R1K1 w - - 0 1", {8, 'e'}, 8},
+        {"7k/8/8/8/8/2N5/8/B3K3 w - - 0 1", {8, 'h'}, 8},
+        {"4k3/8/8/8/8/8/4K3/4R3 w - - 0 1", {8, 'e'}, 6},
+        {"5k2/8/8/8/8/8/8/4K2R w K - 0 1", {8, 'f'}, 3},
+        {"3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", {8, 'd'}, 3},
+        {"4k3/8/8/8/8/8/4P3/4RK2 w - - 0 1", {8, 'e'}, 0},
+    };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        SimplechessGame game;
+        ASSERT_EQ(simplechess_create_game_from_fen(manager, cases[c].fen, &game), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(simplechess_game_get_quiet_checks(game, moves, 256, &counts[0]), SIMPLECHESS_SUCCESS);
+        ASSERT_EQ(counts[0], cases[c].checks);
+        ASSERT_EQ(simplechess_game_get_quiet_moves(game, moves + counts[0], 256 - counts[0], &counts[1]),
+                  SIMPLECHESS_SUCCESS);
+
+        // Each move is in the check stage exactly when playing it attacks
+        // the enemy king
+        for (size_t m = 0; m < counts[0] + counts[1]; m++) {
+            SimplechessGame next;
+            SimplechessSquareSet attackers;
+            ASSERT_EQ(simplechess_make_move(manager, game, &moves[m], false, &next), SIMPLECHESS_SUCCESS);
+            ASSERT_EQ(simplechess_game_get_attackers(next, &cases[c].king, SIMPLECHESS_COLOR_WHITE, &attackers),
+                      SIMPLECHESS_SUCCESS);
+            ASSERT_EQ(attackers != 0, m < counts[0]);
+            simplechess_game_destroy(next);
+        }
+        simplechess_game_destroy(game);
+    }
+    return 1;
+}
+
+static int test_staged_quiet_checks(void) {
+    return with_each_move_generator(check_staged_quiet_checks, NULL);
+}
+
 /* ========================================================================== */
 /* Error Tests for New Functionality                                         */
 /* ========================================================================== */
@@ -1223,6 +3068,31 @@ int main(void) {
     TEST(test_extended_game_queries);
     TEST(test_additional_utilities);
     TEST(test_draw_offer_functionality);
+    TEST(test_tablebase_without_tables);
+    TEST(test_tablebase_adjudication_clock);
+    TEST(test_tablebase_probe_tables);
+    TEST(test_session_store);
+    TEST(test_snapshot_round_trip);
+    TEST(test_move_log_recovery);
+    TEST(test_move_log_attach_to_live_store);
+    TEST(test_clock_flag);
+    TEST(test_stage_diff);
+    TEST(test_broadcast_update);
+    TEST(test_game_to_json);
+    TEST(test_export_planes);
+    TEST(test_position_dedup);
+    TEST(test_bitboard_move_generator);
+    TEST(test_attack_queries);
+    TEST(test_memory_usage);
+    TEST(test_compact_history);
+    TEST(test_game_interning);
+    TEST(test_new_game_template);
+    TEST(test_fen_cache);
+    TEST(test_for_each_move);
+    TEST(test_moves_by_square);
+    TEST(test_move_masks);
+    TEST(test_staged_moves);
+    TEST(test_staged_quiet_checks);
 
     /* Error Case Tests */
     printf("=== ERROR CASE TESTS ===\n");
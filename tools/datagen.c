@@ -0,0 +1,763 @@
+/**
+ * @file datagen.c
+ * @brief Turns a game archive into shuffled shards of training records
+ *
+ * The archive is PGN whose movetext is in coordinate notation ("e2e4",
+ * "e7e8q"), as written for example by pgn-extract -Wuci. Only the Result
+ * and FEN tags are read; move numbers, comments and other tags are skipped,
+ * and games without a decisive or drawn result are dropped.
+ *
+ * The work is a pipeline of threads joined by bounded queues:
+ *
+ *   reader    parses games from the archive (the main thread)
+ *   replay    --workers threads replaying each game through
+ *             simplechess_make_move and sampling positions
+ *   encoder   puts the games back in archive order, packs each sample into
+ *             a record and deals the records over --mix open shards
+ *   writer    shuffles each full shard and writes it out
+ *
+ * Which positions are sampled and how they are dealt and shuffled only
+ * depends on --seed and the archive, not on thread timing, so a run can be
+ * repeated exactly.
+ *
+ * Each shard file is the magic "SCDATA01", u32 record size, u32 record
+ * count and the records; every shard but the last --mix holds --shard-size
+ * records. A record is 40 bytes (integers little-endian):
+ *
+ *   0-31   board, two squares per byte, a1 in the low nibble of byte 0;
+ *          0 is empty, 1-6 white pawn, knight, bishop, rook, queen, king,
+ *          7-12 the same for black
+ *   32     bit 0 set if black is to move, bits 1-4 castling rights in
+ *          SimplechessCastlingRight order
+ *   33     en passant square ((rank - 1) * 8 + file - 'a') or 0xFF
+ *   34     halfmove clock, at most 255
+ *   35     result: 0 black won, 1 draw, 2 white won
+ *   36-37  fullmove number
+ *   38-39  move played: from | to << 6 | promotion << 12, where promotion
+ *          is 0 or 1-4 for knight, bishop, rook, queen
+ *
+ * Usage: simplechess_datagen --input PATH --output PREFIX [--workers N]
+ *                            [--shard-size N] [--mix N] [--sample P]
+ *                            [--skip-plies N] [--seed N]
+ */
+
+#define _GNU_SOURCE
+
+#include "simplechess/simplechess.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RECORD_SIZE 40
+#define QUEUE_CAPACITY 1024
+#define MAX_FEN 128
+
+typedef struct {
+    uint64_t index;
+    uint8_t result;
+    bool has_fen;
+    char fen[MAX_FEN];
+    char* moves;
+    size_t moves_length;
+    size_t moves_capacity;
+} RawGame;
+
+typedef struct {
+    char fen[MAX_FEN];
+    uint16_t move;
+} Sample;
+
+typedef struct {
+    uint64_t index;
+    uint8_t result;
+    Sample* samples;
+    size_t count;
+} ReplayedGame;
+
+typedef struct {
+    uint64_t index;
+    uint8_t* records;
+    size_t count;
+} Shard;
+
+/* A bounded queue of pointers; pop returns NULL once the queue is closed
+ * and empty. */
+typedef struct {
+    void* items[QUEUE_CAPACITY];
+    size_t head;
+    size_t size;
+    bool closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} Queue;
+
+static void queue_init(Queue* queue) {
+    memset(queue, 0, sizeof(*queue));
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+}
+
+static void queue_push(Queue* queue, void* item) {
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->size == QUEUE_CAPACITY) {
+        pthread_cond_wait(&queue->not_full, &queue->mutex);
+    }
+    queue->items[(queue->head + queue->size) % QUEUE_CAPACITY] = item;
+    queue->size++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+static void* queue_pop(Queue* queue) {
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->size == 0 && !queue->closed) {
+        pthread_cond_wait(&queue->not_empty, &queue->mutex);
+    }
+    void* item = NULL;
+    if (queue->size > 0) {
+        item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % QUEUE_CAPACITY;
+        queue->size--;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return item;
+}
+
+static void queue_close(Queue* queue) {
+    pthread_mutex_lock(&queue->mutex);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+static Queue g_games;
+static Queue g_replayed;
+static Queue g_shards;
+static const char* g_output;
+static size_t g_shard_size = 1 << 20;
+static size_t g_mix = 8;
+static double g_sample = 1.0;
+static int g_skip_plies = 8;
+static uint64_t g_seed = 1;
+
+static pthread_mutex_t g_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int g_running_workers;
+static uint64_t g_illegal_games;
+static uint64_t g_samples;
+static uint64_t g_shards_written;
+static bool g_write_failed;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* splitmix64, so nearby seeds give unrelated streams */
+static uint64_t next_random(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static void* checked_realloc(void* data, size_t size) {
+    data = realloc(data, size);
+    if (!data) {
+        perror("realloc");
+        exit(1);
+    }
+    return data;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Reader                                                                   */
+/* ------------------------------------------------------------------------ */
+
+static RawGame* new_raw_game(uint64_t index) {
+    RawGame* game = calloc(1, sizeof(RawGame));
+    if (!game) {
+        perror("calloc");
+        exit(1);
+    }
+    game->index = index;
+    game->result = 0xFF;
+    return game;
+}
+
+static void append_move(RawGame* game, const char* token, size_t length) {
+    if (game->moves_length + length + 2 > game->moves_capacity) {
+        game->moves_capacity = (game->moves_length + length + 2) * 2;
+        game->moves = checked_realloc(game->moves, game->moves_capacity);
+    }
+    memcpy(game->moves + game->moves_length, token, length);
+    game->moves_length += length;
+    game->moves[game->moves_length++] = ' ';
+    game->moves[game->moves_length] = '\0';
+}
+
+static bool parse_result(const char* text, size_t length, uint8_t* result) {
+    if (length == 3 && memcmp(text, "1-0", 3) == 0) {
+        *result = 2;
+    } else if (length == 3 && memcmp(text, "0-1", 3) == 0) {
+        *result = 0;
+    } else if (length == 7 && memcmp(text, "1/2-1/2", 7) == 0) {
+        *result = 1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* Reads the tag value between the first pair of quotes of a tag line */
+static const char* tag_value(char* line, size_t* length) {
+    char* start = strchr(line, '"');
+    char* end = start ? strchr(start + 1, '"') : NULL;
+    if (!end) {
+        return NULL;
+    }
+    *length = (size_t)(end - start - 1);
+    return start + 1;
+}
+
+/* Parses the archive and queues its games; returns the number of games */
+static uint64_t read_archive(FILE* input) {
+    char* line = NULL;
+    size_t capacity = 0;
+    uint64_t count = 0;
+    RawGame* game = new_raw_game(0);
+    bool in_movetext = false;
+    int comment_depth = 0;
+
+    while (getline(&line, &capacity, input) >= 0) {
+        if (line[0] == '[' && comment_depth == 0) {
+            if (in_movetext) {
+                // Tags after movetext start a new game even without a result
+                queue_push(&g_games, game);
+                game = new_raw_game(++count);
+                in_movetext = false;
+            }
+            size_t length;
+            const char* value = tag_value(line, &length);
+            if (value && strncmp(line, "[Result ", 8) == 0) {
+                parse_result(value, length, &game->result);
+            } else if (value && strncmp(line, "[FEN ", 5) == 0 && length < MAX_FEN) {
+                memcpy(game->fen, value, length);
+                game->fen[length] = '\0';
+                game->has_fen = true;
+            }
+            continue;
+        }
+
+        for (char* p = line; *p;) {
+            if (*p == '{') {
+                comment_depth++;
+                p++;
+                continue;
+            }
+            if (*p == '}') {
+                comment_depth = comment_depth ? comment_depth - 1 : 0;
+                p++;
+                continue;
+            }
+            if (comment_depth || isspace((unsigned char)*p)) {
+                p++;
+                continue;
+            }
+            if (*p == ';') {
+                break;
+            }
+            char* token = p;
+            while (*p && !isspace((unsigned char)*p) && *p != '{') {
+                p++;
+            }
+            size_t length = (size_t)(p - token);
+            in_movetext = true;
+
+            uint8_t result;
+            if (parse_result(token, length, &result) || (length == 1 && token[0] == '*')) {
+                queue_push(&g_games, game);
+                game = new_raw_game(++count);
+                in_movetext = false;
+            } else if (!memchr(token, '.', length) && token[0] != '$' && length >= 4 && length <= 5) {
+                append_move(game, token, length);
+            }
+        }
+    }
+
+    if (in_movetext) {
+        queue_push(&g_games, game);
+        count++;
+    } else {
+        free(game->moves);
+        free(game);
+    }
+    free(line);
+    return count;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Replay workers                                                           */
+/* ------------------------------------------------------------------------ */
+
+static bool parse_square(const char* text, SimplechessSquare* square) {
+    if (text[0] < 'a' || text[0] > 'h' || text[1] < '1' || text[1] > '8') {
+        return false;
+    }
+    square->file = text[0];
+    square->rank = (uint8_t)(text[1] - '0');
+    return true;
+}
+
+static int promotion_code(SimplechessPieceType type) {
+    switch (type) {
+        case SIMPLECHESS_PIECE_TYPE_KNIGHT: return 1;
+        case SIMPLECHESS_PIECE_TYPE_BISHOP: return 2;
+        case SIMPLECHESS_PIECE_TYPE_ROOK: return 3;
+        case SIMPLECHESS_PIECE_TYPE_QUEEN: return 4;
+        default: return 0;
+    }
+}
+
+static int promotion_from_char(char c) {
+    switch (c) {
+        case 'n': return 1;
+        case 'b': return 2;
+        case 'r': return 3;
+        case 'q': return 4;
+        default: return -1;
+    }
+}
+
+static int square_index(const SimplechessSquare* square) {
+    return (square->rank - 1) * 8 + (square->file - 'a');
+}
+
+/* Finds the legal move written in coordinate notation */
+static bool find_move(SimplechessGame game, const char* text, size_t length, SimplechessPieceMove* found) {
+    SimplechessSquare src, dst;
+    SimplechessPieceMove moves[32];
+    size_t count;
+    int promotion = length == 5 ? promotion_from_char(text[4]) : 0;
+    if (!parse_square(text, &src) || !parse_square(text + 2, &dst) || promotion < 0) {
+        return false;
+    }
+    if (simplechess_game_get_moves_for_piece_count(game, &src, &count) != SIMPLECHESS_SUCCESS || count > 32 ||
+        simplechess_game_get_moves_for_piece(game, &src, moves, count) != SIMPLECHESS_SUCCESS) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (square_index(&moves[i].dst) == square_index(&dst) &&
+            (moves[i].is_promotion ? promotion_code(moves[i].promoted_type) : 0) == promotion) {
+            *found = moves[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static void replay(SimplechessGameManager manager, const RawGame* raw, ReplayedGame* out) {
+    SimplechessGame game;
+    size_t capacity = 0;
+    uint64_t random_state = g_seed ^ (raw->index * 0xD1B54A32D192ED03ull);
+    double scaled = g_sample * 18446744073709551616.0;
+    uint64_t threshold = scaled >= 18446744073709551615.0 ? UINT64_MAX : (uint64_t)scaled;
+
+    out->index = raw->index;
+    out->result = raw->result;
+    if (raw->result > 2) {
+        return;
+    }
+    SimplechessResult result = raw->has_fen ? simplechess_create_game_from_fen(manager, raw->fen, &game)
+                                            : simplechess_create_new_game(manager, &game);
+    if (result != SIMPLECHESS_SUCCESS) {
+        return;
+    }
+
+    bool legal = true;
+    int ply = 0;
+    const char* p = raw->moves ? raw->moves : "";
+    while (*p) {
+        const char* token = p;
+        while (*p && *p != ' ') {
+            p++;
+        }
+        size_t length = (size_t)(p - token);
+        while (*p == ' ') {
+            p++;
+        }
+
+        SimplechessPieceMove move;
+        if (!find_move(game, token, length, &move)) {
+            legal = false;
+            break;
+        }
+        if (ply >= g_skip_plies && next_random(&random_state) <= threshold) {
+            if (out->count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                out->samples = checked_realloc(out->samples, capacity * sizeof(Sample));
+            }
+            Sample* sample = &out->samples[out->count];
+            if (simplechess_game_get_current_fen(game, sample->fen, sizeof(sample->fen)) == SIMPLECHESS_SUCCESS) {
+                int promotion = move.is_promotion ? promotion_code(move.promoted_type) : 0;
+                sample->move = (uint16_t)(square_index(&move.src) | (square_index(&move.dst) << 6) | (promotion << 12));
+                out->count++;
+            }
+        }
+
+        SimplechessGame next;
+        if (simplechess_make_move(manager, game, &move, false, &next) != SIMPLECHESS_SUCCESS) {
+            legal = false;
+            break;
+        }
+        simplechess_game_destroy(game);
+        game = next;
+        ply++;
+    }
+    simplechess_game_destroy(game);
+
+    if (!legal) {
+        out->count = 0;
+        pthread_mutex_lock(&g_stats_mutex);
+        g_illegal_games++;
+        pthread_mutex_unlock(&g_stats_mutex);
+    }
+}
+
+static void* replay_main(void* arg) {
+    (void)arg;
+    SimplechessGameManager manager;
+    if (simplechess_game_manager_create(&manager) != SIMPLECHESS_SUCCESS) {
+        fprintf(stderr, "cannot create game manager\n");
+        exit(1);
+    }
+
+    RawGame* raw;
+    while ((raw = queue_pop(&g_games)) != NULL) {
+        ReplayedGame* replayed = calloc(1, sizeof(ReplayedGame));
+        if (!replayed) {
+            perror("calloc");
+            exit(1);
+        }
+        replay(manager, raw, replayed);
+        free(raw->moves);
+        free(raw);
+        // Every game goes on, even without samples, so the encoder can
+        // restore the archive order
+        queue_push(&g_replayed, replayed);
+    }
+    simplechess_game_manager_destroy(manager);
+
+    pthread_mutex_lock(&g_stats_mutex);
+    bool last = --g_running_workers == 0;
+    pthread_mutex_unlock(&g_stats_mutex);
+    if (last) {
+        queue_close(&g_replayed);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Encoder                                                                  */
+/* ------------------------------------------------------------------------ */
+
+static uint8_t piece_nibble(char c) {
+    static const char pieces[] = "PNBRQKpnbrqk";
+    const char* found = strchr(pieces, c);
+    return found && c ? (uint8_t)(found - pieces + 1) : 0;
+}
+
+/* Packs a sample into a record; returns false for a malformed FEN */
+static bool encode_record(const Sample* sample, uint8_t result, uint8_t* record) {
+    memset(record, 0, RECORD_SIZE);
+    const char* p = sample->fen;
+    int rank = 7, file = 0;
+    for (; *p && *p != ' '; p++) {
+        if (*p == '/') {
+            rank--;
+            file = 0;
+        } else if (*p >= '1' && *p <= '8') {
+            file += *p - '0';
+        } else {
+            uint8_t nibble = piece_nibble(*p);
+            if (!nibble || rank < 0 || file > 7) {
+                return false;
+            }
+            int sq = rank * 8 + file++;
+            record[sq / 2] |= (uint8_t)(nibble << (4 * (sq & 1)));
+        }
+    }
+
+    char side = 'w', castling[5] = "-", en_passant[3] = "-";
+    unsigned halfmove = 0, fullmove = 1;
+    if (sscanf(p, " %c %4s %2s %u %u", &side, castling, en_passant, &halfmove, &fullmove) < 3) {
+        return false;
+    }
+    uint8_t flags = side == 'b' ? 1 : 0;
+    for (const char* c = castling; *c; c++) {
+        switch (*c) {
+            case 'K': flags |= SIMPLECHESS_CASTLING_WHITE_KINGSIDE << 1; break;
+            case 'Q': flags |= SIMPLECHESS_CASTLING_WHITE_QUEENSIDE << 1; break;
+            case 'k': flags |= SIMPLECHESS_CASTLING_BLACK_KINGSIDE << 1; break;
+            case 'q': flags |= SIMPLECHESS_CASTLING_BLACK_QUEENSIDE << 1; break;
+            default: break;
+        }
+    }
+    record[32] = flags;
+    record[33] = en_passant[0] >= 'a' && en_passant[0] <= 'h' ? (uint8_t)((en_passant[1] - '1') * 8 + (en_passant[0] - 'a'))
+                                                              : 0xFF;
+    record[34] = (uint8_t)(halfmove > 255 ? 255 : halfmove);
+    record[35] = result;
+    record[36] = (uint8_t)fullmove;
+    record[37] = (uint8_t)(fullmove >> 8);
+    record[38] = (uint8_t)sample->move;
+    record[39] = (uint8_t)(sample->move >> 8);
+    return true;
+}
+
+static Shard* new_shard(void) {
+    Shard* shard = calloc(1, sizeof(Shard));
+    if (!shard) {
+        perror("calloc");
+        exit(1);
+    }
+    shard->records = malloc(g_shard_size * RECORD_SIZE);
+    if (!shard->records) {
+        perror("malloc");
+        exit(1);
+    }
+    return shard;
+}
+
+static void* encoder_main(void* arg) {
+    (void)arg;
+    // Games finished out of order wait in a ring until their predecessors
+    // come; slot i of the ring, counted from head, holds game next_index + i
+    ReplayedGame** pending = NULL;
+    size_t pending_capacity = 0;
+    size_t head = 0;
+    uint64_t next_index = 0;
+
+    Shard** open = calloc(g_mix, sizeof(Shard*));
+    uint64_t shard_index = 0;
+    uint64_t random_state = g_seed;
+    uint64_t samples = 0;
+    for (size_t i = 0; i < g_mix; i++) {
+        open[i] = new_shard();
+    }
+
+    ReplayedGame* replayed;
+    while ((replayed = queue_pop(&g_replayed)) != NULL) {
+        size_t slot = (size_t)(replayed->index - next_index);
+        if (slot >= pending_capacity) {
+            size_t capacity = pending_capacity ? pending_capacity : 64;
+            while (capacity <= slot) {
+                capacity *= 2;
+            }
+            ReplayedGame** grown = calloc(capacity, sizeof(ReplayedGame*));
+            if (!grown) {
+                perror("calloc");
+                exit(1);
+            }
+            for (size_t i = 0; i < pending_capacity; i++) {
+                grown[i] = pending[(head + i) % pending_capacity];
+            }
+            free(pending);
+            pending = grown;
+            pending_capacity = capacity;
+            head = 0;
+        }
+        pending[(head + slot) % pending_capacity] = replayed;
+
+        while (pending[head]) {
+            ReplayedGame* game = pending[head];
+            pending[head] = NULL;
+            head = (head + 1) % pending_capacity;
+            next_index++;
+
+            for (size_t i = 0; i < game->count; i++) {
+                size_t which = (size_t)(next_random(&random_state) % g_mix);
+                Shard* shard = open[which];
+                if (!encode_record(&game->samples[i], game->result, shard->records + shard->count * RECORD_SIZE)) {
+                    continue;
+                }
+                samples++;
+                if (++shard->count == g_shard_size) {
+                    shard->index = shard_index++;
+                    queue_push(&g_shards, shard);
+                    open[which] = new_shard();
+                }
+            }
+            free(game->samples);
+            free(game);
+        }
+    }
+
+    for (size_t i = 0; i < g_mix; i++) {
+        if (open[i]->count > 0) {
+            open[i]->index = shard_index++;
+            queue_push(&g_shards, open[i]);
+        } else {
+            free(open[i]->records);
+            free(open[i]);
+        }
+    }
+    free(open);
+    free(pending);
+
+    pthread_mutex_lock(&g_stats_mutex);
+    g_samples = samples;
+    pthread_mutex_unlock(&g_stats_mutex);
+    queue_close(&g_shards);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Writer                                                                   */
+/* ------------------------------------------------------------------------ */
+
+static void shuffle_records(Shard* shard) {
+    uint64_t random_state = g_seed ^ ((shard->index + 1) * 0xA0761D6478BD642Full);
+    uint8_t tmp[RECORD_SIZE];
+    for (size_t i = shard->count; i > 1; i--) {
+        size_t j = (size_t)(next_random(&random_state) % i);
+        uint8_t* a = shard->records + (i - 1) * RECORD_SIZE;
+        uint8_t* b = shard->records + j * RECORD_SIZE;
+        memcpy(tmp, a, RECORD_SIZE);
+        memcpy(a, b, RECORD_SIZE);
+        memcpy(b, tmp, RECORD_SIZE);
+    }
+}
+
+static bool write_shard(const Shard* shard) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s-%05llu.bin", g_output, (unsigned long long)shard->index);
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    uint8_t header[16] = {'S', 'C', 'D', 'A', 'T', 'A', '0', '1', RECORD_SIZE, 0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+        header[12 + i] = (uint8_t)(shard->count >> (8 * i));
+    }
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+              fwrite(shard->records, RECORD_SIZE, shard->count, file) == shard->count;
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        perror(path);
+    }
+    return ok;
+}
+
+static void* writer_main(void* arg) {
+    (void)arg;
+    Shard* shard;
+    while ((shard = queue_pop(&g_shards)) != NULL) {
+        shuffle_records(shard);
+        bool ok = write_shard(shard);
+        pthread_mutex_lock(&g_stats_mutex);
+        if (ok) {
+            g_shards_written++;
+        } else {
+            g_write_failed = true;
+        }
+        pthread_mutex_unlock(&g_stats_mutex);
+        free(shard->records);
+        free(shard);
+    }
+    return NULL;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: simplechess_datagen --input PATH --output PREFIX [--workers N] [--shard-size N] [--mix N]\n"
+            "                           [--sample P] [--skip-plies N] [--seed N]\n");
+}
+
+int main(int argc, char** argv) {
+    const char* input_path = NULL;
+    int workers = 4;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        if (strcmp(argv[i], "--input") == 0) {
+            input_path = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0) {
+            g_output = argv[++i];
+        } else if (strcmp(argv[i], "--workers") == 0) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shard-size") == 0) {
+            g_shard_size = (size_t)strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--mix") == 0) {
+            g_mix = (size_t)strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--sample") == 0) {
+            g_sample = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--skip-plies") == 0) {
+            g_skip_plies = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            g_seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!input_path || !g_output || workers < 1 || g_shard_size < 1 || g_shard_size > UINT32_MAX || g_mix < 1 ||
+        g_sample <= 0.0 || g_skip_plies < 0) {
+        usage();
+        return 2;
+    }
+
+    FILE* input = strcmp(input_path, "-") == 0 ? stdin : fopen(input_path, "r");
+    if (!input) {
+        perror(input_path);
+        return 1;
+    }
+
+    queue_init(&g_games);
+    queue_init(&g_replayed);
+    queue_init(&g_shards);
+
+    uint64_t start = now_ns();
+    g_running_workers = workers;
+    pthread_t* replay_threads = calloc((size_t)workers, sizeof(pthread_t));
+    pthread_t encoder, writer;
+    for (int w = 0; w < workers; w++) {
+        pthread_create(&replay_threads[w], NULL, replay_main, NULL);
+    }
+    pthread_create(&encoder, NULL, encoder_main, NULL);
+    pthread_create(&writer, NULL, writer_main, NULL);
+
+    uint64_t games = read_archive(input);
+    queue_close(&g_games);
+    if (input != stdin) {
+        fclose(input);
+    }
+
+    for (int w = 0; w < workers; w++) {
+        pthread_join(replay_threads[w], NULL);
+    }
+    pthread_join(encoder, NULL);
+    pthread_join(writer, NULL);
+    free(replay_threads);
+
+    double elapsed = (double)(now_ns() - start) / 1e9;
+    printf("games:        %llu (%llu with illegal moves skipped)\n", (unsigned long long)games,
+           (unsigned long long)g_illegal_games);
+    printf("records:      %llu\n", (unsigned long long)g_samples);
+    printf("shards:       %llu\n", (unsigned long long)g_shards_written);
+    printf("elapsed:      %.2f s (%.0f games/s)\n", elapsed, elapsed > 0 ? (double)games / elapsed : 0.0);
+    return g_write_failed ? 1 : 0;
+}
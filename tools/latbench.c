@@ -0,0 +1,376 @@
+/**
+ * @file latbench.c
+ * @brief Per-call latency of the library under multi-threaded contention
+ *
+ * For each thread count, starts that many threads, each playing random
+ * games of its own through simplechess_make_move() and the move queries for
+ * a fixed time, and times every call. Latencies go into HDR-style
+ * histograms (log-linear buckets with 1/128 relative precision) per thread
+ * and per operation, merged at the end of the run, so the tail percentiles
+ * are exact to within a bucket however many calls were made.
+ *
+ * The games are independent, so with no shared state every call would cost
+ * the same at any thread count. Percentiles that grow with the thread
+ * count show contention, such as the allocator or a lock shared by the
+ * games. By default all threads share one game manager, as a server
+ * would; --manager-per-thread gives each thread its own.
+ *
+ * Usage: simplechess_latbench [--threads N,N,...] [--seconds N] [--plies N]
+ *                             [--generator default|bitboard]
+ *                             [--manager-per-thread]
+ */
+
+#define _GNU_SOURCE
+
+#include "simplechess/simplechess.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_MOVES 256
+#define MAX_THREADS 256
+
+/* Histogram buckets: values below 2^SUB_BITS nanoseconds have one bucket
+ * each, then every power of two is split into 2^SUB_BITS buckets. */
+#define SUB_BITS 7
+#define SUB_COUNT (1 << SUB_BITS)
+#define BUCKET_COUNT ((64 - SUB_BITS + 1) * SUB_COUNT)
+
+typedef struct {
+    uint64_t counts[BUCKET_COUNT];
+    uint64_t total;
+    uint64_t max;
+} Histogram;
+
+typedef enum {
+    OP_MAKE_MOVE,
+    OP_AVAILABLE_MOVES,
+    OP_STATE,
+    OP_COUNT
+} Operation;
+
+static const char* const op_names[OP_COUNT] = {"make_move", "available_moves", "get_state"};
+
+typedef struct {
+    pthread_t thread;
+    SimplechessGameManager manager;
+    uint64_t seed;
+    Histogram histograms[OP_COUNT];
+    uint64_t games;
+    bool failed;
+} Worker;
+
+static int g_plies = 120;
+static atomic_bool g_stop;
+static pthread_barrier_t g_start;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t next_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static size_t bucket_of(uint64_t value) {
+    if (value < SUB_COUNT) {
+        return (size_t)value;
+    }
+    int exponent = 63 - __builtin_clzll(value) - SUB_BITS;
+    return (size_t)(exponent + 1) * SUB_COUNT + (size_t)(value >> exponent) - SUB_COUNT;
+}
+
+/* The highest value that falls in the bucket. */
+static uint64_t bucket_value(size_t bucket) {
+    if (bucket < SUB_COUNT) {
+        return bucket;
+    }
+    int exponent = (int)(bucket / SUB_COUNT) - 1;
+    uint64_t mantissa = bucket % SUB_COUNT + SUB_COUNT;
+    return ((mantissa + 1) << exponent) - 1;
+}
+
+/* Checks that bucket_of() and bucket_value() are inverses: the highest
+ * value of every bucket maps back to it and the next value to the next
+ * bucket, so the buckets cover every value without gaps. */
+static bool check_buckets(void) {
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+        uint64_t value = bucket_value(bucket);
+        if (bucket_of(value) != bucket) {
+            fprintf(stderr, "value %llu of bucket %zu maps to bucket %zu\n", (unsigned long long)value, bucket,
+                    bucket_of(value));
+            return false;
+        }
+        if (bucket + 1 < BUCKET_COUNT && bucket_of(value + 1) != bucket + 1) {
+            fprintf(stderr, "value %llu after bucket %zu maps to bucket %zu\n", (unsigned long long)(value + 1),
+                    bucket, bucket_of(value + 1));
+            return false;
+        }
+    }
+    return bucket_value(BUCKET_COUNT - 1) == UINT64_MAX;
+}
+
+static void record(Histogram* histogram, uint64_t value) {
+    histogram->counts[bucket_of(value)]++;
+    histogram->total++;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+static void merge(Histogram* into, const Histogram* from) {
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        into->counts[i] += from->counts[i];
+    }
+    into->total += from->total;
+    if (from->max > into->max) {
+        into->max = from->max;
+    }
+}
+
+static double percentile_us(const Histogram* histogram, double fraction) {
+    if (histogram->total == 0) {
+        return 0.0;
+    }
+    uint64_t rank = (uint64_t)(fraction * (double)(histogram->total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint64_t value = bucket_value(i);
+            return (double)(value < histogram->max ? value : histogram->max) / 1000.0;
+        }
+    }
+    return (double)histogram->max / 1000.0;
+}
+
+/* Plays random games until told to stop, timing every library call. */
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    SimplechessPieceMove moves[MAX_MOVES];
+    SimplechessGame game = NULL;
+    int ply = 0;
+
+    pthread_barrier_wait(&g_start);
+    while (!atomic_load_explicit(&g_stop, memory_order_relaxed)) {
+        uint64_t start;
+        if (!game) {
+            if (simplechess_create_new_game(worker->manager, &game) != SIMPLECHESS_SUCCESS) {
+                worker->failed = true;
+                break;
+            }
+            worker->games++;
+            ply = 0;
+        }
+
+        SimplechessGameState state;
+        start = now_ns();
+        SimplechessResult result = simplechess_game_get_state(game, &state);
+        record(&worker->histograms[OP_STATE], now_ns() - start);
+        if (result != SIMPLECHESS_SUCCESS) {
+            worker->failed = true;
+            break;
+        }
+
+        size_t count = 0;
+        if (state == SIMPLECHESS_GAME_STATE_PLAYING && ply < g_plies) {
+            start = now_ns();
+            result = simplechess_game_get_available_moves_count(game, &count);
+            if (result == SIMPLECHESS_SUCCESS && count > 0) {
+                result = simplechess_game_get_available_moves(game, moves, MAX_MOVES);
+            }
+            record(&worker->histograms[OP_AVAILABLE_MOVES], now_ns() - start);
+            if (result != SIMPLECHESS_SUCCESS) {
+                worker->failed = true;
+                break;
+            }
+        }
+        if (count == 0) {
+            simplechess_game_destroy(game);
+            game = NULL;
+            continue;
+        }
+
+        SimplechessGame next;
+        const SimplechessPieceMove* move = &moves[next_random(&worker->seed) % count];
+        start = now_ns();
+        result = simplechess_make_move(worker->manager, game, move, false, &next);
+        record(&worker->histograms[OP_MAKE_MOVE], now_ns() - start);
+        if (result != SIMPLECHESS_SUCCESS) {
+            worker->failed = true;
+            break;
+        }
+        simplechess_game_destroy(game);
+        game = next;
+        ply++;
+    }
+
+    if (game) {
+        simplechess_game_destroy(game);
+    }
+    return NULL;
+}
+
+/* Runs one round with thread_count threads and prints its percentiles.
+ * Returns false if a call failed. */
+static bool run(int thread_count, int seconds, SimplechessMoveGenerator generator, bool manager_per_thread) {
+    Worker* workers = calloc((size_t)thread_count, sizeof(Worker));
+    Histogram* merged = calloc(OP_COUNT, sizeof(Histogram));
+    SimplechessGameManager shared = NULL;
+    bool ok = workers && merged;
+
+    if (ok && !manager_per_thread) {
+        ok = simplechess_game_manager_create_with_move_generator(generator, &shared) == SIMPLECHESS_SUCCESS;
+    }
+    for (int i = 0; ok && i < thread_count; i++) {
+        workers[i].seed = 0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1) | 1;
+        workers[i].manager = shared;
+        if (manager_per_thread) {
+            ok = simplechess_game_manager_create_with_move_generator(generator, &workers[i].manager) == SIMPLECHESS_SUCCESS;
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "cannot set up %d threads\n", thread_count);
+        free(workers);
+        free(merged);
+        return false;
+    }
+
+    atomic_store(&g_stop, false);
+    pthread_barrier_init(&g_start, NULL, (unsigned)thread_count + 1);
+    for (int i = 0; i < thread_count; i++) {
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+    pthread_barrier_wait(&g_start);
+    uint64_t start = now_ns();
+    sleep((unsigned)seconds);
+    atomic_store(&g_stop, true);
+
+    uint64_t games = 0;
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(workers[i].thread, NULL);
+        ok = ok && !workers[i].failed;
+        games += workers[i].games;
+        for (int op = 0; op < OP_COUNT; op++) {
+            merge(&merged[op], &workers[i].histograms[op]);
+        }
+        if (manager_per_thread) {
+            simplechess_game_manager_destroy(workers[i].manager);
+        }
+    }
+    double elapsed = (double)(now_ns() - start) / 1e9;
+    pthread_barrier_destroy(&g_start);
+    if (shared) {
+        simplechess_game_manager_destroy(shared);
+    }
+
+    for (int op = 0; op < OP_COUNT; op++) {
+        const Histogram* h = &merged[op];
+        printf("%7d %-16s %12.0f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n", thread_count, op_names[op],
+               (double)h->total / elapsed, percentile_us(h, 0.50), percentile_us(h, 0.90), percentile_us(h, 0.99),
+               percentile_us(h, 0.999), percentile_us(h, 0.9999), (double)h->max / 1000.0);
+    }
+    printf("%7s %-16s %12.0f\n", "", "games", (double)games / elapsed);
+    if (!ok) {
+        fprintf(stderr, "a library call failed with %d threads\n", thread_count);
+    }
+
+    free(workers);
+    free(merged);
+    return ok;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: simplechess_latbench [--threads N,N,...] [--seconds N] [--plies N] "
+                    "[--generator default|bitboard] [--manager-per-thread]\n");
+}
+
+int main(int argc, char** argv) {
+    int thread_counts[32];
+    int round_count = 0;
+    int seconds = 5;
+    SimplechessMoveGenerator generator = SIMPLECHESS_MOVE_GENERATOR_DEFAULT;
+    bool manager_per_thread = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--manager-per-thread") == 0) {
+            manager_per_thread = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        if (strcmp(argv[i], "--threads") == 0) {
+            char* p = argv[++i];
+            round_count = 0;
+            while (*p && round_count < 32) {
+                thread_counts[round_count++] = (int)strtol(p, &p, 10);
+                if (*p == ',') {
+                    p++;
+                }
+            }
+        } else if (strcmp(argv[i], "--seconds") == 0) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--plies") == 0) {
+            g_plies = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--generator") == 0) {
+            i++;
+            if (strcmp(argv[i], "default") == 0) {
+                generator = SIMPLECHESS_MOVE_GENERATOR_DEFAULT;
+            } else if (strcmp(argv[i], "bitboard") == 0) {
+                generator = SIMPLECHESS_MOVE_GENERATOR_BITBOARD;
+            } else {
+                usage();
+                return 2;
+            }
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    if (round_count == 0) {
+        // Powers of two up to the number of processors
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int n = 1; round_count < 32; n *= 2) {
+            thread_counts[round_count++] = n < processors ? n : (int)processors;
+            if (n >= processors) {
+                break;
+            }
+        }
+    }
+    for (int i = 0; i < round_count; i++) {
+        if (thread_counts[i] < 1 || thread_counts[i] > MAX_THREADS) {
+            usage();
+            return 2;
+        }
+    }
+    if (seconds < 1 || g_plies < 1) {
+        usage();
+        return 2;
+    }
+    if (!check_buckets()) {
+        return 1;
+    }
+
+    printf("%7s %-16s %12s %9s %9s %9s %9s %9s %9s\n", "threads", "operation", "calls/s", "p50 us", "p90 us",
+           "p99 us", "p99.9 us", "p99.99 us", "max us");
+    bool ok = true;
+    for (int i = 0; i < round_count; i++) {
+        ok = run(thread_counts[i], seconds, generator, manager_per_thread) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,370 @@
+/**
+ * @file loadgen.c
+ * @brief Load generator for the simplechess game server
+ *
+ * Opens a number of connections and plays a number of games on each, all
+ * pipelined: every game keeps one request in flight, so a connection has
+ * up to --games requests outstanding. A game plays random legal moves
+ * (asking the server for them) until it ends or reaches --plies, then is
+ * removed and replaced by a new one. At the end it reports throughput and
+ * the latency distribution of all requests.
+ *
+ * Usage: simplechess_loadgen [--socket PATH] [--connections N] [--games N]
+ *                            [--seconds N] [--plies N]
+ */
+
+#define _GNU_SOURCE
+
+#include "simplechess/simplechess.h"
+#include "protocol.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum {
+    STEP_CREATE,
+    STEP_MOVES,
+    STEP_MOVE,
+    STEP_REMOVE
+} Step;
+
+typedef struct {
+    uint64_t id;
+    Step step;
+    int plies;
+    uint64_t sent_at;
+    uint8_t move[3];
+} GameSlot;
+
+typedef struct {
+    pthread_t thread;
+    int index;
+    uint64_t* latencies;
+    size_t latency_count;
+    size_t latency_capacity;
+    uint64_t moves;
+    uint64_t games;
+    uint64_t errors;
+    bool failed;
+} Client;
+
+static const char* g_socket_path = "/tmp/simplechess.sock";
+static int g_games = 16;
+static int g_plies = 80;
+static uint64_t g_deadline;
+static uint64_t g_id_base;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t next_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static void record_latency(Client* client, uint64_t latency) {
+    if (client->latency_count == client->latency_capacity) {
+        client->latency_capacity = client->latency_capacity ? client->latency_capacity * 2 : 1 << 16;
+        client->latencies = realloc(client->latencies, client->latency_capacity * sizeof(uint64_t));
+        if (!client->latencies) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    client->latencies[client->latency_count++] = latency;
+}
+
+/* Appends the request for the current step of a game to out */
+static size_t put_request(uint8_t* out, uint32_t tag, const GameSlot* game) {
+    switch (game->step) {
+        case STEP_CREATE:
+            protocol_put_header(out, tag, OP_CREATE, 8);
+            protocol_put_u64(out + PROTOCOL_HEADER_SIZE, game->id);
+            return PROTOCOL_HEADER_SIZE + 8;
+        case STEP_MOVES:
+            protocol_put_header(out, tag, OP_MOVES, 8);
+            protocol_put_u64(out + PROTOCOL_HEADER_SIZE, game->id);
+            return PROTOCOL_HEADER_SIZE + 8;
+        case STEP_MOVE:
+            protocol_put_header(out, tag, OP_MOVE, 12);
+            protocol_put_u64(out + PROTOCOL_HEADER_SIZE, game->id);
+            memcpy(out + PROTOCOL_HEADER_SIZE + 8, game->move, 3);
+            out[PROTOCOL_HEADER_SIZE + 11] = 0;
+            return PROTOCOL_HEADER_SIZE + 12;
+        case STEP_REMOVE:
+            protocol_put_header(out, tag, OP_REMOVE, 8);
+            protocol_put_u64(out + PROTOCOL_HEADER_SIZE, game->id);
+            return PROTOCOL_HEADER_SIZE + 8;
+    }
+    return 0;
+}
+
+static bool write_all(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+/* Moves a game to its next step after a response; returns false once the
+ * game should stop sending because the run is over */
+static bool advance(Client* client, GameSlot* game, uint8_t status, const uint8_t* payload, uint32_t size,
+                    uint64_t* random_state, uint64_t* next_id) {
+    if (status != SIMPLECHESS_SUCCESS) {
+        client->errors++;
+    }
+
+    switch (game->step) {
+        case STEP_CREATE:
+            game->step = status == SIMPLECHESS_SUCCESS ? STEP_MOVES : STEP_CREATE;
+            if (status != SIMPLECHESS_SUCCESS) {
+                game->id = (*next_id)++;
+            }
+            break;
+        case STEP_MOVES: {
+            uint16_t count = size >= 2 ? protocol_get_u16(payload) : 0;
+            if (status != SIMPLECHESS_SUCCESS || count == 0 || size < 2u + 3u * count || game->plies >= g_plies) {
+                game->step = STEP_REMOVE;
+                break;
+            }
+            uint16_t pick = (uint16_t)(next_random(random_state) % count);
+            memcpy(game->move, payload + 2 + 3 * pick, 3);
+            game->step = STEP_MOVE;
+            break;
+        }
+        case STEP_MOVE:
+            if (status == SIMPLECHESS_SUCCESS) {
+                client->moves++;
+                game->plies++;
+            }
+            game->step = status == SIMPLECHESS_SUCCESS && size >= 1 && payload[0] == SIMPLECHESS_GAME_STATE_PLAYING
+                             ? STEP_MOVES
+                             : STEP_REMOVE;
+            break;
+        case STEP_REMOVE:
+            client->games++;
+            game->id = (*next_id)++;
+            game->plies = 0;
+            game->step = STEP_CREATE;
+            break;
+    }
+    return now_ns() < g_deadline;
+}
+
+static void* client_main(void* arg) {
+    Client* client = arg;
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, g_socket_path, sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        perror("connect");
+        client->failed = true;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    uint64_t random_state = 0x9E3779B97F4A7C15ull ^ (uint64_t)(client->index + 1) * 0xD1B54A32D192ED03ull;
+    uint64_t next_id = g_id_base + ((uint64_t)client->index << 24);
+    GameSlot* games = calloc((size_t)g_games, sizeof(GameSlot));
+    uint8_t* out = malloc((size_t)g_games * 32);
+    size_t in_capacity = 1 << 16;
+    uint8_t* in = malloc(in_capacity);
+    size_t in_length = 0;
+    size_t out_length = 0;
+    int outstanding = 0;
+
+    uint64_t start = now_ns();
+    for (int g = 0; g < g_games; g++) {
+        games[g].id = next_id++;
+        games[g].step = STEP_CREATE;
+        games[g].sent_at = start;
+        out_length += put_request(out + out_length, (uint32_t)g, &games[g]);
+        outstanding++;
+    }
+    if (!write_all(fd, out, out_length)) {
+        client->failed = true;
+        outstanding = 0;
+    }
+
+    while (outstanding > 0) {
+        ssize_t got = read(fd, in + in_length, in_capacity - in_length);
+        if (got <= 0) {
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            client->failed = true;
+            break;
+        }
+        in_length += (size_t)got;
+
+        // Answer every complete response, then send all follow-ups at once
+        size_t offset = 0;
+        out_length = 0;
+        uint64_t now = now_ns();
+        while (in_length - offset >= 4) {
+            uint32_t length = protocol_get_u32(in + offset);
+            if (in_length - offset < 4 + (size_t)length) {
+                break;
+            }
+            const uint8_t* frame = in + offset;
+            uint32_t tag = protocol_get_u32(frame + 4);
+            offset += 4 + (size_t)length;
+            if (tag >= (uint32_t)g_games || length < 5) {
+                client->failed = true;
+                outstanding = 0;
+                break;
+            }
+
+            GameSlot* game = &games[tag];
+            record_latency(client, now - game->sent_at);
+            outstanding--;
+            if (advance(client, game, frame[8], frame + PROTOCOL_HEADER_SIZE, length - 5, &random_state, &next_id)) {
+                game->sent_at = now;
+                out_length += put_request(out + out_length, tag, game);
+                outstanding++;
+            }
+        }
+        memmove(in, in + offset, in_length - offset);
+        in_length -= offset;
+        if (in_length == in_capacity) {
+            in_capacity *= 2;
+            in = realloc(in, in_capacity);
+        }
+        if (out_length > 0 && !write_all(fd, out, out_length)) {
+            client->failed = true;
+            break;
+        }
+    }
+
+    close(fd);
+    free(games);
+    free(out);
+    free(in);
+    return NULL;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_us(const uint64_t* sorted, size_t count, double fraction) {
+    if (count == 0) {
+        return 0.0;
+    }
+    size_t index = (size_t)(fraction * (double)(count - 1) + 0.5);
+    return (double)sorted[index] / 1000.0;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: simplechess_loadgen [--socket PATH] [--connections N] [--games N] [--seconds N] [--plies N]\n");
+}
+
+int main(int argc, char** argv) {
+    int connections = 4;
+    int seconds = 10;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        if (strcmp(argv[i], "--socket") == 0) {
+            g_socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--connections") == 0) {
+            connections = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--games") == 0) {
+            g_games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--plies") == 0) {
+            g_plies = atoi(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (connections < 1 || g_games < 1 || seconds < 1 || g_plies < 1) {
+        usage();
+        return 2;
+    }
+
+    // Ids unique to this run so several runs can share one server
+    g_id_base = ((uint64_t)(time(NULL) & 0xFFFF) << 48) | ((uint64_t)(getpid() & 0xFFFF) << 32);
+    uint64_t start = now_ns();
+    g_deadline = start + (uint64_t)seconds * 1000000000ull;
+
+    Client* clients = calloc((size_t)connections, sizeof(Client));
+    for (int c = 0; c < connections; c++) {
+        clients[c].index = c;
+        pthread_create(&clients[c].thread, NULL, client_main, &clients[c]);
+    }
+
+    size_t total = 0;
+    uint64_t moves = 0, games = 0, errors = 0;
+    int failed = 0;
+    for (int c = 0; c < connections; c++) {
+        pthread_join(clients[c].thread, NULL);
+        total += clients[c].latency_count;
+        moves += clients[c].moves;
+        games += clients[c].games;
+        errors += clients[c].errors;
+        failed += clients[c].failed ? 1 : 0;
+    }
+    double elapsed = (double)(now_ns() - start) / 1e9;
+
+    uint64_t* latencies = malloc((total ? total : 1) * sizeof(uint64_t));
+    size_t filled = 0;
+    for (int c = 0; c < connections; c++) {
+        memcpy(latencies + filled, clients[c].latencies, clients[c].latency_count * sizeof(uint64_t));
+        filled += clients[c].latency_count;
+        free(clients[c].latencies);
+    }
+    qsort(latencies, total, sizeof(uint64_t), compare_u64);
+
+    printf("connections      %d (%d games each)\n", connections, g_games);
+    printf("elapsed          %.2f s\n", elapsed);
+    printf("requests         %zu (%.0f/s)\n", total, (double)total / elapsed);
+    printf("moves            %llu (%.0f/s)\n", (unsigned long long)moves, (double)moves / elapsed);
+    printf("games finished   %llu\n", (unsigned long long)games);
+    printf("errors           %llu\n", (unsigned long long)errors);
+    printf("latency p50      %.1f us\n", percentile_us(latencies, total, 0.50));
+    printf("latency p99      %.1f us\n", percentile_us(latencies, total, 0.99));
+    printf("latency p99.9    %.1f us\n", percentile_us(latencies, total, 0.999));
+    printf("latency max      %.1f us\n", total ? (double)latencies[total - 1] / 1000.0 : 0.0);
+
+    free(latencies);
+    free(clients);
+    if (failed) {
+        fprintf(stderr, "simplechess_loadgen: %d connection(s) failed\n", failed);
+        return 1;
+    }
+    return 0;
+}
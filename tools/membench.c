@@ -0,0 +1,167 @@
+/**
+ * @file membench.c
+ * @brief Prints the memory held by a game as a function of its length
+ *
+ * Plays random games and measures them with simplechess_game_memory_usage
+ * at fixed plies, once with each move generator, then puts the games in a
+ * session store and measures the store. Games that end before a ply do not
+ * count for it. The bytes per ply column is the growth since the previous
+ * row, which is what a long game costs for each move it adds.
+ *
+ * With --compact K, the games keep a compact history with a checkpoint
+ * every K plies (see simplechess_game_manager_set_compact_history).
+ *
+ * Usage: simplechess_membench [--games N] [--seed N] [--compact K]
+ */
+
+#include "simplechess/simplechess.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_MOVES 256
+
+static const size_t checkpoints[] = {0, 10, 20, 40, 80, 120, 160, 200};
+#define CHECKPOINT_COUNT (sizeof(checkpoints) / sizeof(checkpoints[0]))
+#define MAX_PLIES 200
+
+typedef struct {
+    size_t games;
+    double bytes[2];
+} Row;
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* Plays one random game with both managers, adding the sizes at each
+ * checkpoint to rows. Returns the final game of the default manager. */
+static SimplechessGame play(SimplechessGameManager managers[2], uint64_t* seed, Row* rows) {
+    SimplechessGame games[2];
+    SimplechessPieceMove moves[MAX_MOVES];
+    size_t next_checkpoint = 0;
+
+    if (simplechess_create_new_game(managers[0], &games[0]) != SIMPLECHESS_SUCCESS
+        || simplechess_create_new_game(managers[1], &games[1]) != SIMPLECHESS_SUCCESS) {
+        fprintf(stderr, "cannot create a game\n");
+        exit(1);
+    }
+
+    for (size_t ply = 0; ply <= MAX_PLIES; ply++) {
+        if (next_checkpoint < CHECKPOINT_COUNT && checkpoints[next_checkpoint] == ply) {
+            Row* row = &rows[next_checkpoint++];
+            row->games++;
+            for (int i = 0; i < 2; i++) {
+                size_t bytes = 0;
+                simplechess_game_memory_usage(games[i], &bytes);
+                row->bytes[i] += (double)bytes;
+            }
+        }
+
+        size_t count = 0;
+        SimplechessGameState state;
+        simplechess_game_get_state(games[0], &state);
+        if (ply == MAX_PLIES || state != SIMPLECHESS_GAME_STATE_PLAYING
+            || simplechess_game_get_available_moves_count(games[0], &count) != SIMPLECHESS_SUCCESS || count == 0
+            || simplechess_game_get_available_moves(games[0], moves, MAX_MOVES) != SIMPLECHESS_SUCCESS) {
+            break;
+        }
+
+        const SimplechessPieceMove* move = &moves[next_random(seed) % count];
+        for (int i = 0; i < 2; i++) {
+            SimplechessGame next;
+            if (simplechess_make_move(managers[i], games[i], move, false, &next) != SIMPLECHESS_SUCCESS) {
+                fprintf(stderr, "move rejected\n");
+                exit(1);
+            }
+            simplechess_game_destroy(games[i]);
+            games[i] = next;
+        }
+    }
+
+    simplechess_game_destroy(games[1]);
+    return games[0];
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: simplechess_membench [--games N] [--seed N] [--compact K]\n");
+}
+
+int main(int argc, char** argv) {
+    size_t game_count = 32;
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    unsigned checkpoint_interval = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        if (strcmp(argv[i], "--games") == 0) {
+            game_count = (size_t)strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], NULL, 10) | 1;
+        } else if (strcmp(argv[i], "--compact") == 0) {
+            checkpoint_interval = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (game_count == 0) {
+        usage();
+        return 2;
+    }
+
+    SimplechessGameManager managers[2];
+    SimplechessSessionStore store;
+    if (simplechess_game_manager_create(&managers[0]) != SIMPLECHESS_SUCCESS
+        || simplechess_game_manager_create_with_move_generator(SIMPLECHESS_MOVE_GENERATOR_BITBOARD, &managers[1])
+               != SIMPLECHESS_SUCCESS
+        || simplechess_game_manager_set_compact_history(managers[0], checkpoint_interval) != SIMPLECHESS_SUCCESS
+        || simplechess_game_manager_set_compact_history(managers[1], checkpoint_interval) != SIMPLECHESS_SUCCESS
+        || simplechess_session_store_create(managers[0], 0, &store) != SIMPLECHESS_SUCCESS) {
+        fprintf(stderr, "cannot create the game managers\n");
+        return 1;
+    }
+
+    Row rows[CHECKPOINT_COUNT];
+    memset(rows, 0, sizeof(rows));
+    size_t total_plies = 0;
+    for (size_t i = 0; i < game_count; i++) {
+        SimplechessGame game = play(managers, &seed, rows);
+        size_t length = 0;
+        simplechess_game_get_history_length(game, &length);
+        total_plies += length - 1;
+        simplechess_session_store_insert(store, i, game);
+        simplechess_game_destroy(game);
+    }
+
+    printf("%6s %6s %14s %14s %14s %14s\n", "plies", "games", "default", "bitboard", "bytes/ply", "bytes/ply");
+    printf("%6s %6s %14s %14s %14s %14s\n", "", "", "bytes", "bytes", "default", "bitboard");
+    for (size_t i = 0; i < CHECKPOINT_COUNT && rows[i].games; i++) {
+        double average[2] = {rows[i].bytes[0] / rows[i].games, rows[i].bytes[1] / rows[i].games};
+        printf("%6zu %6zu %14.0f %14.0f", checkpoints[i], rows[i].games, average[0], average[1]);
+        if (i > 0 && rows[i - 1].games) {
+            double plies = (double)(checkpoints[i] - checkpoints[i - 1]);
+            for (int g = 0; g < 2; g++) {
+                double previous = rows[i - 1].bytes[g] / rows[i - 1].games;
+                printf(" %14.0f", (average[g] - previous) / plies);
+            }
+        }
+        printf("\n");
+    }
+
+    size_t store_bytes = 0;
+    simplechess_session_store_memory_usage(store, &store_bytes);
+    printf("\nsession store: %zu games, %zu plies, %zu bytes (%.0f per game)\n", game_count, total_plies, store_bytes,
+           (double)store_bytes / (double)game_count);
+
+    simplechess_session_store_destroy(store);
+    simplechess_game_manager_destroy(managers[0]);
+    simplechess_game_manager_destroy(managers[1]);
+    return 0;
+}
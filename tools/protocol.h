@@ -0,0 +1,96 @@
+/**
+ * @file protocol.h
+ * @brief Wire protocol of the simplechess game server
+ *
+ * Clients send request frames and receive response frames over a stream
+ * socket. Several requests may be in flight on one connection; responses
+ * carry the tag of their request and may come back in any order. All
+ * integers are little-endian.
+ *
+ *   request:   u32 length of the rest of the frame, u32 tag, u8 opcode,
+ *              payload
+ *   response:  u32 length of the rest of the frame, u32 tag, u8 status
+ *              (a SimplechessResult), payload
+ *
+ * Squares are encoded as (rank - 1) * 8 + (file - 'a'). Moves are three
+ * bytes: source square, destination square and the SimplechessPieceType of
+ * a promotion or PROTOCOL_NO_PROMOTION.
+ *
+ *   CREATE      u64 game id, FEN (rest of the frame; empty for the
+ *               standard position)                  -> no payload
+ *   MOVE        u64 game id, move, u8 flags          -> u8 game state
+ *   QUERY       u64 game id                          -> u8 game state,
+ *               u8 active color, FEN (rest of the frame)
+ *   MOVES       u64 game id                          -> u16 count, moves
+ *   CLAIM_DRAW  u64 game id                          -> u8 game state
+ *   RESIGN      u64 game id, u8 resigning color      -> u8 game state
+ *   REMOVE      u64 game id                          -> no payload
+ */
+
+#ifndef SIMPLECHESS_PROTOCOL_H
+#define SIMPLECHESS_PROTOCOL_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROTOCOL_HEADER_SIZE 9
+#define PROTOCOL_MAX_FRAME 1024
+#define PROTOCOL_NO_PROMOTION 0xFF
+#define PROTOCOL_FLAG_OFFER_DRAW 0x01
+
+typedef enum {
+    OP_CREATE = 1,
+    OP_MOVE = 2,
+    OP_QUERY = 3,
+    OP_MOVES = 4,
+    OP_CLAIM_DRAW = 5,
+    OP_RESIGN = 6,
+    OP_REMOVE = 7
+} ProtocolOpcode;
+
+static inline void protocol_put_u16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static inline void protocol_put_u32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static inline void protocol_put_u64(uint8_t* out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static inline uint16_t protocol_get_u16(const uint8_t* in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static inline uint32_t protocol_get_u32(const uint8_t* in) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+static inline uint64_t protocol_get_u64(const uint8_t* in) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+/* Writes a frame header; length counts the tag, the opcode or status and
+ * payload_size bytes of payload. */
+static inline void protocol_put_header(uint8_t* out, uint32_t tag, uint8_t code, uint32_t payload_size) {
+    protocol_put_u32(out, 5 + payload_size);
+    protocol_put_u32(out + 4, tag);
+    out[8] = code;
+}
+
+#endif /* SIMPLECHESS_PROTOCOL_H */
@@ -0,0 +1,699 @@
+/**
+ * @file server.c
+ * @brief Reference game server hosting live games behind a Unix socket
+ *
+ * One thread runs an epoll loop that accepts connections, reads request
+ * frames and writes responses (see protocol.h). Requests are handed to
+ * worker threads by game id, so every game is only ever touched by the
+ * worker that owns it and requests for different games proceed in
+ * parallel. A connection may pipeline any number of requests.
+ *
+ * With --log the server recovers its games from the log (and --snapshot)
+ * at startup, logs every change and acknowledges a batch of requests only
+ * once their changes are on disk. On SIGINT or SIGTERM it writes a
+ * checkpoint and exits.
+ *
+ * Usage: simplechess_server [--socket PATH] [--workers N] [--log PATH]
+ *                           [--snapshot PATH]
+ */
+
+#define _GNU_SOURCE
+
+#include "simplechess/simplechess.h"
+#include "protocol.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 256
+#define READ_CHUNK 65536
+
+typedef struct {
+    uint32_t slot;
+    uint32_t generation;
+    uint32_t tag;
+    uint8_t opcode;
+    uint32_t size;
+    uint8_t payload[];
+} Job;
+
+typedef struct {
+    uint32_t slot;
+    uint32_t generation;
+    uint32_t size;
+    uint8_t frame[];
+} Reply;
+
+typedef struct {
+    void** items;
+    size_t count;
+    size_t capacity;
+} PtrVector;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    PtrVector jobs;
+    PtrVector replies;
+    bool stop;
+} Worker;
+
+typedef struct {
+    int fd;
+    uint32_t generation;
+    uint8_t* in;
+    size_t in_length;
+    size_t in_capacity;
+    uint8_t* out;
+    size_t out_start;
+    size_t out_length;
+    size_t out_capacity;
+    bool writing;
+} Connection;
+
+static SimplechessGameManager g_manager;
+static SimplechessSessionStore g_store;
+static SimplechessMoveLog g_log;
+static int g_wake_fd;
+static Worker* g_workers;
+static size_t g_worker_count;
+
+static void ptr_vector_push(PtrVector* vector, void* item) {
+    if (vector->count == vector->capacity) {
+        vector->capacity = vector->capacity ? vector->capacity * 2 : 64;
+        vector->items = realloc(vector->items, vector->capacity * sizeof(void*));
+        if (!vector->items) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    vector->items[vector->count++] = item;
+}
+
+static void ptr_vector_swap(PtrVector* a, PtrVector* b) {
+    PtrVector t = *a;
+    *a = *b;
+    *b = t;
+}
+
+static SimplechessSquare square_from_index(uint8_t index) {
+    SimplechessSquare square = {(uint8_t)(index / 8 + 1), (char)('a' + index % 8)};
+    return square;
+}
+
+static uint8_t square_index(SimplechessSquare square) {
+    return (uint8_t)((square.rank - 1) * 8 + (square.file - 'a'));
+}
+
+/* Builds the full move from its wire form by looking up the moving piece */
+static SimplechessResult decode_move(uint64_t id, const uint8_t* wire, SimplechessPieceMove* move) {
+    SimplechessGame game;
+    SimplechessBoard board;
+    bool has_piece = false;
+
+    if (wire[0] > 63 || wire[1] > 63) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+    SimplechessResult result = simplechess_session_store_lookup(g_store, id, &game);
+    if (result != SIMPLECHESS_SUCCESS) {
+        return result;
+    }
+    result = simplechess_game_get_current_board(game, &board);
+    if (result == SIMPLECHESS_SUCCESS) {
+        result = simplechess_board_get_piece_at(board, square_from_index(wire[0]), &move->piece, &has_piece);
+        simplechess_board_destroy(board);
+    }
+    simplechess_game_destroy(game);
+    if (result != SIMPLECHESS_SUCCESS) {
+        return result;
+    }
+    if (!has_piece) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+
+    move->src = square_from_index(wire[0]);
+    move->dst = square_from_index(wire[1]);
+    move->is_promotion = wire[2] != PROTOCOL_NO_PROMOTION;
+    move->promoted_type = move->is_promotion ? (SimplechessPieceType)wire[2] : SIMPLECHESS_PIECE_TYPE_PAWN;
+    return SIMPLECHESS_SUCCESS;
+}
+
+/* Runs one request and writes its response payload; returns the status */
+static SimplechessResult run_job(const Job* job, uint8_t* payload, uint32_t* payload_size) {
+    SimplechessGameState state;
+    SimplechessResult result;
+    SimplechessGame game;
+    *payload_size = 0;
+
+    if (job->size < 8) {
+        return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+    uint64_t id = protocol_get_u64(job->payload);
+
+    switch (job->opcode) {
+        case OP_CREATE: {
+            char fen[PROTOCOL_MAX_FRAME];
+            size_t length = job->size - 8;
+            memcpy(fen, job->payload + 8, length);
+            fen[length] = '\0';
+            return simplechess_session_store_create_game(g_store, id, length ? fen : NULL);
+        }
+
+        case OP_MOVE: {
+            SimplechessPieceMove move;
+            if (job->size != 12) {
+                return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+            }
+            result = decode_move(id, job->payload + 8, &move);
+            if (result == SIMPLECHESS_SUCCESS) {
+                bool offer_draw = (job->payload[11] & PROTOCOL_FLAG_OFFER_DRAW) != 0;
+                result = simplechess_session_store_make_move(g_store, id, &move, offer_draw, &state);
+            }
+            if (result == SIMPLECHESS_SUCCESS) {
+                payload[0] = (uint8_t)state;
+                *payload_size = 1;
+            }
+            return result;
+        }
+
+        case OP_QUERY: {
+            SimplechessColor color;
+            result = simplechess_session_store_lookup(g_store, id, &game);
+            if (result != SIMPLECHESS_SUCCESS) {
+                return result;
+            }
+            result = simplechess_game_get_state(game, &state);
+            if (result == SIMPLECHESS_SUCCESS) {
+                result = simplechess_game_get_active_color(game, &color);
+            }
+            if (result == SIMPLECHESS_SUCCESS) {
+                result = simplechess_game_get_current_fen(game, (char*)payload + 2, PROTOCOL_MAX_FRAME - 2);
+            }
+            simplechess_game_destroy(game);
+            if (result == SIMPLECHESS_SUCCESS) {
+                payload[0] = (uint8_t)state;
+                payload[1] = (uint8_t)color;
+                *payload_size = 2 + (uint32_t)strlen((char*)payload + 2);
+            }
+            return result;
+        }
+
+        case OP_MOVES: {
+            SimplechessPieceMove moves[256];
+            size_t count = 0;
+            result = simplechess_session_store_lookup(g_store, id, &game);
+            if (result != SIMPLECHESS_SUCCESS) {
+                return result;
+            }
+            result = simplechess_game_get_available_moves_count(game, &count);
+            if (result == SIMPLECHESS_SUCCESS && count > 256) {
+                result = SIMPLECHESS_ERROR_UNKNOWN;
+            }
+            if (result == SIMPLECHESS_SUCCESS && count > 0) {
+                result = simplechess_game_get_available_moves(game, moves, count);
+            }
+            simplechess_game_destroy(game);
+            if (result == SIMPLECHESS_SUCCESS) {
+                protocol_put_u16(payload, (uint16_t)count);
+                for (size_t i = 0; i < count; i++) {
+                    payload[2 + 3 * i] = square_index(moves[i].src);
+                    payload[3 + 3 * i] = square_index(moves[i].dst);
+                    payload[4 + 3 * i] = moves[i].is_promotion ? (uint8_t)moves[i].promoted_type : PROTOCOL_NO_PROMOTION;
+                }
+                *payload_size = (uint32_t)(2 + 3 * count);
+            }
+            return result;
+        }
+
+        case OP_CLAIM_DRAW:
+        case OP_RESIGN:
+            if (job->opcode == OP_CLAIM_DRAW) {
+                result = simplechess_session_store_claim_draw(g_store, id, &state);
+            } else if (job->size == 9 && job->payload[8] <= SIMPLECHESS_COLOR_BLACK) {
+                result = simplechess_session_store_resign(g_store, id, (SimplechessColor)job->payload[8], &state);
+            } else {
+                result = SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+            }
+            if (result == SIMPLECHESS_SUCCESS) {
+                payload[0] = (uint8_t)state;
+                *payload_size = 1;
+            }
+            return result;
+
+        case OP_REMOVE:
+            return simplechess_session_store_remove(g_store, id);
+
+        default:
+            return SIMPLECHESS_ERROR_INVALID_ARGUMENT;
+    }
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    PtrVector batch = {0};
+    PtrVector done = {0};
+    uint8_t payload[PROTOCOL_MAX_FRAME];
+
+    while (true) {
+        pthread_mutex_lock(&worker->lock);
+        while (worker->jobs.count == 0 && !worker->stop) {
+            pthread_cond_wait(&worker->ready, &worker->lock);
+        }
+        if (worker->jobs.count == 0) {
+            pthread_mutex_unlock(&worker->lock);
+            break;
+        }
+        ptr_vector_swap(&batch, &worker->jobs);
+        pthread_mutex_unlock(&worker->lock);
+
+        for (size_t i = 0; i < batch.count; i++) {
+            Job* job = batch.items[i];
+            uint32_t payload_size;
+            SimplechessResult status = run_job(job, payload, &payload_size);
+
+            Reply* reply = malloc(sizeof(Reply) + PROTOCOL_HEADER_SIZE + payload_size);
+            if (!reply) {
+                perror("malloc");
+                exit(1);
+            }
+            reply->slot = job->slot;
+            reply->generation = job->generation;
+            reply->size = PROTOCOL_HEADER_SIZE + payload_size;
+            protocol_put_header(reply->frame, job->tag, (uint8_t)status, payload_size);
+            memcpy(reply->frame + PROTOCOL_HEADER_SIZE, payload, payload_size);
+            ptr_vector_push(&done, reply);
+            free(job);
+        }
+        batch.count = 0;
+
+        // One sync makes the whole batch durable before it is acknowledged
+        if (g_log && simplechess_move_log_sync(g_log) != SIMPLECHESS_SUCCESS) {
+            fprintf(stderr, "simplechess_server: failed to write the move log\n");
+            exit(1);
+        }
+
+        pthread_mutex_lock(&worker->lock);
+        for (size_t i = 0; i < done.count; i++) {
+            ptr_vector_push(&worker->replies, done.items[i]);
+        }
+        pthread_mutex_unlock(&worker->lock);
+        done.count = 0;
+
+        uint64_t one = 1;
+        if (write(g_wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            perror("write");
+        }
+    }
+
+    free(batch.items);
+    free(done.items);
+    return NULL;
+}
+
+static void reserve(uint8_t** buffer, size_t* capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return;
+    }
+    size_t grown = *capacity ? *capacity : 4096;
+    while (grown < needed) {
+        grown *= 2;
+    }
+    *buffer = realloc(*buffer, grown);
+    if (!*buffer) {
+        perror("realloc");
+        exit(1);
+    }
+    *capacity = grown;
+}
+
+static void close_connection(int epoll_fd, Connection* connection) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+    close(connection->fd);
+    connection->fd = -1;
+    connection->generation++;
+    connection->in_length = 0;
+    connection->out_start = 0;
+    connection->out_length = 0;
+    connection->writing = false;
+}
+
+/* Writes as much as the socket takes and watches for writability if some
+ * is left. Returns false if the connection failed. */
+static bool flush_connection(int epoll_fd, Connection* connection) {
+    while (connection->out_start < connection->out_length) {
+        ssize_t n = write(connection->fd, connection->out + connection->out_start,
+                          connection->out_length - connection->out_start);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        connection->out_start += (size_t)n;
+    }
+    if (connection->out_start == connection->out_length) {
+        connection->out_start = 0;
+        connection->out_length = 0;
+    }
+
+    bool writing = connection->out_length > 0;
+    if (writing != connection->writing) {
+        struct epoll_event event = {0};
+        event.events = EPOLLIN | (writing ? EPOLLOUT : 0);
+        event.data.fd = connection->fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+        connection->writing = writing;
+    }
+    return true;
+}
+
+/* Splits the buffered input into jobs, one batch per worker. Returns false
+ * on a malformed frame. */
+static bool read_frames(Connection* connection, uint32_t slot, PtrVector* pending) {
+    size_t offset = 0;
+    while (connection->in_length - offset >= 4) {
+        uint32_t length = protocol_get_u32(connection->in + offset);
+        if (length < 5 || length > PROTOCOL_MAX_FRAME) {
+            return false;
+        }
+        if (connection->in_length - offset < 4 + (size_t)length) {
+            break;
+        }
+
+        const uint8_t* frame = connection->in + offset;
+        uint32_t size = length - 5;
+        Job* job = malloc(sizeof(Job) + size);
+        if (!job) {
+            perror("malloc");
+            exit(1);
+        }
+        job->slot = slot;
+        job->generation = connection->generation;
+        job->tag = protocol_get_u32(frame + 4);
+        job->opcode = frame[8];
+        job->size = size;
+        memcpy(job->payload, frame + PROTOCOL_HEADER_SIZE, size);
+
+        uint64_t id = size >= 8 ? protocol_get_u64(job->payload) : 0;
+        ptr_vector_push(&pending[id % g_worker_count], job);
+        offset += 4 + (size_t)length;
+    }
+
+    memmove(connection->in, connection->in + offset, connection->in_length - offset);
+    connection->in_length -= offset;
+    return true;
+}
+
+static void dispatch(PtrVector* pending) {
+    for (size_t w = 0; w < g_worker_count; w++) {
+        if (pending[w].count == 0) {
+            continue;
+        }
+        Worker* worker = &g_workers[w];
+        pthread_mutex_lock(&worker->lock);
+        for (size_t i = 0; i < pending[w].count; i++) {
+            ptr_vector_push(&worker->jobs, pending[w].items[i]);
+        }
+        pthread_cond_signal(&worker->ready);
+        pthread_mutex_unlock(&worker->lock);
+        pending[w].count = 0;
+    }
+}
+
+static int listen_on(const char* path) {
+    struct sockaddr_un address = {0};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "simplechess_server: socket path too long\n");
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: simplechess_server [--socket PATH] [--workers N] [--log PATH] [--snapshot PATH]\n");
+}
+
+int main(int argc, char** argv) {
+    const char* socket_path = "/tmp/simplechess.sock";
+    const char* log_path = NULL;
+    const char* snapshot_path = NULL;
+    long workers = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--socket") == 0) {
+            socket_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--workers") == 0) {
+            workers = strtol(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--log") == 0) {
+            log_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--snapshot") == 0) {
+            snapshot_path = argv[++i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (workers < 1) {
+        workers = 1;
+    }
+    if (snapshot_path && !log_path) {
+        usage();
+        return 2;
+    }
+    g_worker_count = (size_t)workers;
+
+    // Block the signals before any thread starts so all threads inherit the
+    // mask and they are only ever seen through signalfd. Background jobs
+    // start with SIGINT ignored, which would discard it.
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0) {
+        perror("signalfd");
+        return 1;
+    }
+
+    if (simplechess_game_manager_create(&g_manager) != SIMPLECHESS_SUCCESS ||
+        simplechess_session_store_create(g_manager, g_worker_count * 16, &g_store) != SIMPLECHESS_SUCCESS) {
+        fprintf(stderr, "simplechess_server: failed to create the game store\n");
+        return 1;
+    }
+    if (log_path) {
+        if (simplechess_move_log_recover(g_store, snapshot_path, log_path, g_worker_count) != SIMPLECHESS_SUCCESS ||
+            simplechess_move_log_open(log_path, &g_log) != SIMPLECHESS_SUCCESS) {
+            fprintf(stderr, "simplechess_server: failed to recover from %s\n", log_path);
+            return 1;
+        }
+        simplechess_session_store_set_move_log(g_store, g_log);
+    }
+
+    int listen_fd = listen_on(socket_path);
+    if (listen_fd < 0) {
+        return 1;
+    }
+    g_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_wake_fd < 0) {
+        perror("eventfd");
+        return 1;
+    }
+
+    g_workers = calloc(g_worker_count, sizeof(Worker));
+    PtrVector* pending = calloc(g_worker_count, sizeof(PtrVector));
+    for (size_t w = 0; w < g_worker_count; w++) {
+        pthread_mutex_init(&g_workers[w].lock, NULL);
+        pthread_cond_init(&g_workers[w].ready, NULL);
+        pthread_create(&g_workers[w].thread, NULL, worker_main, &g_workers[w]);
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int watched[3] = {listen_fd, g_wake_fd, signal_fd};
+    for (int i = 0; i < 3; i++) {
+        struct epoll_event event = {0};
+        event.events = EPOLLIN;
+        event.data.fd = watched[i];
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, watched[i], &event);
+    }
+
+    Connection* connections = NULL;
+    size_t connection_count = 0;
+    PtrVector replies = {0};
+    bool running = true;
+    fprintf(stderr, "simplechess_server: listening on %s with %zu workers\n", socket_path, g_worker_count);
+
+    while (running) {
+        struct epoll_event events[MAX_EVENTS];
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int e = 0; e < n; e++) {
+            int fd = events[e].data.fd;
+
+            if (fd == signal_fd) {
+                struct signalfd_siginfo info;
+                while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+                    if (info.ssi_signo != SIGPIPE) {
+                        running = false;
+                    }
+                }
+            } else if (fd == listen_fd) {
+                int client;
+                while ((client = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    if ((size_t)client >= connection_count) {
+                        size_t grown = connection_count ? connection_count : 64;
+                        while (grown <= (size_t)client) {
+                            grown *= 2;
+                        }
+                        connections = realloc(connections, grown * sizeof(Connection));
+                        memset(connections + connection_count, 0, (grown - connection_count) * sizeof(Connection));
+                        for (size_t i = connection_count; i < grown; i++) {
+                            connections[i].fd = -1;
+                        }
+                        connection_count = grown;
+                    }
+                    connections[client].fd = client;
+                    struct epoll_event event = {0};
+                    event.events = EPOLLIN;
+                    event.data.fd = client;
+                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &event);
+                }
+            } else if (fd == g_wake_fd) {
+                uint64_t count;
+                if (read(g_wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                    perror("read");
+                }
+                for (size_t w = 0; w < g_worker_count; w++) {
+                    pthread_mutex_lock(&g_workers[w].lock);
+                    for (size_t i = 0; i < g_workers[w].replies.count; i++) {
+                        ptr_vector_push(&replies, g_workers[w].replies.items[i]);
+                    }
+                    g_workers[w].replies.count = 0;
+                    pthread_mutex_unlock(&g_workers[w].lock);
+                }
+
+                // Queue every reply first so each connection is written once
+                for (size_t i = 0; i < replies.count; i++) {
+                    Reply* reply = replies.items[i];
+                    Connection* connection = &connections[reply->slot];
+                    if (connection->fd >= 0 && connection->generation == reply->generation) {
+                        reserve(&connection->out, &connection->out_capacity, connection->out_length + reply->size);
+                        memcpy(connection->out + connection->out_length, reply->frame, reply->size);
+                        connection->out_length += reply->size;
+                    }
+                }
+                for (size_t i = 0; i < replies.count; i++) {
+                    Reply* reply = replies.items[i];
+                    Connection* connection = &connections[reply->slot];
+                    if (connection->fd >= 0 && connection->generation == reply->generation && !connection->writing &&
+                        !flush_connection(epoll_fd, connection)) {
+                        close_connection(epoll_fd, connection);
+                    }
+                    free(reply);
+                }
+                replies.count = 0;
+            } else {
+                Connection* connection = &connections[fd];
+                bool alive = true;
+
+                if (events[e].events & EPOLLOUT) {
+                    alive = flush_connection(epoll_fd, connection);
+                }
+                if (alive && (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                    while (true) {
+                        reserve(&connection->in, &connection->in_capacity, connection->in_length + READ_CHUNK);
+                        ssize_t got = read(fd, connection->in + connection->in_length, READ_CHUNK);
+                        if (got > 0) {
+                            connection->in_length += (size_t)got;
+                            continue;
+                        }
+                        if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                            alive = false;
+                        }
+                        break;
+                    }
+                    if (!read_frames(connection, (uint32_t)fd, pending)) {
+                        alive = false;
+                    }
+                }
+                if (!alive) {
+                    close_connection(epoll_fd, connection);
+                }
+            }
+        }
+        dispatch(pending);
+    }
+
+    for (size_t w = 0; w < g_worker_count; w++) {
+        pthread_mutex_lock(&g_workers[w].lock);
+        g_workers[w].stop = true;
+        pthread_cond_signal(&g_workers[w].ready);
+        pthread_mutex_unlock(&g_workers[w].lock);
+        pthread_join(g_workers[w].thread, NULL);
+        for (size_t i = 0; i < g_workers[w].replies.count; i++) {
+            free(g_workers[w].replies.items[i]);
+        }
+        free(g_workers[w].jobs.items);
+        free(g_workers[w].replies.items);
+    }
+    for (size_t i = 0; i < connection_count; i++) {
+        if (connections[i].fd >= 0) {
+            close(connections[i].fd);
+        }
+        free(connections[i].in);
+        free(connections[i].out);
+    }
+
+    int status = 0;
+    if (g_log) {
+        if (snapshot_path && simplechess_move_log_checkpoint(g_log, g_store, snapshot_path) != SIMPLECHESS_SUCCESS) {
+            fprintf(stderr, "simplechess_server: failed to write checkpoint %s\n", snapshot_path);
+            status = 1;
+        }
+        simplechess_session_store_set_move_log(g_store, NULL);
+        simplechess_move_log_close(g_log);
+    }
+    unlink(socket_path);
+    simplechess_session_store_destroy(g_store);
+    simplechess_game_manager_destroy(g_manager);
+    free(connections);
+    free(pending);
+    free(replies.items);
+    free(g_workers);
+    return status;
+}